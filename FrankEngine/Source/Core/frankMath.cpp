@@ -15,7 +15,7 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 // random seed
-unsigned int FrankRand::randomSeed = 0;
+__declspec(thread) unsigned int FrankRand::randomSeed = 0;
 
 float FrankRand::GetGaussian(float variance, float mean)
 {
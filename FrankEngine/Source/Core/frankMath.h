@@ -197,6 +197,7 @@ struct Color : D3DXCOLOR
 struct FrankRand
 {
 	static void SetSeed(unsigned int newSeed);
+	static unsigned int GetSeed() { return randomSeed; }
 	static unsigned int GetInt();
 	static int GetInt(int min, int max);
 	static float GetFloat();
@@ -212,7 +213,8 @@ private:
 	// make sure no one can create an object of this type
 	FrankRand() {}
 
-	static unsigned int randomSeed;
+	// each thread has it's own seed, worker threads must set a seed before use
+	static __declspec(thread) unsigned int randomSeed;
 	static const unsigned int maxRand = 0xffffffff;
 };
 
@@ -253,6 +255,10 @@ struct GameTimer
 	static void SetLeftOverGlobal(float _extraTime)	{ extraTime = _extraTime; }
 	static float GetTimeGlobal()					{ return gameTime/conversion; }
 
+	// exact global time, used to save and restore snapshots
+	static long long GetTicksGlobal()				{ return gameTime; }
+	static void SetTicksGlobal(long long ticks)		{ gameTime = ticks; }
+
 protected:
 
 	float GetTimeInternal() const					{ ASSERT(IsValid()); return (gameTime - startTime)/conversion + extraTime; }
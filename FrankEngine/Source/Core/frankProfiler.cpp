@@ -53,6 +53,14 @@ void FrankProfiler::Render()
 			g_textHelper->SetInsertionPos( x, insertionPos.y );
 			g_textHelper->SetForegroundColor( entry.color );
 			g_textHelper->DrawTextLine( entry.name);
+
+			if (entry.isCounter)
+			{
+				// counters just show the last value they were set to
+				g_textHelper->SetInsertionPos( x + nameGapSize, insertionPos.y );
+				g_textHelper->DrawFormattedTextLine( L"%d", entry.count );
+				continue;
+			}
 			
 			g_textHelper->SetInsertionPos( x + nameGapSize, insertionPos.y );
 			g_textHelper->DrawFormattedTextLine( L"%.5f", 1000*entry.timeAverage );
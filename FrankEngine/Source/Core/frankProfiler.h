@@ -15,6 +15,9 @@
 // use this macro to easily add profile entries
 #define FrankProfilerEntryDefine(name, color, sortOrder) FrankProfilerEntryDefineInternal1(name, color, sortOrder, __COUNTER__)
 
+// use this macro to show a count in the profiler instead of a time
+#define FrankProfilerCounterSet(name, color, sortOrder, value) FrankProfilerCounterSetInternal1(name, color, sortOrder, value, __COUNTER__)
+
 ////////////////////////////////////////////////////////////////////////////////////////
 
 struct FrankProfilerEntry;
@@ -46,12 +49,15 @@ struct FrankProfilerEntry
 		sortOrder(_sortOrder),
 		time(0),
 		timeAverage(0),
-		timeHigh(0)
+		timeHigh(0),
+		count(0),
+		isCounter(false)
 	{
 		FrankProfiler::AddEntry(*this);
 	}
 
 	void AddTime(float deltaTime) { time += deltaTime; }
+	void SetCount(int _count) { count = _count; isCounter = true; }
 	static bool SortCompare(FrankProfilerEntry* first, FrankProfilerEntry* second) { return (first->sortOrder < second->sortOrder); }
 
 	const WCHAR* name;
@@ -61,6 +67,8 @@ struct FrankProfilerEntry
 	float timeAverage;
 	float timeHigh;
 	GameTimer timerHighTimer;
+	int count;
+	bool isCounter;
 };
 
 struct FrankProfilerBlockTimer
@@ -80,4 +88,9 @@ struct FrankProfilerBlockTimer
 static FrankProfilerEntry _profilerEntry##id(name, color, sortOrder);	\
 	FrankProfilerBlockTimer _profilerBlock##id(_profilerEntry##id);
 
+#define FrankProfilerCounterSetInternal1(name, color, sortOrder, value, id) FrankProfilerCounterSetInternal2(name, color, sortOrder, value, id)
+#define FrankProfilerCounterSetInternal2(name, color, sortOrder, value, id)	\
+static FrankProfilerEntry _profilerCounter##id(name, color, sortOrder);	\
+	_profilerCounter##id.SetCount(value);
+
 #endif // FRANK_PROFILER_H
\ No newline at end of file
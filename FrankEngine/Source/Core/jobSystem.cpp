@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Job System
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../core/jobSystem.h"
+#include <process.h>
+
+JobSystem* g_jobSystem = NULL;
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+JobSystem::JobSystem(int threadCount) :
+	task(NULL),
+	itemCount(0),
+	nextItem(0),
+	nextThreadIndex(0),
+	activeWorkers(0),
+	stopThreads(false)
+{
+	if (threadCount <= 0)
+		threadCount = GetCoreCount();
+	threadCount = Min(threadCount, MAXIMUM_WAIT_OBJECTS + 1);
+
+	startSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	doneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	// the calling thread counts as one of the threads
+	for (int i = 1; i < threadCount; ++i)
+	{
+		HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, WorkerThreadEntry, this, 0, NULL);
+		if (thread)
+			threads.push_back(thread);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	ASSERT(!task);
+
+	stopThreads = true;
+	if (!threads.empty())
+	{
+		ReleaseSemaphore(startSemaphore, (LONG)threads.size(), NULL);
+		WaitForMultipleObjects(threads.size(), &threads[0], TRUE, INFINITE);
+	}
+	for (vector<HANDLE>::iterator it = threads.begin(); it != threads.end(); ++it)
+		CloseHandle(*it);
+	threads.clear();
+
+	CloseHandle(startSemaphore);
+	CloseHandle(doneEvent);
+}
+
+int JobSystem::GetCoreCount()
+{
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	return Max((int)systemInfo.dwNumberOfProcessors, 1);
+}
+
+int JobSystem::GetThreadCount(int maxThreads) const
+{
+	const int threadCount = threads.size() + 1;
+	return maxThreads > 0? Min(threadCount, maxThreads) : threadCount;
+}
+
+void JobSystem::ParallelFor(JobTask& _task, int count, int maxThreads)
+{
+	ASSERT(!task);
+	if (count <= 0)
+		return;
+
+	const int threadCount = Min(GetThreadCount(maxThreads), count);
+	if (threadCount <= 1)
+	{
+		// not worth waking anyone up
+		for (int i = 0; i < count; ++i)
+			_task.Run(i, 0);
+		return;
+	}
+
+	task = &_task;
+	itemCount = count;
+	nextItem = 0;
+	nextThreadIndex = 1;
+	activeWorkers = threadCount - 1;
+	ReleaseSemaphore(startSemaphore, threadCount - 1, NULL);
+
+	// help out while waiting
+	RunItems(0);
+	WaitForSingleObject(doneEvent, INFINITE);
+
+	task = NULL;
+}
+
+void JobSystem::RunItems(int threadIndex)
+{
+	while (true)
+	{
+		const LONG index = InterlockedIncrement(&nextItem) - 1;
+		if (index >= itemCount)
+			break;
+
+		task->Run(index, threadIndex);
+	}
+}
+
+unsigned __stdcall JobSystem::WorkerThreadEntry(void* data)
+{
+	static_cast<JobSystem*>(data)->WorkerThread();
+	return 0;
+}
+
+void JobSystem::WorkerThread()
+{
+	while (true)
+	{
+		WaitForSingleObject(startSemaphore, INFINITE);
+		if (stopThreads)
+			break;
+
+		// only as many workers as needed are woken, so indices stay below the thread count
+		const int threadIndex = InterlockedIncrement(&nextThreadIndex) - 1;
+		RunItems(threadIndex);
+
+		if (InterlockedDecrement(&activeWorkers) == 0)
+			SetEvent(doneEvent);
+	}
+}
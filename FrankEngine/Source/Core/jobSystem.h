@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Job System
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- persistent pool of worker threads for splitting up per frame work
+	- the calling thread also runs items while it waits
+	- items are claimed one at a time so uneven work balances out
+	- thread indices are from 0 to the thread count, 0 is always the calling thread
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+
+extern class JobSystem* g_jobSystem;
+
+// derive from this to run work on the job system
+class JobTask
+{
+public:
+
+	virtual ~JobTask() {}
+
+	// called once for each item, may be called from any thread
+	virtual void Run(int index, int threadIndex) = 0;
+};
+
+class JobSystem : private Uncopyable
+{
+public:
+
+	// thread count includes the calling thread, 0 for one per core
+	JobSystem(int threadCount = 0);
+	~JobSystem();
+
+	// run every item of the task and wait for them all to finish
+	// max threads limits how many threads are used, 0 for all of them
+	// this is not reentrant, tasks must not call it
+	void ParallelFor(JobTask& task, int count, int maxThreads = 0);
+
+	// how many threads ParallelFor will use with max threads
+	int GetThreadCount(int maxThreads = 0) const;
+
+	static int GetCoreCount();
+
+private:
+
+	void RunItems(int threadIndex);
+	void WorkerThread();
+
+	static unsigned __stdcall WorkerThreadEntry(void* data);
+
+	vector<HANDLE> threads;
+	HANDLE startSemaphore;				// released once for each worker needed
+	HANDLE doneEvent;					// signaled when the last worker finishes
+	JobTask* volatile task;				// task currently being run
+	volatile LONG itemCount;
+	volatile LONG nextItem;				// next item to be claimed
+	volatile LONG nextThreadIndex;		// next thread index to be claimed by a worker
+	volatile LONG activeWorkers;		// workers still running items
+	volatile bool stopThreads;
+};
+
+#endif // JOB_SYSTEM_H
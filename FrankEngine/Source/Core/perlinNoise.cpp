@@ -10,6 +10,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace PerlineNoise
 {
@@ -28,6 +32,15 @@ namespace PerlineNoise
 
 	static void init(void);
 
+	void Init(unsigned int seed)
+	{
+		const unsigned int oldSeed = FrankRand::GetSeed();
+		FrankRand::SetSeed(seed? seed : 1);
+		init();
+		FrankRand::SetSeed(oldSeed);
+		start = 0;
+	}
+
 	#define s_curve(t) ( t * t * (3. - 2. * t) )
 
 	#define lerp(t, a, b) ( a + t * (b - a) )
@@ -202,4 +215,370 @@ namespace PerlineNoise
 				g3[B + i][j] = g3[i][j];
 		}
 	}
-}
\ No newline at end of file
+
+	////////////////////////////////////////////////////////////////////////////////////////
+	/*
+		batched noise
+		- evaluates several points at once using sse2, or avx2 when compiled for it
+		- matches the scalar functions except the s curve is done in float instead of double
+	*/
+	////////////////////////////////////////////////////////////////////////////////////////
+
+	#define batchSize 256	// points processed per chunk when scaling for octaves and grids
+
+	// smooth step and lerp on 4 lanes
+	static inline __m128 s_curve4(__m128 t)
+	{ return _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3), _mm_add_ps(t, t))); }
+	static inline __m128 lerp4(__m128 t, __m128 a, __m128 b)
+	{ return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a))); }
+
+	// split 4 coordinates into lattice indices and fractions, same as the setup macro
+	static inline void setup4(const float* vec, __m128i& b0, __m128i& b1, __m128& r0, __m128& r1)
+	{
+		const __m128 t = _mm_add_ps(_mm_loadu_ps(vec), _mm_set1_ps((float)N));
+		const __m128i ti = _mm_cvttps_epi32(t);
+		b0 = _mm_and_si128(ti, _mm_set1_epi32(BM));
+		b1 = _mm_and_si128(_mm_add_epi32(b0, _mm_set1_epi32(1)), _mm_set1_epi32(BM));
+		r0 = _mm_sub_ps(t, _mm_cvtepi32_ps(ti));
+		r1 = _mm_sub_ps(r0, _mm_set1_ps(1));
+	}
+
+	static void noise2x4(const float* x, const float* y, float* result)
+	{
+		__m128i bx0, bx1, by0, by1;
+		__m128 rx0, rx1, ry0, ry1;
+		setup4(x, bx0, bx1, rx0, rx1);
+		setup4(y, by0, by1, ry0, ry1);
+
+		// sse2 has no gather so the permutation lookups are done per lane
+		__declspec(align(16)) int bx0a[4], bx1a[4], by0a[4], by1a[4];
+		_mm_store_si128((__m128i*)bx0a, bx0);
+		_mm_store_si128((__m128i*)bx1a, bx1);
+		_mm_store_si128((__m128i*)by0a, by0);
+		_mm_store_si128((__m128i*)by1a, by1);
+
+		__declspec(align(16)) float q[8][4];
+		for (int k = 0; k < 4; ++k)
+		{
+			const int i = p[ bx0a[k] ];
+			const int j = p[ bx1a[k] ];
+			const float* q00 = g2[ p[ i + by0a[k] ] ];
+			const float* q10 = g2[ p[ j + by0a[k] ] ];
+			const float* q01 = g2[ p[ i + by1a[k] ] ];
+			const float* q11 = g2[ p[ j + by1a[k] ] ];
+			q[0][k] = q00[0]; q[1][k] = q00[1];
+			q[2][k] = q10[0]; q[3][k] = q10[1];
+			q[4][k] = q01[0]; q[5][k] = q01[1];
+			q[6][k] = q11[0]; q[7][k] = q11[1];
+		}
+
+		const __m128 sx = s_curve4(rx0);
+		const __m128 sy = s_curve4(ry0);
+
+		#define at2x4(rx, ry, n) _mm_add_ps(_mm_mul_ps(rx, _mm_load_ps(q[n])), _mm_mul_ps(ry, _mm_load_ps(q[n+1])))
+		const __m128 a = lerp4(sx, at2x4(rx0, ry0, 0), at2x4(rx1, ry0, 2));
+		const __m128 b = lerp4(sx, at2x4(rx0, ry1, 4), at2x4(rx1, ry1, 6));
+		_mm_storeu_ps(result, lerp4(sy, a, b));
+	}
+
+	static void noise3x4(const float* x, const float* y, const float* z, float* result)
+	{
+		__m128i bx0, bx1, by0, by1, bz0, bz1;
+		__m128 rx0, rx1, ry0, ry1, rz0, rz1;
+		setup4(x, bx0, bx1, rx0, rx1);
+		setup4(y, by0, by1, ry0, ry1);
+		setup4(z, bz0, bz1, rz0, rz1);
+
+		__declspec(align(16)) int bx0a[4], bx1a[4], by0a[4], by1a[4], bz0a[4], bz1a[4];
+		_mm_store_si128((__m128i*)bx0a, bx0);
+		_mm_store_si128((__m128i*)bx1a, bx1);
+		_mm_store_si128((__m128i*)by0a, by0);
+		_mm_store_si128((__m128i*)by1a, by1);
+		_mm_store_si128((__m128i*)bz0a, bz0);
+		_mm_store_si128((__m128i*)bz1a, bz1);
+
+		__declspec(align(16)) float q[24][4];
+		for (int k = 0; k < 4; ++k)
+		{
+			const int i = p[ bx0a[k] ];
+			const int j = p[ bx1a[k] ];
+			const int b00 = p[ i + by0a[k] ];
+			const int b10 = p[ j + by0a[k] ];
+			const int b01 = p[ i + by1a[k] ];
+			const int b11 = p[ j + by1a[k] ];
+			const int corners[8] = 
+			{
+				b00 + bz0a[k], b10 + bz0a[k], b01 + bz0a[k], b11 + bz0a[k],
+				b00 + bz1a[k], b10 + bz1a[k], b01 + bz1a[k], b11 + bz1a[k]
+			};
+			for (int c = 0; c < 8; ++c)
+			{
+				q[3*c+0][k] = g3[ corners[c] ][0];
+				q[3*c+1][k] = g3[ corners[c] ][1];
+				q[3*c+2][k] = g3[ corners[c] ][2];
+			}
+		}
+
+		const __m128 t = s_curve4(rx0);
+		const __m128 sy = s_curve4(ry0);
+		const __m128 sz = s_curve4(rz0);
+
+		#define at3x4(rx, ry, rz, n) _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, _mm_load_ps(q[3*n])), _mm_mul_ps(ry, _mm_load_ps(q[3*n+1]))), _mm_mul_ps(rz, _mm_load_ps(q[3*n+2])))
+		__m128 a = lerp4(t, at3x4(rx0, ry0, rz0, 0), at3x4(rx1, ry0, rz0, 1));
+		__m128 b = lerp4(t, at3x4(rx0, ry1, rz0, 2), at3x4(rx1, ry1, rz0, 3));
+		const __m128 c = lerp4(sy, a, b);
+
+		a = lerp4(t, at3x4(rx0, ry0, rz1, 4), at3x4(rx1, ry0, rz1, 5));
+		b = lerp4(t, at3x4(rx0, ry1, rz1, 6), at3x4(rx1, ry1, rz1, 7));
+		const __m128 d = lerp4(sy, a, b);
+
+		_mm_storeu_ps(result, lerp4(sz, c, d));
+	}
+
+#ifdef __AVX2__
+
+	// avx2 versions use 8 lanes and hardware gathers for the table lookups
+	static inline __m256 s_curve8(__m256 t)
+	{ return _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_sub_ps(_mm256_set1_ps(3), _mm256_add_ps(t, t))); }
+	static inline __m256 lerp8(__m256 t, __m256 a, __m256 b)
+	{ return _mm256_fmadd_ps(t, _mm256_sub_ps(b, a), a); }
+
+	static inline void setup8(const float* vec, __m256i& b0, __m256i& b1, __m256& r0, __m256& r1)
+	{
+		const __m256 t = _mm256_add_ps(_mm256_loadu_ps(vec), _mm256_set1_ps((float)N));
+		const __m256i ti = _mm256_cvttps_epi32(t);
+		b0 = _mm256_and_si256(ti, _mm256_set1_epi32(BM));
+		b1 = _mm256_and_si256(_mm256_add_epi32(b0, _mm256_set1_epi32(1)), _mm256_set1_epi32(BM));
+		r0 = _mm256_sub_ps(t, _mm256_cvtepi32_ps(ti));
+		r1 = _mm256_sub_ps(r0, _mm256_set1_ps(1));
+	}
+
+	static inline __m256 at2x8(__m256 rx, __m256 ry, __m256i b)
+	{
+		const __m256i index = _mm256_slli_epi32(b, 1);
+		const __m256 qx = _mm256_i32gather_ps(&g2[0][0], index, 4);
+		const __m256 qy = _mm256_i32gather_ps(&g2[0][1], index, 4);
+		return _mm256_fmadd_ps(rx, qx, _mm256_mul_ps(ry, qy));
+	}
+
+	static inline __m256 at3x8(__m256 rx, __m256 ry, __m256 rz, __m256i b)
+	{
+		const __m256i index = _mm256_mullo_epi32(b, _mm256_set1_epi32(3));
+		const __m256 qx = _mm256_i32gather_ps(&g3[0][0], index, 4);
+		const __m256 qy = _mm256_i32gather_ps(&g3[0][1], index, 4);
+		const __m256 qz = _mm256_i32gather_ps(&g3[0][2], index, 4);
+		return _mm256_fmadd_ps(rx, qx, _mm256_fmadd_ps(ry, qy, _mm256_mul_ps(rz, qz)));
+	}
+
+	static void noise2x8(const float* x, const float* y, float* result)
+	{
+		__m256i bx0, bx1, by0, by1;
+		__m256 rx0, rx1, ry0, ry1;
+		setup8(x, bx0, bx1, rx0, rx1);
+		setup8(y, by0, by1, ry0, ry1);
+
+		const __m256i i = _mm256_i32gather_epi32(p, bx0, 4);
+		const __m256i j = _mm256_i32gather_epi32(p, bx1, 4);
+		const __m256i b00 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by0), 4);
+		const __m256i b10 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by0), 4);
+		const __m256i b01 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by1), 4);
+		const __m256i b11 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by1), 4);
+
+		const __m256 sx = s_curve8(rx0);
+		const __m256 sy = s_curve8(ry0);
+		const __m256 a = lerp8(sx, at2x8(rx0, ry0, b00), at2x8(rx1, ry0, b10));
+		const __m256 b = lerp8(sx, at2x8(rx0, ry1, b01), at2x8(rx1, ry1, b11));
+		_mm256_storeu_ps(result, lerp8(sy, a, b));
+	}
+
+	static void noise3x8(const float* x, const float* y, const float* z, float* result)
+	{
+		__m256i bx0, bx1, by0, by1, bz0, bz1;
+		__m256 rx0, rx1, ry0, ry1, rz0, rz1;
+		setup8(x, bx0, bx1, rx0, rx1);
+		setup8(y, by0, by1, ry0, ry1);
+		setup8(z, bz0, bz1, rz0, rz1);
+
+		const __m256i i = _mm256_i32gather_epi32(p, bx0, 4);
+		const __m256i j = _mm256_i32gather_epi32(p, bx1, 4);
+		const __m256i b00 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by0), 4);
+		const __m256i b10 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by0), 4);
+		const __m256i b01 = _mm256_i32gather_epi32(p, _mm256_add_epi32(i, by1), 4);
+		const __m256i b11 = _mm256_i32gather_epi32(p, _mm256_add_epi32(j, by1), 4);
+
+		const __m256 t = s_curve8(rx0);
+		const __m256 sy = s_curve8(ry0);
+		const __m256 sz = s_curve8(rz0);
+
+		__m256 a = lerp8(t, at3x8(rx0, ry0, rz0, _mm256_add_epi32(b00, bz0)), at3x8(rx1, ry0, rz0, _mm256_add_epi32(b10, bz0)));
+		__m256 b = lerp8(t, at3x8(rx0, ry1, rz0, _mm256_add_epi32(b01, bz0)), at3x8(rx1, ry1, rz0, _mm256_add_epi32(b11, bz0)));
+		const __m256 c = lerp8(sy, a, b);
+
+		a = lerp8(t, at3x8(rx0, ry0, rz1, _mm256_add_epi32(b00, bz1)), at3x8(rx1, ry0, rz1, _mm256_add_epi32(b10, bz1)));
+		b = lerp8(t, at3x8(rx0, ry1, rz1, _mm256_add_epi32(b01, bz1)), at3x8(rx1, ry1, rz1, _mm256_add_epi32(b11, bz1)));
+		const __m256 d = lerp8(sy, a, b);
+
+		_mm256_storeu_ps(result, lerp8(sz, c, d));
+	}
+
+#endif // __AVX2__
+
+	void noise2(const float* x, const float* y, float* result, int count)
+	{
+		if (start) {
+			start = 0;
+			init();
+		}
+
+		int i = 0;
+#ifdef __AVX2__
+		for (; i + 8 <= count; i += 8)
+			noise2x8(x + i, y + i, result + i);
+#endif
+		for (; i + 4 <= count; i += 4)
+			noise2x4(x + i, y + i, result + i);
+
+		// scalar for whatever is left over
+		for (; i < count; ++i)
+		{
+			float vec[2] = { x[i], y[i] };
+			result[i] = noise2(vec);
+		}
+	}
+
+	void noise3(const float* x, const float* y, const float* z, float* result, int count)
+	{
+		if (start) {
+			start = 0;
+			init();
+		}
+
+		int i = 0;
+#ifdef __AVX2__
+		for (; i + 8 <= count; i += 8)
+			noise3x8(x + i, y + i, z + i, result + i);
+#endif
+		for (; i + 4 <= count; i += 4)
+			noise3x4(x + i, y + i, z + i, result + i);
+
+		for (; i < count; ++i)
+		{
+			float vec[3] = { x[i], y[i], z[i] };
+			result[i] = noise3(vec);
+		}
+	}
+
+	void noise2Grid(const Vector2& gridStart, const Vector2& step, int width, int height, float* result)
+	{
+		fbm2Grid(gridStart, step, width, height, result, 1);
+	}
+
+	float fbm(const Vector2& v, int octaves, float lacunarity, float gain)
+	{
+		float value = 0;
+		float frequency = 1;
+		float amplitude = 1;
+		for (int i = 0; i < octaves; ++i)
+		{
+			value += amplitude * noise(v * frequency);
+			frequency *= lacunarity;
+			amplitude *= gain;
+		}
+		return value;
+	}
+
+	void fbm2(const float* x, const float* y, float* result, int count, int octaves, float lacunarity, float gain)
+	{
+		__declspec(align(16)) float xScaled[batchSize];
+		__declspec(align(16)) float yScaled[batchSize];
+		__declspec(align(16)) float octave[batchSize];
+
+		for (int offset = 0; offset < count; offset += batchSize)
+		{
+			const int chunk = Min(count - offset, batchSize);
+			float* chunkResult = result + offset;
+			for (int i = 0; i < chunk; ++i)
+				chunkResult[i] = 0;
+
+			float frequency = 1;
+			float amplitude = 1;
+			for (int o = 0; o < octaves; ++o)
+			{
+				for (int i = 0; i < chunk; ++i)
+				{
+					xScaled[i] = x[offset + i] * frequency;
+					yScaled[i] = y[offset + i] * frequency;
+				}
+				noise2(xScaled, yScaled, octave, chunk);
+				for (int i = 0; i < chunk; ++i)
+					chunkResult[i] += amplitude * octave[i];
+
+				frequency *= lacunarity;
+				amplitude *= gain;
+			}
+		}
+	}
+
+	void fbm2Grid(const Vector2& gridStart, const Vector2& step, int width, int height, float* result, int octaves, float lacunarity, float gain)
+	{
+		__declspec(align(16)) float x[batchSize];
+		__declspec(align(16)) float y[batchSize];
+
+		// go a row at a time in chunks
+		for (int j = 0; j < height; ++j)
+		for (int offset = 0; offset < width; offset += batchSize)
+		{
+			const int chunk = Min(width - offset, batchSize);
+			for (int i = 0; i < chunk; ++i)
+			{
+				x[i] = gridStart.x + step.x * (offset + i);
+				y[i] = gridStart.y + step.y * j;
+			}
+			fbm2(x, y, result + width * j + offset, chunk, octaves, lacunarity, gain);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static void ConsoleCallback_noiseBenchmark(const wstring& text)
+{
+	int count = 100000;
+	swscanf_s(text.c_str(), L"%d", &count);
+	count = Max(count, 1);
+
+	vector<float> x(count), y(count), z(count), scalarResult(count), batchResult(count);
+	for (int i = 0; i < count; ++i)
+	{
+		x[i] = RAND_BETWEEN(-100.0f, 100.0f);
+		y[i] = RAND_BETWEEN(-100.0f, 100.0f);
+		z[i] = RAND_BETWEEN(-100.0f, 100.0f);
+	}
+
+	for (int dimensions = 2; dimensions <= 3; ++dimensions)
+	{
+		CDXUTTimer timer;
+		timer.Start();
+		for (int i = 0; i < count; ++i)
+		{
+			float vec[3] = { x[i], y[i], z[i] };
+			scalarResult[i] = (dimensions == 2)? PerlineNoise::noise2(vec) : PerlineNoise::noise3(vec);
+		}
+		const double scalarTime = timer.GetElapsedTime();
+
+		timer.Reset();
+		if (dimensions == 2)
+			PerlineNoise::noise2(&x[0], &y[0], &batchResult[0], count);
+		else
+			PerlineNoise::noise3(&x[0], &y[0], &z[0], &batchResult[0], count);
+		const double batchTime = timer.GetElapsedTime();
+
+		float maxError = 0;
+		for (int i = 0; i < count; ++i)
+			maxError = Max(maxError, fabs(scalarResult[i] - batchResult[i]));
+
+		GetDebugConsole().AddFormatted(L"noise%d scalar: %.2f million points/s", dimensions, count / (1000000 * Max(scalarTime, 1e-9)));
+		GetDebugConsole().AddFormatted(L"noise%d batch: %.2f million points/s, %.1fx, max error %g", dimensions, count / (1000000 * Max(batchTime, 1e-9)), scalarTime / Max(batchTime, 1e-9), maxError);
+	}
+}
+ConsoleCommand(ConsoleCallback_noiseBenchmark, noiseBenchmark);
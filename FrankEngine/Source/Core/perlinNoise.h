@@ -10,6 +10,10 @@
 
 namespace PerlineNoise
 {
+	// rebuild the tables from a seed so noise is the same every run
+	// tables are built on first use otherwise, this must be called before sampling from other threads
+	void Init(unsigned int seed);
+
 	double noise1(double arg);
 	float noise2(float vec[2]);
 	float noise3(float vec[3]);
@@ -17,6 +21,17 @@ namespace PerlineNoise
 	inline double noise(double arg)			{ return noise1(arg); }
 	inline float noise(const Vector2& v)	{ float p[2] = {v.x, v.y}; return noise2(p); }
 	inline float noise(const Vector3& v)	{ float p[3] = {v.x, v.y, v.z}; return noise3(p); }
+
+	// batched versions use simd to do several points at once
+	// results match the scalar functions to within float rounding
+	void noise2(const float* x, const float* y, float* result, int count);
+	void noise3(const float* x, const float* y, const float* z, float* result, int count);
+	void noise2Grid(const Vector2& start, const Vector2& step, int width, int height, float* result);
+
+	// fractal brownian motion, sum of octaves of noise
+	float fbm(const Vector2& v, int octaves, float lacunarity = 2, float gain = 0.5f);
+	void fbm2(const float* x, const float* y, float* result, int count, int octaves, float lacunarity = 2, float gain = 0.5f);
+	void fbm2Grid(const Vector2& start, const Vector2& step, int width, int height, float* result, int octaves, float lacunarity = 2, float gain = 0.5f);
 }
 
 #endif // PERLIN_NOISE_H
\ No newline at end of file
@@ -9,10 +9,6 @@
 #include "../terrain/terrain.h"
 #include "../editor/editor.h"
 
-#define saveStateDirectory	L"temp/"
-#define screenshotPrefix	L"terrain_"
-#define screenshotFileType	L"2dt"
-
 // the one and only game editor
 Editor g_editor;
 
@@ -38,9 +34,6 @@ Editor::Editor()
 	stateChanged = false;
 	isTileEdit = true;
 	isRectangleSelecting = false;
-	saveStateStart = 0;
-	saveStateEnd = 0;
-	saveStatePosition = 0;
 }
 
 void Editor::ResetEditor()
@@ -83,6 +76,7 @@ void Editor::Update()
 		else if (g_input->IsDown(GB_Control) && g_input->WasJustPushed(GB_Editor_Load))
 		{
 			g_terrain->Load(Terrain::terrainFilename);
+			SetStateChanged();
 			SaveState();
 			g_debugMessageSystem.Add(L"Loaded world file...", Color::Cyan());
 			g_debugMessageSystem.Add(Terrain::terrainFilename, Color::Cyan());
@@ -301,8 +295,8 @@ void Editor::Update()
 		}
 	}
 	
-	if (saveStateStart == 0 && saveStateEnd == 0)
-		g_editor.SaveState(); // hack save on startup
+	if (!undoJournal.HasSnapshot())
+		g_editor.SaveState(); // take the undo snapshot on startup
 	else if (!g_input->IsDown(GB_Tab) && (g_input->WasJustReleased(GB_MouseLeft)) || g_input->WasJustReleased(GB_MouseRight))
 		g_editor.SaveState(true);
 }
@@ -512,40 +506,20 @@ void Editor::Undo()
 	const bool hadTileSelection = tileEditor.HasSelection();
 	ClearSelection();
 
-	if (saveStatePosition == saveStateStart)
-		return;
-
+	// throw out anything that was not saved, undoing a selection just puts it back
+	undoJournal.RevertUncommitted();
 	if (!hadTileSelection)
-	{
-		saveStatePosition -= 1;
-		if (saveStatePosition < 0)
-			saveStatePosition = saveStatePosition + maxSaveStates;
-	}
+		undoJournal.Undo();
 
-	if (saveStatePosition != saveStateStart)
-	{
-		saveStatePosition -= 1;
-		if (saveStatePosition < 0)
-			saveStatePosition = saveStatePosition + maxSaveStates;
-	}
-
-	WCHAR* filename = GetUndoFilename(saveStatePosition);
-	g_terrain->Load(filename);
-	++saveStatePosition;
-	saveStatePosition = saveStatePosition%maxSaveStates;
+	stateChanged = false;
 }
 
 void Editor::Redo()
 {
 	ClearSelection();
-	
-	if (saveStatePosition == saveStateEnd)
-		return;
-
-	WCHAR* filename = GetUndoFilename(saveStatePosition);
-	g_terrain->Load(filename);
-	++saveStatePosition;
-	saveStatePosition = saveStatePosition%maxSaveStates;
+	undoJournal.RevertUncommitted();
+	undoJournal.Redo();
+	stateChanged = false;
 }
 
 void Editor::SaveState(bool onlyIfStateChanged)
@@ -553,25 +527,10 @@ void Editor::SaveState(bool onlyIfStateChanged)
 	if (tileEditor.HasSelection() || (onlyIfStateChanged && !stateChanged))
 		return;
 
-	WCHAR* filename = GetUndoFilename(saveStatePosition);
-	CreateDirectory(saveStateDirectory, NULL);
-	g_terrain->Save(filename);
-
-	++saveStatePosition;
-	saveStatePosition = saveStatePosition%maxSaveStates;
-	saveStateEnd = saveStatePosition;
-	if (saveStateStart == saveStateEnd)
-		saveStateStart = (saveStateEnd + 1)%maxSaveStates;
+	undoJournal.Commit();
 	stateChanged = false;
 }
 
-WCHAR* Editor::GetUndoFilename(int i)
-{
-	static WCHAR filename[256];
-	swprintf_s(filename, 256, saveStateDirectory screenshotPrefix L"%d." screenshotFileType, saveStatePosition);
-	return filename;
-}
-
 void Editor::ChangeDrawType(bool direction)
 {
 	if (isTileEdit)
@@ -579,17 +538,3 @@ void Editor::ChangeDrawType(bool direction)
 	else
 		objectEditor.ChangeDrawType(direction);
 }
-
-void Editor::ClearTempFolder()
-{
-	const WCHAR *filename = saveStateDirectory screenshotPrefix L"*";
-	
-	int failsafe = 0;
-	WIN32_FIND_DATA findData;
-	while (FindFirstFile(filename, &findData) != INVALID_HANDLE_VALUE && ++failsafe < 10000)
-	{
-		WCHAR filename[256];
-		swprintf_s(filename, 256, saveStateDirectory L"%s", findData.cFileName);
-		DeleteFile(filename);
-	}
-}
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include "../objects/gameObjectBuilder.h"
 #include "../editor/tileEditor.h"
 #include "../editor/objectEditor.h"
+#include "../editor/undoJournal.h"
 
 // this is the global object editor
 extern class Editor g_editor;
@@ -45,11 +46,12 @@ public:
 	void Undo();
 	void Redo();
 	void SaveState(bool onlyIfStateChanged=false);
-	void SetStateChanged()					{ stateChanged = true; }
+	void SetStateChanged()								{ stateChanged = true; undoJournal.MarkChanged(); g_terrain->SetNeedsSave(); }
+	void SetStateChanged(TerrainPatch& patch)			{ stateChanged = true; undoJournal.MarkChanged(patch); patch.SetNeedsSave(); }
+	void SetStateChanged(const Box2AABB& box)			{ stateChanged = true; undoJournal.MarkChanged(box); g_terrain->SetNeedsSave(box); }
+	UndoJournal& GetUndoJournal()						{ return undoJournal; }
 	void GetTerrainRenderWindow(int xPos, int yPos, int& xStart, int& xEnd, int& yStart, int& yEnd) const;
 
-	static void ClearTempFolder();
-
 	static int terrainRenderWindowSize;
 	static bool showGrid;
 	static Color gridColor;
@@ -58,23 +60,18 @@ public:
 
 private:
 
-	WCHAR* GetUndoFilename(int i);
 	void RenderPatch(const TerrainPatch& patch) const;
 	void RenderStubs(const TerrainPatch& patch) const;
 
 	TileEditor tileEditor;
 	ObjectEditor objectEditor;
+	UndoJournal undoJournal;
 
 	Box2AABB rectangleSelectBox;
 	bool isTileEdit;
 	bool isRectangleSelecting;
 	bool isMultiLayerSelecting;
 	bool stateChanged;
-	
-	int saveStateStart;
-	int saveStateEnd;
-	int saveStatePosition;
-	static const int maxSaveStates = 100;
 };
 
 #endif // EDITOR_H
\ No newline at end of file
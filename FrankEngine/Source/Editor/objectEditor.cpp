@@ -148,8 +148,12 @@ void ObjectEditor::Update(bool isActive)
 			//stub.type = newStubType;
 
 			// update attributes box in real time
+			char attributesOld[GameObjectStub::attributesLength];
+			strncpy_s(attributesOld, stub.attributes, GameObjectStub::attributesLength);
 			LPCWSTR attributes = g_editorGui.GetEditBoxText();
 			wcstombs_s(NULL, stub.attributes, GameObjectStub::attributesLength, attributes, GameObjectStub::attributesLength-1);	
+			if (strcmp(attributesOld, stub.attributes))
+				g_editor.SetStateChanged(stub.GetAABB());
 		}
 
 		for (list<GameObjectStub*>::iterator it = selectedStubs.begin(); it != selectedStubs.end(); ) 
@@ -304,8 +308,11 @@ void ObjectEditor::UpdateSelected(GameObjectStub* stub)
 		}
 	}
 		
-	if (stubCopy.xf != stub->xf || stub->size != stub->size)
-		g_editor.SetStateChanged();
+	if (stubCopy.xf != stub->xf || stubCopy.size != stub->size)
+	{
+		g_editor.SetStateChanged(stubCopy.GetAABB());
+		g_editor.SetStateChanged(stub->GetAABB());
+	}
 }
 
 void ObjectEditor::MoveSelectedStubs(const Vector2& offset)
@@ -348,6 +355,7 @@ GameObjectStub& ObjectEditor::MoveStub(GameObjectStub& stub, const Vector2& offs
 	}
 
 	stub.xf.position += offset;
+	g_editor.SetStateChanged(*patchOld);
 	if (patchOld == patchNew)
 		return stub;
 
@@ -360,7 +368,7 @@ GameObjectStub& ObjectEditor::MoveStub(GameObjectStub& stub, const Vector2& offs
 	if (isSelected)
 		selectedStubs.push_front(newStub);
 
-	g_editor.SetStateChanged();
+	g_editor.SetStateChanged(*patchNew);
 	return *newStub;
 }
 
@@ -386,6 +394,7 @@ void ObjectEditor::AddStub()
 
 	selectedStubs.clear();
 	GameObjectStub* newStub = patch->AddStub(newStubCopy);
+	g_editor.SetStateChanged(*patch);
 	g_editor.SaveState();
 	selectedStubs.push_back(newStub);
 	g_editorGui.NewObjectSelected();
@@ -429,6 +438,7 @@ void ObjectEditor::DeleteUnselected(const Box2AABB& _box)
 				continue;
 
 			patch.RemoveStub(&stub);
+			g_editor.SetStateChanged(patch);
 		}
 	}
 }
@@ -484,7 +494,10 @@ void ObjectEditor::RemoveSelected()
 			++it;
 
 			if (IsSelected(stub))
+			{
 				patch.RemoveStub(&stub);
+				g_editor.SetStateChanged(patch);
+			}
 		}
 	}
 	
@@ -599,6 +612,7 @@ void ObjectEditor::Paste(const Vector2& offset)
 
 		GameObjectStub* newStub = patch->AddStub(stub);
 		selectedStubs.push_front(newStub);
+		g_editor.SetStateChanged(*patch);
 	}
 
 	g_editorGui.NewObjectSelected();
@@ -151,7 +151,7 @@ void TileEditor::Update(bool isActive)
 				TerrainTile* tile = g_terrain->GetTile(mousePos, terrainLayer);
 				if (tile)
 					tile->MakeClear();
-				g_editor.SetStateChanged();
+				g_editor.SetStateChanged(mousePos);
 			}
 			else if 
 			(
@@ -164,7 +164,7 @@ void TileEditor::Update(bool isActive)
 				TerrainTile* tile = g_terrain->GetTile(mousePos, terrainLayer);
 				if (tile)
 					tile->SetTileSet(tileSet);
-				g_editor.SetStateChanged();
+				g_editor.SetStateChanged(mousePos);
 			}
 			else if (!blockEdit && g_input->IsDown(GB_Shift) && !g_input->IsDown(GB_Tab))
 			{
@@ -353,6 +353,7 @@ void TileEditor::Select(Box2AABB& box, bool allLayers)
 	}
 
 	selectedTilesPos = Vector2(pos0) * TerrainTile::GetSize() + g_terrain->GetPosWorld();
+	g_editor.SetStateChanged(box);
 
 	// create new tile buffer
 	// clear that space in the terrain
@@ -391,7 +392,7 @@ void TileEditor::ClearSelection(bool anchor)
 				*terrainTile = selectedTile;
 		}
 
-		g_editor.SetStateChanged();
+		g_editor.SetStateChanged(GetSelectionBox());
 	}
 
 	RemoveSelected();
@@ -413,22 +414,12 @@ void TileEditor::ClearClipboard()
 
 void TileEditor::FloodFill()
 {
-	const Vector2 mousePos = g_input->GetMousePosWorldSpace();
-	TerrainPatch* patch = g_terrain->GetPatch(mousePos);
-	if (!patch)
-		return;
-	
-	FloodFill(*patch, mousePos, drawSurface);
+	FloodFill(g_input->GetMousePosWorldSpace(), drawSurface);
 }
 
 void TileEditor::FloodErase()
 {
-	const Vector2 mousePos = g_input->GetMousePosWorldSpace();
-	TerrainPatch* patch = g_terrain->GetPatch(mousePos);
-	if (!patch)
-		return;
-
-	FloodFill(*patch, mousePos, 0);
+	FloodFill(g_input->GetMousePosWorldSpace(), 0);
 }
 
 void TileEditor::Cut()
@@ -569,90 +560,176 @@ void TileEditor::Resurface(TerrainPatch& patch, const Vector2& posA, const Vecto
 	}
 
 	if (stateChanged)
-		g_editor.SetStateChanged();
+		g_editor.SetStateChanged(patch);
 }
 
-// 0 == left, 1 == up, 2 == right, 3 == down, 
-void TileEditor::FloodFill(TerrainPatch& patch, const Vector2& testPos, BYTE surfaceData)
+struct FloodFillSeed
 {
-	int x, y;
-	TerrainTile* tile = patch.GetTile(testPos, x, y, terrainLayer);
-	if (!tile)
-		return;
+	FloodFillSeed(int _x, int _y, int _side) : x(_x), y(_y), side(_side) {}
 
-	const int startSurfaceSide = g_terrain->GetSurfaceSide(testPos, terrainLayer);
-	const BYTE startSurfaceData = tile->GetSurfaceData(startSurfaceSide);
+	int x, y;
+	int side;
+};
 
-	if (startSurfaceData == surfaceData)
-		return;
+struct FloodFillSpanTile
+{
+	FloodFillSpanTile(int _x, int _side, const TerrainTile& _tile) : x(_x), side(_side), tile(_tile) {}
 
-	FloodFillInternal(patch, x, y, surfaceData, startSurfaceData, startSurfaceSide);
-}
+	int x;
+	int side;
+	TerrainTile tile;		// copy from before it was filled, filling can change the shape
+};
 
+// which surfaces of the next tile are connected to a surface of this tile
 // 0 == left, 1 == up, 2 == right, 3 == down, 
-void TileEditor::FloodFillDirection(TerrainPatch& patch, int x, int y, int direction, BYTE surfaceData, BYTE startSurfaceData, int surfaceSide)
+static void FloodFillTouches(const TerrainTile& tile, int side, const TerrainTile& tileNext, int direction, bool touch[2])
 {
-	TerrainTile* tile = patch.GetTile(x, y, terrainLayer);
-	if (!tile)
-		return;
-
-	// figure out where the next tile in that direction is is
-	int xOffset = 0;
-	int yOffset = 0;
-	if (direction == 0)
-		xOffset = -1;
-	else if (direction == 1)
-		yOffset = 1;
-	else if (direction == 2)
-		xOffset = 1;
-	else if (direction == 3)
-		yOffset = -1;
-
-	int xNext = x + xOffset;
-	int yNext = y + yOffset;
-
-	TerrainTile* tileNext = patch.GetTile(xNext, yNext, terrainLayer);
-	if (!tileNext)
-		return;
+	const int xOffset = (direction == 0)? -1 : (direction == 2)? 1 : 0;
+	const int yOffset = (direction == 3)? -1 : (direction == 1)? 1 : 0;
+	tile.SurfaceTouches(tileNext, xOffset, yOffset, direction, side, touch[0], touch[1]);
 
-	bool surface0Touch, surface1Touch;
-	tile->SurfaceTouches(*tileNext, xOffset, yOffset, direction, surfaceSide, surface0Touch, surface1Touch);
-	if (surface0Touch)
-		FloodFillInternal(patch, xNext, yNext, surfaceData, startSurfaceData, 0);
-	if (surface1Touch)
-		FloodFillInternal(patch, xNext, yNext, surfaceData, startSurfaceData, 1);
+	// full tiles only use surface 0
+	if (tileNext.IsFull())
+	{
+		touch[0] = touch[0] || touch[1];
+		touch[1] = false;
+	}
 }
 
-void TileEditor::FloodFillInternal(TerrainPatch& patch, int x, int y, BYTE surfaceData, BYTE startSurfaceData, int surfaceSide)
+// iterative scanline fill over the whole terrain
+// fills a row of connected tiles at a time and seeds the rows above and below
+void TileEditor::FloodFill(const Vector2& testPos, BYTE surfaceData)
 {
-	TerrainTile* tile = patch.GetTile(x, y, terrainLayer);
-	if (!tile)
-		return;
-
-	// if we hit a tile with no surfaces in common with start then bail out
-	if (tile->GetSurfaceData(false) != startSurfaceData && (tile->IsFull() || tile->GetSurfaceData(true) != startSurfaceData))
+	int startX, startY;
+	TerrainTile* startTile = g_terrain->GetTile(testPos, startX, startY, terrainLayer);
+	if (!startTile)
 		return;
 
-	// stop if we have a tile with the correct surface
-	if (tile->GetSurfaceData(surfaceSide) == surfaceData)
-		return;
+	const int startSurfaceSide = startTile->IsFull()? 0 : g_terrain->GetSurfaceSide(testPos, terrainLayer);
+	const BYTE startSurfaceData = startTile->GetSurfaceData(startSurfaceSide);
 
-	// stop if we are full and surface 1 is the correct surface
-	if (tile->IsFull() && tile->GetSurfaceData(false) == surfaceData)
+	if (startSurfaceData == surfaceData)
 		return;
 
-	tile->SetSurfaceData(surfaceSide, surfaceData);
-	tile->SetTileSet(tileSet);
+	// filled surfaces no longer match the start surface so they act as the visited markers
+	// seeds are only added where a run starts, keeping the stack near the size of the fill perimeter
+	vector<FloodFillSeed> seeds;
+	vector<FloodFillSpanTile> span;
+	vector<bool> changedPatches(Terrain::fullSize*Terrain::fullSize, false);
+	seeds.push_back(FloodFillSeed(startX, startY, startSurfaceSide));
 
-	// if both sides of surface data are the same then wipe out edge data
-	if (tile->AreBothSurfacesEqual())
+	while (!seeds.empty())
 	{
-		tile->MakeFull();
-		tile->SetSurfaceData(true, 0);
+		const FloodFillSeed seed = seeds.back();
+		seeds.pop_back();
+
+		TerrainTile* seedTile = g_terrain->GetTile(seed.x, seed.y, terrainLayer);
+		if (!seedTile || seedTile->GetSurfaceData(seed.side) != startSurfaceData)
+			continue;
+
+		// walk left then right to find the connected run on this row
+		span.clear();
+		span.push_back(FloodFillSpanTile(seed.x, seed.side, *seedTile));
+		for (int direction = 0; direction <= 2; direction += 2)
+		{
+			if (direction == 2)
+			{
+				// put the left side in order so the run goes from left to right
+				for (int i = 0, j = (int)span.size() - 1; i < j; ++i, --j)
+				{
+					const FloodFillSpanTile temp = span[i];
+					span[i] = span[j];
+					span[j] = temp;
+				}
+			}
+
+			const int xOffset = (direction == 0)? -1 : 1;
+			FloodFillSpanTile current(seed.x, seed.side, *seedTile);
+			while (true)
+			{
+				const int xNext = current.x + xOffset;
+				const TerrainTile* tileNext = g_terrain->GetTile(xNext, seed.y, terrainLayer);
+				if (!tileNext)
+					break;
+
+				bool touch[2];
+				FloodFillTouches(current.tile, current.side, *tileNext, direction, touch);
+
+				// continue along the first matching surface, the other surface gets its own seed
+				int sideNext = -1;
+				for (int side = 0; side < 2; ++side)
+				{
+					if (!touch[side] || tileNext->GetSurfaceData(side) != startSurfaceData)
+						continue;
+					if (sideNext < 0)
+						sideNext = side;
+					else
+						seeds.push_back(FloodFillSeed(xNext, seed.y, side));
+				}
+
+				if (sideNext < 0)
+					break;
+
+				current = FloodFillSpanTile(xNext, sideNext, *tileNext);
+				span.push_back(current);
+			}
+		}
+
+		// fill the run
+		for (vector<FloodFillSpanTile>::const_iterator it = span.begin(); it != span.end(); ++it)
+		{
+			TerrainTile& tile = *g_terrain->GetTile(it->x, seed.y, terrainLayer);
+			tile.SetSurfaceData(it->side, surfaceData);
+			tile.SetTileSet(tileSet);
+
+			// if both sides of surface data are the same then wipe out edge data
+			if (tile.AreBothSurfacesEqual())
+			{
+				tile.MakeFull();
+				tile.SetSurfaceData(true, 0);
+			}
+
+			changedPatches[it->x / Terrain::patchSize + Terrain::fullSize * (seed.y / Terrain::patchSize)] = true;
+		}
+
+		// seed the rows above and below
+		for (int direction = 1; direction <= 3; direction += 2)
+		{
+			const int yNext = seed.y + ((direction == 1)? 1 : -1);
+			int lastFullSeedX = -2;
+			for (vector<FloodFillSpanTile>::const_iterator it = span.begin(); it != span.end(); ++it)
+			{
+				const TerrainTile* tileNext = g_terrain->GetTile(it->x, yNext, terrainLayer);
+				if (!tileNext)
+					continue;
+
+				bool touch[2];
+				FloodFillTouches(it->tile, it->side, *tileNext, direction, touch);
+				for (int side = 0; side < 2; ++side)
+				{
+					if (!touch[side] || tileNext->GetSurfaceData(side) != startSurfaceData)
+						continue;
+
+					// full tiles always connect to each other so the seed to the left will get this one
+					if (tileNext->IsFull())
+					{
+						const bool coveredByLastSeed = (lastFullSeedX == it->x - 1);
+						lastFullSeedX = it->x;
+						if (coveredByLastSeed)
+							continue;
+					}
+
+					seeds.push_back(FloodFillSeed(it->x, yNext, side));
+				}
+			}
+		}
 	}
 
-	FloodFillDirection(patch, x, y, 0, surfaceData, startSurfaceData, surfaceSide);
-	FloodFillDirection(patch, x, y, 1, surfaceData, startSurfaceData, surfaceSide);
-	FloodFillDirection(patch, x, y, 2, surfaceData, startSurfaceData, surfaceSide);
-	FloodFillDirection(patch, x, y, 3, surfaceData, startSurfaceData, surfaceSide);
-}
\ No newline at end of file
+	// mark every patch that changed once at the end
+	for (int x = 0; x < Terrain::fullSize; ++x)
+	for (int y = 0; y < Terrain::fullSize; ++y)
+	{
+		if (changedPatches[x + Terrain::fullSize * y])
+			g_editor.SetStateChanged(*g_terrain->GetPatch(x, y));
+	}
+}
@@ -65,9 +65,7 @@ private:
 	void Resurface(const Vector2& posA, const Vector2& posB, BYTE surfaceData);
 	void Resurface(TerrainPatch& patch, const Vector2& posA, const Vector2& posB, BYTE surfaceData);
 
-	void FloodFill(TerrainPatch& patch, const Vector2& testPos, BYTE surfaceData);
-	void FloodFillDirection(TerrainPatch& patch, int x, int y, int direction, BYTE surfaceData, BYTE startSurfaceData, int surfaceSide);
-	void FloodFillInternal(TerrainPatch& patch, int x, int y, BYTE surfaceData, BYTE startSurfaceData, int surfaceSide);
+	void FloodFill(const Vector2& testPos, BYTE surfaceData);
 	
 	Vector2 GetSnapLinePoint(const Vector2& pos, bool snapToGrid = false);
 
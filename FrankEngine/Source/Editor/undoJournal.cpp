@@ -0,0 +1,410 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Undo Journal
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../terrain/terrain.h"
+#include "../editor/undoJournal.h"
+
+// max memory for undo entries in kilobytes, oldest entries are evicted past this
+int UndoJournal::memoryLimit = 32*1024;
+ConsoleCommand(UndoJournal::memoryLimit, editorUndoMemoryLimit);
+
+UndoJournal::UndoJournal() :
+	shadowTiles(NULL),
+	shadowStubs(NULL),
+	changedPatches(NULL),
+	patchCount(0),
+	position(0),
+	memoryUsed(0)
+{
+}
+
+UndoJournal::~UndoJournal()
+{
+	Reset();
+}
+
+void UndoJournal::Reset()
+{
+	for (vector<Entry*>::iterator it = entries.begin(); it != entries.end(); ++it)
+		delete *it;
+	entries.clear();
+
+	SAFE_DELETE_ARRAY(shadowTiles);
+	SAFE_DELETE_ARRAY(shadowStubs);
+	SAFE_DELETE_ARRAY(changedPatches);
+	patchCount = 0;
+	position = 0;
+	memoryUsed = 0;
+}
+
+void UndoJournal::Snapshot()
+{
+	ASSERT(g_terrain);
+	Reset();
+
+	patchCount = Terrain::fullSize*Terrain::fullSize;
+	const int tileCount = Terrain::patchSize*Terrain::patchSize*Terrain::patchLayers;
+	shadowTiles = new TerrainTile[patchCount*tileCount];
+	shadowStubs = new list<GameObjectStub>[patchCount];
+	changedPatches = new bool[patchCount];
+
+	for (int i = 0; i < patchCount; ++i)
+	{
+		const TerrainPatch& patch = GetPatch(i);
+		memcpy(&shadowTiles[i*tileCount], patch.tiles, tileCount*sizeof(TerrainTile));
+		shadowStubs[i] = patch.objectStubs;
+		changedPatches[i] = false;
+	}
+}
+
+TerrainPatch& UndoJournal::GetPatch(int patchIndex) const
+{
+	ASSERT(patchIndex >= 0 && patchIndex < patchCount);
+	return *g_terrain->GetPatch(patchIndex % Terrain::fullSize, patchIndex / Terrain::fullSize);
+}
+
+TerrainTile& UndoJournal::GetShadowTile(int patchIndex, int x, int y, int layer) const
+{
+	ASSERT(TerrainPatch::IsTileIndexValid(x, y, layer));
+	const int tileCount = Terrain::patchSize*Terrain::patchSize*Terrain::patchLayers;
+	return shadowTiles[patchIndex*tileCount + Terrain::patchSize*Terrain::patchSize*layer + Terrain::patchSize*x + y];
+}
+
+void UndoJournal::MarkChanged()
+{
+	for (int i = 0; i < patchCount; ++i)
+		changedPatches[i] = true;
+}
+
+void UndoJournal::MarkChanged(const TerrainPatch& patch)
+{
+	if (!changedPatches)
+		return;
+
+	const IntVector2 offset = g_terrain->GetPatchOffset(patch.GetCenter());
+	if (!Terrain::IsPatchIndexInvalid(offset.x, offset.y))
+		changedPatches[offset.x + Terrain::fullSize*offset.y] = true;
+}
+
+void UndoJournal::MarkChanged(const Box2AABB& _box)
+{
+	if (!changedPatches)
+		return;
+
+	const Box2AABB box = _box.SortBounds();
+	const IntVector2 offset0 = g_terrain->GetPatchOffset(box.lowerBound);
+	const IntVector2 offset1 = g_terrain->GetPatchOffset(box.upperBound);
+	for (int x = Max(offset0.x, 0); x <= Min(offset1.x, Terrain::fullSize-1); ++x)
+	for (int y = Max(offset0.y, 0); y <= Min(offset1.y, Terrain::fullSize-1); ++y)
+		changedPatches[x + Terrain::fullSize*y] = true;
+}
+
+void UndoJournal::RefreshShadow(const TerrainPatch& patch)
+{
+	if (!shadowTiles)
+		return;
+
+	const IntVector2 offset = g_terrain->GetPatchOffset(patch.GetCenter());
+	if (Terrain::IsPatchIndexInvalid(offset.x, offset.y))
+		return;
+
+	const int patchIndex = offset.x + Terrain::fullSize*offset.y;
+	const int tileCount = Terrain::patchSize*Terrain::patchSize*Terrain::patchLayers;
+	memcpy(&shadowTiles[patchIndex*tileCount], patch.tiles, tileCount*sizeof(TerrainTile));
+	shadowStubs[patchIndex] = patch.objectStubs;
+}
+
+bool UndoJournal::Commit()
+{
+	if (!shadowTiles)
+	{
+		// first commit just takes the snapshot to diff against
+		Snapshot();
+		return false;
+	}
+
+	Entry* entry = new Entry;
+	entry->memory = sizeof(Entry);
+	vector<BYTE> xorBuffer;
+
+	for (int i = 0; i < patchCount; ++i)
+	{
+		if (!changedPatches[i])
+			continue;
+		changedPatches[i] = false;
+
+		TerrainPatch& patch = GetPatch(i);
+		PatchDelta delta;
+		delta.patchIndex = i;
+		delta.tileMin = IntVector2(Terrain::patchSize, Terrain::patchSize);
+		delta.tileMax = IntVector2(-1, -1);
+		delta.stubsChanged = false;
+
+		// find the rectangle of tiles that changed on any layer
+		for(int l=0; l<Terrain::patchLayers; ++l)
+		for(int x=0; x<Terrain::patchSize; ++x)
+		for(int y=0; y<Terrain::patchSize; ++y)
+		{
+			if (!memcmp(&patch.GetTileLocal(x, y, l), &GetShadowTile(i, x, y, l), sizeof(TerrainTile)))
+				continue;
+
+			delta.tileMin.x = Min(delta.tileMin.x, x);
+			delta.tileMin.y = Min(delta.tileMin.y, y);
+			delta.tileMax.x = Max(delta.tileMax.x, x);
+			delta.tileMax.y = Max(delta.tileMax.y, y);
+		}
+
+		const bool tilesChanged = (delta.tileMax.x >= 0);
+		if (tilesChanged)
+		{
+			// xor before and after so one buffer works for both undo and redo
+			const IntVector2 size = delta.tileMax - delta.tileMin + IntVector2(1, 1);
+			xorBuffer.resize(size.x*size.y*Terrain::patchLayers*sizeof(TerrainTile));
+			BYTE* xorData = &xorBuffer[0];
+			for(int l=0; l<Terrain::patchLayers; ++l)
+			for(int x=delta.tileMin.x; x<=delta.tileMax.x; ++x)
+			for(int y=delta.tileMin.y; y<=delta.tileMax.y; ++y)
+			{
+				TerrainTile& shadowTile = GetShadowTile(i, x, y, l);
+				const BYTE* after = (const BYTE*)&patch.GetTileLocal(x, y, l);
+				const BYTE* before = (const BYTE*)&shadowTile;
+				for (int b = 0; b < (int)sizeof(TerrainTile); ++b)
+					*(xorData++) = before[b] ^ after[b];
+
+				shadowTile = patch.GetTileLocal(x, y, l);
+			}
+
+			CompressDelta(&xorBuffer[0], xorBuffer.size(), delta.tileDelta);
+		}
+
+		SerializeStubs(shadowStubs[i], delta.stubsBefore);
+		SerializeStubs(patch.objectStubs, delta.stubsAfter);
+		delta.stubsChanged = (delta.stubsBefore != delta.stubsAfter);
+		if (delta.stubsChanged)
+			shadowStubs[i] = patch.objectStubs;
+		else
+		{
+			delta.stubsBefore.clear();
+			delta.stubsAfter.clear();
+		}
+
+		if (!tilesChanged && !delta.stubsChanged)
+			continue;
+
+		entry->memory += sizeof(PatchDelta) + delta.tileDelta.size() + delta.stubsBefore.size() + delta.stubsAfter.size();
+		entry->deltas.push_back(delta);
+	}
+
+	if (entry->deltas.empty())
+	{
+		// nothing actually changed
+		delete entry;
+		return false;
+	}
+
+	// new entry wipes out anything that could be redone
+	while ((int)entries.size() > position)
+	{
+		DeleteEntry(entries.back());
+		entries.pop_back();
+	}
+
+	entries.push_back(entry);
+	memoryUsed += entry->memory;
+	++position;
+
+	// evict oldest entries when over the limit, always keep the newest one
+	while (memoryUsed > memoryLimit*1024 && entries.size() > 1)
+	{
+		DeleteEntry(entries.front());
+		entries.erase(entries.begin());
+		--position;
+	}
+
+	return true;
+}
+
+void UndoJournal::DeleteEntry(Entry* entry)
+{
+	memoryUsed -= entry->memory;
+	delete entry;
+}
+
+void UndoJournal::RevertUncommitted()
+{
+	if (!shadowTiles)
+		return;
+
+	const int tileCount = Terrain::patchSize*Terrain::patchSize*Terrain::patchLayers;
+	for (int i = 0; i < patchCount; ++i)
+	{
+		if (!changedPatches[i])
+			continue;
+		changedPatches[i] = false;
+
+		TerrainPatch& patch = GetPatch(i);
+		memcpy(patch.tiles, &shadowTiles[i*tileCount], tileCount*sizeof(TerrainTile));
+		patch.objectStubs = shadowStubs[i];
+		patch.RebuildPhysics();
+		patch.SetNeedsSave();
+	}
+}
+
+bool UndoJournal::Undo()
+{
+	if (!CanUndo())
+		return false;
+
+	--position;
+	Apply(*entries[position], true);
+	return true;
+}
+
+bool UndoJournal::Redo()
+{
+	if (!CanRedo())
+		return false;
+
+	Apply(*entries[position], false);
+	++position;
+	return true;
+}
+
+void UndoJournal::Apply(const Entry& entry, bool undo)
+{
+	vector<BYTE> xorBuffer;
+
+	for (vector<PatchDelta>::const_iterator it = entry.deltas.begin(); it != entry.deltas.end(); ++it)
+	{
+		const PatchDelta& delta = *it;
+		TerrainPatch& patch = GetPatch(delta.patchIndex);
+
+		if (!delta.tileDelta.empty())
+		{
+			// xor is its own inverse so undo and redo are the same operation on the shadow
+			const IntVector2 size = delta.tileMax - delta.tileMin + IntVector2(1, 1);
+			xorBuffer.assign(size.x*size.y*Terrain::patchLayers*sizeof(TerrainTile), 0);
+			ApplyDelta(delta.tileDelta, &xorBuffer[0], xorBuffer.size());
+
+			const BYTE* xorData = &xorBuffer[0];
+			for(int l=0; l<Terrain::patchLayers; ++l)
+			for(int x=delta.tileMin.x; x<=delta.tileMax.x; ++x)
+			for(int y=delta.tileMin.y; y<=delta.tileMax.y; ++y)
+			{
+				TerrainTile& shadowTile = GetShadowTile(delta.patchIndex, x, y, l);
+				BYTE* shadowData = (BYTE*)&shadowTile;
+				for (int b = 0; b < (int)sizeof(TerrainTile); ++b)
+					shadowData[b] ^= *(xorData++);
+
+				patch.GetTileLocal(x, y, l) = shadowTile;
+			}
+		}
+
+		if (delta.stubsChanged)
+		{
+			DeserializeStubs(undo? delta.stubsBefore : delta.stubsAfter, shadowStubs[delta.patchIndex]);
+			patch.objectStubs = shadowStubs[delta.patchIndex];
+		}
+
+		patch.RebuildPhysics();
+		patch.SetNeedsSave();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	serialization and compression helpers
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+// stubs are packed the same way as the terrain file
+void UndoJournal::SerializeStubs(const list<GameObjectStub>& stubs, vector<BYTE>& data)
+{
+	data.clear();
+	for (list<GameObjectStub>::const_iterator it = stubs.begin(); it != stubs.end(); ++it)
+	{
+		const GameObjectStub& stub = *it;
+		const int attributesLength = strlen(stub.attributes) + 1;
+		const int start = data.size();
+		data.resize(start + sizeof(stub.type) + sizeof(stub.xf) + sizeof(stub.size) + sizeof(stub.handle) + sizeof(int) + attributesLength);
+
+		BYTE* dataPointer = &data[start];
+		memcpy(dataPointer, &stub.type, sizeof(stub.type));				dataPointer += sizeof(stub.type);
+		memcpy(dataPointer, &stub.xf, sizeof(stub.xf));					dataPointer += sizeof(stub.xf);
+		memcpy(dataPointer, &stub.size, sizeof(stub.size));				dataPointer += sizeof(stub.size);
+		memcpy(dataPointer, &stub.handle, sizeof(stub.handle));			dataPointer += sizeof(stub.handle);
+		memcpy(dataPointer, &attributesLength, sizeof(int));			dataPointer += sizeof(int);
+		memcpy(dataPointer, stub.attributes, attributesLength);
+	}
+}
+
+void UndoJournal::DeserializeStubs(const vector<BYTE>& data, list<GameObjectStub>& stubs)
+{
+	stubs.clear();
+	if (data.empty())
+		return;
+
+	const BYTE* dataPointer = &data[0];
+	const BYTE* dataEnd = dataPointer + data.size();
+	while (dataPointer < dataEnd)
+	{
+		GameObjectStub stub;
+		memcpy(&stub.type, dataPointer, sizeof(stub.type));		dataPointer += sizeof(stub.type);
+		memcpy(&stub.xf, dataPointer, sizeof(stub.xf));			dataPointer += sizeof(stub.xf);
+		memcpy(&stub.size, dataPointer, sizeof(stub.size));		dataPointer += sizeof(stub.size);
+		memcpy(&stub.handle, dataPointer, sizeof(stub.handle));	dataPointer += sizeof(stub.handle);
+
+		int attributesLength = 0;
+		memcpy(&attributesLength, dataPointer, sizeof(int));		dataPointer += sizeof(int);
+		ASSERT(attributesLength > 0 && attributesLength <= GameObjectStub::attributesLength);
+		memcpy(stub.attributes, dataPointer, attributesLength);	dataPointer += attributesLength;
+
+		stubs.push_back(stub);
+	}
+}
+
+// xor deltas are mostly zeros, store as [zero count][literal count][literals] with byte counts
+void UndoJournal::CompressDelta(const BYTE* data, int size, vector<BYTE>& compressed)
+{
+	compressed.clear();
+
+	int i = 0;
+	while (i < size)
+	{
+		int zeroCount = 0;
+		while (i < size && data[i] == 0 && zeroCount < 255)
+		{
+			++zeroCount;
+			++i;
+		}
+
+		int literalCount = 0;
+		while (i + literalCount < size && data[i + literalCount] != 0 && literalCount < 255)
+			++literalCount;
+
+		compressed.push_back((BYTE)zeroCount);
+		compressed.push_back((BYTE)literalCount);
+		compressed.insert(compressed.end(), data + i, data + i + literalCount);
+		i += literalCount;
+	}
+}
+
+void UndoJournal::ApplyDelta(const vector<BYTE>& compressed, BYTE* data, int size)
+{
+	const BYTE* dataEnd = data + size;
+	for (vector<BYTE>::const_iterator it = compressed.begin(); it != compressed.end(); )
+	{
+		const int zeroCount = *(it++);
+		const int literalCount = *(it++);
+		data += zeroCount;
+		ASSERT(data + literalCount <= dataEnd);
+
+		for (int i = 0; i < literalCount; ++i)
+			*(data++) ^= *(it++);
+	}
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Undo Journal
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- in memory undo/redo for the editor
+	- keeps a shadow copy of the terrain as of the last commit
+	- editors mark which patches they touch, commit only diffs those patches
+	- each entry stores the changed tile rectangle per patch as rle compressed xor
+	- stub lists are stored before and after for patches where they changed
+	- oldest entries are evicted when over the memory limit
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef UNDO_JOURNAL_H
+#define UNDO_JOURNAL_H
+
+#include <vector>
+#include "../terrain/terrain.h"
+
+class UndoJournal
+{
+public:
+
+	UndoJournal();
+	~UndoJournal();
+
+	// wipe out all entries and the shadow copy, next commit will take a new snapshot
+	void Reset();
+
+	// record changes to marked patches as a new entry, returns true if anything changed
+	bool Commit();
+
+	// restore marked patches to how they were at the last commit
+	void RevertUncommitted();
+
+	bool Undo();
+	bool Redo();
+	bool HasSnapshot() const { return shadowTiles != NULL; }
+	bool CanUndo() const { return position > 0; }
+	bool CanRedo() const { return position < (int)entries.size(); }
+
+	// editors must call these for anything they change so commit knows where to look
+	void MarkChanged();
+	void MarkChanged(const TerrainPatch& patch);
+	void MarkChanged(const Box2AABB& box);
+
+	// take the patch as it is now without making an entry, for changes that should not be undone
+	void RefreshShadow(const TerrainPatch& patch);
+
+	int GetEntryCount() const	{ return entries.size(); }
+	int GetMemoryUsed() const	{ return memoryUsed; }
+
+	static int memoryLimit;		// how many kilobytes the journal can use before evicting old entries
+
+private:
+
+	struct PatchDelta
+	{
+		int patchIndex;
+		IntVector2 tileMin;			// changed tile rectangle, inclusive
+		IntVector2 tileMax;
+		vector<BYTE> tileDelta;		// rle compressed xor of before and after tiles in the rectangle
+		bool stubsChanged;
+		vector<BYTE> stubsBefore;	// serialized stub lists, only used if stubs changed
+		vector<BYTE> stubsAfter;
+	};
+
+	struct Entry
+	{
+		vector<PatchDelta> deltas;
+		int memory;
+	};
+
+	void Snapshot();
+	void Apply(const Entry& entry, bool undo);
+	void DeleteEntry(Entry* entry);
+	TerrainPatch& GetPatch(int patchIndex) const;
+	TerrainTile& GetShadowTile(int patchIndex, int x, int y, int layer) const;
+
+	static void SerializeStubs(const list<GameObjectStub>& stubs, vector<BYTE>& data);
+	static void DeserializeStubs(const vector<BYTE>& data, list<GameObjectStub>& stubs);
+	static void CompressDelta(const BYTE* data, int size, vector<BYTE>& compressed);
+	static void ApplyDelta(const vector<BYTE>& compressed, BYTE* data, int size);
+
+	TerrainTile* shadowTiles;				// copy of every patch's tiles at the last commit
+	list<GameObjectStub>* shadowStubs;		// copy of every patch's stubs at the last commit
+	bool* changedPatches;					// patches that may differ from the shadow copy
+	int patchCount;
+
+	vector<Entry*> entries;
+	int position;							// how many entries are currently applied
+	int memoryUsed;							// total bytes used by entries
+};
+
+#endif // UNDO_JOURNAL_H
@@ -25,3 +25,16 @@ void Actor::ApplyDamage(float damage, GameObject* attacker, GameDamageType damag
 		Kill();
 }
 
+void Actor::SaveSnapshot(SnapshotWriter& writer) const
+{
+	GameObject::SaveSnapshot(writer);
+	writer.Write(health);
+	writer.Write(maxHealth);
+}
+
+void Actor::LoadSnapshot(SnapshotReader& reader)
+{
+	GameObject::LoadSnapshot(reader);
+	reader.Read(health);
+	reader.Read(maxHealth);
+}
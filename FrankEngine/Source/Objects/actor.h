@@ -47,6 +47,9 @@ public:
 		health = Min(health, maxHealth);
 	}
 
+	virtual void SaveSnapshot(SnapshotWriter& writer) const;
+	virtual void LoadSnapshot(SnapshotReader& reader);
+
 protected:
 
 	float health;
@@ -0,0 +1,299 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Bullet Manager
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../objects/weapon.h"
+#include "../objects/bulletManager.h"
+#include <xmmintrin.h>
+
+BulletManager g_bulletManager;			// singleton that contains all lightweight bullets
+
+int BulletManager::maxCount = 20000;
+ConsoleCommand(BulletManager::maxCount, bulletMaxCount);
+
+float BulletManager::lifeTime = 10;
+ConsoleCommand(BulletManager::lifeTime, bulletLifeTime);
+
+float BulletManager::renderLength = 1;
+ConsoleCommand(BulletManager::renderLength, bulletRenderLength);
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+// never added to the world, only used to filter raycasts like a projectile on its team
+class BulletProxy : public GameObject
+{
+public:
+
+	explicit BulletProxy(GameTeam team) :
+		GameObject(XForm2::Identity(), NULL, GAME_OBJECT_TYPE_PROJECTILE, false)
+	{
+		SetTeam(team);
+		SetCollisionCallbacks(CollisionCallback_None);
+	}
+
+	bool IsProjectile() const { return true; }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+BulletManager::BulletManager() :
+	count(0),
+	capacity(0)
+{
+	ZeroMemory(teamProxies, sizeof(teamProxies));
+}
+
+BulletManager::~BulletManager()
+{
+	for (int i = 0; i < CollisionMatrix::maxTeams; ++i)
+		GameObjectManager::DeleteDetached(teamProxies[i]);
+}
+
+const GameObject& BulletManager::GetTeamProxy(GameTeam team)
+{
+	ASSERT(team >= 0 && team < CollisionMatrix::maxTeams);
+	if (!teamProxies[team])
+		teamProxies[team] = new BulletProxy(team);
+	return *teamProxies[team];
+}
+
+bool BulletManager::Fire(const XForm2& xf, const WeaponDef& weaponDef, GameObject* attacker)
+{
+	// set up velocity incorporating the attacker's velocity
+	Vector2 velocity = Vector2::BuildFromAngle(xf.angle)*weaponDef.projectileSpeed*Projectile::projectileSpeedScale;
+	if (Projectile::applyAttackerVelocity && attacker)
+		velocity += attacker->GetVelocity();
+
+	return Add(xf.position, velocity, attacker, weaponDef.damage, weaponDef.projectileRadius, weaponDef.hitEffect, weaponDef.hitSound);
+}
+
+bool BulletManager::Add
+(
+	const Vector2& pos,
+	const Vector2& velocity,
+	GameObject* attacker,
+	float _damage,
+	float radius,
+	const ParticleSystemDef* _hitEffect,
+	SoundControl_ID _hitSound,
+	GameDamageType _damageType
+)
+{
+	if (count >= maxCount)
+		return false;
+
+	if (count == capacity)
+		Reserve(Max(2*capacity, 256));
+
+	const Vector2 gravity = FrankUtil::CalculateGravity(pos);
+	const int i = count++;
+	posX[i] = lastPosX[i] = pos.x;
+	posY[i] = lastPosY[i] = pos.y;
+	velocityX[i] = velocity.x;
+	velocityY[i] = velocity.y;
+	gravityX[i] = gravity.x;
+	gravityY[i] = gravity.y;
+	damping[i] = BulletProjectile::defaultDamping;
+	time[i] = 0;
+
+	// same mass a bullet projectile would have
+	damage[i] = _damage;
+	mass[i] = Max(PI*radius*radius*Projectile::defaultDensity, 0.001f);
+	attackerHandle[i] = attacker? attacker->GetHandle() : GameObject::invalidHandle;
+	team[i] = attacker? attacker->GetTeam() : GameTeam(0);
+	damageType[i] = _damageType;
+	hitEffect[i] = _hitEffect;
+	hitSound[i] = _hitSound;
+	return true;
+}
+
+void BulletManager::Clear()
+{
+	count = 0;
+}
+
+void BulletManager::Reserve(int _capacity)
+{
+	// keep room for a whole simd lane at the end
+	capacity = (_capacity + 3) & ~3;
+
+	posX.resize(capacity);
+	posY.resize(capacity);
+	lastPosX.resize(capacity);
+	lastPosY.resize(capacity);
+	velocityX.resize(capacity);
+	velocityY.resize(capacity);
+	gravityX.resize(capacity);
+	gravityY.resize(capacity);
+	damping.resize(capacity);
+	time.resize(capacity);
+
+	damage.resize(capacity);
+	mass.resize(capacity);
+	attackerHandle.resize(capacity);
+	team.resize(capacity);
+	damageType.resize(capacity);
+	hitEffect.resize(capacity);
+	hitSound.resize(capacity);
+}
+
+void BulletManager::Remove(int i)
+{
+	// move the last bullet into the hole
+	ASSERT(i >= 0 && i < count);
+	const int j = --count;
+	posX[i] = posX[j];
+	posY[i] = posY[j];
+	lastPosX[i] = lastPosX[j];
+	lastPosY[i] = lastPosY[j];
+	velocityX[i] = velocityX[j];
+	velocityY[i] = velocityY[j];
+	gravityX[i] = gravityX[j];
+	gravityY[i] = gravityY[j];
+	damping[i] = damping[j];
+	time[i] = time[j];
+
+	damage[i] = damage[j];
+	mass[i] = mass[j];
+	attackerHandle[i] = attackerHandle[j];
+	team[i] = team[j];
+	damageType[i] = damageType[j];
+	hitEffect[i] = hitEffect[j];
+	hitSound[i] = hitSound[j];
+}
+
+void BulletManager::Update()
+{
+	FrankProfilerEntryDefine(L"BulletManager::Update()", Color::Yellow(), 5);
+
+	if (count == 0)
+		return;
+
+	if (g_terrain->isCircularPlanet)
+	{
+		// gravity only changes with position around planets
+		for (int i = 0; i < count; ++i)
+		{
+			const Vector2 gravity = FrankUtil::CalculateGravity(Vector2(posX[i], posY[i]));
+			gravityX[i] = gravity.x;
+			gravityY[i] = gravity.y;
+		}
+	}
+
+	{
+		// integrate 4 bullets at a time, the padding past the end is harmless
+		const __m128 dt = _mm_set1_ps(GAME_TIME_STEP);
+		const __m128 halfDt2 = _mm_set1_ps(0.5f*GAME_TIME_STEP*GAME_TIME_STEP);
+		const __m128 one = _mm_set1_ps(1);
+		const int simdCount = (count + 3) & ~3;
+		for (int i = 0; i < simdCount; i += 4)
+		{
+			const __m128 px = _mm_loadu_ps(&posX[i]);
+			const __m128 py = _mm_loadu_ps(&posY[i]);
+			const __m128 gx = _mm_loadu_ps(&gravityX[i]);
+			const __m128 gy = _mm_loadu_ps(&gravityY[i]);
+			const __m128 d = _mm_sub_ps(one, _mm_loadu_ps(&damping[i]));
+			_mm_storeu_ps(&lastPosX[i], px);
+			_mm_storeu_ps(&lastPosY[i], py);
+
+			// apply gravity and damping
+			const __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&velocityX[i]), _mm_mul_ps(gx, dt)), d);
+			const __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(&velocityY[i]), _mm_mul_ps(gy, dt)), d);
+			_mm_storeu_ps(&velocityX[i], vx);
+			_mm_storeu_ps(&velocityY[i], vy);
+
+			// update position
+			_mm_storeu_ps(&posX[i], _mm_add_ps(px, _mm_add_ps(_mm_mul_ps(vx, dt), _mm_mul_ps(gx, halfDt2))));
+			_mm_storeu_ps(&posY[i], _mm_add_ps(py, _mm_add_ps(_mm_mul_ps(vy, dt), _mm_mul_ps(gy, halfDt2))));
+			_mm_storeu_ps(&time[i], _mm_add_ps(_mm_loadu_ps(&time[i]), dt));
+		}
+	}
+
+	// raycast along the path each bullet took this update
+	lines.resize(count);
+	filters.resize(count);
+	results.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		lines[i] = Line2(Vector2(lastPosX[i], lastPosY[i]), Vector2(posX[i], posY[i]));
+		filters[i] = RaycastFilter(attackerHandle[i], GetTeamProxy(team[i]));
+	}
+	g_physics->RaycastBatch(&lines[0], count, &results[0], &filters[0]);
+
+	// go backwards so removed bullets are replaced with ones already checked
+	for (int i = count - 1; i >= 0; --i)
+	{
+		const SimpleRaycastResult& result = results[i];
+		GameObject* object = result.GetHitObject();
+		if (object)
+			HitObject(i, *object, result);
+		else if (time[i] > lifeTime)
+			Remove(i);
+	}
+}
+
+void BulletManager::HitObject(int i, GameObject& object, const SimpleRaycastResult& result)
+{
+	// apply impulse to the object manually since there is no physics on the bullet
+	const float impulseCoef = 0.1f;
+	const Vector2 velocity(velocityX[i], velocityY[i]);
+	object.ApplyImpulse(mass[i] * velocity * impulseCoef, result.point);
+
+	// apply damage to the other object
+	object.ApplyDamage(damage[i], g_objectManager.GetObjectFromHandle(attackerHandle[i]), damageType[i]);
+
+	const XForm2 xf(result.point, velocity.GetAngle());
+	g_sound->Play(hitSound[i], xf.position);
+	if (hitEffect[i])
+		ParticleEmitter::SpawnOneShot(*hitEffect[i], xf);
+
+	Remove(i);
+}
+
+void BulletManager::Render()
+{
+	FrankProfilerEntryDefine(L"BulletManager::Render()", Color::White(), 6);
+
+	if (count == 0)
+		return;
+
+	DeferredRender::EmissiveRenderBlock emissiveRenderBlock;
+	g_render->SetSimpleVertsAreAdditive(true);
+	for (int i = 0; i < count; ++i)
+	{
+		// draw a streak behind the interpolated position
+		const Vector2 pos(posX[i], posY[i]);
+		const Vector2 delta = pos - Vector2(lastPosX[i], lastPosY[i]);
+		const Vector2 head = pos - g_interpolatePercent * delta;
+		const Line2 line(head - renderLength * delta, head);
+		if (g_cameraBase->CameraTest(line))
+			g_render->DrawSegment(line);
+	}
+	g_render->RenderSimpleVerts();
+	g_render->SetSimpleVertsAreAdditive(false);
+}
+
+// fires a ring of bullets from the player to test a bullet hell load
+static void ConsoleCallback_bulletStress(const wstring& text)
+{
+	int bulletCount = 10000;
+	float speed = 10;
+	swscanf_s(text.c_str(), L"%d %f", &bulletCount, &speed);
+
+	GameObject* player = g_gameControlBase->GetPlayer();
+	const Vector2 center = player? player->GetPosWorld() : g_cameraBase->GetPosWorld();
+	int added = 0;
+	for (int i = 0; i < bulletCount; ++i)
+	{
+		const Vector2 direction = Vector2::BuildFromAngle(2*PI*i / (float)Max(bulletCount, 1));
+		if (g_bulletManager.Add(center + direction, speed*direction, player, 10, 0.05f))
+			++added;
+	}
+
+	GetDebugConsole().AddFormatted(L"Added %d bullets, %d alive.", added, g_bulletManager.GetCount());
+}
+ConsoleCommand(ConsoleCallback_bulletStress, bulletStress);
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Bullet Manager
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- lightweight bullets that don't need a game object each
+	- bullet data is kept in parallel arrays so they all integrate in one simd loop
+	- collision is done with one batch of raycasts across the job system
+	- game objects are only touched when a bullet hits them
+	- hits apply damage and impulse but there is no projectile for CollisionAdd to see
+	- raycasts are filtered with a proxy projectile so the collision matrix and ShouldCollide still apply
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BULLET_MANAGER_H
+#define BULLET_MANAGER_H
+
+#include <vector>
+#include "../objects/particleSystem.h"
+#include "../sound/soundControl.h"
+
+// global bullet manager singleton
+extern class BulletManager g_bulletManager;
+
+struct WeaponDef;
+
+class BulletManager : private Uncopyable
+{
+public:
+
+	BulletManager();
+	~BulletManager();
+
+	// fire a bullet the same way a weapon would launch a BulletProjectile
+	// returns false if there was no room for another bullet
+	bool Fire(const XForm2& xf, const WeaponDef& weaponDef, GameObject* attacker = NULL);
+
+	bool Add
+	(
+		const Vector2& pos,
+		const Vector2& velocity,
+		GameObject* attacker = NULL,
+		float damage = 100,
+		float radius = 0.2f,
+		const ParticleSystemDef* hitEffect = NULL,
+		SoundControl_ID hitSound = SoundControl_Invalid,
+		GameDamageType damageType = GameDamageType_Default
+	);
+
+	// call these once per frame
+	void Update();
+	void Render();
+
+	// remove all the bullets
+	void Clear();
+
+	int GetCount() const { return count; }
+
+	static int maxCount;			// how many bullets can be alive at once
+	static float lifeTime;			// how long bullets live if they don't hit anything
+	static float renderLength;		// how many updates worth of travel to draw behind each bullet
+
+private:
+
+	void Reserve(int capacity);
+	void Remove(int i);
+	void HitObject(int i, GameObject& object, const SimpleRaycastResult& result);
+	const GameObject& GetTeamProxy(GameTeam team);
+
+	int count;
+	int capacity;
+
+	// hot data used by the integration loop, padded to a multiple of 4
+	vector<float> posX, posY;
+	vector<float> lastPosX, lastPosY;
+	vector<float> velocityX, velocityY;
+	vector<float> gravityX, gravityY;
+	vector<float> damping;
+	vector<float> time;
+
+	// cold data only needed when something is hit
+	vector<float> damage;
+	vector<float> mass;
+	vector<GameObjectHandle> attackerHandle;
+	vector<GameTeam> team;
+	vector<GameDamageType> damageType;
+	vector<const ParticleSystemDef*> hitEffect;
+	vector<SoundControl_ID> hitSound;
+
+	// scratch space for the raycast batch
+	vector<Line2> lines;
+	vector<RaycastFilter> filters;
+	vector<SimpleRaycastResult> results;
+
+	// stand ins for the bullets of each team when filtering raycasts
+	GameObject* teamProxies[CollisionMatrix::maxTeams];
+};
+
+#endif // BULLET_MANAGER_H
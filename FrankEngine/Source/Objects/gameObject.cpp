@@ -36,7 +36,8 @@ GameObject::GameObject(const GameObjectStub& stub, GameObject* _parent, bool add
 	physicsBody(NULL),
 	physicsGroup(PhysicsGroup(0)),
 	renderGroup(1),
-	team(GameTeam(0))
+	team(GameTeam(0)),
+	collisionCallbacks(GameObjectStub::GetObjectInfo(stub.type).GetCollisionCallbacks())
 {
 	// give it the stubs handle
 	if (stub.handle != invalidHandle)
@@ -72,7 +73,8 @@ GameObject::GameObject(const XForm2& xf, GameObject* _parent, GameObjectType _ga
 	physicsBody(NULL),
 	physicsGroup(PhysicsGroup(0)),
 	renderGroup(1),
-	team(GameTeam(0))
+	team(GameTeam(0)),
+	collisionCallbacks(GameObjectStub::GetObjectInfo(_gameObjectType).GetCollisionCallbacks())
 {
 	// automatically add the object to the world
 	if (addToWorld)
@@ -103,6 +105,30 @@ GameObjectStub GameObject::Serialize() const
 	return GameObjectStub(GetXFormWorld(), stubSize, gameObjectType, NULL, handle); 
 }
 
+void GameObject::SaveSnapshot(SnapshotWriter& writer) const
+{
+	writer.Write(xfLocal);
+	writer.Write(xfWorld);
+	writer.Write(xfWorldLast);
+	writer.Write(team);
+	writer.Write(flags);
+	writer.Write(soundTimer);
+}
+
+void GameObject::LoadSnapshot(SnapshotReader& reader)
+{
+	reader.Read(xfLocal);
+	reader.Read(xfWorld);
+	reader.Read(xfWorldLast);
+	reader.Read(team);
+
+	// being destroyed is up to the world, not the snapshot
+	UINT savedFlags = 0;
+	reader.Read(savedFlags);
+	flags = (savedFlags & ~ObjectFlag_Destroyed) | (flags & ObjectFlag_Destroyed);
+	reader.Read(soundTimer);
+}
+
 void GameObject::CreatePhysicsBody(const XForm2& xf, b2BodyType type, bool fixedRotation, bool allowSleeping)
 {
 	b2BodyDef bodyDef;
@@ -26,6 +26,22 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 enum GameObjectType;
+class SnapshotWriter;
+class SnapshotReader;
+
+// which collision callbacks an object wants
+// physics skips building contact data and dispatching when neither object subscribes
+enum CollisionCallbackFlags
+{
+	CollisionCallback_None			= 0x00,
+	CollisionCallback_Add			= 0x01,
+	CollisionCallback_Persist		= 0x02,
+	CollisionCallback_Remove		= 0x04,
+	CollisionCallback_Result		= 0x08,
+	CollisionCallback_PreSolve		= 0x10,
+	CollisionCallback_ShouldCollide	= 0x20,	// needs the virtual ShouldCollide, otherwise only the collision matrix is used
+	CollisionCallback_All			= 0x3f
+};
 
 class GameObject : private Uncopyable
 {
@@ -215,6 +231,7 @@ public: // physics
 	int16 GetPhysicsGroup() const;
 
 	// check if objects should collide. if a fixture is null that indicates it is a raycast collide test
+	// only called for objects with the should collide callback flag, after the collision matrix passes
 	virtual bool ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const { return true; }
 
 	// special check for line of sight collision
@@ -230,6 +247,14 @@ public: // physics
 	// collision pre-solve callback, called immediatly during physics update
 	virtual void CollisionPreSolve(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture, const b2Manifold* oldManifold) {}
 
+	// which collision callbacks this type uses, registered types get this from their object info
+	// override this to return only the callbacks the class implements
+	static int GetCollisionCallbacks() { return CollisionCallback_All; }
+
+	// objects without object info can set their callbacks directly
+	void SetCollisionCallbacks(int callbacks) { collisionCallbacks = callbacks; }
+	bool WantsCollisionCallback(CollisionCallbackFlags callback) const { return (collisionCallbacks & callback) != 0; }
+
 	// create/destroy functions for physics
 	void CreatePhysicsBody(const XForm2& xf, b2BodyType type = b2_dynamicBody, bool fixedRotation = false, bool allowSleeping = true);
 	void CreatePhysicsBody(const b2BodyDef& bodyDef);
@@ -309,6 +334,16 @@ public: // streaming
 	// is this object (or it's children) partially contained inside the aabb?
 	bool PartiallyContainedBy(const Box2AABB& bbox) const;
 
+public: // snapshots
+
+	// objects that are only effects can opt out of world snapshots
+	virtual bool IsSnapshotted() const { return true; }
+
+	// save and load game state for world snapshots, physics bodies are saved with the physics world
+	// derived classes that add state should call the base class first
+	virtual void SaveSnapshot(SnapshotWriter& writer) const;
+	virtual void LoadSnapshot(SnapshotReader& reader);
+
 private: // private stuff
 
 	GameObjectHandle handle;			// the unique handle of this object
@@ -326,6 +361,7 @@ private: // private stuff
 	list<GameObject*> children;			// list of children	
 	GameObject* parent;					// parent if it has one
 	GameTeam team;						// team object is on
+	int collisionCallbacks;				// which collision callbacks are dispatched to this object
 
 	enum ObjectFlags
 	{
@@ -358,6 +394,7 @@ private: // special functions to get and reset the next unique handle
 	friend class ObjectEditor;
 	friend class Terrain;
 	friend class GameObjectManager;
+	friend class WorldSnapshot;
 
 	// these functions should only be used by editors and startup code
 	static GameObjectHandle GetNextUniqueHandleValue() { return nextUniqueHandleValue; }
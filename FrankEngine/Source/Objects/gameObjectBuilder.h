@@ -16,6 +16,11 @@ enum GameObjectType;
 const GameObjectType GAME_OBJECT_TYPE_MAX_COUNT = (GameObjectType)256;
 const GameObjectType GAME_OBJECT_TYPE_INVALID = (GameObjectType)0;
 
+// types for engine objects that are not built from stubs so the collision matrix can tell them apart
+// games should not use these for their own types
+const GameObjectType GAME_OBJECT_TYPE_PROJECTILE = (GameObjectType)254;
+const GameObjectType GAME_OBJECT_TYPE_TERRAIN = (GameObjectType)255;
+
 struct ObjectTypeInfo;
 struct GameObjectStub;
 extern ObjectTypeInfo* g_gameObjectInfoArray[GAME_OBJECT_TYPE_MAX_COUNT];
@@ -41,7 +46,8 @@ public:
 		StubDescriptionFunction _stubAttributesDescriptionFunction, 
 		StubDescriptionFunction _stubDescriptionFunction, 
 		GameTextureID _ti = GameTextureID(0), 
-		const Color& _stubColor = Color::White()
+		const Color& _stubColor = Color::White(),
+		int _collisionCallbacks = CollisionCallback_All
 	) :
 		name(_name),
 		type(_type),
@@ -51,7 +57,8 @@ public:
 		isSerializableFunction(_isSerializableFunction),
 		stubRenderFunction(_stubRenderFunction),
 		stubAttributesDescriptionFunction(_stubAttributesDescriptionFunction),
-		stubDescriptionFunction(_stubDescriptionFunction)
+		stubDescriptionFunction(_stubDescriptionFunction),
+		collisionCallbacks(_collisionCallbacks)
 	{
 		// init my entry in the global object info index array
 		ASSERT(!g_gameObjectInfoArray[type]);
@@ -70,6 +77,7 @@ public:
 	const WCHAR* GetAttributesDescription() const { return stubAttributesDescriptionFunction(); }
 	const WCHAR* GetDescription() const { return stubDescriptionFunction(); }
 	bool IsSerializable() const { return isSerializableFunction(); }
+	int GetCollisionCallbacks() const { return collisionCallbacks; }
 
 	// get maximum registered object type, used by editors
 	static GameObjectType GetMaxType() { return maxType; }
@@ -87,6 +95,7 @@ private:
 	StubRenderFunction stubRenderFunction;
 	StubDescriptionFunction stubAttributesDescriptionFunction;
 	StubDescriptionFunction stubDescriptionFunction;
+	int collisionCallbacks;
 	static GameObjectType maxType;
 };
 
@@ -154,6 +163,6 @@ public:
 #define	GAME_OBJECT_DEFINITION(className, stubTexture, stubColor) \
 static GameObject* className##Build(const GameObjectStub& stub) \
 { return new className(stub); } \
-static ObjectTypeInfo className##Info(L#className, GOT_##className, className##Build, className##::IsSerializable, className##::StubRender, className##::StubAttributesDescription, className##::StubDescription, stubTexture, stubColor);
+static ObjectTypeInfo className##Info(L#className, GOT_##className, className##Build, className##::IsSerializable, className##::StubRender, className##::StubAttributesDescription, className##::StubDescription, stubTexture, stubColor, className##::GetCollisionCallbacks());
 
 #endif // GAME_OBJECT_BUILDER_H
\ No newline at end of file
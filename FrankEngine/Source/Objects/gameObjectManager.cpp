@@ -97,6 +97,28 @@ void GameObjectManager::UpdateTransforms()
 	lockDeleteObjects = true;
 }
 
+// delete destroyed objects without updating anything else
+void GameObjectManager::CollectGarbage()
+{
+	// clear render objects because the objects may be deleted
+	sortedRenderObjects.clear();
+
+	lockDeleteObjects = false;
+	for (GameObjectHashTable::iterator it = objects.begin(); it != objects.end();)
+	{
+		GameObject& obj = (*(*it).second);
+		if (obj.IsDestroyed())
+		{	
+			ASSERT(!obj.parent && obj.children.empty());
+			it = objects.erase(it);
+			delete &obj;
+		} 
+		else
+			++it;
+	}
+	lockDeleteObjects = true;
+}
+
 void GameObjectManager::SaveLastWorldTransforms()
 {
 	// save the last world transform for interpolation
@@ -146,7 +168,8 @@ void GameObjectManager::Render()
 
 		if (renderGroup != obj.GetRenderGroup())
 		{
-			// always render simple verts and disable additive at the end of each group
+			// always render batched particles and simple verts and disable additive at the end of each group
+			g_particleBatch.Render();
 			g_render->RenderSimpleVerts();
 			g_render->SetSimpleVertsAreAdditive(false);
 		}
@@ -155,6 +178,7 @@ void GameObjectManager::Render()
 		obj.Render();
 	}
 
+	g_particleBatch.Render();
 	g_render->RenderSimpleVerts();
 	g_render->SetSimpleVertsAreAdditive(false);
 }
@@ -182,6 +206,13 @@ void GameObjectManager::RenderPost()
 	g_render->SetSimpleVertsAreAdditive(false);
 }
 
+void GameObjectManager::DeleteDetached(GameObject* obj)
+{
+	lockDeleteObjects = false;
+	delete obj;
+	lockDeleteObjects = true;
+}
+
 void GameObjectManager::RemoveAll()
 {
 	// do a normal flush to get rid of all the game objects
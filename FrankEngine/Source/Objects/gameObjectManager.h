@@ -48,6 +48,7 @@ public:	// functions to get / add / remove objects
 	void RemoveAll();
 	void Reset();
 	virtual void UpdateTransforms();
+	void CollectGarbage();
 
 	GameObjectHashTable& GetObjects() { return objects; }
 	list<GameObject*> GetObjects(const Vector2& pos, float radius, bool skipChildern);
@@ -56,6 +57,9 @@ public:	// functions to get / add / remove objects
 
 	static bool GetLockDeleteObjects() { return lockDeleteObjects; }
 
+	// delete an object that was created without being added to the world
+	static void DeleteDetached(GameObject* obj);
+
 private:
 
 	static bool RenderSortCompare(GameObject* first, GameObject* second);
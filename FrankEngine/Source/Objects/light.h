@@ -35,6 +35,7 @@ public:
 	float GetFadeAlpha() const;
 	
 	bool IsLight() const { return true; }
+	bool IsSnapshotted() const { return false; }
 	bool IsSimpleLight() const;
 
 	static void StubRender(const GameObjectStub& stub, float alpha);
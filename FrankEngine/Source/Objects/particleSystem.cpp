@@ -8,6 +8,8 @@
 #include "frankEngine.h"
 #include "../terrain/terrain.h"
 #include "../objects/particleSystem.h"
+#include <xmmintrin.h>
+#include <malloc.h>
 
 // example particle definiton for a basic smoke effect
 const ParticleSystemDef g_testParticleSystemDef = ParticleSystemDef::Build
@@ -27,20 +29,47 @@ const ParticleSystemDef g_testParticleSystemDef = ParticleSystemDef::Build
 );
 
 int ParticleEmitter::totalEmitterCount = 0;
+volatile LONG ParticleEmitter::totalParticleCount = 0;
+int ParticleEmitter::evictedParticleCount = 0;
+int ParticleEmitter::throttledEmitterCount = 0;
+int ParticleEmitter::dormantEmitterCount = 0;
+list<ParticleEmitter*> ParticleEmitter::emitterList;
+list<ParticleEmitter*> ParticleEmitter::emitterPool;
 bool ParticleEmitter::enableParticles = true;
 int ParticleEmitter::defaultRenderGroup = -2;
 int ParticleEmitter::defaultAdditiveRenderGroup = -1;
 ConsoleCommand(ParticleEmitter::enableParticles, particleEnable);
 
+int ParticleEmitter::maxParticles = 20000;
+ConsoleCommand(ParticleEmitter::maxParticles, particleMaxCount);
+
+float ParticleEmitter::particleThrottleStart = 0.75f;
+ConsoleCommand(ParticleEmitter::particleThrottleStart, particleThrottleStart);
+
+float ParticleEmitter::particlePriorityDistance = 50;
+ConsoleCommand(ParticleEmitter::particlePriorityDistance, particlePriorityDistance);
+
+float ParticleEmitter::particleOffScreenPriority = 0.1f;
+ConsoleCommand(ParticleEmitter::particleOffScreenPriority, particleOffScreenPriority);
+
+int ParticleEmitter::particleThreads = 0;
+ConsoleCommand(ParticleEmitter::particleThreads, particleThreads);
+
+int ParticleEmitter::particleEmitterPoolSize = 200;
+ConsoleCommand(ParticleEmitter::particleEmitterPoolSize, particleEmitterPoolSize);
+
+bool ParticleEmitter::particleDormancy = true;
+ConsoleCommand(ParticleEmitter::particleDormancy, particleDormancy);
+
+float ParticleEmitter::particleDormantMargin = 5;
+ConsoleCommand(ParticleEmitter::particleDormantMargin, particleDormantMargin);
+
 float ParticleEmitter::particleStopRadius = 0;
 ConsoleCommand(ParticleEmitter::particleStopRadius, particleStopRadius);
 
 float particleDebug = 0;
 ConsoleCommand(particleDebug, particleDebug);
 
-DWORD Particle::simpleVertsLastColor = 0;
-bool Particle::simpleVertsNeedsCap = false;
-
 float ParticleEmitter::shadowRenderAlpha = 0.6f;
 ConsoleCommand(ParticleEmitter::shadowRenderAlpha, particleShadowRenderAlpha);
 
@@ -49,13 +78,46 @@ ConsoleCommand(ParticleEmitter::shadowRenderAlpha, particleShadowRenderAlpha);
 ParticleEmitter::ParticleEmitter(const ParticleSystemDef& _systemDef, const XForm2& xf, GameObject* _parent, float scale) :
 	GameObject(xf, _parent),
 	systemDef(_systemDef),
-	emitRateTimer(0),
-	setTrailEnd(false),
-	emitterPaused(false)
+	oneShot(false),
+	pooled(false)
 {
 	++totalEmitterCount;
-	time.Set();
+	emitterListIterator = emitterList.insert(emitterList.end(), this);
 	systemDef.Scale(scale);
+	Start();
+}
+
+ParticleEmitter::~ParticleEmitter()
+{
+	RemoveAllParticles();
+	if (pooled)
+		emitterPool.erase(emitterListIterator);
+	else
+	{
+		emitterList.erase(emitterListIterator);
+		--totalEmitterCount;
+	}
+}
+
+// resets everything so pooled emitters start the same way as new ones
+void ParticleEmitter::Start()
+{
+	time.Set();
+	emitRateTimer = 0;
+	setTrailEnd = false;
+	emitterPaused = false;
+	cachedFrame = 0;
+	priority = 0;
+	emitScale = 1;
+	dormant = false;
+	dormantSteps = 0;
+	dormantEmitCount = 0;
+	dormantFirstEmitStep = 0;
+	dormantLastEmitStep = 0;
+	dormantMaxSpeed = 0;
+	dormantLifeTime = 0;
+	curves.Compile(systemDef);
+	particleBounds = Box2AABB((systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE)? Vector2::Zero() : GetPosWorld());
 
 	if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON) && systemDef.emitRate > 0)
 	{
@@ -66,23 +128,62 @@ ParticleEmitter::ParticleEmitter(const ParticleSystemDef& _systemDef, const XFor
 		emitRateTimer -= systemDef.emitRate;
 	}
 
-	// render additive particles on top of normal particles and both under the terrain 
+	// render additive particles on top of normal particles and both under the terrain
 	SetRenderGroup((systemDef.particleFlags & PARTICLE_FLAG_ADDITIVE)? defaultAdditiveRenderGroup : defaultRenderGroup);
 }
 
-ParticleEmitter::~ParticleEmitter()
+ParticleEmitter* ParticleEmitter::SpawnOneShot(const ParticleSystemDef& systemDef, const XForm2& xf, float scale)
 {
-	for (list<Particle*>::iterator it = particles.begin(); it != particles.end(); ++it)
-		DeleteParticle(*it);
+	// one shots must die on their own to get back to the pool
+	ASSERT(systemDef.emitLifeTime > 0);
+
+	// emitters destroyed while pooled are still there until they get deleted
+	if (emitterPool.empty() || emitterPool.back()->IsDestroyed())
+	{
+		ParticleEmitter* emitter = new ParticleEmitter(systemDef, xf, NULL, scale);
+		emitter->oneShot = true;
+		return emitter;
+	}
+
+	// move the list node back so reusing an emitter doesn't allocate
+	ParticleEmitter* emitter = emitterPool.back();
+	emitterList.splice(emitterList.end(), emitterPool, emitter->emitterListIterator);
+	++totalEmitterCount;
+	emitter->pooled = false;
+
+	emitter->systemDef = systemDef;
+	emitter->systemDef.Scale(scale);
+	emitter->SetXFormWorld(xf);
+	emitter->ResetLastWorldTransforms();
+	emitter->SetVisible(true);
+	emitter->Start();
+	return emitter;
+}
+
+// called when the emitter is dead and its particles are gone
+void ParticleEmitter::Finish()
+{
+	RemoveAllParticles();
+	if (!oneShot || (int)emitterPool.size() >= particleEmitterPoolSize)
+	{
+		Destroy();
+		return;
+	}
+
+	// keep the object around hidden so the next one shot can use it
+	emitterPool.splice(emitterPool.end(), emitterList, emitterListIterator);
 	--totalEmitterCount;
+	pooled = true;
+	SetVisible(false);
 }
 
 void ParticleEmitter::WarmUp(float time)
 {
-	while (time >= GAME_TIME_STEP) 
+	while (time >= GAME_TIME_STEP)
 	{
 		time -= GAME_TIME_STEP;
-		Update();
+		UpdateEmitter();
+		FinalizeUpdate();
 	}
 }
 
@@ -95,30 +196,33 @@ void ParticleEmitter::SpawnParticle()
 }
 
 void ParticleEmitter::Update()
+{
+	// particles are updated together by UpdateAll after every object has updated
+}
+
+// only touches this emitter so it can run on any thread
+void ParticleEmitter::UpdateEmitter()
 {
 	if (!enableParticles)
 	{
-		for (list<Particle*>::iterator it = particles.begin(); it != particles.end(); ++it)
-			DeleteParticle(*it);
-		particles.clear();
-		if (IsDead())
-		{
-			Destroy();
-			return;
-		}
+		RemoveAllParticles();
+		return;
 	}
 
-	// check if we are past our life time
-	if (IsDead())
+	if (ShouldBeDormant())
 	{
-		// self destruct if we are past life time and have no particles
-		if (particles.empty())
-			Destroy();
+		if (!dormant)
+			StartDormancy();
+		UpdateDormant();
+		return;
 	}
-	else if (systemDef.emitRate > 0 && !emitterPaused)
+	else if (dormant)
+		WakeUp();
+
+	if (!IsDead() && systemDef.emitRate > 0 && !emitterPaused)
 	{
-		// emit new particles
-		emitRateTimer += GAME_TIME_STEP;
+		// emit new particles, the particle budget may slow it down
+		emitRateTimer += GAME_TIME_STEP * emitScale;
 		while (emitRateTimer >= 0)
 		{
 			emitRateTimer -= systemDef.emitRate;
@@ -134,58 +238,376 @@ void ParticleEmitter::Update()
 	}
 
 	// update particles
-	for (list<Particle*>::iterator it = particles.begin(); it != particles.end();) 
-	{
-		Particle& particle = **it;
-
-		if (particle.IsDead())
-		{ 
-			bool canRemove = true;
-			if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON) && it != --particles.end())
-			{
-				// hack: peek at the next particle
-				// we must wait for the next one to die to avoid a glich when we are destroyed
-				const Particle& nextParticle = **((++it)--);
-				if (!nextParticle.IsDead())
-					canRemove = false;
-			}
+	RemoveDeadParticles();
+	UpdateParticles();
+}
 
-			if (canRemove)
-			{
-				// remove dead particle
-				it = particles.erase(it);
-				DeleteParticle(&particle);
-				continue;
-			}
+// called on the main thread after every emitter has updated
+void ParticleEmitter::FinalizeUpdate()
+{
+	// check if we are past our life time
+	if (IsDead())
+	{
+		// self destruct if we are past life time and have no particles
+		if (!enableParticles || particles.count == 0 || dormant && HaveDormantParticlesExpired())
+		{
+			Finish();
+			return;
 		}
-
-		particle.Update();
-		++it;
 	}
-	
+
+	if (dormant)
+		return;
+
 	if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON))
 	{
-		if ((!IsDead() || setTrailEnd) && particles.size() > 1)
+		if ((!IsDead() || setTrailEnd) && particles.count > 1)
 		{
 			setTrailEnd = false;
-			Particle& particle = *particles.back();
+			const int i = particles.count - 1;
 			if (systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE)
 			{
-				particle.xf.position = Vector2::Zero();
-				particle.xfDelta.position = Vector2::Zero();
+				particles.posX[i] = particles.posY[i] = 0;
+				particles.deltaX[i] = particles.deltaY[i] = 0;
 			}
 			else
 			{
-				particle.xf.position = GetXFormWorld().position;
-				particle.xfDelta.position = GetXFormDelta().position;
+				const Vector2 pos = GetXFormWorld().position;
+				const Vector2 delta = GetXFormDelta().position;
+				particles.posX[i] = pos.x;
+				particles.posY[i] = pos.y;
+				particles.deltaX[i] = delta.x;
+				particles.deltaY[i] = delta.y;
 			}
 
 			if (IsDead() && !(systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE))
 			{
-				particle.xf.position += g_cameraBase->GetXFormDelta().position;
-				particle.xfDelta.position += g_cameraBase->GetXFormDelta().position;
+				const Vector2 cameraDelta = g_cameraBase->GetXFormDelta().position;
+				particles.posX[i] += cameraDelta.x;
+				particles.posY[i] += cameraDelta.y;
+				particles.deltaX[i] += cameraDelta.x;
+				particles.deltaY[i] += cameraDelta.y;
+			}
+		}
+	}
+}
+
+class ParticleUpdateTask : public JobTask
+{
+public:
+
+	// emitters are handed out in chunks so the job overhead stays small
+	static const int chunkSize = 8;
+
+	void Run(int index, int threadIndex)
+	{
+		// each chunk gets its own random stream so results don't depend on which thread ran it
+		unsigned int chunkSeed = seed + 2654435761u * (index + 1);
+		FrankRand::SetSeed(chunkSeed? chunkSeed : 1);
+
+		const int end = Min((index + 1) * chunkSize, count);
+		for (int i = index * chunkSize; i < end; ++i)
+			emitters[i]->UpdateEmitter();
+	}
+
+	ParticleEmitter* const* emitters;
+	int count;
+	unsigned int seed;
+};
+
+void ParticleEmitter::UpdateAll()
+{
+	FrankProfilerEntryDefine(L"ParticleEmitter::UpdateAll()", Color::Yellow(), 5);
+
+	// objects are not updated on the frame they are added
+	static vector<ParticleEmitter*> emitters;
+	emitters.clear();
+	for (list<ParticleEmitter*>::iterator it = emitterList.begin(); it != emitterList.end(); ++it)
+	{
+		ParticleEmitter* emitter = *it;
+		if (!emitter->IsDestroyed() && !emitter->WasJustAdded())
+			emitters.push_back(emitter);
+	}
+
+	if (!emitters.empty())
+		UpdateEmitters(&emitters[0], emitters.size());
+}
+
+void ParticleEmitter::UpdateEmitters(ParticleEmitter* const* emitters, int count)
+{
+	ParticleUpdateTask task;
+	task.emitters = emitters;
+	task.count = count;
+	task.seed = RAND_INT;
+
+	// the main thread runs items too so put its random stream back after
+	const unsigned int mainSeed = FrankRand::GetSeed();
+	const int chunkCount = (count + ParticleUpdateTask::chunkSize - 1) / ParticleUpdateTask::chunkSize;
+	g_jobSystem->ParallelFor(task, chunkCount, particleThreads);
+	FrankRand::SetSeed(mainSeed);
+
+	for (int i = 0; i < count; ++i)
+		emitters[i]->FinalizeUpdate();
+}
+
+static inline bool IsParticleDead(const ParticleArrays& particles, int i)
+{
+	return particles.time[i] >= particles.lifeTime[i] + GAME_TIME_STEP;
+}
+
+void ParticleEmitter::RemoveDeadParticles()
+{
+	ParticleArrays& p = particles;
+	if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON))
+	{
+		// trails must stay in order so slide the living particles down
+		// we must wait for the next one to die to avoid a glich when we are destroyed
+		int keepCount = 0;
+		for (int i = 0; i < p.count; ++i)
+		{
+			if (IsParticleDead(p, i) && (i == p.count - 1 || IsParticleDead(p, i + 1)))
+				continue;
+
+			if (keepCount != i)
+				p.Copy(keepCount, i);
+			++keepCount;
+		}
+
+		InterlockedExchangeAdd(&totalParticleCount, keepCount - p.count);
+		p.count = keepCount;
+	}
+	else
+	{
+		// go backwards so removed particles are replaced with ones already checked
+		const int startCount = p.count;
+		for (int i = p.count - 1; i >= 0; --i)
+		{
+			if (IsParticleDead(p, i))
+				p.RemoveSwap(i);
+		}
+		InterlockedExchangeAdd(&totalParticleCount, p.count - startCount);
+	}
+}
+
+void ParticleEmitter::RemoveAllParticles()
+{
+	InterlockedExchangeAdd(&totalParticleCount, -particles.count);
+	particles.Clear();
+}
+
+void ParticleEmitter::UpdateParticles()
+{
+	ParticleArrays& p = particles;
+	if (p.count == 0)
+		return;
+
+	// gravity is the same everywhere unless there is a planet
+	Vector2 gravity = Vector2::Zero();
+	if (systemDef.particleGravity)
+	{
+		if (g_terrain->isCircularPlanet)
+		{
+			for (int i = 0; i < p.count; ++i)
+			{
+				const Vector2 g = GAME_TIME_STEP * systemDef.particleGravity * FrankUtil::CalculateGravity(Vector2(p.posX[i], p.posY[i]));
+				p.velocityX[i] += g.x;
+				p.velocityY[i] += g.y;
 			}
 		}
+		else
+			gravity = GAME_TIME_STEP * systemDef.particleGravity * g_terrain->gravity;
+	}
+
+	// camera space particles move along with the camera, other particles use identity
+	XForm2 xfCamera = XForm2::Identity();
+	if (systemDef.particleFlags & PARTICLE_FLAG_CAMERA_SPACE)
+		xfCamera = g_cameraBase->GetXFormDelta();
+
+	const __m128 dt = _mm_set1_ps(GAME_TIME_STEP);
+	const __m128 gx = _mm_set1_ps(gravity.x);
+	const __m128 gy = _mm_set1_ps(gravity.y);
+	const __m128 cameraCos = _mm_set1_ps(cosf(xfCamera.angle));
+	const __m128 cameraSin = _mm_set1_ps(sinf(xfCamera.angle));
+	const __m128 cameraX = _mm_set1_ps(xfCamera.position.x);
+	const __m128 cameraY = _mm_set1_ps(xfCamera.position.y);
+	const __m128 cameraAngle = _mm_set1_ps(xfCamera.angle);
+	const bool collideTerrain = CanCollideTerrain();
+	__m128 minX = _mm_set1_ps(FLT_MAX);
+	__m128 minY = _mm_set1_ps(FLT_MAX);
+	__m128 maxX = _mm_set1_ps(-FLT_MAX);
+	__m128 maxY = _mm_set1_ps(-FLT_MAX);
+
+	// update 4 particles at a time, the padding past the end is harmless
+	const int fullCount = p.count & ~3;
+	const int simdCount = (p.count + 3) & ~3;
+	for (int i = 0; i < simdCount; i += 4)
+	{
+		const __m128 lastX = _mm_load_ps(&p.posX[i]);
+		const __m128 lastY = _mm_load_ps(&p.posY[i]);
+		const __m128 lastAngle = _mm_load_ps(&p.angle[i]);
+
+		// update gravity
+		const __m128 vx = _mm_add_ps(_mm_load_ps(&p.velocityX[i]), gx);
+		const __m128 vy = _mm_add_ps(_mm_load_ps(&p.velocityY[i]), gy);
+		_mm_store_ps(&p.velocityX[i], vx);
+		_mm_store_ps(&p.velocityY[i], vy);
+
+		// update transform
+		const __m128 x = _mm_add_ps(lastX, _mm_mul_ps(vx, dt));
+		const __m128 y = _mm_add_ps(lastY, _mm_mul_ps(vy, dt));
+		const __m128 angle = _mm_add_ps(lastAngle, _mm_mul_ps(_mm_load_ps(&p.angularSpeed[i]), dt));
+
+		// apply the camera transform
+		__m128 cameraSpaceX = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(x, cameraCos), _mm_mul_ps(y, cameraSin)), cameraX);
+		__m128 cameraSpaceY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, cameraSin), _mm_mul_ps(y, cameraCos)), cameraY);
+		const __m128 cameraSpaceAngle = _mm_add_ps(angle, cameraAngle);
+
+		_mm_store_ps(&p.posX[i], cameraSpaceX);
+		_mm_store_ps(&p.posY[i], cameraSpaceY);
+		_mm_store_ps(&p.angle[i], cameraSpaceAngle);
+		_mm_store_ps(&p.deltaX[i], _mm_sub_ps(cameraSpaceX, lastX));
+		_mm_store_ps(&p.deltaY[i], _mm_sub_ps(cameraSpaceY, lastY));
+		_mm_store_ps(&p.deltaAngle[i], _mm_sub_ps(cameraSpaceAngle, lastAngle));
+		_mm_store_ps(&p.time[i], _mm_add_ps(_mm_load_ps(&p.time[i]), dt));
+
+		if (collideTerrain)
+		{
+			// check these 4 against the tile grid, reload in case any were pushed back
+			CollideTerrain(i, Min(i + 4, p.count));
+			cameraSpaceX = _mm_load_ps(&p.posX[i]);
+			cameraSpaceY = _mm_load_ps(&p.posY[i]);
+		}
+
+		if (i < fullCount)
+		{
+			// padding is left out of the bounds
+			minX = _mm_min_ps(minX, cameraSpaceX);
+			minY = _mm_min_ps(minY, cameraSpaceY);
+			maxX = _mm_max_ps(maxX, cameraSpaceX);
+			maxY = _mm_max_ps(maxY, cameraSpaceY);
+		}
+	}
+
+	// combine the lanes and add the particles that were left out
+	float minXLanes[4], minYLanes[4], maxXLanes[4], maxYLanes[4];
+	_mm_storeu_ps(minXLanes, minX);
+	_mm_storeu_ps(minYLanes, minY);
+	_mm_storeu_ps(maxXLanes, maxX);
+	_mm_storeu_ps(maxYLanes, maxY);
+	Vector2 lowerBound(FLT_MAX), upperBound(-FLT_MAX);
+	for (int i = 0; i < 4; ++i)
+	{
+		lowerBound.x = Min(lowerBound.x, minXLanes[i]);
+		lowerBound.y = Min(lowerBound.y, minYLanes[i]);
+		upperBound.x = Max(upperBound.x, maxXLanes[i]);
+		upperBound.y = Max(upperBound.y, maxYLanes[i]);
+	}
+	for (int i = fullCount; i < p.count; ++i)
+	{
+		lowerBound.x = Min(lowerBound.x, p.posX[i]);
+		lowerBound.y = Min(lowerBound.y, p.posY[i]);
+		upperBound.x = Max(upperBound.x, p.posX[i]);
+		upperBound.y = Max(upperBound.y, p.posY[i]);
+	}
+
+	// pad by the largest particle
+	const float maxSize = ROOT_2 * Max
+	(
+		fabs(systemDef.particleSizeStart) * (1 + systemDef.particleSizeStartRandomness),
+		fabs(systemDef.particleSizeEnd) * (1 + systemDef.particleSizeEndRandomness)
+	);
+	particleBounds = Box2AABB(lowerBound - Vector2(maxSize), upperBound + Vector2(maxSize));
+
+	// positions changed so the render cache is stale
+	cachedFrame = 0;
+}
+
+bool ParticleEmitter::CanCollideTerrain() const
+{
+	// only world space particles can hit the terrain
+	return (systemDef.particleFlags & PARTICLE_FLAG_COLLIDE_TERRAIN) && g_terrain
+		&& !(systemDef.particleFlags & (PARTICLE_FLAG_LOCAL_SPACE|PARTICLE_FLAG_CAMERA_SPACE));
+}
+
+// point test against the terrain physics layer, returns the tile if the point is inside a solid surface
+static inline const TerrainTile* GetSolidTerrainTile(const Terrain& terrain, const Vector2& pos, IntVector2& tileOffset, Vector2& localPos)
+{
+	tileOffset = terrain.GetTileOffset(pos);
+	const TerrainTile* tile = terrain.GetTile(tileOffset.x, tileOffset.y, Terrain::physicsLayer);
+	if (!tile || tile->IsClear())
+		return NULL;
+
+	// full tiles use surface 0
+	localPos = pos - terrain.GetTilePos(tileOffset.x, tileOffset.y);
+	const int side = tile->IsFull()? 0 : tile->GetSurfaceSide(localPos);
+	if (!tile->GetSurfaceHasArea(side) || !GameSurfaceInfo::Get(tile->GetSurfaceData(side)).HasCollision())
+		return NULL;
+
+	return tile;
+}
+
+// uses the tile grid instead of physics so it stays cheap enough to do every step
+void ParticleEmitter::CollideTerrain(int start, int end)
+{
+	ParticleArrays& p = particles;
+	const Terrain& terrain = *g_terrain;
+	const bool kill = (systemDef.particleFlags & PARTICLE_FLAG_COLLIDE_KILL) != 0;
+
+	for (int i = start; i < end; ++i)
+	{
+		const Vector2 pos(p.posX[i], p.posY[i]);
+		IntVector2 tileOffset;
+		Vector2 localPos;
+		const TerrainTile* tile = GetSolidTerrainTile(terrain, pos, tileOffset, localPos);
+		if (!tile)
+			continue;
+
+		// particles that started inside the terrain are left alone so they don't get stuck
+		const Vector2 delta(p.deltaX[i], p.deltaY[i]);
+		const Vector2 lastPos = pos - delta;
+		IntVector2 lastTileOffset;
+		Vector2 lastLocalPos;
+		if (GetSolidTerrainTile(terrain, lastPos, lastTileOffset, lastLocalPos))
+			continue;
+
+		// put it back where it was before it went in
+		p.posX[i] = lastPos.x;
+		p.posY[i] = lastPos.y;
+		p.deltaX[i] = p.deltaY[i] = 0;
+
+		if (kill)
+		{
+			p.time[i] = p.lifeTime[i] + GAME_TIME_STEP;
+			continue;
+		}
+
+		Vector2 normal;
+		const int side = tile->IsFull()? 0 : tile->GetSurfaceSide(localPos);
+		const int otherSide = 1 - side;
+		if (!tile->IsFull() && !(tile->GetSurfaceHasArea(otherSide) && GameSurfaceInfo::Get(tile->GetSurfaceData(otherSide)).HasCollision()))
+		{
+			// push out through the edge, towards the open side
+			const Line2& edge = tile->GetEdgeLine();
+			const Vector2 direction = (edge.p2 - edge.p1).Normalize();
+			normal = Vector2(-direction.y, direction.x);
+			if (normal.Dot(localPos - edge.p1) > 0)
+				normal = -normal;
+		}
+		else if (lastTileOffset != tileOffset)
+		{
+			// solid tile, push back out the way it came in
+			normal = Vector2(lastTileOffset - tileOffset).Normalize();
+		}
+		else
+			normal = -delta.Normalize();
+
+		// reflect the part of the velocity going into the surface
+		Vector2 velocity(p.velocityX[i], p.velocityY[i]);
+		const float normalSpeed = velocity.Dot(normal);
+		if (normalSpeed < 0)
+			velocity -= (1 + systemDef.particleBounce) * normalSpeed * normal;
+		p.velocityX[i] = velocity.x;
+		p.velocityY[i] = velocity.y;
 	}
 }
 
@@ -197,21 +619,71 @@ void ParticleEmitter::SetTrailEnd(const Vector2& trailEndPos)
 	SetPosLocal(trailEndPos);
 	setTrailEnd = true;
 
-	if (particles.size() > 1)
+	if (particles.count > 1)
 	{
 		// set the first particle to be emiter position
-		Particle& particle = *particles.back();
-		particle.xfDelta.position += trailEndPos - particle.xf.position;
-		particle.xf.position = trailEndPos;// - g_cameraBase->GetXFormDelta().position;
+		const int i = particles.count - 1;
+		particles.deltaX[i] += trailEndPos.x - particles.posX[i];
+		particles.deltaY[i] += trailEndPos.y - particles.posY[i];
+		particles.posX[i] = trailEndPos.x;
+		particles.posY[i] = trailEndPos.y;
+	}
+}
+
+void ParticleEmitter::CacheRenderData(const XForm2& xfParent)
+{
+	ParticleArrays& p = particles;
+	const float interpolation = g_interpolatePercent;
+	const bool useGradient = curves.useGradient;
+	const float parentCos = cosf(xfParent.angle);
+	const float parentSin = sinf(xfParent.angle);
+
+	for (int i = 0; i < p.count; ++i)
+	{
+		// caluculate percent of particle life time
+		const float percent = CapPercent((p.lifeTime[i] == 0) ? 0 : (p.time[i] - interpolation*GAME_TIME_STEP)/p.lifeTime[i]);
+
+		// look up the curves, every table has the same spacing
+		int sample;
+		float sampleFraction;
+		ParticleCurveTables::GetSample(percent, sample, sampleFraction);
+
+		Color color = p.colorStart[i] + percent * p.colorDelta[i];
+		if (useGradient)
+		{
+			const Color tint = ParticleCurveTables::Lookup(curves.gradient, sample, sampleFraction);
+			color = Color(color.r*tint.r, color.g*tint.g, color.b*tint.b, color.a*tint.a);
+		}
+		color.a *= ParticleCurveTables::Lookup(curves.alpha, sample, sampleFraction);
+		p.cachedColor[i] = color;
+		p.cachedSize[i] = p.sizeStart[i] + ParticleCurveTables::Lookup(curves.size, sample, sampleFraction) * (p.sizeEnd[i] - p.sizeStart[i]);
+
+		// interpolate and transform by the parent
+		const float x = p.posX[i] - interpolation * p.deltaX[i];
+		const float y = p.posY[i] - interpolation * p.deltaY[i];
+		p.cachedX[i] = x*parentCos - y*parentSin + xfParent.position.x;
+		p.cachedY[i] = x*parentSin + y*parentCos + xfParent.position.y;
+		p.cachedAngle[i] = p.angle[i] - interpolation * p.deltaAngle[i] + xfParent.angle;
 	}
-	if (particles.size() > 1)
+
+	if (systemDef.particleFlags & PARTICLE_FLAG_TRAIL_RIBBON && p.count > 1)
 	{
-		// set the first particle to be emiter position
-		Particle& particle = *particles.back();
-		particle.xf.position = trailEndPos;
+		// create a fake previous pos based on where the next particle is
+		// this used to orient the ribbon properly
+		Vector2 previousPos(2*p.cachedX[0] - p.cachedX[1], 2*p.cachedY[0] - p.cachedY[1]);
+		for (int i = 0; i < p.count; ++i)
+		{
+			const Vector2 pos(p.cachedX[i], p.cachedY[i]);
+			const Vector2 offset = p.cachedSize[i]*(pos - previousPos).Normalize().RotateRightAngle();
+			p.cachedX[i] = pos.x - offset.x;
+			p.cachedY[i] = pos.y - offset.y;
+			p.cachedX2[i] = pos.x + offset.x;
+			p.cachedY2[i] = pos.y + offset.y;
+			previousPos = pos;
+		}
 	}
 }
-	
+
 void ParticleEmitter::RenderInternal(bool allowAdditive)
 {
 	FrankProfilerEntryDefine(L"ParticleEmitter::Render()", Color::White(), 6);
@@ -219,67 +691,119 @@ void ParticleEmitter::RenderInternal(bool allowAdditive)
 	const XForm2 xfParticles = (systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE)? xf : XForm2::Identity();
 	//xfParticles.RenderDebug(Color::White(), 1, 1);
 
+	if (cachedFrame != g_gameControlBase->GetRenderFrameCount())
+	{
+		// cache data for faster rendering, shadow passes draw the same particles again
+		cachedFrame = g_gameControlBase->GetRenderFrameCount();
+		CacheRenderData(xfParticles);
+	}
+
+	const ParticleArrays& p = particles;
+	const float alphaScale = DeferredRender::GetRenderPassIsShadow()? shadowRenderAlpha : 1;
+
 	if (systemDef.particleFlags & PARTICLE_FLAG_TRAIL_LINE)
 	{
-		if (particles.size() > 1)
+		if (p.count > 1)
 		{
 			// set additive rendering for simple verts
 			g_render->SetSimpleVertsAreAdditive(allowAdditive && (systemDef.particleFlags & PARTICLE_FLAG_ADDITIVE) != 0);
 
-			Particle::simpleVertsNeedsCap = true;
-			for (list<Particle*>::iterator it = particles.begin(); it != particles.end(); ++it) 
-				(**it).RenderTrail(xfParticles);
-   
+			DWORD lastColor = 0;
+			g_render->CapLineVerts(Vector2(p.cachedX[0], p.cachedY[0]));
+			for (int i = 0; i < p.count; ++i)
+			{
+				Color color = p.cachedColor[i];
+				color.a *= alphaScale;
+				lastColor = color;
+				g_render->AddPointToLineVerts(Vector2(p.cachedX[i], p.cachedY[i]), lastColor);
+			}
+
 			// connect to the end and cap it off
 			const Vector2 endPos = xf.position;
-			g_render->AddPointToLineVerts(endPos, Particle::simpleVertsLastColor);
+			g_render->AddPointToLineVerts(endPos, lastColor);
 			g_render->CapLineVerts(endPos);
 		}
 	}
 	else if (systemDef.particleFlags & PARTICLE_FLAG_TRAIL_RIBBON)
 	{
-		if (particles.size() > 1)
+		if (p.count > 1)
 		{
 			// set additive rendering for simple verts
 			g_render->SetSimpleVertsAreAdditive(allowAdditive && (systemDef.particleFlags & PARTICLE_FLAG_ADDITIVE) != 0);
 
-			Vector2 previousPos = (**particles.begin()).GetInterpolatedXForm(xfParticles).position;
-			if (particles.size() > 1)
+			DWORD lastColor = 0;
+			g_render->CapTriVerts(Vector2(p.cachedX[0], p.cachedY[0]));
+			for (int i = 0; i < p.count; ++i)
 			{
-				// if ribbion has more then 1 particle, create a fake previous pos based on where the next particle is
-				// this used to orient the ribbon properly
-				const Vector2 nextPos = (**(++particles.begin())).GetInterpolatedXForm(xfParticles).position;
-				previousPos = previousPos - (nextPos - previousPos);
+				Color color = p.cachedColor[i];
+				color.a *= alphaScale;
+				lastColor = color;
+				g_render->AddPointToTriVerts(Vector2(p.cachedX[i], p.cachedY[i]), lastColor);
+				g_render->AddPointToTriVerts(Vector2(p.cachedX2[i], p.cachedY2[i]), lastColor);
 			}
 
-			Particle::simpleVertsNeedsCap = true;
-			for (list<Particle*>::iterator it = particles.begin(); it != particles.end(); ++it) 
-				(**it).RenderRibbon(xfParticles, previousPos);
-		
 			if (IsDead() && systemDef.particleFlags & PARTICLE_FLAG_CAMERA_SPACE)
 			{
 				// for camera space systems that are no longer spawning particles, cap on the last particle instead of the emitter
 				// this fixes a tiny glitch where the end point will see to stick in world space since only particles update their camera space offsets
-				g_render->CapTriVerts(previousPos);
+				const int i = p.count - 1;
+				g_render->CapTriVerts(0.5f*Vector2(p.cachedX[i] + p.cachedX2[i], p.cachedY[i] + p.cachedY2[i]));
 			}
 			else
 			{
 				// connect to the end and cap it off
 				const Vector2 endPos = xf.position;
-				g_render->AddPointToTriVerts(endPos, Particle::simpleVertsLastColor);
+				g_render->AddPointToTriVerts(endPos, lastColor);
 				g_render->CapTriVerts(endPos);
 				//endPos.RenderDebug();
 			}
 		}
 	}
+	else if (ParticleBatch::enable && !DeferredRender::GetRenderPassIsNormalMap() && !DeferredRender::GetRenderPassIsSpecular())
+	{
+		// add to the batch for this render group, normal and specular passes need their own transform per quad
+		const bool additive = (allowAdditive && (systemDef.particleFlags & PARTICLE_FLAG_ADDITIVE) != 0);
+		const int bucket = g_particleBatch.GetBucket(systemDef.texture, additive);
+
+		// shadows use the shadow color with the particle's alpha like other quads do
+		const bool useShadowColor = DeferredRender::GetRenderPassIsShadow() &&
+			(DeferredRender::GetRenderPassIsDirectionalShadow() || !DeferredRender::TransparentRenderBlock::IsActive());
+
+		for (int i = 0; i < p.count; ++i)
+		{
+			const Vector2 pos(p.cachedX[i], p.cachedY[i]);
+			const float size = p.cachedSize[i];
+			if (!g_cameraBase->CameraTest(pos, fabs(size) * ROOT_2))
+				continue;
+
+			Color color = p.cachedColor[i];
+			if (useShadowColor)
+			{
+				const float alpha = color.a;
+				color = DeferredRender::defaultShadowColor;
+				color.a *= alpha;
+			}
+			color.a *= alphaScale;
+			g_particleBatch.AddQuad(bucket, pos, p.cachedAngle[i], size, color);
+		}
+	}
 	else
 	{
 		const bool additive = (allowAdditive && (systemDef.particleFlags & PARTICLE_FLAG_ADDITIVE) != 0);
 		DeferredRender::AdditiveRenderBlock additiveRenderBlock(additive);
 		DeferredRender::EmissiveRenderBlock emissiveRenderBlock(additive);
 
-		for (list<Particle*>::iterator it = particles.begin(); it != particles.end(); ++it) 
-			(**it).Render(xfParticles);
+		for (int i = 0; i < p.count; ++i)
+		{
+			const Vector2 pos(p.cachedX[i], p.cachedY[i]);
+			const float size = p.cachedSize[i];
+			if (!g_cameraBase->CameraTest(pos, fabs(size) * ROOT_2))
+				continue;
+
+			Color color = p.cachedColor[i];
+			color.a *= alphaScale;
+			g_render->RenderQuad(XForm2(pos, p.cachedAngle[i]), Vector2(size), color, systemDef.texture);
+		}
 	}
 }
 
@@ -289,7 +813,7 @@ void ParticleEmitter::ManualRender()
 	{
 		// todo: add flag for particles blocking vision
 		if (DeferredRender::GetRenderPassIsVision())
-			return; 
+			return;
 
 		if (DeferredRender::GetRenderPassIsLight())
 		{
@@ -323,6 +847,10 @@ void ParticleEmitter::ManualRender()
 			}
 		}
 
+		// skip the whole emitter if none of it is on screen
+		if (!g_cameraBase->CameraTest(GetParticleBounds()))
+			return;
+
 		RenderInternal();
 	}
 }
@@ -340,6 +868,9 @@ inline void ParticleEmitter::AddParticle(const XForm2& xf, float startTime)
 	if (!enableParticles)
 		return;
 
+	if (totalParticleCount >= 2*maxParticles)
+		return; // way over budget, wait for the budget to evict some
+
 	if (particleStopRadius > 0 && g_cameraBase && !g_cameraBase->CameraTest(GetPosWorld(), particleStopRadius))
 		return; // off screen
 
@@ -359,203 +890,528 @@ inline void ParticleEmitter::AddParticle(const XForm2& xf, float startTime)
 	if (!(systemDef.particleFlags & PARTICLE_FLAG_DONT_FLIP_ANGULAR))
 		angularSpeed *= RAND_SIGN;
 
-	Particle *particle = NewParticle();
-	if (!particle)
-		return;
+	ParticleArrays& p = particles;
+	const int i = p.Add();
+	InterlockedIncrement(&totalParticleCount);
+	cachedFrame = 0;
+
+	p.posX[i] = particlePosition.x;
+	p.posY[i] = particlePosition.y;
+	p.deltaX[i] = p.deltaY[i] = p.deltaAngle[i] = 0;
+	p.velocityX[i] = speed * direction.x;
+	p.velocityY[i] = speed * direction.y;
+	p.angularSpeed[i] = angularSpeed;
+	p.time[i] = startTime;
 
-	particle->Init(systemDef, XForm2(particlePosition, angle), direction*speed, angularSpeed, startTime);
-	particles.push_back(particle);
+	// randomize particle values
+	p.lifeTime[i] = systemDef.particleLifeTime * (1 + systemDef.particleLifeTimeRandomness*RAND_BETWEEN(-1.0f,1.0f));
+
+	// randomly flip the texture for more randomness
+	const float randomFlip = (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON|PARTICLE_FLAG_DONT_FLIP))? 1 : (float)RAND_SIGN;
+	p.sizeStart[i] = randomFlip * systemDef.particleSizeStart * (1 + systemDef.particleSizeStartRandomness*RAND_BETWEEN(-1.0f,1.0f));
+	p.sizeEnd[i] = randomFlip * systemDef.particleSizeEnd * (1 + systemDef.particleSizeEndRandomness*RAND_BETWEEN(-1.0f,1.0f));
+	p.angle[i] = angle + RAND_BETWEEN(-systemDef.particleConeAngle, systemDef.particleConeAngle);
+
+	const Color colorStart = Color::RandBetween(systemDef.colorStart1, systemDef.colorStart2);
+	const Color colorEnd = Color::RandBetween(systemDef.colorEnd1, systemDef.colorEnd2);
+	p.colorStart[i] = colorStart;
+	p.colorDelta[i] = colorEnd - colorStart;
 }
 
 ///////////////////////////////////////////////////////////
-// particle member functions
+// particle budget
 ///////////////////////////////////////////////////////////
 
-void Particle::Init(const ParticleSystemDef& _systemDef, const XForm2& _xf, const Vector2& _velocity, float _angularSpeed, float _startTime)
+Box2AABB ParticleEmitter::GetParticleBounds() const
 {
-	cachedFrame = 0;
-	systemDef = &_systemDef;
-	xf = _xf;
-	xfDelta = XForm2::Identity();
-	velocity = _velocity;
-	angularSpeed = _angularSpeed;
-	time = _startTime;
-
-	// randomize particle values
-	lifeTime = systemDef->particleLifeTime * (1 + systemDef->particleLifeTimeRandomness*RAND_BETWEEN(-1.0f,1.0f));
+	Box2AABB emitterBounds(GetPosWorld());
+	Box2AABB bounds = particleBounds;
+	bool hasParticles = particles.count > 0;
+	if (dormant)
+	{
+		// dormant particles could be anywhere they can reach before they die
+		const float dormantTime = dormantSteps * GAME_TIME_STEP;
+		const float gravity = fabs(systemDef.particleGravity) * FrankUtil::CalculateGravity(GetPosWorld()).Magnitude();
+		const float growthTime = Min(dormantTime, dormantLifeTime);
+		const Vector2 growth(dormantMaxSpeed * growthTime + 0.5f * gravity * growthTime * growthTime);
+		bounds.lowerBound -= growth;
+		bounds.upperBound += growth;
+
+		// once they are all dead only newly emitted particles matter
+		if (dormantTime > dormantLifeTime)
+			hasParticles = false;
+
+		if (dormantEmitCount > 0)
+		{
+			// particles that will be added when waking up can only be so far from the emitter
+			const float emitTime = Min(dormantTime, GetMaxParticleLifeTime());
+			const float speed = fabs(systemDef.particleSpeed) * (1 + systemDef.particleSpeedRandomness);
+			const Vector2 emitGrowth(systemDef.emitSize + speed * emitTime + 0.5f * gravity * emitTime * emitTime);
+			emitterBounds.lowerBound -= emitGrowth;
+			emitterBounds.upperBound += emitGrowth;
+		}
+	}
 
-	// randomly flip the texture for more randomness
-	const float randomFlip = (systemDef->particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON|PARTICLE_FLAG_DONT_FLIP))? 1 : (float)RAND_SIGN;
-	sizeStart = randomFlip * systemDef->particleSizeStart * (1 + systemDef->particleSizeStartRandomness*RAND_BETWEEN(-1.0f,1.0f));
-	sizeEnd = randomFlip * systemDef->particleSizeEnd * (1 + systemDef->particleSizeEndRandomness*RAND_BETWEEN(-1.0f,1.0f));
-	xf.angle += RAND_BETWEEN(-systemDef->particleConeAngle, systemDef->particleConeAngle);
+	if (!hasParticles)
+		return emitterBounds;
 
-	colorStart = Color::RandBetween(systemDef->colorStart1, systemDef->colorStart2);
-	const Color colorEnd = Color::RandBetween(systemDef->colorEnd1, systemDef->colorEnd2);
-	colorDelta = (colorEnd - colorStart);
+	if (systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE)
+		return emitterBounds + Box2AABB(GetXFormWorld(), bounds);
+	else
+		return emitterBounds + bounds;
 }
 
-inline void Particle::Update()
+float ParticleEmitter::CalculatePriority() const
 {
-	// update time
-	time += GAME_TIME_STEP;
+	if (IsDestroyed())
+		return 0; // get rid of these first
+
+	// closer emitters are more important
+	const float distance = (GetPosWorld() - g_cameraBase->GetPosWorld()).Magnitude();
+	float value = systemDef.importance / (1 + distance / Max(particlePriorityDistance, FRANK_EPSILON));
+	if (!g_cameraBase->CameraTest(GetParticleBounds()))
+		value *= particleOffScreenPriority;
 
-	const XForm2 xfLast = xf;
+	return value;
+}
 
-	// update gravity
-	if (systemDef->particleGravity)
-		velocity += GAME_TIME_STEP * systemDef->particleGravity * FrankUtil::CalculateGravity(xf.position); 
+int ParticleEmitter::EvictParticles(int evictCount)
+{
+	ParticleArrays& p = particles;
+	if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON))
+	{
+		// trails lose their oldest end but keep enough to connect to the emitter
+		evictCount = Min(evictCount, p.count - 2);
+	}
+	else
+	{
+		// new particles go on the end, dead ones are swapped out so the front is only roughly the oldest
+		evictCount = Min(evictCount, p.count);
+	}
+	if (evictCount <= 0)
+		return 0;
 
-	// update transform
-	xf.position += velocity * GAME_TIME_STEP;
-	xf.angle += angularSpeed * GAME_TIME_STEP;
+	// shift the survivors down so the ones evicted next time are still the older ones
+	for (int i = evictCount; i < p.count; ++i)
+		p.Copy(i - evictCount, i);
+	p.count -= evictCount;
 
-	// camera space particles move along with the camera
-	if (systemDef->particleFlags & PARTICLE_FLAG_CAMERA_SPACE)
-		xf *= g_cameraBase->GetXFormDelta();
-	
-	xfDelta = xf - xfLast;
+	InterlockedExchangeAdd(&totalParticleCount, -evictCount);
+	cachedFrame = 0;
+	return evictCount;
 }
 
-inline void Particle::Render(const XForm2& xfParent)
+void ParticleEmitter::UpdateParticleBudget()
 {
-	if (cachedFrame != g_gameControlBase->GetRenderFrameCount())
-	{
-		// cache data for faster rendering
-		cachedFrame = g_gameControlBase->GetRenderFrameCount();
+	FrankProfilerEntryDefine(L"ParticleEmitter::UpdateParticleBudget()", Color::Yellow(), 5);
 
-		// caluculate percent of particle life time
-		const float percent = CapPercent((lifeTime == 0) ? 0 : (time - g_interpolatePercent*GAME_TIME_STEP)/lifeTime);
+	evictedParticleCount = 0;
+	throttledEmitterCount = 0;
+	dormantEmitterCount = 0;
+	for (list<ParticleEmitter*>::iterator it = emitterList.begin(); it != emitterList.end(); ++it)
+	{
+		ParticleEmitter& emitter = **it;
+		emitter.priority = emitter.CalculatePriority();
+		emitter.emitScale = 1;
+		if (emitter.dormant)
+			++dormantEmitterCount;
+	}
 
-		// cache the particle info for this render frame
-		const XForm2 xfWorld = GetInterpolatedXForm(xfParent);
-		cachedSize = sizeStart + percent * (sizeEnd - sizeStart);
+	// emission is throttled more as the budget fills up
+	const int budget = Max(maxParticles, 0);
+	const float throttleStart = CapPercent(particleThrottleStart);
+	const float throttleCount = throttleStart * budget;
+	const float throttleRange = budget - throttleCount;
+	float pressure = 0;
+	if (throttleRange > 0)
+		pressure = CapPercent((totalParticleCount - throttleCount) / throttleRange);
+	else if (totalParticleCount > throttleCount)
+		pressure = 1;
+
+	if (pressure > 0 || totalParticleCount > budget)
+	{
+		list<ParticleEmitter*> sortedEmitters = emitterList;
+		sortedEmitters.sort(PriorityCompare);
 
-		cachedColor = colorStart + percent * colorDelta;
-		if (percent < systemDef->particleFadeInTime)
-			cachedColor.a *= (percent / systemDef->particleFadeInTime);
+		// the least important emitters are throttled the most
+		int rank = 0;
+		const float emitterCount = (float)sortedEmitters.size();
+		for (list<ParticleEmitter*>::iterator it = sortedEmitters.begin(); it != sortedEmitters.end(); ++it, ++rank)
+		{
+			ParticleEmitter& emitter = **it;
+			const float rankPercent = (rank + 0.5f) / emitterCount;
+			emitter.emitScale = 1 - pressure * (1 - rankPercent);
+			if (emitter.emitScale < 1 && !emitter.IsDead() && emitter.systemDef.emitRate > 0)
+				++throttledEmitterCount;
+		}
 
-		cachedPos1 = xfWorld.position;
-		cachedAngle = xfWorld.angle;
+		// evict particles from the least important emitters until we are back under budget
+		for (list<ParticleEmitter*>::iterator it = sortedEmitters.begin(); it != sortedEmitters.end() && totalParticleCount > budget; ++it)
+			evictedParticleCount += (**it).EvictParticles(totalParticleCount - budget);
 	}
 
-	if (!g_cameraBase->CameraTest(cachedPos1, fabs(cachedSize) * ROOT_2))
-		return;
-	
-	Color color = cachedColor;
-	if (DeferredRender::GetRenderPassIsShadow())
-		color.a *= ParticleEmitter::shadowRenderAlpha;
-	
-	const XForm2 xfWorld(cachedPos1, cachedAngle);
-	g_render->RenderQuad(xfWorld, Vector2(cachedSize), color, systemDef->texture);
+	FrankProfilerCounterSet(L"Particles Live", Color::Yellow(), 5, totalParticleCount);
+	FrankProfilerCounterSet(L"Particles Evicted", Color::Yellow(), 5, evictedParticleCount);
+	FrankProfilerCounterSet(L"Particle Emitters Throttled", Color::Yellow(), 5, throttledEmitterCount);
+	FrankProfilerCounterSet(L"Particle Emitters Dormant", Color::Yellow(), 5, dormantEmitterCount);
+	FrankProfilerCounterSet(L"Particle Emitters Pooled", Color::Yellow(), 5, (int)emitterPool.size());
 }
 
-inline void Particle::RenderTrail(const XForm2& xfParent)
+///////////////////////////////////////////////////////////
+// dormant emitters
+///////////////////////////////////////////////////////////
+
+bool ParticleEmitter::ShouldBeDormant() const
 {
-	if (cachedFrame != g_gameControlBase->GetRenderFrameCount())
-	{
-		// cache data for faster rendering
-		cachedFrame = g_gameControlBase->GetRenderFrameCount();
+	if (!particleDormancy || !g_cameraBase)
+		return false;
 
-		// caluculate percent of particle life time
-		const float percent = CapPercent((lifeTime == 0) ? 0 : (time - g_interpolatePercent*GAME_TIME_STEP)/lifeTime);
+	// camera space particles are always near the camera
+	if (systemDef.particleFlags & PARTICLE_FLAG_CAMERA_SPACE)
+		return false;
+
+	// there is no way to predict where colliding particles end up
+	if (CanCollideTerrain())
+		return false;
 
-		cachedColor = colorStart + percent * colorDelta;
-		if (percent < systemDef->particleFadeInTime)
-			cachedColor.a *= (percent / systemDef->particleFadeInTime);
+	// trails depend on the path the emitter took so they must keep updating until they stop emitting
+	if (systemDef.particleFlags & (PARTICLE_FLAG_TRAIL_LINE|PARTICLE_FLAG_TRAIL_RIBBON) && !IsDead())
+		return false;
+
+	Box2AABB bounds = GetParticleBounds();
+	bounds.lowerBound -= Vector2(particleDormantMargin);
+	bounds.upperBound += Vector2(particleDormantMargin);
+	return !g_cameraBase->CameraTest(bounds);
+}
 
-		cachedPos1 = GetInterpolatedXForm(xfParent).position;
+void ParticleEmitter::StartDormancy()
+{
+	dormant = true;
+	dormantSteps = 0;
+	dormantEmitCount = 0;
+
+	// save how far and how long the particles can go
+	const ParticleArrays& p = particles;
+	float maxSpeedSquared = 0;
+	dormantLifeTime = 0;
+	for (int i = 0; i < p.count; ++i)
+	{
+		maxSpeedSquared = Max(maxSpeedSquared, p.velocityX[i]*p.velocityX[i] + p.velocityY[i]*p.velocityY[i]);
+		dormantLifeTime = Max(dormantLifeTime, p.lifeTime[i] + GAME_TIME_STEP - p.time[i]);
 	}
-	
-	Color color = cachedColor;
-	if (DeferredRender::GetRenderPassIsShadow())
-		color.a *= ParticleEmitter::shadowRenderAlpha;
+	dormantMaxSpeed = sqrtf(maxSpeedSquared);
+}
+
+void ParticleEmitter::UpdateDormant()
+{
+	++dormantSteps;
 
-	if (Particle::simpleVertsNeedsCap)
+	if (!IsDead() && systemDef.emitRate > 0 && !emitterPaused)
 	{
-		g_render->CapLineVerts(cachedPos1);
-		Particle::simpleVertsNeedsCap = false;
+		// count the particles that would have been emitted
+		emitRateTimer += GAME_TIME_STEP * emitScale;
+		while (emitRateTimer >= 0)
+		{
+			emitRateTimer -= systemDef.emitRate;
+			if (dormantEmitCount++ == 0)
+				dormantFirstEmitStep = dormantSteps;
+			dormantLastEmitStep = dormantSteps;
+		}
 	}
-	
-	const DWORD colorDword = color;
-	g_render->AddPointToLineVerts(cachedPos1, colorDword);
-	simpleVertsLastColor = colorDword;
 }
 
-inline void Particle::RenderRibbon(const XForm2& xfParent, Vector2& previousPos)
+bool ParticleEmitter::HaveDormantParticlesExpired() const
 {
-	if (cachedFrame != g_gameControlBase->GetRenderFrameCount())
+	// check the particles that were alive when going dormant and any that would have been emitted since
+	const float dormantTime = dormantSteps * GAME_TIME_STEP;
+	const bool emittedAlive = dormantEmitCount > 0 && (dormantSteps - dormantLastEmitStep) * GAME_TIME_STEP <= GetMaxParticleLifeTime() + GAME_TIME_STEP;
+	return dormantTime > dormantLifeTime && !emittedAlive;
+}
+
+void ParticleEmitter::WakeUp()
+{
+	// move the particles to where they would be if they had been updating
+	AdvanceParticles(0, particles.count, dormantSteps);
+
+	// add the particles that were not emitted that would still be alive, newest first
+	const XForm2 xfEmit = (systemDef.particleFlags & PARTICLE_FLAG_LOCAL_SPACE)? XForm2::Identity() : GetXFormWorld();
+	const float maxLifeTime = GetMaxParticleLifeTime();
+	for (int j = 0; j < dormantEmitCount; ++j)
 	{
-		// cache data for faster rendering
-		cachedFrame = g_gameControlBase->GetRenderFrameCount();
+		// assume they were spread evenly between the first and last missed emit
+		const float percent = (dormantEmitCount > 1)? j / float(dormantEmitCount - 1) : 0;
+		const int emitStep = (int)(dormantLastEmitStep + percent * (dormantFirstEmitStep - dormantLastEmitStep));
+		const int stepCount = dormantSteps - emitStep + 1;
+		if (stepCount * GAME_TIME_STEP > maxLifeTime + GAME_TIME_STEP)
+			break;
+
+		const int i = particles.count;
+		AddParticle(xfEmit);
+		if (particles.count == i)
+			break; // no room
+
+		AdvanceParticles(i, i + 1, stepCount);
+	}
 
-		// caluculate percent of particle life time
- 		const float percent = CapPercent((lifeTime == 0) ? 0 : (time - g_interpolatePercent*GAME_TIME_STEP)/lifeTime);
+	dormant = false;
+	dormantSteps = 0;
+	dormantEmitCount = 0;
+}
 
-		cachedColor = colorStart + percent * colorDelta;
-		if (percent < systemDef->particleFadeInTime)
-			cachedColor.a *= (percent / systemDef->particleFadeInTime);
+void ParticleEmitter::AdvanceParticles(int start, int end, int stepCount)
+{
+	if (stepCount <= 0)
+		return;
 
-		const XForm2 xfWorld = GetInterpolatedXForm(xfParent);
-		const float size = sizeStart + percent * (sizeEnd - sizeStart);
+	// particles are ballistic so any number of steps can be done at once
+	// this matches the update loop exactly when gravity is constant
+	ParticleArrays& p = particles;
+	const float deltaTime = stepCount * GAME_TIME_STEP;
+	const float gravityScale = 0.5f * stepCount * (stepCount + 1) * GAME_TIME_STEP * GAME_TIME_STEP;
+	for (int i = start; i < end; ++i)
+	{
+		Vector2 gravity = Vector2::Zero();
+		if (systemDef.particleGravity)
+			gravity = systemDef.particleGravity * FrankUtil::CalculateGravity(Vector2(p.posX[i], p.posY[i]));
+
+		p.posX[i] += deltaTime * p.velocityX[i] + gravityScale * gravity.x;
+		p.posY[i] += deltaTime * p.velocityY[i] + gravityScale * gravity.y;
+		p.velocityX[i] += deltaTime * gravity.x;
+		p.velocityY[i] += deltaTime * gravity.y;
+		p.angle[i] += deltaTime * p.angularSpeed[i];
+		p.time[i] += deltaTime;
+
+		// what the last step would have moved
+		p.deltaX[i] = GAME_TIME_STEP * p.velocityX[i];
+		p.deltaY[i] = GAME_TIME_STEP * p.velocityY[i];
+		p.deltaAngle[i] = GAME_TIME_STEP * p.angularSpeed[i];
+	}
 
-		const Vector2 offset = size*(xfWorld.position - previousPos).Normalize().RotateRightAngle();
+	cachedFrame = 0;
+}
 
-		cachedPos1 = xfWorld.position - offset;
-		cachedPos2 = xfWorld.position + offset;
+///////////////////////////////////////////////////////////
+// particle arrays
+///////////////////////////////////////////////////////////
 
-		// pass out the position of the particle
-		previousPos = xfWorld.position;
+ParticleArrays::ParticleArrays() :
+	count(0),
+	capacity(0),
+	block(NULL)
+{
+	SetArrays(NULL, 0);
+}
 
-		//cachedPos1.RenderDebug();
-	}
-	
-	Color color = cachedColor;
-	if (DeferredRender::GetRenderPassIsShadow())
-		color.a *= ParticleEmitter::shadowRenderAlpha;
+ParticleArrays::~ParticleArrays()
+{
+	_aligned_free(block);
+}
+
+void ParticleArrays::Reserve(int _capacity)
+{
+	// keep room for a whole simd lane at the end
+	_capacity = (_capacity + 3) & ~3;
+	if (_capacity <= capacity)
+		return;
+
+	// clear it so the padding always holds valid floats
+	const int blockSize = (floatArrayCount + 4*colorArrayCount) * _capacity * sizeof(float);
+	float* newBlock = (float*)_aligned_malloc(blockSize, 16);
+	memset(newBlock, 0, blockSize);
 
-	if (Particle::simpleVertsNeedsCap)
+	if (count > 0)
 	{
-		g_render->CapTriVerts(cachedPos1);
-		Particle::simpleVertsNeedsCap = false;
+		// every array keeps its place in the block
+		for (int j = 0; j < floatArrayCount; ++j)
+			memcpy(newBlock + j*_capacity, block + j*capacity, count*sizeof(float));
+		for (int j = 0; j < colorArrayCount; ++j)
+			memcpy(newBlock + (floatArrayCount + 4*j)*_capacity, block + (floatArrayCount + 4*j)*capacity, count*sizeof(Color));
 	}
 
-	const DWORD colorDword = color;
-	g_render->AddPointToTriVerts(cachedPos1, colorDword);
-	g_render->AddPointToTriVerts(cachedPos2, colorDword);
-	simpleVertsLastColor = colorDword;
+	_aligned_free(block);
+	SetArrays(newBlock, _capacity);
 }
 
-///////////////////////////////////////////////////////////
-// particle memory management
-///////////////////////////////////////////////////////////
+int ParticleArrays::Add()
+{
+	if (count == capacity)
+		Reserve(Max(2*capacity, 16));
+
+	return count++;
+}
+
+void ParticleArrays::Copy(int to, int from)
+{
+	ASSERT(to >= 0 && to < capacity && from >= 0 && from < capacity);
+
+	for (int j = 0; j < floatArrayCount; ++j)
+		block[j*capacity + to] = block[j*capacity + from];
 
-// global particle pools
-list<Particle*> ParticleEmitter::freeParticleList;
-Particle ParticleEmitter::particlePool[maxParticles];
+	Color* colors = (Color*)(block + floatArrayCount*capacity);
+	for (int j = 0; j < colorArrayCount; ++j)
+		colors[j*capacity + to] = colors[j*capacity + from];
+}
 
-void ParticleEmitter::InitParticleSystem()
+void ParticleArrays::SetArrays(float* _block, int _capacity)
 {
-	// prep the free particle list
-	for(int i = 0; i < maxParticles; ++i)
-		freeParticleList.push_back(&particlePool[i]);
+	block = _block;
+	capacity = _capacity;
+
+	// float arrays come first followed by the color arrays
+	float* next = block;
+	posX = next;			next += capacity;
+	posY = next;			next += capacity;
+	angle = next;			next += capacity;
+	deltaX = next;			next += capacity;
+	deltaY = next;			next += capacity;
+	deltaAngle = next;		next += capacity;
+	velocityX = next;		next += capacity;
+	velocityY = next;		next += capacity;
+	angularSpeed = next;	next += capacity;
+	time = next;			next += capacity;
+	lifeTime = next;		next += capacity;
+	sizeStart = next;		next += capacity;
+	sizeEnd = next;			next += capacity;
+	cachedX = next;			next += capacity;
+	cachedY = next;			next += capacity;
+	cachedX2 = next;		next += capacity;
+	cachedY2 = next;		next += capacity;
+	cachedAngle = next;		next += capacity;
+	cachedSize = next;		next += capacity;
+	ASSERT(next == block + floatArrayCount*capacity);
+
+	Color* nextColor = (Color*)next;
+	colorStart = nextColor;		nextColor += capacity;
+	colorDelta = nextColor;		nextColor += capacity;
+	cachedColor = nextColor;	nextColor += capacity;
+	ASSERT((float*)nextColor == block + (floatArrayCount + 4*colorArrayCount)*capacity);
 }
 
-Particle* ParticleEmitter::NewParticle()
+///////////////////////////////////////////////////////////
+// console commands
+///////////////////////////////////////////////////////////
+
+// fills some emitters with particles and times how long it takes to update them
+static void ConsoleCallback_particleBenchmark(const wstring& text)
 {
-	if (freeParticleList.empty())
-		return NULL; // ran out of particles
+	int particleCount = 100000;
+	int stepCount = 60;
+	int emitterCount = 64;
+	swscanf_s(text.c_str(), L"%d %d %d", &particleCount, &stepCount, &emitterCount);
+	stepCount = Max(stepCount, 1);
+	emitterCount = Max(emitterCount, 1);
+
+	// long lived particles that are never drawn
+	ParticleSystemDef systemDef = g_testParticleSystemDef;
+	systemDef.particleLifeTime = 1000;
+	systemDef.emitRate = 0;
+	systemDef.emitLifeTime = 0;
+	systemDef.particleGravity = 1;
+	systemDef.particleFlags = PARTICLE_FLAG_MANUAL_RENDER;
+
+	// make room in the budget for the test
+	const int maxParticlesOld = ParticleEmitter::maxParticles;
+	const float particleStopRadiusOld = ParticleEmitter::particleStopRadius;
+	ParticleEmitter::maxParticles = ParticleEmitter::GetTotalParticleCount() + particleCount;
+	ParticleEmitter::particleStopRadius = 0;
+
+	const int startCount = ParticleEmitter::GetTotalParticleCount();
+	vector<ParticleEmitter*> emitters(emitterCount);
+	for (int i = 0; i < emitterCount; ++i)
+	{
+		emitters[i] = new ParticleEmitter(systemDef, XForm2(g_cameraBase->GetPosWorld()));
+		const int emitterParticleCount = (i + 1) * particleCount / emitterCount - i * particleCount / emitterCount;
+		for (int j = 0; j < emitterParticleCount; ++j)
+			emitters[i]->SpawnParticle();
+	}
+	particleCount = ParticleEmitter::GetTotalParticleCount() - startCount;
+
+	ParticleEmitter::maxParticles = maxParticlesOld;
+	ParticleEmitter::particleStopRadius = particleStopRadiusOld;
+
+	CDXUTTimer timer;
+	timer.Start();
+	for (int i = 0; i < stepCount; ++i)
+		ParticleEmitter::UpdateEmitters(&emitters[0], emitterCount);
+	const double updateTime = timer.GetElapsedTime();
+
+	for (int i = 0; i < emitterCount; ++i)
+		emitters[i]->Destroy();
 
-	list<Particle*>::iterator it = freeParticleList.begin();
-	Particle* particle = *it;
-	freeParticleList.erase(it);
-	return particle;
+	GetDebugConsole().AddFormatted(L"Updated %d particles in %d emitters on %d threads %d times, %.3f ms per update.",
+		particleCount, emitterCount, g_jobSystem->GetThreadCount(ParticleEmitter::particleThreads), stepCount, 1000*updateTime/stepCount);
 }
+ConsoleCommand(ConsoleCallback_particleBenchmark, particleBenchmark);
 
-void ParticleEmitter::DeleteParticle(Particle* particle)
+// headless test, checks the default curve tables against the math they replace and times the lookups
+static void ConsoleCallback_particleCurveBenchmark(const wstring& text)
 {
-	freeParticleList.push_back(particle);
+	int sampleCount = 1000000;
+	swscanf_s(text.c_str(), L"%d", &sampleCount);
+	sampleCount = Max(sampleCount, 1);
+
+	ParticleSystemDef systemDef = g_testParticleSystemDef;
+	ParticleCurveTables curves;
+	curves.Compile(systemDef);
+	const float fadeInTime = systemDef.particleFadeInTime;
+	const float sizeStart = systemDef.particleSizeStart;
+	const float sizeEnd = systemDef.particleSizeEnd;
+
+	vector<float> percents(sampleCount);
+	for (int i = 0; i < sampleCount; ++i)
+		percents[i] = RAND_PERCENT;
+
+	// how far the tables are from the direct math, the fade in may fall between samples
+	float maxSizeError = 0;
+	float maxAlphaError = 0;
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		const float percent = percents[i];
+		int sample;
+		float sampleFraction;
+		ParticleCurveTables::GetSample(percent, sample, sampleFraction);
+
+		const float size = sizeStart + percent * (sizeEnd - sizeStart);
+		const float alpha = (percent < fadeInTime)? percent / fadeInTime : 1;
+		const float sizeTable = sizeStart + ParticleCurveTables::Lookup(curves.size, sample, sampleFraction) * (sizeEnd - sizeStart);
+		const float alphaTable = ParticleCurveTables::Lookup(curves.alpha, sample, sampleFraction);
+		maxSizeError = Max(maxSizeError, fabs(size - sizeTable));
+		maxAlphaError = Max(maxAlphaError, fabs(alpha - alphaTable));
+	}
+
+	// time a three key gradient with alpha and size curves
+	const ParticleGradientKey gradientKeys[3] =
+	{
+		ParticleGradientKey(0.0f, Color::White()),
+		ParticleGradientKey(0.3f, Color::Yellow()),
+		ParticleGradientKey(1.0f, Color::Red(0))
+	};
+	const ParticleCurveKey sizeKeys[3] = { ParticleCurveKey(0, 0), ParticleCurveKey(0.2f, 1), ParticleCurveKey(1, 0.5f) };
+	systemDef.SetGradient(gradientKeys, 3);
+	systemDef.SetSizeCurve(sizeKeys, 3);
+
+	CDXUTTimer timer;
+	timer.Start();
+	curves.Compile(systemDef);
+	const double compileTime = timer.GetElapsedTime();
+
+	timer.Start();
+	float total = 0;
+	for (int i = 0; i < sampleCount; ++i)
+	{
+		int sample;
+		float sampleFraction;
+		ParticleCurveTables::GetSample(percents[i], sample, sampleFraction);
+		const Color tint = ParticleCurveTables::Lookup(curves.gradient, sample, sampleFraction);
+		total += tint.r + tint.a * ParticleCurveTables::Lookup(curves.alpha, sample, sampleFraction);
+		total += ParticleCurveTables::Lookup(curves.size, sample, sampleFraction);
+	}
+	const double lookupTime = timer.GetElapsedTime();
+
+	GetDebugConsole().AddFormatted(L"Compiled curves in %.3f ms, %d lookups in %.3f ms (%.1f ns each), max size error %f, max alpha error %f, checksum %f",
+		1000*compileTime, sampleCount, 1000*lookupTime, 1e9*lookupTime / sampleCount, maxSizeError, maxAlphaError, total / sampleCount);
 }
+ConsoleCommand(ConsoleCallback_particleCurveBenchmark, particleCurveBenchmark);
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
@@ -565,4 +1421,108 @@ void ParticleSystemDef::Scale(float scale)
 	particleSizeEnd *= scale;
 	particleSpeed *= scale;
 	emitSize *= scale;
+}
+
+template <class T>
+static int SetKeys(T* keys, const T* newKeys, int keyCount)
+{
+	ASSERT(keyCount >= 0 && keyCount <= ParticleSystemDef::maxCurveKeys);
+	keyCount = Max(Min(keyCount, int(ParticleSystemDef::maxCurveKeys)), 0);
+	for (int i = 0; i < keyCount; ++i)
+	{
+		ASSERT(i == 0 || newKeys[i].percent >= newKeys[i-1].percent); // keys must be in order
+		keys[i] = newKeys[i];
+	}
+	return keyCount;
+}
+
+void ParticleSystemDef::SetSizeCurve(const ParticleCurveKey* keys, int keyCount)	{ sizeKeyCount = SetKeys(sizeKeys, keys, keyCount); }
+void ParticleSystemDef::SetAlphaCurve(const ParticleCurveKey* keys, int keyCount)	{ alphaKeyCount = SetKeys(alphaKeys, keys, keyCount); }
+void ParticleSystemDef::SetGradient(const ParticleGradientKey* keys, int keyCount)	{ gradientKeyCount = SetKeys(gradientKeys, keys, keyCount); }
+
+static void LerpKey(float percent, ParticleCurveKey& key, const ParticleCurveKey& key1, const ParticleCurveKey& key2)
+{
+	key.percent = FrankMath::Lerp(percent, key1.percent, key2.percent);
+	key.value = FrankMath::Lerp(percent, key1.value, key2.value);
+}
+
+static void LerpKey(float percent, ParticleGradientKey& key, const ParticleGradientKey& key1, const ParticleGradientKey& key2)
+{
+	key.percent = FrankMath::Lerp(percent, key1.percent, key2.percent);
+	key.color = FrankMath::Lerp(percent, key1.color, key2.color);
+}
+
+template <class T>
+static int LerpKeys(float percent, T* keys, const T* keys1, int keyCount1, const T* keys2, int keyCount2)
+{
+	if (keyCount1 == keyCount2)
+	{
+		for (int i = 0; i < keyCount1; ++i)
+			LerpKey(percent, keys[i], keys1[i], keys2[i]);
+		return keyCount1;
+	}
+
+	// different shapes can't be blended so use the closest one
+	return SetKeys(keys, (percent < 0.5f)? keys1 : keys2, (percent < 0.5f)? keyCount1 : keyCount2);
+}
+
+void ParticleSystemDef::LerpCurves(float percent, const ParticleSystemDef& p1, const ParticleSystemDef& p2)
+{
+	sizeKeyCount = LerpKeys(percent, sizeKeys, p1.sizeKeys, p1.sizeKeyCount, p2.sizeKeys, p2.sizeKeyCount);
+	alphaKeyCount = LerpKeys(percent, alphaKeys, p1.alphaKeys, p1.alphaKeyCount, p2.alphaKeys, p2.alphaKeyCount);
+	gradientKeyCount = LerpKeys(percent, gradientKeys, p1.gradientKeys, p1.gradientKeyCount, p2.gradientKeys, p2.gradientKeyCount);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+// linear between keys and flat past the ends
+static float SampleKeys(const ParticleCurveKey* keys, int keyCount, float percent)
+{
+	if (percent <= keys[0].percent)
+		return keys[0].value;
+
+	for (int i = 1; i < keyCount; ++i)
+	{
+		if (percent <= keys[i].percent)
+			return FrankMath::PercentLerp(percent, keys[i-1].percent, keys[i].percent, keys[i-1].value, keys[i].value);
+	}
+	return keys[keyCount-1].value;
+}
+
+static Color SampleKeys(const ParticleGradientKey* keys, int keyCount, float percent)
+{
+	if (percent <= keys[0].percent)
+		return keys[0].color;
+
+	for (int i = 1; i < keyCount; ++i)
+	{
+		if (percent <= keys[i].percent)
+			return FrankMath::PercentLerp(percent, keys[i-1].percent, keys[i].percent, keys[i-1].color, keys[i].color);
+	}
+	return keys[keyCount-1].color;
+}
+
+void ParticleCurveTables::Compile(const ParticleSystemDef& systemDef)
+{
+	const float fadeInTime = systemDef.particleFadeInTime;
+	for (int i = 0; i <= sampleCount; ++i)
+	{
+		const float percent = i / float(sampleCount);
+
+		if (systemDef.sizeKeyCount > 0)
+			size[i] = SampleKeys(systemDef.sizeKeys, systemDef.sizeKeyCount, percent);
+		else
+			size[i] = percent;
+
+		if (systemDef.alphaKeyCount > 0)
+			alpha[i] = SampleKeys(systemDef.alphaKeys, systemDef.alphaKeyCount, percent);
+		else
+			alpha[i] = (percent < fadeInTime)? percent / fadeInTime : 1;
+
+		if (systemDef.gradientKeyCount > 0)
+			gradient[i] = SampleKeys(systemDef.gradientKeys, systemDef.gradientKeyCount, percent);
+		else
+			gradient[i] = Color::White();
+	}
+	useGradient = systemDef.gradientKeyCount > 0;
 }
\ No newline at end of file
@@ -6,6 +6,14 @@
 	- controls particle system for a 2d game
 	- simple, fast, easy to use particle system
 	- does not keep references to particle or emitter definitions
+	- particles are stored per emitter in parallel arrays and updated 4 at a time with simd
+	- a particle budget throttles and evicts the least important emitters first
+	- off screen emitters go dormant and catch up analytically when they come back into view
+	- emitters update together across the job system after the objects update
+	- world space particles can collide with the terrain tiles without using physics
+	- quads from every emitter in a render group are batched into one draw per texture
+	- one shot effects reuse pooled emitters instead of creating new objects
+	- size, alpha and color gradients over particle life are baked into small lookup tables
 */
 ////////////////////////////////////////////////////////////////////////////////////////
 
@@ -24,6 +32,28 @@
 #define PARTICLE_FLAG_CAST_SHADOWS				(1 << 7) // should this particle system be used for drawing shadows
 #define PARTICLE_FLAG_CAST_SHADOWS_DIRECTIONAL	(1 << 8) // this particle casts shadows only for the background
 #define PARTICLE_FLAG_MANUAL_RENDER				(1 << 9) // this particle is only rendered manually
+#define PARTICLE_FLAG_COLLIDE_TERRAIN			(1 << 10) // should particles bounce off the terrain physics layer
+#define PARTICLE_FLAG_COLLIDE_KILL				(1 << 11) // should particles die when they hit the terrain instead of bouncing
+
+// a key on a curve over normalized particle life
+struct ParticleCurveKey
+{
+	ParticleCurveKey() {}
+	ParticleCurveKey(float _percent, float _value) : percent(_percent), value(_value) {}
+
+	float percent;		// when in the particle's life (0 = birth, 1 = death)
+	float value;
+};
+
+// a key on a color gradient over normalized particle life
+struct ParticleGradientKey
+{
+	ParticleGradientKey() {}
+	ParticleGradientKey(float _percent, const Color& _color) : percent(_percent), color(_color) {}
+
+	float percent;		// when in the particle's life (0 = birth, 1 = death)
+	Color color;
+};
 
 struct ParticleSystemDef
 {
@@ -86,8 +116,14 @@ struct ParticleSystemDef
 
 	static ParticleSystemDef Lerp(float percent, const ParticleSystemDef& p1, const ParticleSystemDef& p2);
 
-	// default constructor doesn't init anything!
-	ParticleSystemDef() {}
+	// default constructor only inits the newer settings, everything else is left alone!
+	ParticleSystemDef() :
+		importance(1),
+		particleBounce(0.5f),
+		sizeKeyCount(0),
+		alphaKeyCount(0),
+		gradientKeyCount(0)
+	{}
 
 	// full constructor for particle systems
 	ParticleSystemDef
@@ -117,11 +153,23 @@ struct ParticleSystemDef
 		float _emitConeAngle,					// angle in radians of the emit cone in local space
 		float _particleConeAngle,				// angle in radians of the particle's initial rotation cone
 		UINT _particleFlags,					// list of flags for the system
-		float _particleGravity					// how much does gravity effect particles
+		float _particleGravity,					// how much does gravity effect particles
+		float _importance = 1,					// how important to keep when over the particle budget
+		float _particleBounce = 0.5f			// how much speed particles keep when bouncing off terrain
 	);
 
 	void Scale(float scale);
 
+	// optional curves over particle life, keys must be in order of percent (0 keys = use the default)
+	void SetSizeCurve(const ParticleCurveKey* keys, int keyCount);		// blend from start to end size, default is linear
+	void SetAlphaCurve(const ParticleCurveKey* keys, int keyCount);		// alpha scale, default fades in over particleFadeInTime
+	void SetGradient(const ParticleGradientKey* keys, int keyCount);	// tint for the particle color, default is white
+
+	// blend the curves of two systems, keys are lerped if both have the same number
+	void LerpCurves(float percent, const ParticleSystemDef& p1, const ParticleSystemDef& p2);
+
+	enum { maxCurveKeys = 8 };
+
 public:
 
 	GameTextureID texture;					// texture of particle
@@ -154,9 +202,98 @@ public:
 	float emitConeAngle;					// angle in radians of the emit cone in local space (0 = directional, PI = omnidirectional)
 
 	UINT particleFlags;						// list of flags for the system
+	float importance;						// how important to keep when over the particle budget (higher = more important)
+	float particleBounce;					// how much speed particles keep when bouncing off terrain (0 = stop, 1 = perfect bounce)
+
+	int sizeKeyCount;						// how many keys are in the size curve
+	int alphaKeyCount;						// how many keys are in the alpha curve
+	int gradientKeyCount;					// how many keys are in the color gradient
+	ParticleCurveKey sizeKeys[maxCurveKeys];
+	ParticleCurveKey alphaKeys[maxCurveKeys];
+	ParticleGradientKey gradientKeys[maxCurveKeys];
+};
+
+// the curves of a system def baked into fixed size tables so particles only do a lookup
+struct ParticleCurveTables
+{
+	enum { sampleCount = 64 };
+
+	void Compile(const ParticleSystemDef& systemDef);
+
+	// get the sample index and fraction for a percent of particle life, shared by all the tables
+	static void GetSample(float percent, int& i, float& t)
+	{
+		const float x = percent * sampleCount;
+		i = Min(int(x), int(sampleCount - 1));
+		t = x - i;
+	}
+
+	template <class T>
+	static T Lookup(const T* table, int i, float t) { return table[i] + t * (table[i + 1] - table[i]); }
+
+	float size[sampleCount + 1];		// blend from start to end size
+	float alpha[sampleCount + 1];		// alpha scale
+	Color gradient[sampleCount + 1];	// color tint
+	bool useGradient;					// skip the tint when there is no gradient
 };
 
-class Particle;
+// particles for one emitter are kept in parallel arrays so they can be updated 4 at a time
+// all the arrays share one 16 byte aligned block with room for a multiple of 4 particles
+struct ParticleArrays : private Uncopyable
+{
+	ParticleArrays();
+	~ParticleArrays();
+
+	// make room for at least this many particles, keeps the ones already there
+	void Reserve(int capacity);
+
+	// returns the index of a new particle, its data is not initialized
+	int Add();
+
+	// copy all of a particle's data over another one
+	void Copy(int to, int from);
+
+	// move the last particle into the hole, does not keep the order
+	void RemoveSwap(int i) { ASSERT(i >= 0 && i < count); Copy(i, --count); }
+
+	void Clear() { count = 0; }
+
+	int count;
+	int capacity;
+
+	// simulation data
+	float* posX;
+	float* posY;
+	float* angle;
+	float* deltaX;			// how much the particle moved last update, used for interpolation
+	float* deltaY;
+	float* deltaAngle;
+	float* velocityX;
+	float* velocityY;
+	float* angularSpeed;
+	float* time;
+	float* lifeTime;
+	float* sizeStart;
+	float* sizeEnd;
+	Color* colorStart;
+	Color* colorDelta;
+
+	// render data cached once per frame for all the passes that draw the particles
+	float* cachedX;
+	float* cachedY;
+	float* cachedX2;		// other side of ribbons
+	float* cachedY2;
+	float* cachedAngle;
+	float* cachedSize;
+	Color* cachedColor;
+
+private:
+
+	void SetArrays(float* block, int capacity);
+
+	enum { floatArrayCount = 19, colorArrayCount = 3 };
+	float* block;
+};
 
 class ParticleEmitter : public GameObject
 {
@@ -166,6 +303,7 @@ public:
 	virtual ~ParticleEmitter();
 
 	virtual bool IsParticleEmitter() const { return true; }
+	virtual bool IsSnapshotted() const { return false; }
 
 	virtual void WasDetachedFromParent()
 	{ 
@@ -195,6 +333,9 @@ public:
 	// get our copy of the system def
 	ParticleSystemDef& GetDef() { return systemDef; }
 
+	// rebuild the curve tables, call after changing the fade in time or curves of our def
+	void CompileCurves() { curves.Compile(systemDef); }
+
 	// let the emitter run a bit to warm up the system
 	void WarmUp(float time);
 
@@ -205,21 +346,53 @@ public:
 	virtual void StreamOut() { Kill(); }
 
 	// particle systems can be rendered manually
+	// quads are batched, call g_particleBatch.Render() after if not rendering from the object manager
 	void ManualRender();
 
+	// bounding box of the emitter and its particles in world space
+	Box2AABB GetParticleBounds() const;
+
+	// how much the particle budget values this emitter, updated every step
+	float GetPriority() const { return priority; }
+
+	// dormant emitters are off screen and skip updating their particles
+	bool IsDormant() const { return dormant; }
+
 public: // static functions
 
-	static void InitParticleSystem();
+	// start a fire and forget effect using a pooled emitter, the effect must stop on its own
+	// the returned emitter can be changed right away but should not be kept after that
+	static ParticleEmitter* SpawnOneShot(const ParticleSystemDef& systemDef, const XForm2& xf, float scale = 1.0f);
 
 	static void EnableParticles(bool enable) { enableParticles = enable; }
 	static bool AreParticlesEnabled() { return enableParticles; }
 
-	static int GetTotalParticleCount() { return maxParticles - freeParticleList.size(); }
+	static int GetTotalParticleCount() { return (int)totalParticleCount; }
 	static int GetTotalEmitterCount() { return totalEmitterCount; }
+	static int GetEvictedParticleCount() { return evictedParticleCount; }
+	static int GetThrottledEmitterCount() { return throttledEmitterCount; }
+	static int GetPooledEmitterCount() { return emitterPool.size(); }
+
+	// updates every emitter across the job system, call once per update after the objects update
+	static void UpdateAll();
+
+	// update a set of emitters across the job system, random numbers come from the calling thread's seed
+	static void UpdateEmitters(ParticleEmitter* const* emitters, int count);
+
+	// keeps particles under budget, call once per update after UpdateAll
+	static void UpdateParticleBudget();
 
 	static void SetParticleStopRadius(float radius) { particleStopRadius = radius; }
 
 	static bool enableParticles;
+	static int maxParticles;				// how many particles should be alive across all emitters
+	static float particleThrottleStart;		// percent of the budget where emit rates start to be throttled
+	static float particlePriorityDistance;	// distance from the camera where an emitter's priority is halved
+	static float particleOffScreenPriority;	// priority scale for emitters that are off screen
+	static int particleThreads;				// threads used to update emitters, 0 for all cores
+	static int particleEmitterPoolSize;		// how many finished one shot emitters are kept for reuse
+	static bool particleDormancy;			// let off screen emitters skip updating
+	static float particleDormantMargin;		// how far off screen an emitter must be to go dormant
 	static float particleStopRadius;		// does and on screen test with this radius and won't emit particles from offscreen (0 = always spawn)
 	static int defaultRenderGroup;
 	static int defaultAdditiveRenderGroup;
@@ -227,9 +400,6 @@ public: // static functions
 
 protected:
 
-	static Particle* NewParticle();
-	static void DeleteParticle(Particle* particle);
-
 	// add a new particle to the emitter
 	void AddParticle(const XForm2& xf, float startTime = 0);
 
@@ -239,72 +409,64 @@ protected:
 
 private:
 
+	friend class ParticleUpdateTask;
+
+	void Start();
+	void Finish();
+	void UpdateEmitter();
+	void FinalizeUpdate();
+
+	void UpdateParticles();
+	void CollideTerrain(int start, int end);
+	bool CanCollideTerrain() const;
+	void RemoveDeadParticles();
+	void RemoveAllParticles();
+	void CacheRenderData(const XForm2& xfParent);
+	float CalculatePriority() const;
+	bool ShouldBeDormant() const;
+	void StartDormancy();
+	void UpdateDormant();
+	bool HaveDormantParticlesExpired() const;
+	void WakeUp();
+	void AdvanceParticles(int start, int end, int stepCount);
+	float GetMaxParticleLifeTime() const { return systemDef.particleLifeTime * (1 + systemDef.particleLifeTimeRandomness); }
+	int EvictParticles(int evictCount);
+	static bool PriorityCompare(const ParticleEmitter* first, const ParticleEmitter* second) { return first->priority < second->priority; }
+
 	bool setTrailEnd;
 	bool emitterPaused;		// user control to pause particle emitters
+	bool oneShot;			// goes back to the pool when finished instead of being destroyed
+	bool pooled;			// waiting in the pool to be reused
 
 	GameTimer time;
 	float emitRateTimer;
 	ParticleSystemDef systemDef;
-
-	list<Particle*> particles;
-
+	ParticleCurveTables curves;
+
+	ParticleArrays particles;
+	Box2AABB particleBounds;	// bounds of the particles in particle space, updated each step
+	UINT cachedFrame;			// render frame the particle render data was cached for
+
+	float priority;				// how much the particle budget values this emitter
+	float emitScale;			// how much the particle budget has throttled the emit rate
+	list<ParticleEmitter*>::iterator emitterListIterator;	// points into the pool while pooled
+
+	// dormant emitters only count steps and emits, the particles catch up when woken
+	bool dormant;
+	int dormantSteps;			// how many updates were skipped
+	int dormantEmitCount;		// how many particles would have been emitted
+	int dormantFirstEmitStep;
+	int dormantLastEmitStep;
+	float dormantMaxSpeed;		// fastest particle when going dormant, used to predict the bounds
+	float dormantLifeTime;		// how long until every particle that was alive will be dead
+
+	static list<ParticleEmitter*> emitterList;
+	static list<ParticleEmitter*> emitterPool;
 	static int totalEmitterCount;
-	
-	static const UINT32 maxParticles = 2000;
-	static list<Particle*> freeParticleList;
-	static Particle particlePool[maxParticles];
-};
-
-class Particle : private Uncopyable
-{
-public:
-
-	friend ParticleEmitter;
-
-	Particle() {}
-	void Init(const ParticleSystemDef& _systemDef, const XForm2& _xf, const Vector2& _velocity, float _angularSpeed, float _startTime);
-
-	void Update();
-
-	void Render(const XForm2& xfParent);
-	void RenderTrail(const XForm2& xfParent);
-	void RenderRibbon(const XForm2& xfParent, Vector2& previousPos);
-
-	bool IsDead() const { return time >= lifeTime + GAME_TIME_STEP; }
-
-	XForm2 GetInterpolatedXForm(const XForm2& xfParent) const
-	{ 
-		const XForm2 xfInterpolated = xf.Interpolate(xfDelta, g_interpolatePercent);
-		return xfInterpolated * xfParent;
-	}
-
-private:
-
-	XForm2 xf;
-	XForm2 xfDelta;
-
-	Vector2 velocity;
-	float angularSpeed;
-	float time;
-
-	float lifeTime;
-	float sizeStart;
-	float sizeEnd;
-	Color colorStart;
-	Color colorDelta;
-
-	// cache some particle data for faster rendering
-	UINT cachedFrame;
-	Color cachedColor;
-	Vector2 cachedPos1;
-	Vector2 cachedPos2;
-	float cachedAngle;
-	float cachedSize;
-
-	const ParticleSystemDef* systemDef;
-
-	static DWORD simpleVertsLastColor;
-	static bool simpleVertsNeedsCap;
+	static volatile LONG totalParticleCount;
+	static int evictedParticleCount;
+	static int throttledEmitterCount;
+	static int dormantEmitterCount;
 };
 
 extern const ParticleSystemDef g_testParticleSystemDef;
@@ -337,7 +499,9 @@ inline ParticleSystemDef::ParticleSystemDef
 	float _emitConeAngle,					// angle in radians of the emit cone in local space
 	float _particleConeAngle,				// angle in radians of the particle's initial rotation cone
 	UINT _particleFlags,					// list of flags for the system
-	float _particleGravity					// how much does gravity effect particles
+	float _particleGravity,					// how much does gravity effect particles
+	float _importance,						// how important to keep when over the particle budget
+	float _particleBounce					// how much speed particles keep when bouncing off terrain
 ) :
 	texture(_texture),
 	colorStart1(_colorStart1),
@@ -361,7 +525,12 @@ inline ParticleSystemDef::ParticleSystemDef
 	particleAngularSpeedRandomness(_particleAngularSpeedRandomness),
 	particleSizeStartRandomness(_particleSizeStartRandomness),
 	particleSizeEndRandomness(_particleSizeEndRandomness),
-	particleLifeTimeRandomness(_particleLifeTimeRandomness)
+	particleLifeTimeRandomness(_particleLifeTimeRandomness),
+	importance(_importance),
+	particleBounce(_particleBounce),
+	sizeKeyCount(0),
+	alphaKeyCount(0),
+	gradientKeyCount(0)
 {
 }
 	
@@ -472,7 +641,7 @@ inline ParticleSystemDef ParticleSystemDef::BuildRibbonTrail
 
 inline ParticleSystemDef ParticleSystemDef::Lerp(float percent, const ParticleSystemDef& p1, const ParticleSystemDef& p2)
 {
-	return ParticleSystemDef
+	ParticleSystemDef systemDef
 	(
 		p1.texture,
 		FrankMath::Lerp(percent, p1.colorStart1,						p2.colorStart1),					
@@ -496,8 +665,12 @@ inline ParticleSystemDef ParticleSystemDef::Lerp(float percent, const ParticleSy
 		FrankMath::Lerp(percent, p1.emitConeAngle,						p2.emitConeAngle),
 		FrankMath::Lerp(percent, p1.particleConeAngle,					p2.particleConeAngle),
 		p1.particleFlags,
-		FrankMath::Lerp(percent, p1.particleGravity,					p2.particleGravity)
+		FrankMath::Lerp(percent, p1.particleGravity,					p2.particleGravity),
+		FrankMath::Lerp(percent, p1.importance,							p2.importance),
+		FrankMath::Lerp(percent, p1.particleBounce,						p2.particleBounce)
 	);
+	systemDef.LerpCurves(percent, p1, p2);
+	return systemDef;
 }
 
 
@@ -83,22 +83,23 @@ void Projectile::Init(GameObject* attacker, const ParticleSystemDef* particleDef
 
 	// store the attacker handle
 	attackerHandle = attacker? attacker->GetHandle() : invalidHandle;
+
+	// the collision matrix handles teams, only skipping an attacker with no team needs the virtual call
+	SetType(GAME_OBJECT_TYPE_PROJECTILE);
+	if (!attacker || attacker->GetTeam() != 0)
+		SetCollisionCallbacks(CollisionCallback_All & ~CollisionCallback_ShouldCollide);
+
+	// pick up changes to the console setting
+	CollisionMatrix::SetTypesCollide(GAME_OBJECT_TYPE_PROJECTILE, GAME_OBJECT_TYPE_PROJECTILE, projectilesCollide);
 }
 
 bool Projectile::ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const
 {
 	// dont collide with our attacker
+	// team rules and projectiles colliding with eachother are handled by the collision matrix
 	if (IsAttacker(otherObject))
 		return false;
 
-	// projectiles dont collide other objects in the same team except for team 0
-	if (GetTeam() != 0 && otherObject.GetTeam() == GetTeam())
-		return false;
-
-	// projectiles can be set to not collide with eachother
-	if (!projectilesCollide && otherObject.IsProjectile())
-		return false;
-
 	// projectiles should collide with the world
 	//if (otherObject.IsStatic())
 	//	return true;
@@ -156,7 +157,7 @@ void Projectile::Kill()
 	// todo: sound radius must be gameside
 	g_sound->Play(hitSound, xf.position);
 	if (hitEffect)
-		new ParticleEmitter(*hitEffect, xf);
+		ParticleEmitter::SpawnOneShot(*hitEffect, xf);
 
 	GameObject::Kill();
 }
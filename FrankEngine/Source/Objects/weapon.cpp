@@ -22,7 +22,8 @@ WeaponDef::WeaponDef
 	const ParticleSystemDef* _fireFlashEffect,	// flash effect when weapon is fired
 	const ParticleSystemDef* _fireSmokeEffect,	// smoke effect when weapon is fired
 	const ParticleSystemDef* _hitEffect,		// effect when projectile hits
-	SoundControl_ID _hitSound						// sound effect when projectile hits
+	SoundControl_ID _hitSound,						// sound effect when projectile hits
+	bool _projectileLightweight					// are bullets handled by the bullet manager?
 ) :
 	fireRate(_fireRate),
 	damage(_damage),
@@ -31,6 +32,7 @@ WeaponDef::WeaponDef
 	fireAngle(_fireAngle),
 	fireAutomatic(_fireAutomatic),
 	projectileBullet(_projectileBullet),
+	projectileLightweight(_projectileLightweight),
 	fireSound(_fireSound),
 	trailEffect(_trailEffect),
 	fireFlashEffect(_fireFlashEffect),
@@ -100,7 +102,12 @@ bool Weapon::Fire()
 // this may be a physical or a bullet type projectile
 GameObject* Weapon::LaunchProjectile(const XForm2& xf)
 {
-	if (GetWeaponDef().projectileBullet)
+	if (GetWeaponDef().projectileBullet && GetWeaponDef().projectileLightweight)
+	{
+		g_bulletManager.Fire(xf, GetWeaponDef(), GetOwner());
+		return NULL;
+	}
+	else if (GetWeaponDef().projectileBullet)
 		return new BulletProjectile(xf, *this);
 	else
 		return new SolidProjectile(xf, *this);
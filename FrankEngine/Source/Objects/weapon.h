@@ -30,7 +30,8 @@ struct WeaponDef
 		const ParticleSystemDef* _fireFlashEffect = NULL,	// flash effect when weapon is fired (in local space of weapon)
 		const ParticleSystemDef* _fireSmokeEffect = NULL,	// looping smoke effect when weapon is being fired
 		const ParticleSystemDef* _hitEffect = NULL,			// effect when projectile hits
-		SoundControl_ID _hitSound = SoundControl_Invalid			// sound effect when projectile hits
+		SoundControl_ID _hitSound = SoundControl_Invalid,			// sound effect when projectile hits
+		bool _projectileLightweight = false					// are bullets handled by the bullet manager?
 	);
 
 	float fireRate;
@@ -40,6 +41,7 @@ struct WeaponDef
 	float fireAngle;
 	bool fireAutomatic;
 	bool projectileBullet;
+	bool projectileLightweight;		// bullets are handled by the bullet manager instead of being objects
 	SoundControl_ID fireSound;
 	SoundControl_ID hitSound;
 	const ParticleSystemDef* trailEffect;
@@ -85,6 +87,7 @@ public:
 
 	// weapons automatically launch a projectile when they fire
 	// this may be a physical object or a bullet/raycast type projectile
+	// returns null for lightweight bullets since they have no object
 	virtual GameObject* LaunchProjectile(const XForm2& xf);
 
 	void SetFireXForm(const XForm2& xf)	{ xfFire = xf; }
@@ -0,0 +1,333 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	World Snapshot
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../objects/worldSnapshot.h"
+#include <hash_set>
+
+struct SnapshotHeader
+{
+	GameObjectHandle nextHandle;	// so objects created after restoring get the same handles
+	long long gameTime;
+	unsigned int randomSeed;
+};
+
+// saved before each object's own data
+struct SnapshotObjectHeader
+{
+	GameObjectHandle handle;
+	int size;						// how many bytes the object wrote
+
+	// enough to rebuild the object if it was destroyed
+	GameObjectType type;
+	XForm2 xf;
+	Vector2 stubSize;
+
+	// physics body motion for when the world can't be restored exactly
+	bool hasBody;
+	bool awake;
+	b2Vec2 position;
+	float angle;
+	b2Vec2 linearVelocity;
+	float angularVelocity;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+BYTE* SnapshotWriter::Reserve(int size)
+{
+	const int position = buffer.size();
+	buffer.resize(position + size);
+	return size > 0? &buffer[position] : NULL;
+}
+
+void SnapshotReader::Read(void* value, int valueSize)
+{
+	const BYTE* source = Skip(valueSize);
+	if (source)
+		memcpy(value, source, valueSize);
+	else
+		memset(value, 0, valueSize);
+}
+
+const BYTE* SnapshotReader::Skip(int skipSize)
+{
+	if (skipSize < 0 || position + skipSize > size)
+	{
+		ASSERT(false); // snapshot data is corrupt or was read wrong
+		failed = true;
+		return NULL;
+	}
+
+	const BYTE* source = data + position;
+	position += skipSize;
+	return source;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+void WorldSnapshot::Save()
+{
+	FrankProfilerEntryDefine(L"WorldSnapshot::Save()", Color::White(), 5);
+
+	// keep the capacity so saving every frame doesn't allocate
+	buffer.clear();
+	SnapshotWriter writer(buffer);
+
+	SnapshotHeader header;
+	header.nextHandle = GameObject::GetNextUniqueHandleValue();
+	header.gameTime = GameTimer::GetTicksGlobal();
+	header.randomSeed = FrankRand::GetSeed();
+	writer.Write(header);
+
+	g_physics->SaveSnapshot(writer);
+
+	// each object is saved with a header that says how many bytes it wrote
+	GameObjectHashTable& objects = g_objectManager.GetObjects();
+	for (GameObjectHashTable::iterator it = objects.begin(); it != objects.end(); ++it)
+	{
+		const GameObject& object = *(*it).second;
+		if (object.IsDestroyed() || !object.IsSnapshotted())
+			continue;
+
+		SnapshotObjectHeader objectHeader;
+		ZeroMemory(&objectHeader, sizeof(objectHeader));
+		objectHeader.handle = object.GetHandle();
+		objectHeader.type = object.GetType();
+		objectHeader.xf = object.GetXFormWorld();
+		objectHeader.stubSize = object.stubSize;
+
+		const b2Body* body = object.GetPhysicsBody();
+		if (body)
+		{
+			objectHeader.hasBody = true;
+			objectHeader.awake = body->IsAwake();
+			objectHeader.position = body->GetPosition();
+			objectHeader.angle = body->GetAngle();
+			objectHeader.linearVelocity = body->GetLinearVelocity();
+			objectHeader.angularVelocity = body->GetAngularVelocity();
+		}
+
+		const int headerPosition = buffer.size();
+		writer.Write(objectHeader);
+		object.SaveSnapshot(writer);
+
+		const int size = buffer.size() - headerPosition - sizeof(SnapshotObjectHeader);
+		memcpy(&buffer[headerPosition] + offsetof(SnapshotObjectHeader, size), &size, sizeof(int));
+	}
+}
+
+// destroy objects that were not in the snapshot and delete them along with their physics bodies
+static void RemoveUnsavedObjects(const stdext::hash_set<GameObjectHandle>& handles)
+{
+	GameObjectHashTable& objects = g_objectManager.GetObjects();
+	for (GameObjectHashTable::iterator it = objects.begin(); it != objects.end(); ++it)
+	{
+		GameObject& object = *(*it).second;
+		if (object.IsSnapshotted() && handles.find(object.GetHandle()) == handles.end())
+			object.Destroy();
+	}
+
+	g_objectManager.CollectGarbage();
+}
+
+bool WorldSnapshot::Restore()
+{
+	FrankProfilerEntryDefine(L"WorldSnapshot::Restore()", Color::White(), 5);
+
+	if (buffer.empty())
+		return false;
+
+	// check everything before changing anything
+	SnapshotReader reader(&buffer[0], buffer.size());
+	SnapshotHeader header;
+	reader.Read(header);
+
+	const int physicsPosition = reader.GetPosition();
+	if (!Physics::IsSnapshotValid(reader))
+		return false;
+
+	// objects that are gone must be rebuilt from their stubs
+	stdext::hash_set<GameObjectHandle> handles;
+	vector<GameObjectStub> rebuildStubs;
+	const int objectsPosition = reader.GetPosition();
+	while (reader.GetPosition() < GetSize() && !reader.HasFailed())
+	{
+		SnapshotObjectHeader objectHeader;
+		reader.Read(objectHeader);
+		reader.Skip(objectHeader.size);
+		if (reader.HasFailed() || !handles.insert(objectHeader.handle).second)
+			return false;
+
+		const GameObject* object = g_objectManager.GetObjectFromHandle(objectHeader.handle);
+		if (object && !object->IsDestroyed())
+			continue;
+
+		// prefer the terrain's stub since it still has the attributes
+		const GameObjectStub* terrainStub = g_terrain? g_terrain->GetStub(objectHeader.handle) : NULL;
+		GameObjectStub stub = terrainStub? *terrainStub : GameObjectStub(objectHeader.xf, objectHeader.stubSize, objectHeader.type, NULL, objectHeader.handle);
+		if (stub.type != objectHeader.type || !stub.HasObjectInfo())
+			return false;
+		stub.xf = objectHeader.xf;
+		rebuildStubs.push_back(stub);
+	}
+	if (reader.HasFailed())
+		return false;
+
+	// remove objects that were created since the save, this also gets rid of ones waiting to be deleted
+	RemoveUnsavedObjects(handles);
+
+	bool restoredAll = true;
+	if (!rebuildStubs.empty())
+	{
+		for (vector<GameObjectStub>::const_iterator it = rebuildStubs.begin(); it != rebuildStubs.end(); ++it)
+		{
+			const GameObject* object = (*it).BuildObject();
+			if (!object || object->GetHandle() != (*it).handle)
+				restoredAll = false;
+		}
+
+		// get rid of anything the rebuilt objects created, like their children
+		RemoveUnsavedObjects(handles);
+	}
+
+	// the physics world can only be restored exactly if it has all the same bodies
+	SnapshotReader physicsReader(&buffer[physicsPosition], objectsPosition - physicsPosition);
+	const bool physicsRestored = rebuildStubs.empty() && g_physics->RestoreSnapshot(physicsReader);
+
+	SnapshotReader objectsReader(&buffer[0] + objectsPosition, GetSize() - objectsPosition);
+	while (objectsReader.GetPosition() < GetSize() - objectsPosition)
+	{
+		SnapshotObjectHeader objectHeader;
+		objectsReader.Read(objectHeader);
+
+		// give each object its own reader so one bad object can't throw off the rest
+		SnapshotReader objectReader(objectsReader.Skip(objectHeader.size), objectHeader.size);
+		GameObject* object = g_objectManager.GetObjectFromHandle(objectHeader.handle);
+		if (!object)
+		{
+			ASSERT(!restoredAll);
+			continue;
+		}
+
+		object->LoadSnapshot(objectReader);
+		ASSERT(!objectReader.HasFailed() && objectReader.GetPosition() == objectHeader.size);
+
+		// put bodies back where they were, contacts will be found again on the next step
+		b2Body* body = object->GetPhysicsBody();
+		if (!physicsRestored && body && objectHeader.hasBody)
+		{
+			body->SetTransform(objectHeader.position, objectHeader.angle);
+			body->SetLinearVelocity(objectHeader.linearVelocity);
+			body->SetAngularVelocity(objectHeader.angularVelocity);
+			body->SetAwake(objectHeader.awake);
+		}
+	}
+
+	GameObject::SetNextUniqueHandleValue(header.nextHandle);
+	GameTimer::SetTicksGlobal(header.gameTime);
+	FrankRand::SetSeed(header.randomSeed);
+
+	// lightweight bullets are not saved
+	g_bulletManager.Clear();
+	return restoredAll;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Console commands
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+static WorldSnapshot checkpointSnapshot;
+
+static void ConsoleCallback_snapshotSave(const wstring& text)
+{
+	checkpointSnapshot.Save();
+	GetDebugConsole().AddFormatted(L"Saved snapshot, %d bytes.", checkpointSnapshot.GetSize());
+}
+ConsoleCommand(ConsoleCallback_snapshotSave, snapshotSave);
+
+static void ConsoleCallback_snapshotRestore(const wstring& text)
+{
+	if (!checkpointSnapshot.IsValid())
+		GetDebugConsole().AddFormatted(L"No snapshot has been saved.");
+	else if (!checkpointSnapshot.Restore())
+		GetDebugConsole().AddFormatted(L"Snapshot could not be fully restored, the world changed too much since it was saved.");
+	else
+		GetDebugConsole().AddFormatted(L"Restored snapshot.");
+}
+ConsoleCommand(ConsoleCallback_snapshotRestore, snapshotRestore);
+
+static UINT GetPhysicsHash(const b2World& world)
+{
+	// fnv hash of every body's motion
+	UINT hash = 2166136261u;
+	for (const b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+	{
+		const float state[6] =
+		{
+			body->GetPosition().x, body->GetPosition().y, body->GetAngle(),
+			body->GetLinearVelocity().x, body->GetLinearVelocity().y, body->GetAngularVelocity()
+		};
+		const BYTE* bytes = (const BYTE*)state;
+		for (int i = 0; i < (int)sizeof(state); ++i)
+			hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+// headless determinism test, steps only the physics world from a snapshot twice and compares
+static void ConsoleCallback_snapshotTest(const wstring& text)
+{
+	int stepCount = 120;
+	swscanf_s(text.c_str(), L"%d", &stepCount);
+	stepCount = Max(stepCount, 1);
+
+	b2World& world = *g_physics->GetPhysicsWorld();
+	WorldSnapshot snapshot;
+
+	CDXUTTimer timer;
+	timer.Start();
+	snapshot.Save();
+	const double saveTime = timer.GetElapsedTime();
+
+	vector<UINT> hashes(stepCount);
+	for (int i = 0; i < stepCount; ++i)
+	{
+		world.Step(GAME_TIME_STEP, Physics::velocityIterations, Physics::positionIterations);
+		hashes[i] = GetPhysicsHash(world);
+	}
+
+	timer.Start();
+	const bool restored = snapshot.Restore();
+	const double restoreTime = timer.GetElapsedTime();
+	if (!restored)
+	{
+		GetDebugConsole().AddFormatted(L"Snapshot test failed, could not restore.");
+		return;
+	}
+
+	int mismatch = -1;
+	for (int i = 0; i < stepCount; ++i)
+	{
+		world.Step(GAME_TIME_STEP, Physics::velocityIterations, Physics::positionIterations);
+		if (mismatch < 0 && GetPhysicsHash(world) != hashes[i])
+			mismatch = i;
+	}
+
+	// leave the world how it was before the test
+	snapshot.Restore();
+
+	GetDebugConsole().AddFormatted(L"Snapshot %d bytes, %d bodies, %d contacts, save %.3f ms, restore %.3f ms",
+		snapshot.GetSize(), world.GetBodyCount(), world.GetContactCount(), 1000*saveTime, 1000*restoreTime);
+	if (mismatch < 0)
+		GetDebugConsole().AddFormatted(L"Deterministic over %d steps.", stepCount);
+	else
+		GetDebugConsole().AddFormatted(L"Not deterministic, first mismatch on step %d of %d.", mismatch + 1, stepCount);
+}
+ConsoleCommand(ConsoleCallback_snapshotTest, snapshotTest);
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	World Snapshot
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- saves the physics world and game object state into one contiguous buffer
+	- restoring is deterministic, stepping after a restore matches stepping after the save
+	- fast enough to save and restore many times per second for rollback
+	- objects created after the save are destroyed when restoring
+	- objects destroyed since the save are rebuilt from their stubs if their type has a builder
+	- if the physics bodies changed only their motion is restored, so it is not deterministic
+	- effects like particle emitters and lights are not part of snapshots
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef WORLD_SNAPSHOT_H
+#define WORLD_SNAPSHOT_H
+
+#include <vector>
+
+// appends data to a snapshot buffer
+class SnapshotWriter
+{
+public:
+
+	explicit SnapshotWriter(vector<BYTE>& _buffer) : buffer(_buffer) {}
+
+	void Write(const void* data, int size) { memcpy(Reserve(size), data, size); }
+	template <class T> void Write(const T& value) { Write(&value, sizeof(T)); }
+
+	// make room for data that will be written directly into the buffer
+	BYTE* Reserve(int size);
+
+private:
+
+	vector<BYTE>& buffer;
+};
+
+// reads data back out of a snapshot buffer
+class SnapshotReader
+{
+public:
+
+	SnapshotReader(const BYTE* _data, int _size) : data(_data), size(_size), position(0), failed(false) {}
+
+	void Read(void* value, int valueSize);
+	template <class T> void Read(T& value) { Read(&value, sizeof(T)); }
+
+	// returns the next bytes and moves past them, null if there are not enough left
+	const BYTE* Skip(int skipSize);
+
+	int GetPosition() const { return position; }
+	bool HasFailed() const { return failed; }
+
+private:
+
+	const BYTE* data;
+	int size;
+	int position;
+	bool failed;			// set if anything tried to read past the end
+};
+
+class WorldSnapshot
+{
+public:
+
+	// save the current state of the world, replacing whatever was saved before
+	void Save();
+
+	// put the world back how it was when saved
+	// returns false without changing anything if the data is bad or a destroyed object can't be rebuilt
+	// also returns false if a rebuilt object didn't come back with its handle, everything else is still restored
+	bool Restore();
+
+	void Clear() { buffer.clear(); }
+	bool IsValid() const { return !buffer.empty(); }
+	int GetSize() const { return buffer.size(); }
+
+private:
+
+	vector<BYTE> buffer;
+};
+
+#endif // WORLD_SNAPSHOT_H
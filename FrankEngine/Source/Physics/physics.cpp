@@ -36,6 +36,15 @@ ConsoleCommand(Physics::velocityIterations, physicsVelocityIterations);
 int32 Physics::positionIterations = 3;
 ConsoleCommand(Physics::positionIterations, physicsPositionIterations);
 
+int Physics::solverThreads = 1;
+ConsoleCommand(Physics::solverThreads, physicsSolverThreads);
+
+bool Physics::simdContactSolver = false;
+ConsoleCommand(Physics::simdContactSolver, physicsSimdSolver);
+
+int Physics::raycastBatchThreads = 0;
+ConsoleCommand(Physics::raycastBatchThreads, raycastBatchThreads);
+
 static bool showRaycasts = false;
 ConsoleCommand(showRaycasts, showRaycasts);
 
@@ -61,6 +70,7 @@ public:
 	BoundaryObject(const Vector2& pos, const Vector2& size) :
 		GameObject(pos)
 	{
+		SetCollisionCallbacks(CollisionCallback_None);
 		CreatePhysicsBody(pos, b2_staticBody);
 
 		b2PolygonShape shapeDef;
@@ -91,6 +101,8 @@ private:
 Physics::Physics()
 {
 	ASSERT(!g_physics);
+	raycastCount = 0;
+	collisionCallbackCount = 0;
 	worldAABB.lowerBound.Set(-worldSize, -worldSize);
 	worldAABB.upperBound.Set(worldSize, worldSize);
 	b2Vec2 gravity;
@@ -100,11 +112,19 @@ Physics::Physics()
 	world->SetContactListener(&m_contactListener);
 	world->SetContactFilter(&m_contactFilter);
 	world->SetDebugDraw(&g_physicsRender);
+
+	taskExecutor = new PhysicsTaskExecutor(*g_jobSystem, solverThreads);
+	world->SetTaskExecutor(taskExecutor);
+
+	contactAddEvents.reserve(256);
+	contactRemoveEvents.reserve(256);
+	contactResults.reserve(1024);
 }
 
 Physics::~Physics()
 {
 	SAFE_DELETE(world);
+	SAFE_DELETE(taskExecutor);
 }
 
 void Physics::Init()
@@ -114,6 +134,12 @@ void Physics::Init()
 	ASSERT(!initialized);
 	initialized = true;
 
+	{
+		// engine collision rules, games add their own at startup
+		CollisionMatrix::SetTypesCollide(GAME_OBJECT_TYPE_TERRAIN, GAME_OBJECT_TYPE_TERRAIN, false);
+		CollisionMatrix::SetTypeFlags(GAME_OBJECT_TYPE_PROJECTILE, CollisionType_IgnoreSameTeam);
+	}
+
 	{
 		// create boundry objects to keep everything inside the world
 		const float size = 10;
@@ -150,7 +176,10 @@ void Physics::Update(float delta)
 	FrankProfilerEntryDefine(L"Physics::Update()", Color::White(), 5);
 
 	raycastCount = 0;
+	collisionCallbackCount = 0;
 	world->SetGravity(Terrain::gravity);
+	taskExecutor->maxThreads = solverThreads;
+	world->SetSimdContactSolver(simdContactSolver);
 
 	if (enablePhysics)
 		world->Step(delta, velocityIterations, positionIterations);
@@ -162,51 +191,52 @@ void Physics::ProcessEvents()
 {
 	// process buffered collision events after physics update
 	// this is to fix problems with changing the physics state during an update
+	// callbacks can destroy bodies which adds remove events, so use indices instead of iterators
 
 	// process contact add events
-	for (list<ContactEvent>::iterator it = contactAddEvents.begin(); it != contactAddEvents.end(); ++it) 
+	for (unsigned i = 0; i < contactAddEvents.size(); ++i) 
 	{
-		ContactEvent& ce = *it;
+		const ContactEvent ce = contactAddEvents[i];
 		GameObject* obj1 = GameObject::GetFromPhysicsBody(*ce.fixtureA->GetBody());
 		GameObject* obj2 = GameObject::GetFromPhysicsBody(*ce.fixtureB->GetBody());
 
 		ASSERT(obj1 && obj2);
-		if (!obj1->IsDestroyed())
+		if (!obj1->IsDestroyed() && obj1->WantsCollisionCallback(CollisionCallback_Add))
+		{
 			obj1->CollisionAdd(*obj2, ce, ce.fixtureA, ce.fixtureB);
-		if (!obj2->IsDestroyed())
+			++collisionCallbackCount;
+		}
+		if (!obj2->IsDestroyed() && obj2->WantsCollisionCallback(CollisionCallback_Add))
+		{
 			obj2->CollisionAdd(*obj1, ce, ce.fixtureB, ce.fixtureA);
+			++collisionCallbackCount;
+		}
 	}
 	contactAddEvents.clear();
 	
 	// process contact persist events
-	for (list<b2Contact*>::iterator it = g_physics->contacts.begin(); it != g_physics->contacts.end(); ++it) 
+	// callbacks can destroy bodies which removes contacts, the set is compacted after so none get skipped
+	contacts.BeginIterate();
+	for (int i = 0; i < contacts.GetCount(); ++i) 
 	{
-		b2Contact* contact = *it;
+		b2Contact* contact = contacts.Get(i);
+		if (!contact)
+			continue;
+
 		b2Fixture* fixtureA = contact->GetFixtureA();
 		b2Fixture* fixtureB = contact->GetFixtureB();
 		GameObject* obj1 = GameObject::GetFromPhysicsBody(*fixtureA->GetBody());
 		GameObject* obj2 = GameObject::GetFromPhysicsBody(*fixtureB->GetBody());
+		ASSERT(obj1 && obj2);
+
+		// skip building the manifold if nobody is listening
+		const bool obj1Wants = !obj1->IsDestroyed() && obj1->WantsCollisionCallback(CollisionCallback_Persist);
+		const bool obj2Wants = !obj2->IsDestroyed() && obj2->WantsCollisionCallback(CollisionCallback_Persist);
+		if (!obj1Wants && !obj2Wants && !showContacts)
+			continue;
 
 		ContactEvent ce;
-		ce.fixtureA = fixtureA;
-		ce.fixtureB = fixtureB;
-		ce.contact = contact;
-		
-		if (fixtureA->IsSensor() || fixtureB->IsSensor())
-		{
-			// sensors don't have manifolds, just use midpoint as center
-			const Vector2 p1 = fixtureA->GetAABB(0).GetCenter();
-			const Vector2 p2 = fixtureB->GetAABB(0).GetCenter();
-			ce.point = 0.5f*p1 + 0.5f*p2;
-			ce.normal = (p1 - p2).Normalize();
-		}
-		else
-		{
-			b2WorldManifold worldManifold;
-			contact->GetWorldManifold(&worldManifold);
-			ce.point = worldManifold.points[0];
-			ce.normal = worldManifold.normal;
-		}
+		GetContactEvent(contact, ce);
 
 		if (showContacts)
 		{
@@ -215,44 +245,180 @@ void Physics::ProcessEvents()
 			ce.point.RenderDebug(Color::Yellow(0.5f));
 		}
 
-		ASSERT(obj1 && obj2);
-		if (!obj1->IsDestroyed())
+		if (obj1Wants)
+		{
 			obj1->CollisionPersist(*obj2, ce, fixtureA, fixtureB);
-		if (!obj2->IsDestroyed())
+			++collisionCallbackCount;
+		}
+		if (obj2Wants && !obj2->IsDestroyed() && contacts.Get(i) == contact)
+		{
 			obj2->CollisionPersist(*obj1, ce, fixtureB, fixtureA);
+			++collisionCallbackCount;
+		}
 	}
+	contacts.EndIterate();
 
 	// process contact remove events
-	for (list<ContactEvent>::iterator it = contactRemoveEvents.begin(); it != contactRemoveEvents.end(); ++it) 
+	for (unsigned i = 0; i < contactRemoveEvents.size(); ++i) 
 	{
-		ContactEvent& ce = *it;
+		const ContactEvent ce = contactRemoveEvents[i];
 		GameObject* obj1 = GameObject::GetFromPhysicsBody(*ce.fixtureA->GetBody());
 		GameObject* obj2 = GameObject::GetFromPhysicsBody(*ce.fixtureB->GetBody());
 
 		ASSERT(obj1 && obj2);
-		if (!obj1->IsDestroyed())
+		if (!obj1->IsDestroyed() && obj1->WantsCollisionCallback(CollisionCallback_Remove))
+		{
 			obj1->CollisionRemove(*obj2, ce, ce.fixtureA, ce.fixtureB);
-		if (!obj2->IsDestroyed())
+			++collisionCallbackCount;
+		}
+		if (!obj2->IsDestroyed() && obj2->WantsCollisionCallback(CollisionCallback_Remove))
+		{
 			obj2->CollisionRemove(*obj1, ce, ce.fixtureB, ce.fixtureA);
+			++collisionCallbackCount;
+		}
 	}
 	contactRemoveEvents.clear();
 
 	// process contact result events
-	for (list<ContactResult>::iterator it = contactResults.begin(); it != contactResults.end(); ++it) 
+	for (unsigned i = 0; i < contactResults.size(); ++i) 
 	{
-		ContactResult& cr = *it;
+		const ContactResult cr = contactResults[i];
 		GameObject* obj1 = GameObject::GetFromPhysicsBody(*cr.ce.fixtureA->GetBody());
 		GameObject* obj2 = GameObject::GetFromPhysicsBody(*cr.ce.fixtureB->GetBody());
 
 		ASSERT(obj1 && obj2);
-		if (!obj1->IsDestroyed())
+		if (!obj1->IsDestroyed() && obj1->WantsCollisionCallback(CollisionCallback_Result))
+		{
 			obj1->CollisionResult(*obj2, cr, cr.ce.fixtureA, cr.ce.fixtureB);
-		if (!obj2->IsDestroyed())
+			++collisionCallbackCount;
+		}
+		if (!obj2->IsDestroyed() && obj2->WantsCollisionCallback(CollisionCallback_Result))
+		{
 			obj2->CollisionResult(*obj1, cr, cr.ce.fixtureB, cr.ce.fixtureA);
+			++collisionCallbackCount;
+		}
 	}
 	contactResults.clear();
 }
 
+void Physics::GetContactEvent(b2Contact* contact, ContactEvent& ce)
+{
+	ce.fixtureA = contact->GetFixtureA();
+	ce.fixtureB = contact->GetFixtureB();
+	ce.contact = contact;
+	
+	if (ce.fixtureA->IsSensor() || ce.fixtureB->IsSensor())
+	{
+		// sensors don't have manifolds, just use midpoint as center
+		const Vector2 p1 = ce.fixtureA->GetAABB(0).GetCenter();
+		const Vector2 p2 = ce.fixtureB->GetAABB(0).GetCenter();
+		ce.point = 0.5f*p1 + 0.5f*p2;
+		ce.normal = (p1 - p2).Normalize();
+	}
+	else
+	{
+		b2WorldManifold worldManifold;
+		contact->GetWorldManifold(&worldManifold);
+		ce.point = worldManifold.points[0];
+		ce.normal = worldManifold.normal;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Contact Set
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+void ContactSet::Add(b2Contact* contact)
+{
+	ASSERT(!Contains(contact));
+	contacts.push_back(contact);
+
+	// store index + 1 so null means not in the set
+	contact->SetUserData((void*)contacts.size());
+}
+
+void ContactSet::Remove(b2Contact* contact)
+{
+	if (!Contains(contact))
+		return;
+
+	const int index = (int)(size_t)contact->GetUserData() - 1;
+	contact->SetUserData(NULL);
+	if (deferRemoves)
+	{
+		// leave a hole to be filled in when iteration is done
+		contacts[index] = NULL;
+		++removedCount;
+		return;
+	}
+
+	// move the last contact into the hole
+	b2Contact* lastContact = contacts.back();
+	contacts[index] = lastContact;
+	lastContact->SetUserData((void*)(index + 1));
+	contacts.pop_back();
+}
+
+void ContactSet::EndIterate()
+{
+	ASSERT(deferRemoves);
+	deferRemoves = false;
+	if (!removedCount)
+		return;
+
+	// squeeze out the holes and fix up the stored indices
+	int count = 0;
+	for (int i = 0; i < (int)contacts.size(); ++i)
+	{
+		b2Contact* contact = contacts[i];
+		if (!contact)
+			continue;
+
+		contacts[count++] = contact;
+		contact->SetUserData((void*)count);
+	}
+	contacts.resize(count);
+	removedCount = 0;
+}
+
+void ContactSet::Clear()
+{
+	for (vector<b2Contact*>::iterator it = contacts.begin(); it != contacts.end(); ++it) 
+	{
+		if (*it)
+			(**it).SetUserData(NULL);
+	}
+	contacts.clear();
+	removedCount = 0;
+}
+
+void ContactSet::Rebuild(b2World& world)
+{
+	// restored contacts keep the index they had when saved
+	contacts.clear();
+	int count = 0;
+	for (b2Contact* contact = world.GetContactList(); contact; contact = contact->GetNext())
+	{
+		const int index = (int)(size_t)contact->GetUserData() - 1;
+		if (index < 0)
+			continue;
+
+		if (index >= (int)contacts.size())
+			contacts.resize(index + 1, NULL);
+		contacts[index] = contact;
+		++count;
+	}
+	ASSERT(count == contacts.size()); // every slot should be filled
+}
+
+bool ContactSet::Contains(const b2Contact* contact) const
+{
+	const int index = (int)(size_t)contact->GetUserData() - 1;
+	return index >= 0 && index < (int)contacts.size() && contacts[index] == contact;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 /*
 	Physics Helper Functions
@@ -271,6 +437,38 @@ int Physics::GetProxyCount() const
 	return world->GetProxyCount();
 }
 
+void Physics::SaveSnapshot(SnapshotWriter& writer) const
+{
+	const int size = world->GetStateSize();
+	writer.Write(size);
+	world->SaveState(writer.Reserve(size));
+}
+
+bool Physics::RestoreSnapshot(SnapshotReader& reader)
+{
+	int size = 0;
+	reader.Read(size);
+	const BYTE* data = reader.Skip(size);
+	if (!data || !world->RestoreState(data, size))
+		return false;
+
+	// any buffered events are for contacts that no longer exist
+	contactAddEvents.clear();
+	contactRemoveEvents.clear();
+	contactResults.clear();
+	contacts.Rebuild(*world);
+	return true;
+}
+
+// reads past the physics part of a snapshot and checks it without changing the world
+bool Physics::IsSnapshotValid(SnapshotReader& reader)
+{
+	int size = 0;
+	reader.Read(size);
+	const BYTE* data = reader.Skip(size);
+	return data && b2World::IsStateValid(data, size);
+}
+
 b2Body* Physics::CreatePhysicsBody(const b2BodyDef& bodyDef)
 {
 	ASSERT(worldAABB.Contains(bodyDef.position));	// physics body out of world
@@ -292,13 +490,7 @@ bool ContactFilter::ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB)
 	const GameObject* obj2 = GameObject::GetFromPhysicsBody(*fixtureB->GetBody());
 	ASSERT(obj1 && obj2);
 
-	if (!obj1->ShouldCollide(*obj2, fixtureA, fixtureB))
-		return false;
-
-	if (!obj2->ShouldCollide(*obj1, fixtureB, fixtureA))
-		return false;
-
-	return true;
+	return CollisionMatrix::ShouldCollide(*obj1, fixtureA, *obj2, fixtureB);
 
 	// box2d filter data collide code
 	//const b2FilterData& filter1 = shape1->GetFilterData();
@@ -309,135 +501,581 @@ bool ContactFilter::ShouldCollide(b2Fixture* fixtureA, b2Fixture* fixtureB)
 	//return (filter1.maskBits & filter2.categoryBits) != 0 && (filter1.categoryBits & filter2.maskBits) != 0;
 }
 
-void ContactListener::BeginContact(b2Contact* contact)
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Collision Matrix
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+UINT32 CollisionMatrix::typeBits[maxTypes][maxTypes / 32] = {0};
+UINT32 CollisionMatrix::teamBits[maxTeams] = {0};
+BYTE CollisionMatrix::typeFlags[maxTypes] = {0};
+
+void CollisionMatrix::SetTypesCollide(GameObjectType typeA, GameObjectType typeB, bool collide)
 {
-	ContactEvent ce;
-	ce.fixtureA = contact->GetFixtureA();
-	ce.fixtureB = contact->GetFixtureB();
-	ce.contact = contact;
+	ASSERT(typeA >= 0 && typeA < maxTypes && typeB >= 0 && typeB < maxTypes);
 
-	if (ce.fixtureA->IsSensor() || ce.fixtureB->IsSensor())
+	// keep it symmetric
+	if (collide)
 	{
-		// sensors don't have manifolds, just use midpoint as center
-		const Vector2 p1 = ce.fixtureA->GetAABB(0).GetCenter();
-		const Vector2 p2 = ce.fixtureB->GetAABB(0).GetCenter();
-		ce.point = 0.5f*p1 + 0.5f*p2;
-		ce.normal = (p1 - p2).Normalize();
+		typeBits[typeA][typeB / 32] &= ~(1u << (typeB % 32));
+		typeBits[typeB][typeA / 32] &= ~(1u << (typeA % 32));
 	}
 	else
 	{
-		b2WorldManifold worldManifold;
-		contact->GetWorldManifold(&worldManifold);
-		ce.point = worldManifold.points[0];
-		ce.normal = worldManifold.normal;
+		typeBits[typeA][typeB / 32] |= (1u << (typeB % 32));
+		typeBits[typeB][typeA / 32] |= (1u << (typeA % 32));
 	}
+}
+
+bool CollisionMatrix::GetTypesCollide(GameObjectType typeA, GameObjectType typeB)
+{
+	ASSERT(typeA >= 0 && typeA < maxTypes && typeB >= 0 && typeB < maxTypes);
+	return (typeBits[typeA][typeB / 32] & (1u << (typeB % 32))) == 0;
+}
+
+void CollisionMatrix::SetTeamsCollide(GameTeam teamA, GameTeam teamB, bool collide)
+{
+	ASSERT(teamA >= 0 && teamA < maxTeams && teamB >= 0 && teamB < maxTeams);
+
+	if (collide)
+	{
+		teamBits[teamA] &= ~(1u << teamB);
+		teamBits[teamB] &= ~(1u << teamA);
+	}
+	else
+	{
+		teamBits[teamA] |= (1u << teamB);
+		teamBits[teamB] |= (1u << teamA);
+	}
+}
+
+bool CollisionMatrix::GetTeamsCollide(GameTeam teamA, GameTeam teamB)
+{
+	ASSERT(teamA >= 0 && teamA < maxTeams && teamB >= 0 && teamB < maxTeams);
+	return (teamBits[teamA] & (1u << teamB)) == 0;
+}
+
+void CollisionMatrix::SetTypeFlags(GameObjectType type, int flags)
+{
+	ASSERT(type >= 0 && type < maxTypes);
+	typeFlags[type] = (BYTE)flags;
+}
+
+int CollisionMatrix::GetTypeFlags(GameObjectType type)
+{
+	ASSERT(type >= 0 && type < maxTypes);
+	return typeFlags[type];
+}
+
+void CollisionMatrix::Reset()
+{
+	ZeroMemory(typeBits, sizeof(typeBits));
+	ZeroMemory(teamBits, sizeof(teamBits));
+	ZeroMemory(typeFlags, sizeof(typeFlags));
+}
+
+// check the type flag rules of one object against the other
+static bool TypeFlagsAllowCollide(int flags, const GameObject& object, const GameObject& otherObject, const b2Fixture* otherFixture)
+{
+	if ((flags & CollisionType_IgnoreSameTeam) && object.GetTeam() != 0 && otherObject.GetTeam() == object.GetTeam())
+		return false;
+
+	if ((flags & CollisionType_IgnoreSensors) && otherFixture && otherFixture->IsSensor())
+		return false;
+
+	if ((flags & CollisionType_StaticOnly) && !otherObject.IsStatic())
+		return false;
+
+	return true;
+}
+
+bool CollisionMatrix::ShouldCollide(const GameObject& objectA, const b2Fixture* fixtureA, const GameObject& objectB, const b2Fixture* fixtureB)
+{
+	if (!GetTypesCollide(objectA.GetType(), objectB.GetType()))
+		return false;
+
+	if (!GetTeamsCollide(objectA.GetTeam(), objectB.GetTeam()))
+		return false;
+
+	const int flagsA = GetTypeFlags(objectA.GetType());
+	if (flagsA && !TypeFlagsAllowCollide(flagsA, objectA, objectB, fixtureB))
+		return false;
+
+	const int flagsB = GetTypeFlags(objectB.GetType());
+	if (flagsB && !TypeFlagsAllowCollide(flagsB, objectB, objectA, fixtureA))
+		return false;
+
+	// only objects that need dynamic decisions get the virtual call
+	if (objectA.WantsCollisionCallback(CollisionCallback_ShouldCollide) && !objectA.ShouldCollide(objectB, fixtureA, fixtureB))
+		return false;
+
+	if (objectB.WantsCollisionCallback(CollisionCallback_ShouldCollide) && !objectB.ShouldCollide(objectA, fixtureB, fixtureA))
+		return false;
+
+	return true;
+}
+
+// check if either object in a contact subscribes to a callback
+static bool ContactWantsCallback(b2Contact* contact, CollisionCallbackFlags callback)
+{
+	const GameObject* obj1 = GameObject::GetFromPhysicsBody(*contact->GetFixtureA()->GetBody());
+	const GameObject* obj2 = GameObject::GetFromPhysicsBody(*contact->GetFixtureB()->GetBody());
+	ASSERT(obj1 && obj2);
+	return obj1->WantsCollisionCallback(callback) || obj2->WantsCollisionCallback(callback);
+}
+
+void ContactListener::BeginContact(b2Contact* contact)
+{
+	// always track the contact so persist works if callbacks change
+	g_physics->contacts.Add(contact);
 
+	if (!ContactWantsCallback(contact, CollisionCallback_Add))
+		return;
+
+	ContactEvent ce;
+	Physics::GetContactEvent(contact, ce);
 	g_physics->contactAddEvents.push_back(ce);
-	g_physics->contacts.push_back(contact);
 }
 
 void ContactListener::EndContact(b2Contact* contact)
 {
 	// dont process remove events now
 	// there is a problem when a body is destroyed it is also sending a contact remove event
+	g_physics->contacts.Remove(contact);
+}
+
+void ContactListener::PreSolve(b2Contact* contact, const b2Manifold* oldManifold)
+{
+	if (!ContactWantsCallback(contact, CollisionCallback_PreSolve))
+		return;
+
 	ContactEvent ce;
-	ce.fixtureA = contact->GetFixtureA();
-	ce.fixtureB = contact->GetFixtureB();
-	ce.contact = contact;
-	
-	if (ce.fixtureA->IsSensor() || ce.fixtureB->IsSensor())
+	Physics::GetContactEvent(contact, ce);
+
+	GameObject* obj1 = GameObject::GetFromPhysicsBody(*ce.fixtureA->GetBody());
+	GameObject* obj2 = GameObject::GetFromPhysicsBody(*ce.fixtureB->GetBody());
+	ASSERT(obj1 && obj2);
+
+	if (obj1->WantsCollisionCallback(CollisionCallback_PreSolve))
 	{
-		// sensors don't have manifolds, just use midpoint as center
-		const Vector2 p1 = ce.fixtureA->GetAABB(0).GetCenter();
-		const Vector2 p2 = ce.fixtureB->GetAABB(0).GetCenter();
-		ce.point = 0.5f*p1 + 0.5f*p2;
-		ce.normal = (p1 - p2).Normalize();
+		obj1->CollisionPreSolve(*obj2, ce, ce.fixtureA, ce.fixtureB, oldManifold);
+		++g_physics->collisionCallbackCount;
 	}
-	else
+	if (obj2->WantsCollisionCallback(CollisionCallback_PreSolve))
 	{
-		b2WorldManifold worldManifold;
-		contact->GetWorldManifold(&worldManifold);
-		ce.point = worldManifold.points[0];
-		ce.normal = worldManifold.normal;
+		obj2->CollisionPreSolve(*obj1, ce, ce.fixtureB, ce.fixtureA, oldManifold);
+		++g_physics->collisionCallbackCount;
 	}
+}
+
+void ContactListener::PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
+{
+	if (!ContactWantsCallback(contact, CollisionCallback_Result))
+		return;
+
+	ContactResult cr;
+	Physics::GetContactEvent(contact, cr.ce);
 	
-	g_physics->contacts.push_back(contact);
+	cr.normalImpulse = 0;
+	cr.tangentImpulse = 0;
+	for (int32 i = 0; i < impulse->count; ++i)
+		cr.normalImpulse = Max(cr.normalImpulse, impulse->normalImpulses[i]);
+	for (int32 i = 0; i < impulse->count; ++i)
+		cr.tangentImpulse = Max(cr.tangentImpulse, impulse->tangentImpulses[i]);
 
-	// search and remove from the list
-	for (list<b2Contact*>::iterator it = g_physics->contacts.begin(); it != g_physics->contacts.end(); ) 
+	g_physics->contactResults.push_back(cr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Contact Benchmark
+	- drops a pile of debris in a private world and times stepping it
+	- runs once with list based contact tracking and once with the contact set
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+class BenchmarkContactListener : public b2ContactListener
+{
+public:
+
+	BenchmarkContactListener(bool _useContactSet) : useContactSet(_useContactSet) {}
+
+	void BeginContact(b2Contact* contact)
 	{
-		const b2Contact* checkContact = *it;
-		if (checkContact == contact)
+		ContactEvent ce;
+		Physics::GetContactEvent(contact, ce);
+		if (useContactSet)
 		{
-			it = g_physics->contacts.erase(it);
-			continue;
+			addEvents.push_back(ce);
+			contactSet.Add(contact);
 		}
+		else
+		{
+			addEventList.push_back(ce);
+			contactList.push_back(contact);
+		}
+	}
+
+	void EndContact(b2Contact* contact)
+	{
+		if (useContactSet)
+			contactSet.Remove(contact);
+		else
+			contactList.remove(contact);
+	}
+
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
+	{
+		ContactResult cr;
+		Physics::GetContactEvent(contact, cr.ce);
+		cr.normalImpulse = impulse->normalImpulses[0];
+		cr.tangentImpulse = impulse->tangentImpulses[0];
+		if (useContactSet)
+			results.push_back(cr);
+		else
+			resultList.push_back(cr);
+	}
+
+	// same work as process events without the game object callbacks
+	void ProcessEvents()
+	{
+		ContactEvent ce;
+		if (useContactSet)
+		{
+			for (int i = 0; i < contactSet.GetCount(); ++i)
+				Physics::GetContactEvent(contactSet.Get(i), ce);
+			addEvents.clear();
+			results.clear();
+		}
+		else
+		{
+			for (list<b2Contact*>::iterator it = contactList.begin(); it != contactList.end(); ++it) 
+				Physics::GetContactEvent(*it, ce);
+			addEventList.clear();
+			resultList.clear();
+		}
+	}
+
+	int GetContactCount() const { return useContactSet? contactSet.GetCount() : contactList.size(); }
+
+	bool useContactSet;
+	ContactSet contactSet;
+	vector<ContactEvent> addEvents;
+	vector<ContactResult> results;
+	list<b2Contact*> contactList;
+	list<ContactEvent> addEventList;
+	list<ContactResult> resultList;
+};
+
+static double RunContactBenchmark(int bodyCount, int stepCount, bool useContactSet, int& contactCount)
+{
+	b2World world(b2Vec2(0, -10));
+	BenchmarkContactListener listener(useContactSet);
+	world.SetContactListener(&listener);
+
+	// container for the pile
+	const int columns = Max(int(sqrtf((float)bodyCount)), 1);
+	const float width = columns * 0.5f;
+	{
+		b2BodyDef bodyDef;
+		b2Body* ground = world.CreateBody(&bodyDef);
+		b2PolygonShape shape;
+		shape.SetAsBox(width + 1, 0.5f, b2Vec2(0, -0.5f), 0);
+		ground->CreateFixture(&shape, 0);
+		shape.SetAsBox(0.5f, 4*width, b2Vec2(-width - 0.5f, 4*width), 0);
+		ground->CreateFixture(&shape, 0);
+		shape.SetAsBox(0.5f, 4*width, b2Vec2(width + 0.5f, 4*width), 0);
+		ground->CreateFixture(&shape, 0);
+	}
+
+	// stack of small boxes that collapses into a pile
+	b2PolygonShape shape;
+	shape.SetAsBox(0.2f, 0.2f);
+	for (int i = 0; i < bodyCount; ++i)
+	{
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(-width + 0.25f + 0.5f * (i % columns) + 0.05f * ((i / columns) % 2), 0.25f + 0.45f * (i / columns));
+		b2Body* body = world.CreateBody(&bodyDef);
+		body->CreateFixture(&shape, 1);
+	}
+
+	// let the pile settle before timing
+	for (int i = 0; i < 60; ++i)
+	{
+		world.Step(1/60.0f, Physics::velocityIterations, Physics::positionIterations);
+		listener.ProcessEvents();
+	}
 
-		++it;
+	CDXUTTimer timer;
+	timer.Start();
+	for (int i = 0; i < stepCount; ++i)
+	{
+		world.Step(1/60.0f, Physics::velocityIterations, Physics::positionIterations);
+		listener.ProcessEvents();
 	}
+	const double time = timer.GetElapsedTime();
+	contactCount = listener.GetContactCount();
+
+	// remove the listener so destroying the world doesn't touch it
+	world.SetContactListener(NULL);
+	return time / stepCount;
 }
 
-void ContactListener::PreSolve(b2Contact* contact, const b2Manifold* oldManifold)
+static void ConsoleCallback_physicsContactBenchmark(const wstring& text)
 {
-	ContactEvent ce;
-	ce.fixtureA = contact->GetFixtureA();
-	ce.fixtureB = contact->GetFixtureB();
-	ce.contact = contact;
-	
-	if (ce.fixtureA->IsSensor() || ce.fixtureB->IsSensor())
+	int bodyCount = 2500;
+	int stepCount = 120;
+	swscanf_s(text.c_str(), L"%d %d", &bodyCount, &stepCount);
+	bodyCount = Max(bodyCount, 1);
+	stepCount = Max(stepCount, 1);
+
+	int listContactCount = 0, setContactCount = 0;
+	const double listTime = RunContactBenchmark(bodyCount, stepCount, false, listContactCount);
+	const double setTime = RunContactBenchmark(bodyCount, stepCount, true, setContactCount);
+
+	GetDebugConsole().AddFormatted(L"%d bodies, %d contacts", bodyCount, setContactCount);
+	GetDebugConsole().AddFormatted(L"list contacts: %.3f ms per step", 1000 * listTime);
+	GetDebugConsole().AddFormatted(L"contact set: %.3f ms per step", 1000 * setTime);
+}
+ConsoleCommand(ConsoleCallback_physicsContactBenchmark, physicsContactBenchmark);
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Physics Task Executor
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+PhysicsTaskExecutor::PhysicsTaskExecutor(JobSystem& _jobSystem, int _maxThreads) :
+	maxThreads(_maxThreads),
+	jobSystem(_jobSystem),
+	task(NULL)
+{
+}
+
+PhysicsTaskExecutor::~PhysicsTaskExecutor()
+{
+}
+
+int32 PhysicsTaskExecutor::GetThreadCount() const
+{
+	return jobSystem.GetThreadCount(maxThreads);
+}
+
+void PhysicsTaskExecutor::Execute(b2Task* _task, int32 count)
+{
+	task = _task;
+	jobSystem.ParallelFor(*this, count, maxThreads);
+	task = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Island Benchmark
+	- headless scene with many small piles that each form their own island
+	- steps the same scene with 1, 2, 4 and 8 solver threads
+	- results must match the single threaded solve exactly
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+class BenchmarkImpulseListener : public b2ContactListener
+{
+public:
+
+	BenchmarkImpulseListener() : impulseSum(0), count(0) {}
+
+	// order dependent sum so the replay order is checked too
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
 	{
-		// sensors don't have manifolds, just use midpoint as center
-		const Vector2 p1 = ce.fixtureA->GetAABB(0).GetCenter();
-		const Vector2 p2 = ce.fixtureB->GetAABB(0).GetCenter();
-		ce.point = 0.5f*p1 + 0.5f*p2;
-		ce.normal = (p1 - p2).Normalize();
+		impulseSum += impulse->normalImpulses[0] * (double)(++count % 1000);
 	}
-	else
+
+	double impulseSum;
+	int count;
+};
+
+static double RunIslandBenchmark(int pileCount, int stepCount, int threadCount, vector<b2Vec2>& positions, double& impulseSum)
+{
+	JobSystem jobSystem(threadCount);
+	PhysicsTaskExecutor executor(jobSystem, threadCount);
+	BenchmarkImpulseListener listener;
+
+	b2World world(b2Vec2(0, -10));
+	world.SetTaskExecutor(&executor);
+	world.SetContactListener(&listener);
+
+	// islands are not joined through static bodies so all piles can share the ground
+	const float spacing = 4;
 	{
-		b2WorldManifold worldManifold;
-		contact->GetWorldManifold(&worldManifold);
-		ce.point = worldManifold.points[0];
-		ce.normal = worldManifold.normal;
+		b2BodyDef bodyDef;
+		b2Body* ground = world.CreateBody(&bodyDef);
+		b2EdgeShape shape;
+		shape.Set(b2Vec2(-spacing, 0), b2Vec2(spacing * pileCount, 0));
+		ground->CreateFixture(&shape, 0);
 	}
 
-	GameObject* obj1 = GameObject::GetFromPhysicsBody(*ce.fixtureA->GetBody());
-	GameObject* obj2 = GameObject::GetFromPhysicsBody(*ce.fixtureB->GetBody());
-	ASSERT(obj1 && obj2);
+	// each pile is a short pyramid of boxes
+	const int pileRows = 5;
+	b2PolygonShape shape;
+	shape.SetAsBox(0.25f, 0.25f);
+	for (int i = 0; i < pileCount; ++i)
+	for (int row = 0; row < pileRows; ++row)
+	for (int j = 0; j < pileRows - row; ++j)
+	{
+		b2BodyDef bodyDef;
+		bodyDef.type = b2_dynamicBody;
+		bodyDef.position.Set(spacing * i + 0.55f * j + 0.275f * row, 0.25f + 0.5f * row);
+		b2Body* body = world.CreateBody(&bodyDef);
+		body->CreateFixture(&shape, 1);
+	}
+
+	CDXUTTimer timer;
+	timer.Start();
+	for (int i = 0; i < stepCount; ++i)
+		world.Step(1/60.0f, Physics::velocityIterations, Physics::positionIterations);
+	const double time = timer.GetElapsedTime();
 
-	obj1->CollisionPreSolve(*obj2, ce, ce.fixtureA, ce.fixtureB, oldManifold);
-	obj2->CollisionPreSolve(*obj1, ce, ce.fixtureB, ce.fixtureA, oldManifold);
+	positions.clear();
+	for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+		positions.push_back(body->GetPosition());
+	impulseSum = listener.impulseSum;
+
+	world.SetContactListener(NULL);
+	world.SetTaskExecutor(NULL);
+	return time / stepCount;
 }
 
-void ContactListener::PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
+static void ConsoleCallback_physicsIslandBenchmark(const wstring& text)
 {
-	ContactResult cr;
-	cr.ce.fixtureA = contact->GetFixtureA();
-	cr.ce.fixtureB = contact->GetFixtureB();
-	cr.ce.contact = contact;
-	
-	if (cr.ce.fixtureA->IsSensor() || cr.ce.fixtureB->IsSensor())
+	int pileCount = 500;
+	int stepCount = 120;
+	swscanf_s(text.c_str(), L"%d %d", &pileCount, &stepCount);
+	pileCount = Max(pileCount, 1);
+	stepCount = Max(stepCount, 1);
+
+	GetDebugConsole().AddFormatted(L"%d islands, %d steps, %d cores", pileCount, stepCount, JobSystem::GetCoreCount());
+
+	vector<b2Vec2> serialPositions, positions;
+	double serialImpulseSum = 0, impulseSum = 0;
+	double serialTime = 0;
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	for (int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); ++i)
 	{
-		// sensors don't have manifolds, just use midpoint as center
-		const Vector2 p1 = cr.ce.fixtureA->GetAABB(0).GetCenter();
-		const Vector2 p2 = cr.ce.fixtureB->GetAABB(0).GetCenter();
-		cr.ce.point = 0.5f*p1 + 0.5f*p2;
-		cr.ce.normal = (p1 - p2).Normalize();
+		const int threadCount = threadCounts[i];
+		const double time = RunIslandBenchmark(pileCount, stepCount, threadCount, positions, impulseSum);
+
+		bool matches = true;
+		if (threadCount == 1)
+		{
+			serialTime = time;
+			serialPositions = positions;
+			serialImpulseSum = impulseSum;
+		}
+		else
+		{
+			matches = impulseSum == serialImpulseSum && positions.size() == serialPositions.size();
+			for (unsigned j = 0; matches && j < positions.size(); ++j)
+				matches = positions[j] == serialPositions[j];
+		}
+
+		// text bar chart of the speedup, one mark per quarter
+		const float speedup = time > 0? float(serialTime / time) : 0;
+		const int barLength = Min(int(4 * speedup + 0.5f), 64);
+		const wstring bar(barLength, L'#');
+		GetDebugConsole().AddFormatted(L"%d threads: %.3f ms  %.2fx %s%s", threadCount, 1000 * time, speedup, bar.c_str(), matches? L"" : L"  MISMATCH");
+	}
+}
+ConsoleCommand(ConsoleCallback_physicsIslandBenchmark, physicsIslandBenchmark);
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Contact Solver Benchmark
+	- standard stacking and pyramid scenes solved with the scalar and simd contact solvers
+	- reports how far apart the final positions are, they should stay close
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+static double RunSolverBenchmark(bool pyramid, int stepCount, bool simd, vector<b2Vec2>& positions)
+{
+	b2World world(b2Vec2(0, -10));
+	world.SetSimdContactSolver(simd);
+	{
+		b2BodyDef bodyDef;
+		b2Body* ground = world.CreateBody(&bodyDef);
+		b2EdgeShape shape;
+		shape.Set(b2Vec2(-100, 0), b2Vec2(100, 0));
+		ground->CreateFixture(&shape, 0);
+	}
+
+	b2PolygonShape shape;
+	shape.SetAsBox(0.5f, 0.5f);
+	if (pyramid)
+	{
+		const int rows = 30;
+		for (int row = 0; row < rows; ++row)
+		for (int i = 0; i < rows - row; ++i)
+		{
+			b2BodyDef bodyDef;
+			bodyDef.type = b2_dynamicBody;
+			bodyDef.position.Set(-20 + 1.125f * i + 0.5625f * row, 0.75f + row);
+			world.CreateBody(&bodyDef)->CreateFixture(&shape, 5);
+		}
 	}
 	else
 	{
-		b2WorldManifold worldManifold;
-		contact->GetWorldManifold(&worldManifold);
-		cr.ce.point = worldManifold.points[0];
-		cr.ce.normal = worldManifold.normal;
+		const int columns = 10;
+		const int height = 20;
+		for (int i = 0; i < columns; ++i)
+		for (int j = 0; j < height; ++j)
+		{
+			b2BodyDef bodyDef;
+			bodyDef.type = b2_dynamicBody;
+			bodyDef.position.Set(-15 + 3.0f * i, 0.5f + j);
+			world.CreateBody(&bodyDef)->CreateFixture(&shape, 1);
+		}
 	}
-	
-    for (int32 i = 0; i < impulse->count; ++i)
-        cr.normalImpulse = Max(cr.normalImpulse, impulse->normalImpulses[i]);
-    for (int32 i = 0; i < impulse->count; ++i)
-        cr.tangentImpulse = Max(cr.tangentImpulse, impulse->tangentImpulses[i]);
 
-	g_physics->contactResults.push_back(cr);
+	CDXUTTimer timer;
+	timer.Start();
+	for (int i = 0; i < stepCount; ++i)
+		world.Step(1/60.0f, Physics::velocityIterations, Physics::positionIterations);
+	const double time = timer.GetElapsedTime();
+
+	positions.clear();
+	for (b2Body* body = world.GetBodyList(); body; body = body->GetNext())
+		positions.push_back(body->GetPosition());
+	return time / stepCount;
+}
+
+static void ConsoleCallback_physicsSolverBenchmark(const wstring& text)
+{
+	int stepCount = 600;
+	swscanf_s(text.c_str(), L"%d", &stepCount);
+	stepCount = Max(stepCount, 1);
+
+	// the simd solver is compiled out when the width is 0, then both runs are scalar
+	const int simdWidth = b2World::GetSimdContactSolverWidth();
+	if (simdWidth == 0)
+		GetDebugConsole().AddFormatted(L"Simd contact solver is not available in this build, both runs use the scalar solver.");
+	else
+		GetDebugConsole().AddFormatted(L"Simd contact solver width %d.", simdWidth);
+
+	for (int scene = 0; scene < 2; ++scene)
+	{
+		vector<b2Vec2> scalarPositions, simdPositions;
+		const double scalarTime = RunSolverBenchmark(scene == 1, stepCount, false, scalarPositions);
+		const double simdTime = RunSolverBenchmark(scene == 1, stepCount, true, simdPositions);
+
+		float maxDifference = 0;
+		for (unsigned i = 0; i < scalarPositions.size() && i < simdPositions.size(); ++i)
+			maxDifference = Max(maxDifference, (scalarPositions[i] - simdPositions[i]).Length());
+
+		GetDebugConsole().AddFormatted(L"%s: scalar %.3f ms, simd %.3f ms, max difference %.4f", 
+			scene? L"pyramid" : L"stacking", 1000 * scalarTime, 1000 * simdTime, maxDifference);
+	}
 }
+ConsoleCommand(ConsoleCallback_physicsSolverBenchmark, physicsSolverBenchmark);
 
 ////////////////////////////////////////////////////////////////////////////////////////
 /*
@@ -453,13 +1091,33 @@ void SimpleRaycastResult::RenderDebug(const Color& color, float radius, float ti
 	Line2(point, point + 2*radius*normal).RenderDebug(color, time);
 }
 
+GameObject* SimpleRaycastResult::GetHitObject() const
+{
+	return hitFixture? GameObject::GetFromPhysicsBody(*hitFixture->GetBody()) : NULL;
+}
+
+bool RaycastFilter::ShouldHit(const GameObject& object, const b2Fixture* fixture) const
+{
+	ASSERT(proxy);
+	if (object.GetHandle() == ignoreHandle)
+		return false;
+
+	// projectiles pass through sensors, so they can't stop the ray either
+	if (fixture->IsSensor())
+		return false;
+
+	// use the same rules a projectile would get from the contact filter
+	return CollisionMatrix::ShouldCollide(object, fixture, *proxy, NULL);
+}
+
 class RaycastQueryCallback : public b2QueryCallback
 {
 public:
 
-	RaycastQueryCallback(const GameObject* ignoreObject, const b2Vec2& point, bool sightCheck)
+	RaycastQueryCallback(const GameObject* ignoreObject, const b2Vec2& point, bool sightCheck, const RaycastFilter* filter = NULL)
 	{
 		m_ignoreObject = ignoreObject;
+		m_filter = filter;
 		m_fixture = NULL;
 		m_point = point;
 		m_sightCheck = sightCheck;
@@ -484,20 +1142,18 @@ public:
 			return true;
 
 		// do object should collide check
-		if (m_ignoreObject)
-		{
-			if (!object->ShouldCollide(*m_ignoreObject, fixture, NULL))
-				return true;
+		if (m_ignoreObject && !CollisionMatrix::ShouldCollide(*object, fixture, *m_ignoreObject, NULL))
+			return true;
 
-			if (!m_ignoreObject->ShouldCollide(*object, NULL, fixture))
-				return true;
-		}
+		if (m_filter && !m_filter->ShouldHit(*object, fixture))
+			return true;
 		
 		m_fixture = fixture;
 		return false;
 	}
 
 	const GameObject* m_ignoreObject;
+	const RaycastFilter* m_filter;
 	b2Fixture* m_fixture;
 	b2Vec2 m_point;
 	bool m_sightCheck;
@@ -507,9 +1163,10 @@ class RayCastClosestCallback : public b2RayCastCallback
 {
 public:
 	
-	RayCastClosestCallback(const GameObject* ignoreObject = NULL, bool sightCheck = false)
+	RayCastClosestCallback(const GameObject* ignoreObject = NULL, bool sightCheck = false, const RaycastFilter* filter = NULL)
 	{
 		m_ignoreObject = ignoreObject;
+		m_filter = filter;
 		m_hitObject = NULL;
 		m_hitFixture = NULL;
 		m_lambda = 0;
@@ -529,14 +1186,11 @@ public:
 			return -1.0f;
 	
 		// do object should collide check
-		if (m_ignoreObject)
-		{
-			if (!object->ShouldCollide(*m_ignoreObject, fixture, NULL))
-				return -1.0f;
+		if (m_ignoreObject && !CollisionMatrix::ShouldCollide(*object, fixture, *m_ignoreObject, NULL))
+			return -1.0f;
 
-			if (!m_ignoreObject->ShouldCollide(*object, NULL, fixture))
-				return -1.0f;
-		}
+		if (m_filter && !m_filter->ShouldHit(*object, fixture))
+			return -1.0f;
 
 		m_hitObject = object;
 		m_point = point;
@@ -547,6 +1201,7 @@ public:
 	}
 
 	const GameObject* m_ignoreObject;
+	const RaycastFilter* m_filter;
 	GameObject* m_hitObject;
 	b2Fixture* m_hitFixture;
 	b2Vec2 m_point;
@@ -555,18 +1210,18 @@ public:
 	bool m_sightCheck;
 };
 
-GameObject* Physics::RaycastSimple(const Line2& line, SimpleRaycastResult* result, const GameObject* ignoreObject, bool sightCheck)
+// only reads from the world so batches can call this from worker threads
+static GameObject* RaycastClosest(const b2World& world, const Line2& line, SimpleRaycastResult* result, const GameObject* ignoreObject, bool sightCheck, const RaycastFilter* filter = NULL)
 {
-	FrankProfilerBlockTimer profilerBlock(rayCastProfilerEntry);
 	{
 		// check inside solid fixtures
 		// First check if we are starting inside an object
-		RaycastQueryCallback queryCallback(ignoreObject, line.p1, sightCheck);
+		RaycastQueryCallback queryCallback(ignoreObject, line.p1, sightCheck, filter);
 
 		// make a small box
 		b2Vec2 d(0.001f, 0.001f);
 		b2AABB aabb = {b2Vec2(line.p1) - d, b2Vec2(line.p1) + d};
-		world->QueryAABB(&queryCallback, aabb);
+		world.QueryAABB(&queryCallback, aabb);
 
 		if (queryCallback.m_fixture)
 		{
@@ -582,8 +1237,9 @@ GameObject* Physics::RaycastSimple(const Line2& line, SimpleRaycastResult* resul
 		}
 	}
 
-	RayCastClosestCallback raycastResult(ignoreObject, sightCheck);
-	Raycast(line, raycastResult);
+	RayCastClosestCallback raycastResult(ignoreObject, sightCheck, filter);
+	if (line.p1.x != line.p2.x || line.p1.y != line.p2.y)
+		world.RayCast(&raycastResult, line.p1, line.p2);
 
 	if (result)
 	{
@@ -607,6 +1263,132 @@ GameObject* Physics::RaycastSimple(const Line2& line, SimpleRaycastResult* resul
 	return raycastResult.m_hitObject;
 }
 
+GameObject* Physics::RaycastSimple(const Line2& line, SimpleRaycastResult* result, const GameObject* ignoreObject, bool sightCheck)
+{
+	FrankProfilerBlockTimer profilerBlock(rayCastProfilerEntry);
+
+	if (showRaycasts)
+		line.RenderDebug(Color(1.0f, 0.8f, 0.5f, 0.5f));
+
+	++raycastCount;
+	return RaycastClosest(*world, line, result, ignoreObject, sightCheck);
+}
+
+class RaycastBatchTask : public JobTask
+{
+public:
+
+	// rays are handed out in chunks so the job overhead stays small
+	static const int chunkSize = 16;
+
+	void Run(int index, int threadIndex)
+	{
+		const int end = Min((index + 1) * chunkSize, count);
+		for (int i = index * chunkSize; i < end; ++i)
+			RaycastClosest(*world, lines[i], results + i, ignoreObjects? ignoreObjects[i] : NULL, sightCheck, filters? filters + i : NULL);
+	}
+
+	const b2World* world;
+	const Line2* lines;
+	SimpleRaycastResult* results;
+	const GameObject* const* ignoreObjects;
+	const RaycastFilter* filters;
+	int count;
+	bool sightCheck;
+};
+
+void Physics::RaycastBatch(const Line2* lines, int count, SimpleRaycastResult* results, const GameObject* const* ignoreObjects, bool sightCheck)
+{
+	FrankProfilerBlockTimer profilerBlock(rayCastProfilerEntry);
+	ASSERT(!world->IsLocked());
+	ASSERT(lines && results || count == 0);
+
+	if (showRaycasts)
+	{
+		for (int i = 0; i < count; ++i)
+			lines[i].RenderDebug(Color(1.0f, 0.8f, 0.5f, 0.5f));
+	}
+	raycastCount += count;
+
+	RaycastBatchTask task;
+	task.world = world;
+	task.lines = lines;
+	task.results = results;
+	task.ignoreObjects = ignoreObjects;
+	task.filters = NULL;
+	task.count = count;
+	task.sightCheck = sightCheck;
+	g_jobSystem->ParallelFor(task, (count + RaycastBatchTask::chunkSize - 1) / RaycastBatchTask::chunkSize, raycastBatchThreads);
+}
+
+void Physics::RaycastBatch(const Line2* lines, int count, SimpleRaycastResult* results, const RaycastFilter* filters)
+{
+	FrankProfilerBlockTimer profilerBlock(rayCastProfilerEntry);
+	ASSERT(!world->IsLocked());
+	ASSERT(lines && results && filters || count == 0);
+
+	if (showRaycasts)
+	{
+		for (int i = 0; i < count; ++i)
+			lines[i].RenderDebug(Color(1.0f, 0.8f, 0.5f, 0.5f));
+	}
+	raycastCount += count;
+
+	RaycastBatchTask task;
+	task.world = world;
+	task.lines = lines;
+	task.results = results;
+	task.ignoreObjects = NULL;
+	task.filters = filters;
+	task.count = count;
+	task.sightCheck = false;
+	g_jobSystem->ParallelFor(task, (count + RaycastBatchTask::chunkSize - 1) / RaycastBatchTask::chunkSize, raycastBatchThreads);
+}
+
+// casts random rays around the camera through the live world one at a time and batched
+static void ConsoleCallback_physicsRaycastBenchmark(const wstring& text)
+{
+	int rayCount = 1000;
+	float range = 30;
+	swscanf_s(text.c_str(), L"%d %f", &rayCount, &range);
+	rayCount = Max(rayCount, 1);
+
+	vector<Line2> lines(rayCount);
+	const Vector2 center = g_cameraBase->GetPosWorld();
+	for (int i = 0; i < rayCount; ++i)
+	{
+		const Vector2 start = center + Vector2::BuildRandomInCircle(range);
+		lines[i] = Line2(start, start + Vector2::BuildRandomInCircle(range));
+	}
+
+	vector<SimpleRaycastResult> simpleResults(rayCount), batchResults(rayCount);
+	CDXUTTimer timer;
+	timer.Start();
+	for (int i = 0; i < rayCount; ++i)
+		g_physics->RaycastSimple(lines[i], &simpleResults[i]);
+	const double simpleTime = timer.GetElapsedTime();
+
+	timer.Reset();
+	g_physics->RaycastBatch(&lines[0], rayCount, &batchResults[0]);
+	const double batchTime = timer.GetElapsedTime();
+
+	int hitCount = 0, mismatchCount = 0;
+	for (int i = 0; i < rayCount; ++i)
+	{
+		if (simpleResults[i].hitFixture)
+			++hitCount;
+		if (simpleResults[i].hitFixture != batchResults[i].hitFixture || simpleResults[i].lambda != batchResults[i].lambda)
+			++mismatchCount;
+	}
+
+	GetDebugConsole().AddFormatted(L"%d rays, %d hits, %d threads", rayCount, hitCount, g_jobSystem->GetThreadCount(Physics::raycastBatchThreads));
+	GetDebugConsole().AddFormatted(L"simple: %.2f us per ray", 1000000 * simpleTime / rayCount);
+	GetDebugConsole().AddFormatted(L"batch: %.2f us per ray", 1000000 * batchTime / rayCount);
+	if (mismatchCount)
+		GetDebugConsole().AddFormatted(L"%d results did not match!", mismatchCount);
+}
+ConsoleCommand(ConsoleCallback_physicsRaycastBenchmark, physicsRaycastBenchmark);
+
 void Physics::Raycast(const Line2& line, b2RayCastCallback& raycastResult)
 {
 	FrankProfilerBlockTimer profilerBlock(rayCastProfilerEntry);
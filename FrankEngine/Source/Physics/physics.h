@@ -11,6 +11,11 @@
 // this is the global physics controller
 extern class Physics* g_physics;
 
+enum GameObjectType;
+class GameObject;
+class SnapshotWriter;
+class SnapshotReader;
+
 class ContactFilter : public b2ContactFilter
 {
 public:
@@ -52,6 +57,99 @@ struct ContactResult
 	float32 tangentImpulse;
 };
 
+// set of touching contacts with constant time add and remove
+// each contact stores its index in the contact user data
+class ContactSet
+{
+public:
+
+	ContactSet() : deferRemoves(false), removedCount(0) {}
+
+	void Add(b2Contact* contact);
+	void Remove(b2Contact* contact);
+	void Clear();
+
+	// while iterating removes only clear the slot so nothing moves, slots can be null until the end
+	void BeginIterate()						{ ASSERT(!deferRemoves); deferRemoves = true; }
+	void EndIterate();
+
+	// put contacts back in their slots after the world is restored from a snapshot
+	void Rebuild(b2World& world);
+
+	int GetCount() const					{ return contacts.size(); }
+	b2Contact* Get(int i) const				{ return contacts[i]; }
+	bool Contains(const b2Contact* contact) const;
+
+private:
+
+	vector<b2Contact*> contacts;
+	bool deferRemoves;
+	int removedCount;
+};
+
+// rules for a type that depend on the other object
+enum CollisionTypeFlags
+{
+	CollisionType_None				= 0x00,
+	CollisionType_IgnoreSameTeam	= 0x01,	// don't collide with objects on the same team, except team 0
+	CollisionType_IgnoreSensors		= 0x02,	// don't collide with sensor fixtures
+	CollisionType_StaticOnly		= 0x04,	// only collide with static objects
+};
+
+// declarative rules for which object types and teams can collide
+// this is checked before any virtual should collide calls, everything collides by default
+// register rules at startup and clear CollisionCallback_ShouldCollide for types that are fully covered
+class CollisionMatrix
+{
+public:
+
+	static void SetTypesCollide(GameObjectType typeA, GameObjectType typeB, bool collide);
+	static bool GetTypesCollide(GameObjectType typeA, GameObjectType typeB);
+
+	static void SetTeamsCollide(GameTeam teamA, GameTeam teamB, bool collide);
+	static bool GetTeamsCollide(GameTeam teamA, GameTeam teamB);
+
+	static void SetTypeFlags(GameObjectType type, int flags);
+	static int GetTypeFlags(GameObjectType type);
+
+	// allow everything to collide again
+	static void Reset();
+
+	// check the matrix and then the virtual should collide for objects that need it
+	static bool ShouldCollide(const GameObject& objectA, const b2Fixture* fixtureA, const GameObject& objectB, const b2Fixture* fixtureB);
+
+	static const int maxTypes = 256;
+	static const int maxTeams = 32;
+
+private:
+
+	// bits are set for pairs that don't collide so everything starts out colliding
+	static UINT32 typeBits[maxTypes][maxTypes / 32];
+	static UINT32 teamBits[maxTeams];
+	static BYTE typeFlags[maxTypes];
+};
+
+// lets box2d solve islands on the job system
+class PhysicsTaskExecutor : public b2TaskExecutor, private JobTask
+{
+public:
+
+	PhysicsTaskExecutor(JobSystem& _jobSystem, int _maxThreads = 0);
+	~PhysicsTaskExecutor();
+
+	int32 GetThreadCount() const;
+	void Execute(b2Task* task, int32 count);
+
+	int maxThreads;				// how many threads to use, 0 for all of them
+
+private:
+
+	void Run(int index, int threadIndex) { task->Run(index, threadIndex); }
+
+	JobSystem& jobSystem;
+	b2Task* task;
+};
+
 struct SimpleRaycastResult
 {
 	Vector2 point;
@@ -59,9 +157,23 @@ struct SimpleRaycastResult
 	b2Fixture* hitFixture;
 	float lambda;
 
+	GameObject* GetHitObject() const;
 	void RenderDebug(const Color& color = Color::White(0.5f), float radius = 0.1f, float time = 0.0f) const;
 };
 
+// filters a ray the way a projectile would, for things that have no game object of their own
+// the proxy stands in for the projectile so the collision matrix and ShouldCollide get the final say
+struct RaycastFilter
+{
+	RaycastFilter(GameObjectHandle _ignoreHandle, const GameObject& _proxy) : ignoreHandle(_ignoreHandle), proxy(&_proxy) {}
+	RaycastFilter() : ignoreHandle(0), proxy(NULL) {}
+
+	bool ShouldHit(const GameObject& object, const b2Fixture* fixture) const;
+
+	GameObjectHandle ignoreHandle;	// object to pass through, usually the attacker
+	const GameObject* proxy;		// object that collides like the projectile would, it is never in the world
+};
+
 class Physics : private Uncopyable
 {
 public:
@@ -76,9 +188,23 @@ public:
 	int GetBodyCount() const;
 	int GetProxyCount() const;
 
+	// save and restore the physics world for world snapshots
+	// restoring fails if any bodies, fixtures or joints were created or destroyed since saving
+	void SaveSnapshot(SnapshotWriter& writer) const;
+	bool RestoreSnapshot(SnapshotReader& reader);
+	static bool IsSnapshotValid(SnapshotReader& reader);
+
 	void Raycast(const Line2& line, b2RayCastCallback& raycastResult);
 	class GameObject* RaycastSimple(const Line2& line, SimpleRaycastResult* result = NULL, const GameObject* ignoreObject = NULL, bool sightCheck = false);
 
+	// same as calling RaycastSimple for each line, split up across the job system
+	// ignore objects can be null or have one entry per line
+	// should collide callbacks are called from worker threads so they must only read
+	void RaycastBatch(const Line2* lines, int count, SimpleRaycastResult* results, const GameObject* const* ignoreObjects = NULL, bool sightCheck = false);
+
+	// same as above but each line has a filter instead of an ignore object
+	void RaycastBatch(const Line2* lines, int count, SimpleRaycastResult* results, const RaycastFilter* filters);
+
 	unsigned QueryAABB(const Box2AABB& box, GameObject** hitObjects = NULL, unsigned maxHitObjectCount = 0, const GameObject* ignoreObject = NULL, bool ignoreSensors = true);
 	bool QueryAABBSimple(const Box2AABB& box, const GameObject* ignoreObject = NULL, bool ignoreSensors = true);
 
@@ -92,6 +218,10 @@ public:
 	b2World* GetPhysicsWorld()							{ return world; }
 	bool IsInWorld(const Vector2& pos) const			{ return true; }//worldAABB.TestPoint(pos); }
 	int GetRaycastCount() const							{ return raycastCount; }
+	int GetCollisionCallbackCount() const				{ return collisionCallbackCount; }
+
+	// fill in contact point and normal, sensors use the midpoint between fixtures
+	static void GetContactEvent(b2Contact* contact, ContactEvent& ce);
 
 public:	// settings
 
@@ -103,6 +233,9 @@ public:	// settings
 	static float worldSize;					// maximum extents of physics world
 	static int32 velocityIterations;		// settings for physics world update
 	static int32 positionIterations;		// settings for physics world update
+	static int solverThreads;				// threads used to solve islands, 1 to solve on the main thread, 0 for all cores
+	static bool simdContactSolver;			// solve contacts that don't share bodies together with simd
+	static int raycastBatchThreads;			// threads used for batched raycasts, 0 for all cores
 
 private:
 
@@ -118,15 +251,17 @@ private:
 
 	b2AABB worldAABB;
 	b2World* world;
+	PhysicsTaskExecutor* taskExecutor;
 	int raycastCount;
+	int collisionCallbackCount;			// how many collision callbacks were dispatched last update
 	bool debugRender;
 
-	list<b2Contact*> contacts;
+	ContactSet contacts;
 
-	// contact point buffers
-	list<ContactEvent> contactAddEvents;
-	list<ContactEvent> contactRemoveEvents;
-	list<ContactResult> contactResults;
+	// contact point buffers, capacity is kept between steps
+	vector<ContactEvent> contactAddEvents;
+	vector<ContactEvent> contactRemoveEvents;
+	vector<ContactResult> contactResults;
 };
 
 #endif // PHYSICS_H
\ No newline at end of file
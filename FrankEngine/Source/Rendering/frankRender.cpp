@@ -22,6 +22,7 @@ struct CUSTOMVERTEX
 };
 
 #define D3DFVF_SimpleVertex (D3DFVF_XYZ|D3DFVF_DIFFUSE)
+#define D3DFVF_TexturedVertex (D3DFVF_XYZ|D3DFVF_DIFFUSE|D3DFVF_TEX1)
 
 bool g_usePointFiltering = false;
 ConsoleCommand(g_usePointFiltering, usePointFiltering);
@@ -80,6 +81,7 @@ void FrankRender::InitDeviceObjects()
 		primitiveCube.vb = NULL;
 		primitiveLines.vb = NULL;
 		primitiveTris.vb = NULL;
+		primitiveTexturedTris.vb = NULL;
 		normalMapShader = NULL;
 		normalMapConstantTable = NULL;
 	}
@@ -118,6 +120,15 @@ void FrankRender::InitDeviceObjects()
 			D3DFVF_SimpleVertex,			// fvf
 			true							// dynamic
 		);
+		primitiveTexturedTris.Create
+		(
+			0,								// primitiveCount
+			maxTexturedVerts,				// vertexCount
+			D3DPT_TRIANGLELIST,				// primitiveType
+			sizeof(TexturedVertex),			// stride
+			D3DFVF_TexturedVertex,			// fvf
+			true							// dynamic
+		);
 	}
 
 	if (DeferredRender::normalMappingEnable)
@@ -162,6 +173,7 @@ void FrankRender::DestroyDeviceObjects()
 	primitiveCube.SafeRelease();
 	primitiveLines.SafeRelease();
 	primitiveTris.SafeRelease();
+	primitiveTexturedTris.SafeRelease();
 	SAFE_RELEASE(normalMapConstantTable);
 	SAFE_RELEASE(normalMapShader);
 
@@ -804,6 +816,47 @@ void FrankRender::RenderSimpleTriVerts()
 	}
 }
 
+void FrankRender::RenderTexturedTris(const TexturedVertex* verts, int vertCount, GameTextureID ti, bool additive)
+{
+	// normal and specular passes need a transform per quad, those must be drawn the normal way
+	ASSERT(!DeferredRender::GetRenderPassIsNormalMap() && !DeferredRender::GetRenderPassIsSpecular());
+	ASSERT(vertCount % 3 == 0);
+
+	if (vertCount < 3 || !primitiveTexturedTris.vb)
+		return;
+	
+	IDirect3DDevice9* pd3dDevice = DXUTGetD3D9Device();
+	DeferredRender::AdditiveRenderBlock additiveRenderBlock(additive);
+	DeferredRender::EmissiveRenderBlock emissiveRenderBlock(additive);
+
+	if (DeferredRender::GetRenderPassIsEmissive())
+	{
+		// only additive verts are full bright in the emissive buffer
+		if (additive)
+			pd3dDevice->SetRenderState(D3DRS_LIGHTING, FALSE);
+	}
+	else if (!DeferredRender::GetRenderPassIsShadow())
+	{
+		// use the vertex colors as is
+		pd3dDevice->SetRenderState(D3DRS_LIGHTING, FALSE);
+	}
+
+	for (int start = 0; start < vertCount; start += maxTexturedVerts)
+	{
+		const int count = Min(vertCount - start, int(maxTexturedVerts));
+		TexturedVertex* lockedVerts;
+		if (FAILED(primitiveTexturedTris.vb->Lock(0, count*sizeof(TexturedVertex), (VOID**)&lockedVerts, D3DLOCK_DISCARD)))
+			break;
+
+		memcpy(lockedVerts, verts + start, count*sizeof(TexturedVertex));
+		primitiveTexturedTris.vb->Unlock();
+		primitiveTexturedTris.primitiveCount = count / 3;
+		Render(Matrix44::Identity(), Color::White(), ti, primitiveTexturedTris);
+	}
+	
+	pd3dDevice->SetRenderState(D3DRS_LIGHTING, TRUE);
+}
+
 void FrankRender::DrawPolygon(const Vector2* vertices, int vertexCount, const DWORD color)
 {
 	const Vector2 startPos = vertices[0];
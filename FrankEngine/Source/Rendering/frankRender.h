@@ -105,6 +105,17 @@ public:	// lower level functions for fast rendering
 	void SetSimpleVertsAreAdditive(bool additive);
 	bool GetSimpleVertsAreAdditive() const			{ return simpleVertsAreAdditive; }
 
+	// textured verts with their own color, used to draw many quads in one call
+	struct TexturedVertex
+	{
+		Vector3 position;
+		DWORD color;
+		float u, v;
+	};
+
+	// draw a triangle list of textured verts, large lists are split into a few draws
+	void RenderTexturedTris(const TexturedVertex* verts, int vertCount, GameTextureID ti, bool additive);
+
 public:	// rendering functions
 
 	static Matrix44 GetScreenSpaceMatrix(float x, float y, float sx, float sy, float r = 0) 
@@ -508,6 +519,7 @@ private:
 	RenderPrimitive primitiveCube;
 	RenderPrimitive primitiveLines;
 	RenderPrimitive primitiveTris;
+	RenderPrimitive primitiveTexturedTris;
 	
 	LPDIRECT3DPIXELSHADER9 normalMapShader;
 	LPD3DXCONSTANTTABLE normalMapConstantTable;
@@ -537,6 +549,8 @@ private: // simple vert stuff
 	SimpleVertex simpleVertsTris[maxSimpleVerts];
 	int totalSimpleVertsRendered;
 	bool simpleVertsAreAdditive;
+
+	static const int maxTexturedVerts = 6*1000;
 };
 
 inline void FrankRender::AddPointToLineVerts(const Vector2& position, DWORD color)
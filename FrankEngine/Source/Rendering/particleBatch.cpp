@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Particle Batch
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../rendering/particleBatch.h"
+
+ParticleBatch g_particleBatch;
+
+bool ParticleBatch::enable = true;
+ConsoleCommand(ParticleBatch::enable, particleBatch);
+
+// draws buckets with the device
+class DeviceParticleBatchRenderer : public ParticleBatchRenderer
+{
+public:
+
+	virtual void RenderBucket(GameTextureID ti, bool additive, const FrankRender::TexturedVertex* verts, int vertCount)
+	{
+		g_render->RenderTexturedTris(verts, vertCount, ti, additive);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+ParticleBatch::ParticleBatch() :
+	bucketCount(0),
+	quadCount(0)
+{
+}
+
+int ParticleBatch::GetBucket(GameTextureID ti, bool additive)
+{
+	// most emitters use the same few textures so a short search is fine
+	for (int i = bucketCount - 1; i >= 0; --i)
+	{
+		const Bucket& bucket = buckets[i];
+		if (bucket.ti == ti && bucket.additive == additive)
+			return i;
+	}
+
+	// reuse old buckets so their verts stay allocated
+	if (bucketCount == (int)buckets.size())
+		buckets.push_back(Bucket());
+
+	Bucket& bucket = buckets[bucketCount];
+	bucket.ti = ti;
+	bucket.additive = additive;
+	bucket.vertCount = 0;
+	return bucketCount++;
+}
+
+void ParticleBatch::Render(ParticleBatchRenderer& renderer)
+{
+	for (int i = 0; i < bucketCount; ++i)
+	{
+		const Bucket& bucket = buckets[i];
+		if (bucket.vertCount > 0)
+			renderer.RenderBucket(bucket.ti, bucket.additive, &bucket.verts[0], bucket.vertCount);
+	}
+
+	Clear();
+}
+
+void ParticleBatch::Render()
+{
+	if (bucketCount == 0)
+		return;
+
+	FrankProfilerEntryDefine(L"ParticleBatch::Render()", Color::White(), 6);
+	DeviceParticleBatchRenderer renderer;
+	Render(renderer);
+}
+
+void ParticleBatch::Clear()
+{
+	for (int i = 0; i < bucketCount; ++i)
+		buckets[i].vertCount = 0;
+
+	bucketCount = 0;
+	quadCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Console commands
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+// counts what would have been drawn
+class CountingParticleBatchRenderer : public ParticleBatchRenderer
+{
+public:
+
+	CountingParticleBatchRenderer() : drawCount(0) {}
+
+	virtual void RenderBucket(GameTextureID ti, bool additive, const FrankRender::TexturedVertex* verts, int vertCount) { ++drawCount; }
+
+	int drawCount;
+};
+
+// headless test, builds verts for random particles and checks them against the quad primitive transform
+static void ConsoleCallback_particleBatchBenchmark(const wstring& text)
+{
+	int quadCount = 100000;
+	int textureCount = 4;
+	int repeatCount = 10;
+	swscanf_s(text.c_str(), L"%d %d %d", &quadCount, &textureCount, &repeatCount);
+	quadCount = Max(quadCount, 1);
+	textureCount = Max(textureCount, 1);
+	repeatCount = Max(repeatCount, 1);
+
+	vector<Vector2> positions(quadCount);
+	vector<float> angles(quadCount);
+	vector<float> sizes(quadCount);
+	vector<DWORD> colors(quadCount);
+	vector<GameTextureID> textures(quadCount);
+	vector<bool> additives(quadCount);
+	for (int i = 0; i < quadCount; ++i)
+	{
+		positions[i] = Vector2::BuildRandomInCircle(100);
+		angles[i] = RAND_ANGLE;
+		sizes[i] = RAND_BETWEEN(0.1f, 2.0f);
+		colors[i] = Color::White(RAND_BETWEEN(0.0f, 1.0f));
+		textures[i] = GameTextureID(GameTexture_Smoke + RAND_INT % textureCount);
+		additives[i] = (RAND_INT % 2) == 0;
+	}
+
+	// compare against the matrix RenderQuad would use
+	float maxError = 0;
+	{
+		const Vector2 corners[4] = { Vector2(-1, 1), Vector2(1, 1), Vector2(-1, -1), Vector2(1, -1) };
+		const int cornerVerts[4] = { 0, 1, 2, 5 };
+		FrankRender::TexturedVertex verts[6];
+		for (int i = 0; i < Min(quadCount, 1000); ++i)
+		{
+			ParticleBatch::BuildQuad(verts, positions[i], angles[i], sizes[i], colors[i]);
+			const Matrix44 matrix = Matrix44::BuildScale(Vector2(sizes[i])) * Matrix44(XForm2(positions[i], angles[i]));
+			for (int j = 0; j < 4; ++j)
+			{
+				const Vector2 expected = Vector2(matrix.TransformCoord(Vector3(corners[j])));
+				const Vector2 built = Vector2(verts[cornerVerts[j]].position);
+				maxError = Max(maxError, (expected - built).Length());
+			}
+		}
+	}
+
+	ParticleBatch batch;
+	CountingParticleBatchRenderer renderer;
+	CDXUTTimer timer;
+	timer.Start();
+	for (int r = 0; r < repeatCount; ++r)
+	{
+		// same pattern as emitters, one bucket lookup per run of quads
+		int bucket = -1;
+		for (int i = 0; i < quadCount; ++i)
+		{
+			if (i % 64 == 0)
+				bucket = batch.GetBucket(textures[i], additives[i]);
+			batch.AddQuad(bucket, positions[i], angles[i], sizes[i], colors[i]);
+		}
+		batch.Render(renderer);
+	}
+	const double time = timer.GetElapsedTime() / repeatCount;
+
+	GetDebugConsole().AddFormatted(L"Batched %d quads into %d draws in %.3f ms (%.1f ns per quad), max error %f",
+		quadCount, renderer.drawCount / repeatCount, 1000*time, 1e9*time / quadCount, maxError);
+}
+ConsoleCommand(ConsoleCallback_particleBatchBenchmark, particleBatchBenchmark);
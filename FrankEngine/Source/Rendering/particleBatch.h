@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Particle Batch
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- collects the visible particle quads of a render group into vertex arrays
+	- quads are bucketed by texture and additive blending, each bucket is one draw
+	- buckets are drawn in the order they were first used
+	- building verts never touches the device so it can be tested and timed headless
+	- the object manager renders the batch at the end of each render group
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PARTICLE_BATCH_H
+#define PARTICLE_BATCH_H
+
+#include <vector>
+
+// global particle batch singleton
+extern class ParticleBatch g_particleBatch;
+
+// receives each finished bucket when the batch is rendered
+class ParticleBatchRenderer
+{
+public:
+
+	virtual ~ParticleBatchRenderer() {}
+	virtual void RenderBucket(GameTextureID ti, bool additive, const FrankRender::TexturedVertex* verts, int vertCount) = 0;
+};
+
+class ParticleBatch : private Uncopyable
+{
+public:
+
+	ParticleBatch();
+
+	// get the bucket for a texture and blend mode, starting a new one if needed
+	int GetBucket(GameTextureID ti, bool additive);
+
+	// add a square quad the same way RenderQuad would draw it
+	void AddQuad(int bucket, const Vector2& pos, float angle, float size, DWORD color);
+
+	// send all the buckets to a renderer and clear them
+	void Render(ParticleBatchRenderer& renderer);
+
+	// draw all the buckets with the device
+	void Render();
+
+	// throw away everything without drawing it
+	void Clear();
+
+	int GetQuadCount() const		{ return quadCount; }
+	int GetBucketCount() const		{ return bucketCount; }
+
+	// write the 6 verts of a quad as a triangle list
+	static void BuildQuad(FrankRender::TexturedVertex* verts, const Vector2& pos, float angle, float size, DWORD color);
+
+	static bool enable;			// if false particles are drawn one quad at a time
+
+private:
+
+	struct Bucket
+	{
+		GameTextureID ti;
+		bool additive;
+		int vertCount;
+		vector<FrankRender::TexturedVertex> verts;	// only grows so buckets don't allocate every frame
+	};
+
+	vector<Bucket> buckets;
+	int bucketCount;
+	int quadCount;
+};
+
+inline void ParticleBatch::AddQuad(int b, const Vector2& pos, float angle, float size, DWORD color)
+{
+	ASSERT(b >= 0 && b < bucketCount);
+	Bucket& bucket = buckets[b];
+	if (bucket.vertCount + 6 > (int)bucket.verts.size())
+		bucket.verts.resize(Max(2*(int)bucket.verts.size(), 6*256));
+
+	BuildQuad(&bucket.verts[bucket.vertCount], pos, angle, size, color);
+	bucket.vertCount += 6;
+	++quadCount;
+}
+
+inline void ParticleBatch::BuildQuad(FrankRender::TexturedVertex* verts, const Vector2& pos, float angle, float size, DWORD color)
+{
+	// rotate the same way as Matrix44(XForm2)
+	const float c = size*cosf(angle);
+	const float s = size*sinf(angle);
+	const Vector2 right(c, s);
+	const Vector2 up(-s, c);
+
+	// corners and uvs match the quad primitive
+	const Vector2 topLeft = pos - right + up;
+	const Vector2 topRight = pos + right + up;
+	const Vector2 bottomLeft = pos - right - up;
+	const Vector2 bottomRight = pos + right - up;
+
+	verts[0].position = Vector3(topLeft.x, topLeft.y, 0);
+	verts[0].u = 0; verts[0].v = 0;
+	verts[1].position = Vector3(topRight.x, topRight.y, 0);
+	verts[1].u = 1; verts[1].v = 0;
+	verts[2].position = Vector3(bottomLeft.x, bottomLeft.y, 0);
+	verts[2].u = 0; verts[2].v = 1;
+	verts[3] = verts[2];
+	verts[4] = verts[1];
+	verts[5].position = Vector3(bottomRight.x, bottomRight.y, 0);
+	verts[5].u = 1; verts[5].v = 1;
+
+	for (int i = 0; i < 6; ++i)
+		verts[i].color = color;
+}
+
+#endif // PARTICLE_BATCH_H
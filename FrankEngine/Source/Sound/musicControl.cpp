@@ -13,19 +13,20 @@
 #include "../../../oggvorbis/vorbis/include/vorbis/vorbisfile.h"
 
 const DWORD MusicControl::bufferSize = 65536;
+const int MusicControl::decodeBufferSize = 4*65536;
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-// callbacks used to stream the file from mem
+// callbacks used to stream the file from mem or disk
 static long VorbisTell(void *datasource);
 static int VorbisClose(void *datasourc);
 static int VorbisSeek(void *datasource, ogg_int64_t offset, int whence);
 static size_t VorbisRead(void *ptr, size_t byteSize, size_t sizeToRead, void *datasource);
 static ov_callbacks vorbisCallbacks;
 
-// struct that contains the pointer to our file in memory
+// struct that contains the pointer to our file in memory or on disk
 
-static SOggFile oggMemoryFile;		// Data on the ogg file in memory
+static SOggFile oggOpenFile;		// Data on the ogg file being played
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -35,6 +36,11 @@ ConsoleCommand(MusicControl::musicEnable, musicEnable);
 float MusicControl::masterVolume = 0.8f;
 ConsoleCommand(MusicControl::masterVolume, musicVolume);
 
+int MusicControl::cacheSize = 32;
+ConsoleCommand(MusicControl::cacheSize, musicCacheSize);
+
+const int MusicControl::streamBufferSize = 65536;
+
 MusicControl::MusicControl() :
 	ds(NULL),
 	dsBuffer(NULL),
@@ -48,7 +54,9 @@ MusicControl::MusicControl() :
 	enableFrequencyScale(true),
 	frequencyScale(1.0f),
 	volumeScale(1.0f),
-	vf(new OggVorbis_File())
+	vf(new OggVorbis_File()),
+	decoder(decodeBufferSize),
+	loadedOggFilesSize(0)
 {
 	transitionVolumeScale = 1;
 }
@@ -60,7 +68,7 @@ MusicControl::~MusicControl()
 void MusicControl::ShutDown()
 {
 	if (fileOpened)
-		Close(oggMemoryFile);
+		Close(oggOpenFile);
 
 	for (list<SOggFile>::iterator it = loadedOggFiles.begin(); it != loadedOggFiles.end(); ++it)
 	{
@@ -70,6 +78,7 @@ void MusicControl::ShutDown()
 			delete [] oggFile.dataPtr;
 	}
 	loadedOggFiles.clear();
+	loadedOggFilesSize = 0;
 
 	SAFE_DELETE(vf);
 }
@@ -97,7 +106,11 @@ SOggFile* MusicControl::GetLoaded(WCHAR* filename)
 		SOggFile& oggFile = *it;
 
 		if (wcscmp(filename, oggFile.filename) == 0)
-			return &oggFile;
+		{
+			// move it to the front so it is the last to be thrown out
+			loadedOggFiles.splice(loadedOggFiles.begin(), loadedOggFiles, it);
+			return &loadedOggFiles.front();
+		}
 	}
 
 	return NULL;
@@ -113,20 +126,36 @@ bool MusicControl::Load(WCHAR* filename)
 	if (!LoadInternal(filename, oggFile))
 		return false;
 	oggFile.isPreLoaded = true;
-	loadedOggFiles.push_back(oggFile);
+	loadedOggFiles.push_front(oggFile);
+	loadedOggFilesSize += oggFile.dataSize;
+	TrimCache();
 
 	return true;
 }
 
+// throw out the least recently used files until the cache fits
+void MusicControl::TrimCache()
+{
+	const int maxSize = cacheSize * 1024 * 1024;
+	list<SOggFile>::iterator it = loadedOggFiles.end();
+	while (loadedOggFilesSize > maxSize && it != loadedOggFiles.begin())
+	{
+		--it;
+		SOggFile& oggFile = *it;
+		if (fileOpened && oggFile.dataPtr == oggOpenFile.dataPtr)
+			continue; // still playing
+
+		loadedOggFilesSize -= oggFile.dataSize;
+		delete [] oggFile.dataPtr;
+		it = loadedOggFiles.erase(it);
+	}
+}
+
 bool MusicControl::LoadInternal(WCHAR* filename, SOggFile& oggFile)
 {
 	// read the file into memory
 	FILE *f = NULL;
-		
-	char filenameChar[FILENAME_STRING_LENGTH];
-	wcstombs_s(NULL, filenameChar, FILENAME_STRING_LENGTH, filename, FILENAME_STRING_LENGTH);
-
-	fopen_s(&f, filenameChar, "rb");
+	_wfopen_s(&f, filename, L"rb");
 	if (!f)
 	{
 		g_debugMessageSystem.AddError(L"Could not find music file \"%s\"", filename);
@@ -137,28 +166,40 @@ bool MusicControl::LoadInternal(WCHAR* filename, SOggFile& oggFile)
 	wcsncpy_s(oggFile.filename, FILENAME_STRING_LENGTH, filename, FILENAME_STRING_LENGTH);
 
 	// find out how big the file is
-	int sizeOfFile = 0;
-	while (!feof(f))
-	{
-		getc(f);
-		++sizeOfFile;
-	}
+	fseek(f, 0, SEEK_END);
+	const int sizeOfFile = Max((int)ftell(f), 0);
+	fseek(f, 0, SEEK_SET);
 
-	// move the data into memory
+	// move the data into memory all at once
 	oggFile.dataPtr = new char[sizeOfFile];
-	rewind(f);
-	int i = 0;
-	while (!feof(f))
-		oggFile.dataPtr[i++] = getc(f);
-
-	// close the file
+	oggFile.dataSize = (int)fread(oggFile.dataPtr, 1, sizeOfFile, f);
 	fclose(f);
 
-	// Save the data in the ogg memory file because we need this when we are actually reading in the data
 	// We havnt read anything yet
 	oggFile.dataRead = 0;
-	// Save the size so we know how much we need to read
-	oggFile.dataSize = sizeOfFile;	
+	oggFile.file = NULL;
+	oggFile.isPreLoaded = false;
+	return true;
+}
+
+bool MusicControl::OpenStream(WCHAR* filename, SOggFile& oggFile)
+{
+	FILE *f = NULL;
+	_wfopen_s(&f, filename, L"rb");
+	if (!f)
+	{
+		g_debugMessageSystem.AddError(L"Could not find music file \"%s\"", filename);
+		return false;
+	}
+
+	// vorbis only asks for a few kb at a time so read bigger chunks from the disk
+	setvbuf(f, NULL, _IOFBF, streamBufferSize);
+
+	wcsncpy_s(oggFile.filename, FILENAME_STRING_LENGTH, filename, FILENAME_STRING_LENGTH);
+	oggFile.dataPtr = NULL;
+	oggFile.dataSize = 0;
+	oggFile.dataRead = 0;
+	oggFile.file = f;
 	oggFile.isPreLoaded = false;
 	return true;
 }
@@ -171,17 +212,18 @@ bool MusicControl::Open( WCHAR *filename )
 	wcsncpy_s(openFilename, filename, GameObjectStub::attributesLength);
 
 	if (fileOpened)
-		Close(oggMemoryFile);
+		Close(oggOpenFile);
 
 	{
+		// play from memory if it was preloaded, otherwise stream it from disk
 		SOggFile* oggFile = GetLoaded(filename);
 		if (oggFile)
 		{
-			oggMemoryFile = *oggFile;
+			oggOpenFile = *oggFile;
 		}
 		else
 		{
-			if (!LoadInternal(filename, oggMemoryFile))
+			if (!OpenStream(filename, oggOpenFile))
 				return false;
 		}
 	}
@@ -190,10 +232,13 @@ bool MusicControl::Open( WCHAR *filename )
 	vorbisCallbacks.close_func = VorbisClose;
 	vorbisCallbacks.seek_func = VorbisSeek;
 	vorbisCallbacks.tell_func = VorbisTell;
-	if (ov_open_callbacks(&oggMemoryFile, vf, NULL, 0, vorbisCallbacks) != 0)
+	if (ov_open_callbacks(&oggOpenFile, vf, NULL, 0, vorbisCallbacks) != 0)
 	{
-		delete [] oggMemoryFile.dataPtr;
-		oggMemoryFile.dataPtr = NULL;
+		// preloaded data stays in the cache
+		if (oggOpenFile.file)
+			fclose(oggOpenFile.file);
+		oggOpenFile.file = NULL;
+		oggOpenFile.dataPtr = NULL;
 		return false;
 	}
 
@@ -222,22 +267,16 @@ bool MusicControl::Open( WCHAR *filename )
 	desc.dwBufferBytes  = bufferSize*2;
 	ds->CreateSoundBuffer(&desc, &dsBuffer, NULL );
 
-	// fill the buffer
-	DWORD	pos = 0;
-	int		sec = 0;
-	int		ret = 1;
-	DWORD	size = bufferSize*2;
+	// decode the whole buffer and the next section now, the decode thread takes over after that
+	// don't loop yet or a short file would wrap around while priming, play turns looping on
+	decoder.Start(vf, false, 3*bufferSize);
 
+	// fill the buffer
+	DWORD size = bufferSize*2;
 	char *buf;
 	dsBuffer->Lock(0, size, (LPVOID*)&buf, &size, NULL, NULL, DSBLOCK_ENTIREBUFFER);
-
-	// now read in the bits
-	while (ret && pos<size)
-	{
-		ret = ov_read(vf, buf+pos, size-pos, 0, 2, 1, &sec);
-		pos += ret;
-	}
-
+	const int readSize = decoder.Read(buf, size);
+	memset(buf + readSize, 0, size - readSize);
 	dsBuffer->Unlock( buf, size, NULL, NULL );
 
 	curSection		= 0;
@@ -249,7 +288,7 @@ bool MusicControl::Open( WCHAR *filename )
 
 void MusicControl::Close()
 {
-	Close(oggMemoryFile);
+	Close(oggOpenFile);
 }
 
 void MusicControl::Close(SOggFile& oggFile)
@@ -258,12 +297,17 @@ void MusicControl::Close(SOggFile& oggFile)
 		return;
 
 	fileOpened = false;
+	decoder.Stop();
 	ov_clear(vf);
 
 	if (oggFile.dataPtr && !oggFile.isPreLoaded)
-	{
 		delete [] oggFile.dataPtr;
-		oggFile.dataPtr = NULL;
+	oggFile.dataPtr = NULL;
+
+	if (oggFile.file)
+	{
+		fclose(oggFile.file);
+		oggFile.file = NULL;
 	}
 
 	SAFE_RELEASE(dsBuffer);
@@ -279,6 +323,14 @@ static void ConsoleCommandCallback_musicPause(const wstring& text)
 }
 ConsoleCommand(ConsoleCommandCallback_musicPause, musicPause);
 
+static void ConsoleCommandCallback_musicStats(const wstring& text)
+{
+	const MusicControl& music = g_sound->GetMusicPlayer();
+	GetDebugConsole().AddFormatted(L"Music decoded %.0f ms ahead, %d underruns, %d files cached using %d kb.",
+		1000*music.GetDecodeAheadTime(), music.GetUnderrunCount(), music.GetCacheCount(), music.GetCacheSize() / 1024);
+}
+ConsoleCommand(ConsoleCommandCallback_musicStats, musicStats);
+
 void MusicControl::Pause( bool _pause )
 {
 	if (!dsBuffer || pause == _pause)
@@ -299,6 +351,7 @@ void MusicControl::Play( bool _loop )
 
 	pause = false;
 	loop = _loop;
+	decoder.SetLoop(loop);
 	done = false;
 	almostDone = false;
 	
@@ -330,7 +383,7 @@ void MusicControl::Update()
 		if (p == 0)
 		{
 			transitionTimer.Invalidate();
-			Close(oggMemoryFile);
+			Close(oggOpenFile);
 			transitionVolumeScale = 1;
 			if (transitionFilename[0] != 0)
 			{
@@ -385,46 +438,18 @@ void MusicControl::Update()
 		DWORD size = bufferSize;
 		char *buf;
 
-		// fill the section we just left
+		// fill the section we just left, the decode thread should already have it ready
 		dsBuffer->Lock( lastSection*bufferSize, size, (LPVOID*)&buf, &size, NULL, NULL, 0 );
-
-		DWORD	pos = 0;
-		int		sec = 0;
-		int		ret = 1;
-	            
-		while (ret && pos < size)
-		{
-			ret = ov_read(vf, buf+pos, size-pos, 0, 2, 1, &sec);
-			pos += ret;
-		}
-
-		// reached the and?
-		if (!ret && loop)
-		{
-			// we are looping so restart from the beginning
-			// NOTE: sound with sizes smaller than bufferSize may be cut off
-
-			ret = 1;
-			ov_pcm_seek(vf, 0);
-			while(ret && pos<size)
-			{
-				ret = ov_read(vf, buf+pos, size-pos, 0, 2, 1, &sec);
-				pos += ret;
-			}
-		}
-		else if (!ret && !loop)
+		const int readSize = decoder.Read(buf, size);
+		if (readSize < (int)size)
 		{
-			// not looping so fill the rest with 0
-			while (pos < size)
-			{
-				*(buf+pos)=0; 
-				pos++;
-			}
+			// fill the rest with 0, either it ran out or the decoder fell behind
+			memset(buf + readSize, 0, size - readSize);
 
 			// and say that after the current section no other sectin follows
-			almostDone = true;
+			if (decoder.IsFinished())
+				almostDone = true;
 		}
-	            
 		dsBuffer->Unlock( buf, size, NULL, NULL );
 
 		lastSection = curSection;
@@ -456,6 +481,10 @@ static size_t VorbisRead(void *ptr			/* ptr to the data that the vorbis files ne
 	// Get the data in the right format
 	vorbisData = (SOggFile*)datasource;
 
+	// streaming files read straight from the buffered file
+	if (vorbisData->file)
+		return fread(ptr, byteSize, sizeToRead, vorbisData->file);
+
 	// Calculate how much we need to read.  This can be sizeToRead*byteSize or less depending on how near the EOF marker we are
 	spaceToEOF = vorbisData->dataSize - vorbisData->dataRead;
 	if ((sizeToRead*byteSize) < spaceToEOF)
@@ -492,6 +521,9 @@ static int VorbisSeek(void *datasource	/*this is a pointer to the data we passed
 	// Get the data in the right format
 	vorbisData = (SOggFile*)datasource;
 
+	if (vorbisData->file)
+		return fseek(vorbisData->file, (long)offset, whence);
+
 	// Goto where we wish to seek to
 	switch (whence)
 	{
@@ -549,6 +581,9 @@ static long VorbisTell(void *datasource /*this is a pointer to the data we passe
 	// Get the data in the right format
 	vorbisData = (SOggFile*)datasource;
 
+	if (vorbisData->file)
+		return ftell(vorbisData->file);
+
 	// We just want to tell the vorbis libs how much we have read so far
 	return vorbisData->dataRead;
 }
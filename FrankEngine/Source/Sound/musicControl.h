@@ -4,6 +4,9 @@
 	Copyright 2013 Frank Force - http://www.frankforce.com
 
 	- simple music player using ogg vorbis
+	- decoding happens on a separate thread, the game thread only copies pcm into the sound buffer
+	- music streams from disk unless it was preloaded
+	- preloaded music is kept in a size capped cache, the least recently used is thrown out first
 
 	- directx portion adapted from Bjorn Paetzel's "Ogg Vorbis Player Class" example
 	- http://www.flipcode.com/archives/Ogg_Vorbis_Player_Class.shtml
@@ -16,6 +19,8 @@
 #ifndef MUSIC_CONTROL_H
 #define MUSIC_CONTROL_H
 
+#include "../sound/musicDecoder.h"
+
 typedef struct IDirectSound8		*LPDIRECTSOUND8;
 typedef struct IDirectSoundBuffer	*LPDIRECTSOUNDBUFFER;
 
@@ -25,6 +30,7 @@ struct SOggFile
 	char*		dataPtr;			// Pointer to the data in memoru
 	int			dataSize;			// Sizeo fo the data
 	int			dataRead;			// How much data we have read so far
+	FILE*		file;				// file to stream from when it is not in memory
 	bool		isPreLoaded;
 };
 
@@ -39,7 +45,10 @@ public:
 	void ShutDown();
 	void SetDirectSound( LPDIRECTSOUND8 _ds )		{ ds = _ds; }
 	
+	// get preloaded music and mark it as recently used
 	SOggFile* GetLoaded(WCHAR* filename);
+
+	// preload music into the cache so it doesn't need to stream from disk
 	bool Load(WCHAR* filename);
 
 	bool Open( WCHAR* filename );
@@ -52,7 +61,7 @@ public:
 
 	void Play( bool _loop = true );
 	bool IsPlaying() const							{ return !done; }
-	void SetLoop( bool _loop )						{ loop = _loop; }
+	void SetLoop( bool _loop )						{ loop = _loop; decoder.SetLoop(loop); }
 
 	void Pause( bool pause );
 	bool IsPaused() const							{ return pause; }
@@ -64,12 +73,24 @@ public:
 	void SetVolumeScale( float _volumeScale )		{ volumeScale = _volumeScale; }
 	float GetVolumeScale() const					{ return volumeScale; }
 
+	// how far ahead of playback the decode thread is
+	float GetDecodeAheadTime() const				{ return decoder.GetDecodeAheadTime(); }
+
+	// how many times the sound buffer needed more than was decoded
+	int GetUnderrunCount() const					{ return decoder.GetUnderrunCount(); }
+
+	int GetCacheCount() const						{ return loadedOggFiles.size(); }
+	int GetCacheSize() const						{ return loadedOggFilesSize; }
+
 	static bool musicEnable;
 	static float masterVolume;
+	static int cacheSize;			// megabytes of preloaded music to keep around
 
 protected:
 	
 	bool LoadInternal(WCHAR* filename, SOggFile& oggFile);
+	bool OpenStream(WCHAR* filename, SOggFile& oggFile);
+	void TrimCache();
 	void Stop();  
 
 	bool almostDone;				// only one half of the buffer to play
@@ -87,7 +108,10 @@ protected:
 	LPDIRECTSOUND8 ds;				// the directsound 8 object
 	LPDIRECTSOUNDBUFFER dsBuffer;	// the buffer
 	static const DWORD bufferSize;	// how big is the buffer
+	static const int streamBufferSize;	// how much is read from disk at a time when streaming
+	static const int decodeBufferSize;	// how far ahead music can be decoded
 	struct OggVorbis_File* vf;		// for the vorbisfile interface
+	MusicDecoder decoder;			// decodes vf on its own thread
 
 	WCHAR transitionFilename[GameObjectStub::attributesLength];
 	WCHAR openFilename[GameObjectStub::attributesLength];
@@ -96,7 +120,8 @@ protected:
 	float transitionTime;
 	float transitionVolumeScale;
 
-	list<SOggFile> loadedOggFiles;
+	list<SOggFile> loadedOggFiles;	// most recently used first
+	int loadedOggFilesSize;			// bytes used by all the loaded files
 };
 
 #endif // MUSIC_CONTROL_H
\ No newline at end of file
@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Music Decoder
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../sound/musicDecoder.h"
+#include <process.h>
+
+#include "../../../oggvorbis/vorbis/include/vorbis/codec.h"
+#include "../../../oggvorbis/vorbis/include/vorbis/vorbisfile.h"
+
+const int MusicDecoder::decodeChunkSize = 4096;
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+PcmRingBuffer::PcmRingBuffer(int size) :
+	buffer(new BYTE[size]),
+	capacity(size),
+	readPosition(0),
+	writePosition(0)
+{
+	ASSERT(size > 0 && (size & (size - 1)) == 0); // size must be a power of 2
+}
+
+PcmRingBuffer::~PcmRingBuffer()
+{
+	delete [] buffer;
+}
+
+int PcmRingBuffer::Write(const void* data, int size)
+{
+	size = Min(size, GetWriteSize());
+	if (size <= 0)
+		return 0;
+
+	// copy in up to 2 pieces if it wraps around the end
+	const int start = (ULONG)writePosition & (capacity - 1);
+	const int firstSize = Min(size, capacity - start);
+	memcpy(buffer + start, data, firstSize);
+	memcpy(buffer, (const BYTE*)data + firstSize, size - firstSize);
+
+	// the data must be there before the reader can see it
+	InterlockedExchange(&writePosition, (LONG)((ULONG)writePosition + size));
+	return size;
+}
+
+int PcmRingBuffer::Read(void* data, int size)
+{
+	size = Min(size, GetReadSize());
+	if (size <= 0)
+		return 0;
+
+	const int start = (ULONG)readPosition & (capacity - 1);
+	const int firstSize = Min(size, capacity - start);
+	memcpy(data, buffer + start, firstSize);
+	memcpy((BYTE*)data + firstSize, buffer, size - firstSize);
+
+	// the data must be copied out before the writer can reuse the space
+	InterlockedExchange(&readPosition, (LONG)((ULONG)readPosition + size));
+	return size;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+MusicDecoder::MusicDecoder(int ringBufferSize) :
+	ringBuffer(ringBufferSize),
+	vf(NULL),
+	loop(false),
+	endOfStream(false),
+	decodedSinceSeek(false),
+	bytesPerSecond(0),
+	underrunCount(0),
+	chunkBuffer(new char[decodeChunkSize]),
+	thread(NULL),
+	stopThread(false)
+{
+	wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	InitializeCriticalSection(&decodeLock);
+}
+
+MusicDecoder::~MusicDecoder()
+{
+	ASSERT(!vf); // stop before the file is cleared
+
+	if (thread)
+	{
+		stopThread = true;
+		SetEvent(wakeEvent);
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+
+	CloseHandle(wakeEvent);
+	DeleteCriticalSection(&decodeLock);
+	delete [] chunkBuffer;
+}
+
+void MusicDecoder::Start(OggVorbis_File* _vf, bool _loop, int primeBytes)
+{
+	ASSERT(_vf);
+	Stop();
+
+	EnterCriticalSection(&decodeLock);
+	vf = _vf;
+	loop = _loop;
+	endOfStream = false;
+	decodedSinceSeek = false;
+
+	const vorbis_info* vi = ov_info(vf, -1);
+	bytesPerSecond = vi? 2 * vi->channels * vi->rate : 0;
+
+	// get the start ready now so it can play right away
+	primeBytes = Min(primeBytes, ringBuffer.GetCapacity());
+	while (ringBuffer.GetReadSize() < primeBytes && DecodeChunk()) {}
+	LeaveCriticalSection(&decodeLock);
+
+	if (!thread)
+	{
+		// music must keep up even when the game is busy
+		thread = (HANDLE)_beginthreadex(NULL, 0, DecodeThreadEntry, this, 0, NULL);
+		if (thread)
+			SetThreadPriority(thread, THREAD_PRIORITY_ABOVE_NORMAL);
+	}
+	SetEvent(wakeEvent);
+}
+
+void MusicDecoder::Stop()
+{
+	// waits for the chunk being decoded to finish
+	EnterCriticalSection(&decodeLock);
+	vf = NULL;
+	endOfStream = false;
+	ringBuffer.Clear();
+	LeaveCriticalSection(&decodeLock);
+}
+
+void MusicDecoder::SetLoop(bool _loop)
+{
+	if (loop == _loop)
+		return;
+
+	EnterCriticalSection(&decodeLock);
+	loop = _loop;
+	if (loop && endOfStream && vf)
+	{
+		// it already decoded the end so start again from the beginning
+		ov_pcm_seek(vf, 0);
+		decodedSinceSeek = false;
+		endOfStream = false;
+	}
+	LeaveCriticalSection(&decodeLock);
+	SetEvent(wakeEvent);
+}
+
+int MusicDecoder::Read(void* data, int size)
+{
+	// check the end first, if it was set everything is already in the buffer
+	const bool wasEndOfStream = endOfStream;
+	const int readSize = ringBuffer.Read(data, size);
+	if (readSize < size && !wasEndOfStream && vf)
+		++underrunCount;
+
+	// let the decoder fill the space back up
+	SetEvent(wakeEvent);
+	return readSize;
+}
+
+// decode one chunk into the ring buffer, returns false if there is nothing to do
+// must be called with the decode lock
+bool MusicDecoder::DecodeChunk()
+{
+	if (!vf || endOfStream || ringBuffer.GetWriteSize() < decodeChunkSize)
+		return false;
+
+	int section = 0;
+	const long size = ov_read(vf, chunkBuffer, decodeChunkSize, 0, 2, 1, &section);
+	if (size > 0)
+	{
+		decodedSinceSeek = true;
+		ringBuffer.Write(chunkBuffer, size);
+		return true;
+	}
+	else if (size == OV_HOLE)
+	{
+		// corrupt data was skipped, keep going
+		return true;
+	}
+	else if (size == 0 && loop && decodedSinceSeek)
+	{
+		// reached the end so start again from the beginning
+		ov_pcm_seek(vf, 0);
+		decodedSinceSeek = false;
+		return true;
+	}
+
+	endOfStream = true;
+	return false;
+}
+
+unsigned __stdcall MusicDecoder::DecodeThreadEntry(void* data)
+{
+	static_cast<MusicDecoder*>(data)->DecodeThread();
+	return 0;
+}
+
+void MusicDecoder::DecodeThread()
+{
+	while (!stopThread)
+	{
+		EnterCriticalSection(&decodeLock);
+		const bool decoded = DecodeChunk();
+		LeaveCriticalSection(&decodeLock);
+
+		// sleep until there is room in the buffer, the timeout is just in case
+		if (!decoded)
+			WaitForSingleObject(wakeEvent, 100);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Console commands
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+// headless test, decodes a file on the decode thread and compares it to decoding it directly
+static void ConsoleCallback_musicDecodeTest(const wstring& text)
+{
+	WCHAR filename[FILENAME_STRING_LENGTH] = L"testMusic.ogg";
+	int readSize = 16384;
+	swscanf_s(text.c_str(), L"%s %d", filename, FILENAME_STRING_LENGTH, &readSize);
+	readSize = Max(readSize, 1);
+
+	char filenameChar[FILENAME_STRING_LENGTH];
+	wcstombs_s(NULL, filenameChar, FILENAME_STRING_LENGTH, filename, FILENAME_STRING_LENGTH);
+
+	OggVorbis_File vf;
+	if (ov_fopen(filenameChar, &vf) != 0)
+	{
+		GetDebugConsole().AddFormatted(L"Could not open music file \"%s\".", filename);
+		return;
+	}
+
+	// decode the whole thing on this thread
+	CDXUTTimer timer;
+	timer.Start();
+	vector<char> expected;
+	{
+		vector<char> chunk(MusicDecoder::decodeChunkSize);
+		int section = 0;
+		long size = 0;
+		while ((size = ov_read(&vf, &chunk[0], (int)chunk.size(), 0, 2, 1, &section)) != 0)
+		{
+			if (size > 0)
+				expected.insert(expected.end(), chunk.begin(), chunk.begin() + size);
+			else if (size != OV_HOLE)
+				break;
+		}
+	}
+	const double directTime = timer.GetElapsedTime();
+
+	// read it back out through the decode thread as fast as possible
+	ov_pcm_seek(&vf, 0);
+	MusicDecoder decoder(1 << 18);
+	vector<char> decoded;
+	vector<char> readBuffer(readSize);
+	int maxDecodeAhead = 0;
+	timer.Start();
+	decoder.Start(&vf, false);
+	while (!decoder.IsFinished())
+	{
+		maxDecodeAhead = Max(maxDecodeAhead, decoder.GetDecodeAheadBytes());
+		const int size = decoder.Read(&readBuffer[0], readSize);
+		decoded.insert(decoded.end(), readBuffer.begin(), readBuffer.begin() + size);
+		if (size == 0)
+			SwitchToThread();
+	}
+	const double threadTime = timer.GetElapsedTime();
+	const int underrunCount = decoder.GetUnderrunCount();
+	decoder.Stop();
+	ov_clear(&vf);
+
+	const bool match = decoded.size() == expected.size() && (expected.empty() || memcmp(&decoded[0], &expected[0], expected.size()) == 0);
+	GetDebugConsole().AddFormatted(L"Decoded %d bytes directly in %.3f ms, on the decode thread in %.3f ms, max decode ahead %d bytes, %d underruns, %s",
+		(int)expected.size(), 1000*directTime, 1000*threadTime, maxDecodeAhead, underrunCount, match? L"output matches" : L"OUTPUT DOES NOT MATCH");
+}
+ConsoleCommand(ConsoleCallback_musicDecodeTest, musicDecodeTest);
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Music Decoder
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- decodes ogg vorbis music on its own thread so the game thread never calls ov_read
+	- decoded pcm goes into a single producer single consumer lock free ring buffer
+	- the output side only copies out of the ring buffer
+	- looping is handled while decoding so there is no gap or cut off at the end
+	- counts underruns for when the output needs more than has been decoded
+	- does not use directsound so it can be tested headless
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef MUSIC_DECODER_H
+#define MUSIC_DECODER_H
+
+// lock free ring buffer for one writing thread and one reading thread
+class PcmRingBuffer : private Uncopyable
+{
+public:
+
+	// size must be a power of 2
+	explicit PcmRingBuffer(int size);
+	~PcmRingBuffer();
+
+	// copy in as much as fits, returns how many bytes were written, only call from the writing thread
+	int Write(const void* data, int size);
+
+	// copy out as much as is there, returns how many bytes were read, only call from the reading thread
+	int Read(void* data, int size);
+
+	// throw away everything, neither side can be using the buffer
+	void Clear() { readPosition = writePosition = 0; }
+
+	int GetReadSize() const		{ return (int)((ULONG)writePosition - (ULONG)readPosition); }
+	int GetWriteSize() const	{ return capacity - GetReadSize(); }
+	int GetCapacity() const		{ return capacity; }
+
+private:
+
+	BYTE* buffer;
+	int capacity;
+	volatile LONG readPosition;		// total bytes read, wraps around
+	volatile LONG writePosition;	// total bytes written, wraps around
+};
+
+class MusicDecoder : private Uncopyable
+{
+public:
+
+	// ring buffer size is how far ahead the decoder can get, must be a power of 2
+	explicit MusicDecoder(int ringBufferSize);
+	~MusicDecoder();
+
+	// start decoding an opened file, it belongs to the decoder until Stop is called
+	// decodes up to prime bytes on the calling thread so there is something to play right away
+	void Start(struct OggVorbis_File* vf, bool loop, int primeBytes = 0);
+
+	// stop decoding and throw away anything left, the file can be cleared after this
+	void Stop();
+
+	// copy out decoded pcm, returns how many bytes were copied, only call from one thread
+	int Read(void* data, int size);
+
+	// change if the music should loop, can restart music that already reached the end
+	void SetLoop(bool loop);
+
+	// true when the end was reached without looping and everything was read
+	bool IsFinished() const				{ return endOfStream && ringBuffer.GetReadSize() == 0; }
+	bool IsStarted() const				{ return vf != NULL; }
+
+	// how much has been decoded ahead of what was read
+	int GetDecodeAheadBytes() const		{ return ringBuffer.GetReadSize(); }
+	float GetDecodeAheadTime() const	{ return bytesPerSecond > 0? GetDecodeAheadBytes() / float(bytesPerSecond) : 0; }
+
+	// how many times a read came up short before the end
+	int GetUnderrunCount() const		{ return underrunCount; }
+
+	static const int decodeChunkSize;	// how much is decoded at a time
+
+private:
+
+	bool DecodeChunk();
+	void DecodeThread();
+	static unsigned __stdcall DecodeThreadEntry(void* data);
+
+	PcmRingBuffer ringBuffer;
+	struct OggVorbis_File* volatile vf;
+	volatile bool loop;
+	volatile bool endOfStream;		// set by the decoder when there is nothing more to decode
+	bool decodedSinceSeek;			// so a file with no data can't loop forever
+	int bytesPerSecond;
+	int underrunCount;
+	char* chunkBuffer;			// where each chunk is decoded before going into the ring buffer
+
+	HANDLE thread;
+	HANDLE wakeEvent;				// signaled when there is something for the decoder to do
+	CRITICAL_SECTION decodeLock;	// held while decoding, so starting and stopping wait for it
+	volatile bool stopThread;
+};
+
+#endif // MUSIC_DECODER_H
@@ -8,13 +8,15 @@
 #include "frankEngine.h"
 #include "../terrain/terrainSurface.h"
 #include "../terrain/terrain.h"
+#include "../terrain/terrainGenerator.h"
 #include "../editor/objectEditor.h"
 #include <fstream>
+#include <process.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
 // terrain settings
-int Terrain::dataVersion			= 11;
+int Terrain::dataVersion			= 12;
 int Terrain::fullSize				= 20;				// how many patches per terrain
 int Terrain::patchSize				= 16;				// how many tiles per patch
 int Terrain::patchLayers			= 2;				// how many layers per patch
@@ -48,6 +50,9 @@ bool Terrain::usePolyPhysics = true;
 // combine physics of tiles to reduce proxies
 bool Terrain::combineTileShapes = true;
 
+// add patch physics to the broadphase as one subtree
+bool Terrain::bulkPhysicsProxies = true;
+
 // stream a window around the player
 bool Terrain::enableStreaming = true;
 static bool streamDebug = false;
@@ -65,6 +70,7 @@ ConsoleCommand(Terrain::restitution, terrainRestitution);
 ConsoleCommand(Terrain::friction, terrainFriction);
 ConsoleCommand(Terrain::usePolyPhysics, terrainPolyPhysics);
 ConsoleCommand(Terrain::combineTileShapes, combineTileShapes);
+ConsoleCommand(Terrain::bulkPhysicsProxies, terrainBulkPhysicsProxies);
 ConsoleCommand(Terrain::enableStreaming, enableStreaming);
 ConsoleCommand(Terrain::maxProxies, maxTerrainProxies);
 ConsoleCommand(streamDebug, streamDebug);
@@ -75,7 +81,9 @@ Terrain::Terrain(const Vector2& pos) :
 	GameObject(XForm2(pos)),
 	streamWindowPatch(0, 0),
 	streamWindowPatchLast(0, 0),
-	streamWindow(Vector2::Zero(), Vector2::Zero())
+	streamWindow(Vector2::Zero(), Vector2::Zero()),
+	saveThread(NULL),
+	saveJob(NULL)
 {
 	playerEditorStartPos = Vector2(0);
 	SetRenderGroup(0); // terrain is on render 0
@@ -106,6 +114,8 @@ Terrain::Terrain(const Vector2& pos) :
 
 Terrain::~Terrain()
 {
+	WaitForSave();
+
 	for(int x=0; x<fullSize; ++x)
 	for(int y=0; y<fullSize; ++y)
 		delete GetPatch(x,y);
@@ -182,6 +192,15 @@ void Terrain::UpdateActiveWindow(bool init)
 		}
 	}
 
+	if (g_terrainGenerator)
+	{
+		// fill in empty patches before they become active
+		if (enableStreaming)
+			g_terrainGenerator->UpdateWindow(streamWindowPatch);
+		else if (init)
+			g_terrainGenerator->GenerateArea(IntVector2(0), IntVector2(fullSize - 1));
+	}
+
 	if (enableStreaming)
 	{
 		// make physics in the current window active
@@ -349,72 +368,279 @@ void Terrain::Convert()
 	outTerrainFile.close();
 }*/
 
-void Terrain::Save(const WCHAR* filename)
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Terrain Saving
+
+	File layout for the current data version...
+	- header: version, player start pos, fullSize, patchSize, patchLayers, start handle
+	- patch index: offset and size of each patch block, indexed by x + fullSize * y
+	- patch blocks: tile data followed by the stub count and stubs
+
+	Patches that have not changed since the last save or load are copied over
+	from the previous file byte for byte, only the changed patches get serialized.
+	The new file is written to a temp file on a background thread and then
+	renamed over the old one so a partially written terrain file is never seen.
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+struct TerrainPatchIndexEntry
 {
-	ofstream outTerrainFile(filename, ios::out | ios::binary);
-	if (outTerrainFile.fail())
+	unsigned int offset;
+	unsigned int size;
+};
+
+struct TerrainPatchSnapshot
+{
+	TerrainPatchSnapshot() : saved(false) {}
+
+	bool saved;						// if this patch is serialized, otherwise it is copied from the old file
+	vector<TerrainTile> tiles;
+	list<GameObjectStub> objectStubs;
+};
+
+struct TerrainSaveJob
+{
+	TerrainSaveJob() : incremental(false), succeeded(false) {}
+
+	void Run();
+	bool ReadPreviousFile(vector<BYTE>& fileData, vector<TerrainPatchIndexEntry>& patchIndex) const;
+	static void SerializePatch(const TerrainPatchSnapshot& patch, vector<BYTE>& data);
+
+	wstring filename;
+	bool incremental;						// if clean patches should be copied from the existing file
+	bool succeeded;
+	vector<BYTE> header;
+	vector<TerrainPatchSnapshot> patches;
+};
+
+static unsigned __stdcall TerrainSaveThread(void* data)
+{
+	static_cast<TerrainSaveJob*>(data)->Run();
+	return 0;
+}
+
+void TerrainSaveJob::SerializePatch(const TerrainPatchSnapshot& patch, vector<BYTE>& data)
+{
+	data.resize(patch.tiles.size() * sizeof(TerrainTile) + sizeof(unsigned int));
+	BYTE* dataPointer = &data[0];
+
+	// tile data
+	memcpy(dataPointer, &patch.tiles[0], patch.tiles.size() * sizeof(TerrainTile));
+	dataPointer += patch.tiles.size() * sizeof(TerrainTile);
+
+	// object stubs
+	const unsigned int stubCount = patch.objectStubs.size();
+	memcpy(dataPointer, &stubCount, sizeof(stubCount));
+	for (list<GameObjectStub>::const_iterator it = patch.objectStubs.begin(); it != patch.objectStubs.end(); ++it) 
+	{       
+		const GameObjectStub& stub = *it;
+		const int attributesLength = strlen(stub.attributes) + 1;
+		const int start = data.size();
+		data.resize(start + sizeof(stub.type) + sizeof(stub.xf) + sizeof(stub.size) + sizeof(stub.handle) + sizeof(attributesLength) + attributesLength);
+
+		dataPointer = &data[start];
+		memcpy(dataPointer, &stub.type,			sizeof(stub.type));			dataPointer += sizeof(stub.type);
+		memcpy(dataPointer, &stub.xf,			sizeof(stub.xf));			dataPointer += sizeof(stub.xf);
+		memcpy(dataPointer, &stub.size,			sizeof(stub.size));			dataPointer += sizeof(stub.size);
+		memcpy(dataPointer, &stub.handle,		sizeof(stub.handle));		dataPointer += sizeof(stub.handle);
+		memcpy(dataPointer, &attributesLength,	sizeof(attributesLength));	dataPointer += sizeof(attributesLength);
+		memcpy(dataPointer, stub.attributes,	attributesLength);
+	}
+}
+
+bool TerrainSaveJob::ReadPreviousFile(vector<BYTE>& fileData, vector<TerrainPatchIndexEntry>& patchIndex) const
+{
+	ifstream inTerrainFile(filename.c_str(), ios::in | ios::binary | ios::ate);
+	if (inTerrainFile.fail())
+		return false;
+
+	const int fileSize = (int)inTerrainFile.tellg();
+	const int indexSize = patches.size() * sizeof(TerrainPatchIndexEntry);
+	if (fileSize < (int)header.size() + indexSize)
+		return false;
+
+	fileData.resize(fileSize);
+	inTerrainFile.seekg(0);
+	inTerrainFile.read((char*)&fileData[0], fileSize);
+	if (inTerrainFile.fail())
+		return false;
+
+	// the version and sizes must match, the player pos and start handle may differ
+	const int sizesStart = 1 + 2*sizeof(float);
+	const int sizesLength = 3*sizeof(int);
+	if (fileData[0] != header[0] || memcmp(&fileData[sizesStart], &header[sizesStart], sizesLength))
+		return false;
+
+	patchIndex.resize(patches.size());
+	memcpy(&patchIndex[0], &fileData[header.size()], indexSize);
+	for (vector<TerrainPatchIndexEntry>::const_iterator it = patchIndex.begin(); it != patchIndex.end(); ++it)
+	{
+		if (it->offset + it->size > (unsigned int)fileSize)
+			return false;
+	}
+
+	return true;
+}
+
+void TerrainSaveJob::Run()
+{
+	// everything this does must be thread safe, only the snapshot and files are touched here
+	succeeded = false;
+
+	vector<BYTE> previousFile;
+	vector<TerrainPatchIndexEntry> previousIndex;
+	if (incremental && !ReadPreviousFile(previousFile, previousIndex))
 		return;
 
-	// write out the data version
-	const char version = (char)(dataVersion);
-	outTerrainFile.write(&version, 1);
+	const wstring tempFilename = filename + L".tmp";
+	ofstream outTerrainFile(tempFilename.c_str(), ios::out | ios::binary);
+	if (outTerrainFile.fail())
+		return;
 
-	// save player position
-	playerEditorStartPos = g_gameControlBase->GetPlayer()? g_gameControlBase->GetPlayer()->GetPosWorld() : Vector2(0);
-	outTerrainFile.write((const char *)&playerEditorStartPos.x,	sizeof(float));
-	outTerrainFile.write((const char *)&playerEditorStartPos.y,	sizeof(float));
-	
-	outTerrainFile.write((const char *)&fullSize, sizeof(fullSize));
-	outTerrainFile.write((const char *)&patchSize, sizeof(patchSize));
-	outTerrainFile.write((const char *)&patchLayers, sizeof(patchLayers));
+	outTerrainFile.write((const char *)&header[0], header.size());
 
-	// save the next handle
-	outTerrainFile.write((const char *)&startHandle, sizeof(startHandle));
+	// write a blank index for now, it gets filled in after the blocks are written
+	vector<TerrainPatchIndexEntry> patchIndex(patches.size());
+	const streamoff indexStart = outTerrainFile.tellp();
+	outTerrainFile.write((const char *)&patchIndex[0], patchIndex.size() * sizeof(TerrainPatchIndexEntry));
 
-	for(int x=0; x<fullSize; ++x)
-	for(int y=0; y<fullSize; ++y)
+	vector<BYTE> patchData;
+	for (unsigned int i = 0; i < patches.size(); ++i)
 	{
-		const TerrainPatch& patch = *GetPatch(x,y);
-		
-		// fast write out the tile data
-		outTerrainFile.write((const char *)patch.tiles, sizeof(TerrainTile) * patchSize * patchSize * patchLayers);
+		TerrainPatchIndexEntry& entry = patchIndex[i];
+		entry.offset = (unsigned int)outTerrainFile.tellp();
 
-		// separate write out the tile data
-		/*for(int l=0; l<patchLayers; ++l)
-		for(int j=0; j<patchSize; ++j)
-		for(int k=0; k<patchSize; ++k)
+		if (patches[i].saved)
+		{
+			SerializePatch(patches[i], patchData);
+			outTerrainFile.write((const char *)&patchData[0], patchData.size());
+			entry.size = patchData.size();
+		}
+		else
 		{
-			const TerrainTile& tile = patch.GetTileLocal(j, k, l);
+			const TerrainPatchIndexEntry& previousEntry = previousIndex[i];
+			outTerrainFile.write((const char *)&previousFile[previousEntry.offset], previousEntry.size);
+			entry.size = previousEntry.size;
+		}
+	}
 
-			outTerrainFile << tile.GetEdgeData();
-			outTerrainFile << tile.GetSurfaceData(0);
-			outTerrainFile << tile.GetSurfaceData(1);
-			outTerrainFile << tile.GetTileSet();
-		}*/
+	outTerrainFile.seekp(indexStart);
+	outTerrainFile.write((const char *)&patchIndex[0], patchIndex.size() * sizeof(TerrainPatchIndexEntry));
+	outTerrainFile.close();
 
-		// save out the object stubs
-		unsigned int stubCount = patch.objectStubs.size();
-		outTerrainFile.write((const char *)&stubCount, sizeof(stubCount));
-		for (list<GameObjectStub>::const_iterator it = patch.objectStubs.begin(); it != patch.objectStubs.end(); ++it) 
-		{       
-			const GameObjectStub& stub = *it;
+	if (outTerrainFile.fail() || !MoveFileEx(tempFilename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		DeleteFile(tempFilename.c_str());
+		return;
+	}
+
+	succeeded = true;
+}
+
+void Terrain::Save(const WCHAR* filename)
+{
+	// only one save can be in flight at a time
+	WaitForSave();
 
-			outTerrainFile.write((const char *)&stub.type,		sizeof(stub.type));
-			outTerrainFile.write((const char *)&stub.xf,		sizeof(stub.xf));
-			outTerrainFile.write((const char *)&stub.size,		sizeof(stub.size));
-			outTerrainFile.write((const char *)&stub.handle,	sizeof(stub.handle));
+	TerrainSaveJob* job = new TerrainSaveJob;
+	job->filename = filename;
+	job->incremental = (savedFilename == filename);
 
-			int attributesLength = strlen(stub.attributes) + 1;
-			outTerrainFile.write((const char *)&attributesLength, sizeof(attributesLength));
-			outTerrainFile.write((const char *)&stub.attributes, attributesLength);
+	// build the header
+	playerEditorStartPos = g_gameControlBase->GetPlayer()? g_gameControlBase->GetPlayer()->GetPosWorld() : Vector2(0);
+	const char version = (char)(dataVersion);
+	job->header.push_back(version);
+	job->header.insert(job->header.end(), (const BYTE*)&playerEditorStartPos.x, (const BYTE*)&playerEditorStartPos.x + sizeof(float));
+	job->header.insert(job->header.end(), (const BYTE*)&playerEditorStartPos.y, (const BYTE*)&playerEditorStartPos.y + sizeof(float));
+	job->header.insert(job->header.end(), (const BYTE*)&fullSize, (const BYTE*)&fullSize + sizeof(fullSize));
+	job->header.insert(job->header.end(), (const BYTE*)&patchSize, (const BYTE*)&patchSize + sizeof(patchSize));
+	job->header.insert(job->header.end(), (const BYTE*)&patchLayers, (const BYTE*)&patchLayers + sizeof(patchLayers));
+	job->header.insert(job->header.end(), (const BYTE*)&startHandle, (const BYTE*)&startHandle + sizeof(startHandle));
+
+	// snapshot the patches that need to be serialized
+	const int tileCount = patchSize * patchSize * patchLayers;
+	job->patches.resize(fullSize * fullSize);
+	for (int i = 0; i < fullSize * fullSize; ++i)
+	{
+		TerrainPatch& patch = *patches[i];
+		if (job->incremental && !patch.needsSave)
+			continue;
+
+		TerrainPatchSnapshot& snapshot = job->patches[i];
+		snapshot.saved = true;
+		snapshot.tiles.assign(patch.tiles, patch.tiles + tileCount);
+		snapshot.objectStubs = patch.objectStubs;
+		patch.needsSave = false;
+	}
+
+	savedFilename = filename;
+	saveJob = job;
+	saveThread = (HANDLE)_beginthreadex(NULL, 0, TerrainSaveThread, job, 0, NULL);
+	if (!saveThread)
+	{
+		// fall back to saving right now if the thread could not be created
+		job->Run();
+		FinishSave();
+	}
+}
+
+void Terrain::WaitForSave()
+{
+	if (!saveThread)
+		return;
+
+	WaitForSingleObject(saveThread, INFINITE);
+	CloseHandle(saveThread);
+	saveThread = NULL;
+	FinishSave();
+}
+
+void Terrain::UpdateSave()
+{
+	// check if the background save has finished
+	if (saveThread && WaitForSingleObject(saveThread, 0) == WAIT_OBJECT_0)
+		WaitForSave();
+}
+
+void Terrain::FinishSave()
+{
+	ASSERT(saveJob);
+	if (!saveJob->succeeded)
+	{
+		// put back the flags for what was not saved and do a full save next time
+		for (unsigned int i = 0; i < saveJob->patches.size(); ++i)
+		{
+			if (saveJob->patches[i].saved)
+				patches[i]->needsSave = true;
 		}
+		savedFilename.clear();
+		g_debugMessageSystem.AddError(L"Failed to save terrain file '%s'.", saveJob->filename.c_str());
 	}
 
-	outTerrainFile.close();
+	SAFE_DELETE(saveJob);
+}
+
+void Terrain::SetNeedsSave()
+{
+	for (int i = 0; i < fullSize * fullSize; ++i)
+		patches[i]->needsSave = true;
+}
+
+void Terrain::SetNeedsSave(const Box2AABB& _box)
+{
+	const Box2AABB box = _box.SortBounds();
+	const IntVector2 offset0 = GetPatchOffset(box.lowerBound);
+	const IntVector2 offset1 = GetPatchOffset(box.upperBound);
+	for (int x = Max(offset0.x, 0); x <= Min(offset1.x, fullSize-1); ++x)
+	for (int y = Max(offset0.y, 0); y <= Min(offset1.y, fullSize-1); ++y)
+		GetPatch(x, y)->needsSave = true;
 }
 
 void Terrain::Load(const WCHAR* filename)
 {
+	// make sure we don't read a file that is still being saved
+	WaitForSave();
 	g_editor.ResetEditor();
 
 	ifstream inTerrainFile(filename, ios::in | ios::binary);
@@ -429,7 +655,8 @@ void Terrain::Load(const WCHAR* filename)
 	char version;
 	inTerrainFile.read(&version, 1);
 
-	if (version != dataVersion)
+	const bool isIndexed = (version == dataVersion);
+	if (!isIndexed && version != legacyDataVersion)
 	{
 		g_debugMessageSystem.AddError(L"Local terrain file version mismatch.  Using built in terrain.");
 		inTerrainFile.close();
@@ -459,10 +686,22 @@ void Terrain::Load(const WCHAR* filename)
 	// read in next handle
 	inTerrainFile.read((char *)&startHandle, sizeof(startHandle));
 
+	// read in the patch index
+	vector<TerrainPatchIndexEntry> patchIndex;
+	if (isIndexed)
+	{
+		patchIndex.resize(fullSize * fullSize);
+		inTerrainFile.read((char *)&patchIndex[0], patchIndex.size() * sizeof(TerrainPatchIndexEntry));
+	}
+
+	bool loadError = false;
 	for(int x=0; x<fullSize; ++x)
 	for(int y=0; y<fullSize; ++y)
 	{
 		TerrainPatch& patch = *GetPatch(x,y);
+
+		if (isIndexed)
+			inTerrainFile.seekg(patchIndex[x + fullSize * y].offset);
 		
 		// fast read in the tile data
 		inTerrainFile.read((char *)patch.tiles, sizeof(TerrainTile) * patchSize * patchSize * patchLayers);
@@ -491,7 +730,10 @@ void Terrain::Load(const WCHAR* filename)
 		}*/
 
 		if (inTerrainFile.eof())
+		{
+			loadError = true;
 			break; // error
+		}
 
 		// read in the object stubs
 		unsigned int stubCount;
@@ -517,18 +759,32 @@ void Terrain::Load(const WCHAR* filename)
 			
 			patch.AddStub(stub);
 			if (inTerrainFile.eof())
+			{
+				loadError = true;
 				break; // error
+			}
 		}
 	}
 
 	inTerrainFile.close();
 	ResetStartHandle();
+
+	if (isIndexed && !loadError)
+	{
+		// patches match the file now, only what changes from here on needs to be saved
+		for (int i = 0; i < fullSize * fullSize; ++i)
+			patches[i]->needsSave = false;
+		savedFilename = filename;
+	}
+	else
+		savedFilename.clear();
 }
 
 void Terrain::LoadFromResource(const WCHAR* filename)
 {
 	// clear out terrain
 	Clear();
+	savedFilename.clear();
 
 	// Get pointer and size to resource
 	HRSRC hRes = FindResource(0, filename, RT_RCDATA);
@@ -543,7 +799,8 @@ void Terrain::LoadFromResource(const WCHAR* filename)
 
 	// check the data version
 	const BYTE version = *(dataPointer++);
-	if (version != dataVersion)
+	const bool isIndexed = (version == dataVersion);
+	if (!isIndexed && version != legacyDataVersion)
 	{
 		g_debugMessageSystem.AddError(L"Built in terrain version mismatch.  Using clear terrain.");
 		return;
@@ -569,11 +826,17 @@ void Terrain::LoadFromResource(const WCHAR* filename)
 	startHandle = *(GameObjectHandle*)(dataPointer);
 	dataPointer += sizeof(startHandle);
 
+	// patch index follows the header for indexed files
+	const TerrainPatchIndexEntry* patchIndex = isIndexed? (const TerrainPatchIndexEntry*)(dataPointer) : NULL;
+
 	for(int x=0; x<fullSize; ++x)
 	for(int y=0; y<fullSize; ++y)
 	{
 		TerrainPatch& patch = *GetPatch(x,y);
 
+		if (patchIndex)
+			dataPointer = (BYTE*)pMem + patchIndex[x + fullSize * y].offset;
+
 		// read in the tile data
 		const int dataSize = sizeof(TerrainTile) * patchSize * patchSize * patchLayers;
 		memcpy(patch.tiles, dataPointer, dataSize);
@@ -622,6 +885,12 @@ void Terrain::Clear()
 
 	startHandle = firstStartHandle;
 	ResetStartHandle();
+
+	if (g_terrainGenerator)
+		g_terrainGenerator->Reset();
+
+	// everything may be different now, editor must diff all patches on the next save state
+	g_editor.SetStateChanged();
 }
 
 IntVector2 Terrain::GetTileOffset(const Vector2& pos) const
@@ -702,6 +971,7 @@ void Terrain::SetSurfaceIndex(const Vector2& pos, BYTE surface, int layer)
 	{
 		const Vector2 offset = pos - GetTilePos(x, y);
 		tile->SetSurfaceData(offset, surface);
+		GetPatch(pos)->SetNeedsSave();
 	}
 }
 
@@ -900,6 +1170,7 @@ void Terrain::Deform(const Vector2& pos, float radius)
 			}
 
 			patch->RebuildPhysics();
+			patch->SetNeedsSave();
 		}
 	}
 }
@@ -951,6 +1222,7 @@ void Terrain::DeformTile(const Vector2& startPos, const Vector2& direction, cons
 				tile->MakeClear();
 		}
 		patch->RebuildPhysics();
+		patch->SetNeedsSave();
 		g_terrainRender.RefereshCached(*patch);
 	}
 }
@@ -1062,10 +1334,11 @@ void Terrain::CheckForErrors()
 // Terrain patch constructor
 // note: terrain patches are not be added to the world!
 TerrainPatch::TerrainPatch(const Vector2& pos) :
-	GameObject(pos, NULL, GameObjectType(0), false),
+	GameObject(pos, NULL, GAME_OBJECT_TYPE_TERRAIN, false),
 	activePhysics(false),
 	activeObjects(false),
-	needsPhysicsRebuild(false)
+	needsPhysicsRebuild(false),
+	needsSave(true)
 {
 	tiles = new TerrainTile[Terrain::patchLayers * Terrain::patchSize * Terrain::patchSize];
 
@@ -1073,6 +1346,10 @@ TerrainPatch::TerrainPatch(const Vector2& pos) :
 
 	// terrain layer render handles rendering
 	SetVisible(false);
+
+	// objects that hit the terrain get the callbacks, patches don't need them
+	// patches not colliding with eachother is in the collision matrix
+	SetCollisionCallbacks(CollisionCallback_None);
 }
 
 TerrainPatch::~TerrainPatch()
@@ -1098,6 +1375,7 @@ void TerrainPatch::ClearTileData(int layer)
 		// reset tiles
 		GetTileLocal(x, y, layer).MakeClear();
 	}
+	needsSave = true;
 }
 	
 
@@ -1111,12 +1389,14 @@ void TerrainPatch::ClearTileData()
 		// reset tiles
 		GetTileLocal(x, y, l).MakeClear();
 	}
+	needsSave = true;
 }
 
 void TerrainPatch::ClearObjectStubs()
 {
 	// clear the object stub list
 	objectStubs.clear();
+	needsSave = true;
 }
 
 void TerrainPatch::SetActivePhysics(bool _activePhysics)
@@ -1170,6 +1450,7 @@ void TerrainPatch::SetActiveObjects(bool _activeObjects, bool windowMoved)
 			
 			// seralizeable objects are removed as they are spawned
 			objectStubs.erase(itLast);
+			needsSave = true;
 		}
 	}
 
@@ -1243,6 +1524,11 @@ void TerrainPatch::CreateEdgePhysicsBody(const Vector2 &pos)
 	needsPhysicsRebuild = false;
 	GameObject::CreatePhysicsBody(XForm2(pos), b2_staticBody);
 
+	// fixtures go into the broadphase all at once when the body is activated
+	if (Terrain::bulkPhysicsProxies)
+		GetPhysicsBody()->SetActive(false);
+	int fixtureCount = 0;
+
 	for(int x=0; x<Terrain::patchSize; ++x)
 	for(int y=0; y<Terrain::patchSize; ++y)
 	{
@@ -1251,7 +1537,7 @@ void TerrainPatch::CreateEdgePhysicsBody(const Vector2 &pos)
 			continue;
 
 		// protect against creating way too many proxies
-		const int proxyCount = g_physics->GetPhysicsWorld()->GetProxyCount();
+		const int proxyCount = g_physics->GetPhysicsWorld()->GetProxyCount() + (GetPhysicsBody()->IsActive()? 0 : fixtureCount);
 		if (proxyCount > Terrain::maxProxies)
 			break;
 
@@ -1270,8 +1556,10 @@ void TerrainPatch::CreateEdgePhysicsBody(const Vector2 &pos)
 			fixtureDef.friction = Terrain::friction;
 			fixtureDef.restitution = Terrain::restitution;
 			GetPhysicsBody()->CreateFixture(&fixtureDef);
+			++fixtureCount;
 		}
 	}
+	GetPhysicsBody()->SetActive(true);
 }
 
 void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
@@ -1283,6 +1571,11 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 	
 	needsPhysicsRebuild = false;
 	GameObject::CreatePhysicsBody(XForm2(pos), b2_staticBody);
+
+	// fixtures go into the broadphase all at once when the body is activated
+	if (Terrain::bulkPhysicsProxies)
+		GetPhysicsBody()->SetActive(false);
+	int fixtureCount = 0;
 	
 	bool* solidTileArray = static_cast<bool*>(malloc(sizeof(bool) * Terrain::patchSize * Terrain::patchSize));
 	for(int x=0; x<Terrain::patchSize; ++x)
@@ -1305,7 +1598,7 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 			continue;
 
 		// protect against creating way too many proxies
-		const int proxyCount = g_physics->GetPhysicsWorld()->GetProxyCount();
+		const int proxyCount = g_physics->GetPhysicsWorld()->GetProxyCount() + (GetPhysicsBody()->IsActive()? 0 : fixtureCount);
 		if (proxyCount > Terrain::maxProxies)
 			break;
 
@@ -1361,6 +1654,7 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 			fixtureDef.friction = Terrain::friction;
 			fixtureDef.restitution = Terrain::restitution;
 			GetPhysicsBody()->CreateFixture(&fixtureDef);
+			++fixtureCount;
 			continue;
 		}
 
@@ -1383,6 +1677,7 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 			fixtureDef.friction = Terrain::friction;
 			fixtureDef.restitution = Terrain::restitution;
 			GetPhysicsBody()->CreateFixture(&fixtureDef);
+			++fixtureCount;
 			continue;
 		}
 
@@ -1403,6 +1698,7 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 			fixtureDef.friction = Terrain::friction;
 			fixtureDef.restitution = Terrain::restitution;
 			GetPhysicsBody()->CreateFixture(&fixtureDef);
+			++fixtureCount;
 		}
 		
 		if (tile.GetSurfaceHasArea(1) && tile1Info.HasCollision())
@@ -1422,9 +1718,11 @@ void TerrainPatch::CreatePolyPhysicsBody(const Vector2 &pos)
 			fixtureDef.friction = Terrain::friction;
 			fixtureDef.restitution = Terrain::restitution;
 			GetPhysicsBody()->CreateFixture(&fixtureDef);
+			++fixtureCount;
 		}
 	}
 	free(solidTileArray);
+	GetPhysicsBody()->SetActive(true);
 }
 
 // returns true if position is in this terrain patch, false if it is not
@@ -1497,6 +1795,7 @@ bool TerrainPatch::RemoveStub(GameObjectHandle handle)
 			continue;
 
 		objectStubs.erase(it);
+		needsSave = true;
 		return true;
 	}
 
@@ -1531,6 +1830,49 @@ static void ConsoleCallback_clearTerrain(const wstring& text)
 }
 ConsoleCommand(ConsoleCallback_clearTerrain, clearTerrain);
 
+// rebuilds physics for every active patch with and without bulk proxies
+static void ConsoleCallback_terrainPhysicsBenchmark(const wstring& text)
+{
+	if (!g_terrain)
+		return;
+
+	int repeatCount = 10;
+	swscanf_s(text.c_str(), L"%d", &repeatCount);
+	repeatCount = Max(repeatCount, 1);
+
+	list<TerrainPatch*> activePatches;
+	for(int x=0; x<Terrain::fullSize; ++x)
+	for(int y=0; y<Terrain::fullSize; ++y)
+	{
+		TerrainPatch* patch = g_terrain->GetPatch(x, y);
+		if (patch && patch->HasActivePhysics())
+			activePatches.push_back(patch);
+	}
+
+	const bool bulkPhysicsProxiesOld = Terrain::bulkPhysicsProxies;
+	const b2World& world = *g_physics->GetPhysicsWorld();
+	for (int bulk = 0; bulk < 2; ++bulk)
+	{
+		Terrain::bulkPhysicsProxies = (bulk != 0);
+
+		CDXUTTimer timer;
+		timer.Start();
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			for (list<TerrainPatch*>::iterator it = activePatches.begin(); it != activePatches.end(); ++it)
+				(**it).SetActivePhysics(false);
+			for (list<TerrainPatch*>::iterator it = activePatches.begin(); it != activePatches.end(); ++it)
+				(**it).SetActivePhysics(true);
+		}
+		const double time = timer.GetElapsedTime() / repeatCount;
+
+		GetDebugConsole().AddFormatted(L"%s: %.2f ms for %d patches, proxies %d, tree height %d, balance %d, area ratio %.2f",
+			bulk? L"bulk" : L"one by one", 1000*time, (int)activePatches.size(), world.GetProxyCount(), world.GetTreeHeight(), world.GetTreeBalance(), world.GetTreeQuality());
+	}
+	Terrain::bulkPhysicsProxies = bulkPhysicsProxiesOld;
+}
+ConsoleCommand(ConsoleCallback_terrainPhysicsBenchmark, terrainPhysicsBenchmark);
+
 static void ConsoleCallback_replaceTile(const wstring& text)
 {
 	if (!g_terrain)
@@ -1569,6 +1911,7 @@ static void ConsoleCallback_replaceTile(const wstring& text)
 
 	}
 
+	g_editor.SetStateChanged();
 	g_editor.SaveState();
 
 	GetDebugConsole().AddFormatted(L"Replaced %d tiles %d with %d.", replaceCount, oldTileID, newTileID);
@@ -4,6 +4,8 @@
 	Copyright 2013 Frank Force - http://www.frankforce.com
 	
 	- static terrain to form the world
+	- saves are indexed per patch, only patches that changed get serialized
+	- saving happens on a background thread against a snapshot of the changed patches
 */
 ////////////////////////////////////////////////////////////////////////////////////////
 
@@ -18,6 +20,7 @@
 // terrain defines
 
 class TerrainLayerRender;
+struct TerrainSaveJob;
 
 class TerrainPatch : public GameObject
 {
@@ -31,6 +34,8 @@ public:
 	bool GetTileLocalIsSolid(int x, int y) const;
 	Vector2 GetTilePos(int x, int y) const { return GetPosWorld() + TerrainTile::GetSize() * Vector2((float)x, (float)y); }
 	void RebuildPhysics() { needsPhysicsRebuild = true; }
+	void SetNeedsSave() { needsSave = true; }
+	bool NeedsSave() const { return needsSave; }
 	Vector2 GetCenter() const;
 	Box2AABB GetAABB() const;
 
@@ -50,8 +55,6 @@ public:
 
 	virtual bool IsTerrain() const { return true; }
 
-	virtual bool ShouldCollide(const GameObject& otherObject, const b2Shape* myShape, const b2Shape* otherShape) const { return !otherObject.IsTerrain(); }
-
 public: // internal engine functions
 
 	bool HasActivePhysics() const { return activePhysics; }
@@ -72,6 +75,7 @@ public: // internal engine functions
 	GameObjectStub* AddStub(const GameObjectStub& stub) 
 	{ 
 		objectStubs.push_back(stub); 
+		needsSave = true;
 		return &objectStubs.back();
 	}
 
@@ -82,6 +86,7 @@ public: // internal engine functions
 			if (stub == &(*it))
 			{
 				objectStubs.erase(it);
+				needsSave = true;
 				return true;
 			}
 		}
@@ -97,6 +102,7 @@ public: // data members
 	bool activePhysics;
 	bool activeObjects;
 	bool needsPhysicsRebuild;
+	bool needsSave;				// changed since the terrain was last saved or loaded
 };
 
 class Terrain : public GameObject
@@ -170,6 +176,13 @@ public:
 
 	void Save(const WCHAR* filename);
 	void Load(const WCHAR* filename);
+	void WaitForSave();
+	void UpdateSave();
+	bool IsSaving() const { return saveThread != NULL; }
+
+	// mark patches that were changed so the next save will write them out
+	void SetNeedsSave();
+	void SetNeedsSave(const Box2AABB& box);
 
 	void Clear();
 
@@ -207,6 +220,7 @@ public:
 public: // settings
 
 	static int dataVersion;					// used to prevent old version from getting loaded
+	static const int legacyDataVersion = 11;	// unindexed version that can still be loaded
 	static int fullSize;					// how many patches per terrain
 	static int patchSize;					// how many tiles per patch
 	static int patchLayers;					// how many layers patch
@@ -221,6 +235,7 @@ public: // settings
 	static float friction;					// friction for terrain physics
 	static bool usePolyPhysics;				// should polygons be used instead of edge shapes for collision
 	static bool combineTileShapes;			// optimization to combine physics shapes for tiles
+	static bool bulkPhysicsProxies;			// build each patch's physics proxies together as one broadphase subtree
 	static bool enableStreaming;			// streaming of objects and physics for the window around the player
 	static int maxProxies;					// limit on how many terrain proxies can be made
 
@@ -245,6 +260,7 @@ private:
 	
 	void UpdateStreaming();
 	void LoadFromResource(const WCHAR* filename);
+	void FinishSave();
 	
 	IntVector2 streamWindowPatch;
 	IntVector2 streamWindowPatchLast;
@@ -254,6 +270,11 @@ private:
 	GameObjectHandle startHandle;
 	TerrainLayerRender** layerRenderArray;
 
+	// background saving
+	HANDLE saveThread;
+	TerrainSaveJob* saveJob;
+	wstring savedFilename;					// file that patches which don't need save match
+
 	friend class TerrainRender;
 };
 
@@ -0,0 +1,610 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Terrain Generator
+	Copyright 2013 Frank Force - http://www.frankforce.com
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "frankEngine.h"
+#include "../terrain/terrain.h"
+#include "../terrain/terrainGenerator.h"
+#include <process.h>
+
+// the game sets this to enable procedural terrain
+TerrainGenerator* g_terrainGenerator = NULL;
+
+int TerrainGenerator::threadCount = 0;
+ConsoleCommand(TerrainGenerator::threadCount, terrainGeneratorThreads);
+
+int TerrainGenerator::generateAhead = 1;
+ConsoleCommand(TerrainGenerator::generateAhead, terrainGeneratorAhead);
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+TerrainGenerator::TerrainGenerator(unsigned int _seed) :
+	seed(_seed),
+	noiseScale(0.05f),
+	noiseOctaves(3),
+	density(0),
+	surfaceData(1),
+	backgroundSurfaceData(0),
+	stubType(GAME_OBJECT_TYPE_INVALID),
+	stubChance(0.02f),
+	jobSemaphore(NULL),
+	jobFinishedEvent(NULL),
+	stopThreads(false),
+	noiseSeed(0),
+	noiseInitialized(false)
+{
+	InitializeCriticalSection(&criticalSection);
+}
+
+TerrainGenerator::~TerrainGenerator()
+{
+	StopThreads();
+	Reset();
+	DeleteCriticalSection(&criticalSection);
+}
+
+void TerrainGenerator::InitNoise()
+{
+	if (noiseInitialized && noiseSeed == seed)
+		return;
+
+	// noise tables must be built before any worker samples them
+	StopThreads();
+	PerlineNoise::Init(seed);
+	noiseSeed = seed;
+	noiseInitialized = true;
+}
+
+void TerrainGenerator::StartThreads()
+{
+	InitNoise();
+	if (!threads.empty())
+		return;
+
+	int count = threadCount;
+	if (count <= 0)
+	{
+		SYSTEM_INFO systemInfo;
+		GetSystemInfo(&systemInfo);
+		count = Max((int)systemInfo.dwNumberOfProcessors - 1, 1);
+	}
+	count = Min(count, MAXIMUM_WAIT_OBJECTS);
+
+	stopThreads = false;
+	jobSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+	jobFinishedEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	for (int i = 0; i < count; ++i)
+	{
+		HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, WorkerThreadEntry, this, 0, NULL);
+		if (thread)
+			threads.push_back(thread);
+	}
+}
+
+void TerrainGenerator::StopThreads()
+{
+	if (threads.empty())
+		return;
+
+	stopThreads = true;
+	ReleaseSemaphore(jobSemaphore, (LONG)threads.size(), NULL);
+	WaitForMultipleObjects(threads.size(), &threads[0], TRUE, INFINITE);
+	for (vector<HANDLE>::iterator it = threads.begin(); it != threads.end(); ++it)
+		CloseHandle(*it);
+	threads.clear();
+
+	CloseHandle(jobSemaphore);
+	CloseHandle(jobFinishedEvent);
+	jobSemaphore = NULL;
+	jobFinishedEvent = NULL;
+
+	// anything still queued gets done on the main thread if it is needed
+	for (list<Job*>::iterator it = queuedJobs.begin(); it != queuedJobs.end(); ++it)
+	{
+		if ((*it)->patchIndex >= 0)
+		{
+			patchStates[(*it)->patchIndex] = PatchState_Unchecked;
+			pendingPatches.remove((*it)->patchIndex);
+		}
+		delete *it;
+	}
+	queuedJobs.clear();
+}
+
+void TerrainGenerator::Reset()
+{
+	// wait for workers to finish what they are doing so nothing old gets applied
+	StopThreads();
+
+	for (list<Job*>::iterator it = finishedJobs.begin(); it != finishedJobs.end(); ++it)
+		delete *it;
+	finishedJobs.clear();
+	pendingPatches.clear();
+
+	patchStates.assign(Terrain::fullSize * Terrain::fullSize, PatchState_Unchecked);
+}
+
+unsigned __stdcall TerrainGenerator::WorkerThreadEntry(void* data)
+{
+	static_cast<TerrainGenerator*>(data)->WorkerThread();
+	return 0;
+}
+
+void TerrainGenerator::WorkerThread()
+{
+	while (true)
+	{
+		WaitForSingleObject(jobSemaphore, INFINITE);
+		if (stopThreads)
+			break;
+
+		EnterCriticalSection(&criticalSection);
+		Job* job = NULL;
+		if (!queuedJobs.empty())
+		{
+			job = queuedJobs.front();
+			queuedJobs.pop_front();
+			if (job->patchIndex >= 0)
+				patchStates[job->patchIndex] = PatchState_Working;
+		}
+		LeaveCriticalSection(&criticalSection);
+
+		if (!job)
+			continue;
+
+		RunJob(*job);
+
+		EnterCriticalSection(&criticalSection);
+		if (job->patchIndex >= 0)
+			patchStates[job->patchIndex] = PatchState_Finished;
+		finishedJobs.push_back(job);
+		LeaveCriticalSection(&criticalSection);
+		SetEvent(jobFinishedEvent);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	main thread functions
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+void TerrainGenerator::UpdateWindow(const IntVector2& windowPatch)
+{
+	ApplyFinished();
+
+	// everything in the window must be generated before it becomes active
+	const int windowSize = Terrain::windowSize;
+	GenerateArea(windowPatch - IntVector2(windowSize), windowPatch + IntVector2(windowSize));
+
+	// queue up patches around the window, closest rings first
+	for (int ring = windowSize + 1; ring <= windowSize + generateAhead; ++ring)
+	for (int x = windowPatch.x - ring; x <= windowPatch.x + ring; ++x)
+	for (int y = windowPatch.y - ring; y <= windowPatch.y + ring; ++y)
+	{
+		if (abs(x - windowPatch.x) == ring || abs(y - windowPatch.y) == ring)
+			QueuePatch(x, y);
+	}
+}
+
+void TerrainGenerator::GenerateArea(const IntVector2& patchMin, const IntVector2& patchMax)
+{
+	for (int x = patchMin.x; x <= patchMax.x; ++x)
+	for (int y = patchMin.y; y <= patchMax.y; ++y)
+		QueuePatch(x, y);
+
+	for (int x = patchMin.x; x <= patchMax.x; ++x)
+	for (int y = patchMin.y; y <= patchMax.y; ++y)
+		WaitForPatch(x, y);
+}
+
+void TerrainGenerator::QueuePatch(int x, int y)
+{
+	if (Terrain::IsPatchIndexInvalid(x, y))
+		return;
+
+	if (patchStates.size() != Terrain::fullSize * Terrain::fullSize)
+		patchStates.assign(Terrain::fullSize * Terrain::fullSize, PatchState_Unchecked);
+
+	const int patchIndex = x + Terrain::fullSize * y;
+	if (patchStates[patchIndex] != PatchState_Unchecked)
+		return;
+
+	// only fill in patches that are totally empty
+	const TerrainPatch& patch = *g_terrain->GetPatch(x, y);
+	bool isEmpty = patch.objectStubs.empty();
+	for (int l = 0; l < Terrain::patchLayers && isEmpty; ++l)
+	for (int i = 0; i < Terrain::patchSize && isEmpty; ++i)
+	for (int j = 0; j < Terrain::patchSize && isEmpty; ++j)
+		isEmpty = patch.GetTileLocal(i, j, l).IsClear();
+
+	if (!isEmpty)
+	{
+		patchStates[patchIndex] = PatchState_Skipped;
+		return;
+	}
+
+	StartThreads();
+
+	Job* job = new Job;
+	job->patchIndex = patchIndex;
+	InitJob(*job, IntVector2(x, y));
+
+	EnterCriticalSection(&criticalSection);
+	patchStates[patchIndex] = PatchState_Queued;
+	queuedJobs.push_back(job);
+	LeaveCriticalSection(&criticalSection);
+	pendingPatches.push_back(patchIndex);
+	ReleaseSemaphore(jobSemaphore, 1, NULL);
+}
+
+void TerrainGenerator::WaitForPatch(int x, int y)
+{
+	if (Terrain::IsPatchIndexInvalid(x, y))
+		return;
+
+	// patches are applied in the order they were queued so everything before this one must finish too
+	const int patchIndex = x + Terrain::fullSize * y;
+	while (!pendingPatches.empty() && IsPatchPending(patchIndex))
+	{
+		FinishPatch(pendingPatches.front());
+		ApplyFinished();
+	}
+}
+
+bool TerrainGenerator::IsPatchPending(int patchIndex)
+{
+	EnterCriticalSection(&criticalSection);
+	const BYTE state = patchStates[patchIndex];
+	LeaveCriticalSection(&criticalSection);
+	return state == PatchState_Queued || state == PatchState_Working || state == PatchState_Finished;
+}
+
+void TerrainGenerator::FinishPatch(int patchIndex)
+{
+	while (true)
+	{
+		EnterCriticalSection(&criticalSection);
+		const BYTE state = patchStates[patchIndex];
+		Job* job = NULL;
+		if (state == PatchState_Queued)
+		{
+			// no worker has it yet so just do it here
+			for (list<Job*>::iterator it = queuedJobs.begin(); it != queuedJobs.end(); ++it)
+			{
+				if ((*it)->patchIndex != patchIndex)
+					continue;
+
+				job = *it;
+				queuedJobs.erase(it);
+				patchStates[patchIndex] = PatchState_Working;
+				break;
+			}
+		}
+		LeaveCriticalSection(&criticalSection);
+
+		if (job)
+		{
+			RunJob(*job);
+			EnterCriticalSection(&criticalSection);
+			patchStates[patchIndex] = PatchState_Finished;
+			finishedJobs.push_back(job);
+			LeaveCriticalSection(&criticalSection);
+		}
+		else if (state == PatchState_Working)
+		{
+			WaitForSingleObject(jobFinishedEvent, 1);
+			continue;
+		}
+
+		break;
+	}
+}
+
+void TerrainGenerator::ApplyFinished()
+{
+	// apply in the order patches were queued so stub handles come out the same no matter which thread finishes first
+	while (!pendingPatches.empty())
+	{
+		const int patchIndex = pendingPatches.front();
+		Job* job = NULL;
+
+		EnterCriticalSection(&criticalSection);
+		const BYTE state = patchStates[patchIndex];
+		if (state == PatchState_Finished)
+		{
+			for (list<Job*>::iterator it = finishedJobs.begin(); it != finishedJobs.end(); ++it)
+			{
+				if ((*it)->patchIndex != patchIndex)
+					continue;
+
+				job = *it;
+				finishedJobs.erase(it);
+				break;
+			}
+		}
+		LeaveCriticalSection(&criticalSection);
+
+		// anything after a patch that is still being generated has to wait for it
+		if (state == PatchState_Queued || state == PatchState_Working)
+			break;
+
+		pendingPatches.pop_front();
+		if (!job)
+			continue;
+
+		TerrainPatch& patch = *g_terrain->GetPatch(job->patch.offset.x, job->patch.offset.y);
+		memcpy(patch.tiles, &job->patch.tiles[0], job->patch.tiles.size() * sizeof(TerrainTile));
+		for (list<GameObjectStub>::iterator stubIt = job->patch.objectStubs.begin(); stubIt != job->patch.objectStubs.end(); ++stubIt)
+		{
+			GameObjectStub& stub = *stubIt;
+			g_terrain->GiveStubNewHandle(stub);
+			patch.AddStub(stub);
+		}
+		patch.RebuildPhysics();
+		patch.SetNeedsSave();
+
+		// generated patches are not an edit, keep them out of undo
+		g_editor.GetUndoJournal().RefreshShadow(patch);
+
+		patchStates[patchIndex] = PatchState_Done;
+		delete job;
+	}
+}
+
+float TerrainGenerator::Benchmark(int patchCount, bool singleThread)
+{
+	ApplyFinished();
+	if (singleThread)
+		InitNoise();
+	else
+		StartThreads();
+
+	CDXUTTimer timer;
+	timer.Start();
+
+	if (singleThread)
+	{
+		Job job;
+		job.patchIndex = -1;
+		for (int i = 0; i < patchCount; ++i)
+		{
+			// use coordinates outside the terrain so nothing real is touched
+			InitJob(job, IntVector2(Terrain::fullSize + i, Terrain::fullSize));
+			RunJob(job);
+		}
+	}
+	else
+	{
+		EnterCriticalSection(&criticalSection);
+		for (int i = 0; i < patchCount; ++i)
+		{
+			Job* job = new Job;
+			job->patchIndex = -1;
+			InitJob(*job, IntVector2(Terrain::fullSize + i, Terrain::fullSize));
+			queuedJobs.push_back(job);
+		}
+		LeaveCriticalSection(&criticalSection);
+		ReleaseSemaphore(jobSemaphore, patchCount, NULL);
+
+		// wait for all of the benchmark jobs to come back
+		int finishedCount = 0;
+		while (finishedCount < patchCount)
+		{
+			WaitForSingleObject(jobFinishedEvent, 1);
+
+			EnterCriticalSection(&criticalSection);
+			for (list<Job*>::iterator it = finishedJobs.begin(); it != finishedJobs.end(); )
+			{
+				if ((*it)->patchIndex >= 0)
+				{
+					++it;
+					continue;
+				}
+
+				delete *it;
+				it = finishedJobs.erase(it);
+				++finishedCount;
+			}
+			LeaveCriticalSection(&criticalSection);
+		}
+	}
+
+	const float time = (float)timer.GetElapsedTime();
+	return time > 0? patchCount / time : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	generation, must be thread safe
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+void TerrainGenerator::InitJob(Job& job, const IntVector2& offset) const
+{
+	TerrainGeneratorPatch& patch = job.patch;
+	patch.offset = offset;
+	patch.pos = g_terrain->GetPosWorld() + Terrain::patchSize * TerrainTile::GetSize() * Vector2(offset);
+	patch.seed = GetPatchSeed(offset);
+	patch.tiles.assign(Terrain::patchSize * Terrain::patchSize * Terrain::patchLayers, TerrainTile());
+	patch.objectStubs.clear();
+}
+
+void TerrainGenerator::RunJob(Job& job) const
+{
+	// random numbers are per thread, seed them so each patch always comes out the same
+	const unsigned int oldSeed = FrankRand::GetSeed();
+	FrankRand::SetSeed(job.patch.seed);
+	Generate(job.patch);
+	FrankRand::SetSeed(oldSeed);
+}
+
+unsigned int TerrainGenerator::GetPatchSeed(const IntVector2& offset) const
+{
+	// hash the coordinates together with the seed
+	unsigned int hash = seed * 0x9E3779B1u;
+	hash ^= (unsigned int)offset.x * 0x85EBCA6Bu + 0x27D4EB2Fu + (hash << 6) + (hash >> 2);
+	hash ^= (unsigned int)offset.y * 0xC2B2AE35u + 0x165667B1u + (hash << 6) + (hash >> 2);
+	return hash? hash : 1;
+}
+
+float TerrainGenerator::GetDensity(const Vector2& pos) const
+{
+	// add together octaves of perlin noise
+	return density + PerlineNoise::fbm(pos * noiseScale, noiseOctaves);
+}
+
+void TerrainGenerator::GetDensityGrid(const Vector2& start, const Vector2& step, int width, int height, float* result) const
+{
+	// batched version of the same noise
+	PerlineNoise::fbm2Grid(start * noiseScale, step * noiseScale, width, height, result, noiseOctaves);
+	for (int i = 0; i < width * height; ++i)
+		result[i] += density;
+}
+
+void TerrainGenerator::Generate(TerrainGeneratorPatch& patch) const
+{
+	// sample density at the tile corners, shared corners make neighboring patches line up
+	const int cornerCount = Terrain::patchSize + 1;
+	vector<float> cornerDensity(cornerCount * cornerCount);
+	GetDensityGrid(patch.pos, TerrainTile::GetSize() * Vector2(1), cornerCount, cornerCount, &cornerDensity[0]);
+
+	for (int x = 0; x < Terrain::patchSize; ++x)
+	for (int y = 0; y < Terrain::patchSize; ++y)
+	{
+		const float tileDensity[4] =
+		{
+			cornerDensity[x + cornerCount * y],
+			cornerDensity[x + 1 + cornerCount * y],
+			cornerDensity[x + 1 + cornerCount * (y + 1)],
+			cornerDensity[x + cornerCount * (y + 1)]
+		};
+		BuildTile(patch.GetTileLocal(x, y, 0), tileDensity);
+
+		if (backgroundSurfaceData && Terrain::patchLayers > 1)
+			patch.GetTileLocal(x, y, 1) = TerrainTile(0, backgroundSurfaceData, backgroundSurfaceData);
+	}
+
+	if (stubType == GAME_OBJECT_TYPE_INVALID)
+		return;
+
+	// place stubs on open tiles with solid ground below
+	for (int x = 0; x < Terrain::patchSize; ++x)
+	for (int y = 1; y < Terrain::patchSize; ++y)
+	{
+		if (!patch.GetTileLocal(x, y).IsClear() || !patch.GetTileLocal(x, y - 1).IsFull() || patch.GetTileLocal(x, y - 1).IsClear())
+			continue;
+		if (RAND_PERCENT >= stubChance)
+			continue;
+
+		const Vector2 stubPos = patch.GetTilePos(x, y) + Vector2(0.5f * TerrainTile::GetSize());
+		patch.objectStubs.push_back(GameObjectStub(XForm2(stubPos), Vector2(0.5f * TerrainTile::GetSize()), stubType));
+	}
+}
+
+void TerrainGenerator::BuildTile(TerrainTile& tile, const float cornerDensity[4]) const
+{
+	// corners go counter clockwise from the bottom left
+	const float size = TerrainTile::GetSize();
+	const Vector2 cornerPos[4] = { Vector2(0, 0), Vector2(size, 0), Vector2(size, size), Vector2(0, size) };
+
+	int solidCount = 0;
+	int solidCorner = 0;
+	Vector2 crossings[4];
+	int crossingCount = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		const int j = (i + 1) % 4;
+		const float a = cornerDensity[i];
+		const float b = cornerDensity[j];
+		if (a > 0)
+		{
+			++solidCount;
+			if (a > cornerDensity[solidCorner] || cornerDensity[solidCorner] <= 0)
+				solidCorner = i;
+		}
+
+		// find where the surface crosses this side of the tile
+		if ((a > 0) != (b > 0))
+			crossings[crossingCount++] = cornerPos[i] + (a / (a - b)) * (cornerPos[j] - cornerPos[i]);
+	}
+
+	if (solidCount == 0)
+	{
+		tile.MakeClear();
+		return;
+	}
+	if (solidCount == 4)
+	{
+		tile = TerrainTile(0, surfaceData, surfaceData);
+		return;
+	}
+
+	if (crossingCount == 2)
+	{
+		// extend the line a little so it passes through the sides of the tile
+		const Vector2 direction = (crossings[1] - crossings[0]).Normalize();
+		const Vector2 posA = crossings[0] - 0.01f * size * direction;
+		const Vector2 posB = crossings[1] + 0.01f * size * direction;
+
+		tile.MakeClear();
+		if (tile.Resurface(posA, posB))
+		{
+			// put the surface on the side with the solid corners
+			const int side = tile.GetSurfaceSide(cornerPos[solidCorner] + 0.1f * (Vector2(0.5f * size) - cornerPos[solidCorner]));
+			tile.SetSurfaceData(side, surfaceData);
+			tile.SetSurfaceData(!side, 0);
+			return;
+		}
+	}
+
+	// saddles and edges too small to make a shape use whichever is most of the tile
+	if (cornerDensity[0] + cornerDensity[1] + cornerDensity[2] + cornerDensity[3] > 0)
+		tile = TerrainTile(0, surfaceData, surfaceData);
+	else
+		tile.MakeClear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static void ConsoleCallback_terrainGeneratorBenchmark(const wstring& text)
+{
+	if (!g_terrain || !g_terrainGenerator)
+	{
+		GetDebugConsole().AddLine(L"No terrain generator is set.");
+		return;
+	}
+
+	int patchCount = 256;
+	swscanf_s(text.c_str(), L"%d", &patchCount);
+	patchCount = Max(patchCount, 1);
+
+	const float singleRate = g_terrainGenerator->Benchmark(patchCount, true);
+	const float threadedRate = g_terrainGenerator->Benchmark(patchCount);
+	const int threads = g_terrainGenerator->GetThreadCount();
+
+	GetDebugConsole().AddFormatted(L"Generated %d patches of %dx%dx%d tiles.", patchCount, Terrain::patchSize, Terrain::patchSize, Terrain::patchLayers);
+	GetDebugConsole().AddFormatted(L"1 thread: %.1f patches/s per core", singleRate);
+	GetDebugConsole().AddFormatted(L"%d threads: %.1f patches/s, %.1f patches/s per core", threads, threadedRate, threadedRate / Max(threads, 1));
+}
+ConsoleCommand(ConsoleCallback_terrainGeneratorBenchmark, terrainGeneratorBenchmark);
+
+static void ConsoleCallback_terrainGenerate(const wstring& text)
+{
+	if (!g_terrain || !g_terrainGenerator)
+	{
+		GetDebugConsole().AddLine(L"No terrain generator is set.");
+		return;
+	}
+
+	// fill in every empty patch, in edit mode this bakes the result so it can be saved
+	g_editor.ClearSelection();
+	g_terrainGenerator->GenerateArea(IntVector2(0), IntVector2(Terrain::fullSize - 1));
+	g_editor.SetStateChanged();
+	g_editor.SaveState();
+	GetDebugConsole().AddLine(L"Terrain generated.");
+}
+ConsoleCommand(ConsoleCallback_terrainGenerate, terrainGenerate);
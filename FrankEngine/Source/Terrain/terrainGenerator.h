@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Terrain Generator
+	Copyright 2013 Frank Force - http://www.frankforce.com
+
+	- procedurally fills empty patches the first time they become active
+	- generation runs on worker threads ahead of the stream window
+	- results only depend on the seed and patch coordinate
+	- finished patches are applied in the order they were queued so stub handles are deterministic
+	- derive from this and override Generate or GetDensity and GetDensityGrid for custom terrain
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TERRAIN_GENERATOR_H
+#define TERRAIN_GENERATOR_H
+
+#include <vector>
+#include <list>
+#include "../terrain/terrain.h"
+
+extern class TerrainGenerator* g_terrainGenerator;
+
+// output for a single patch, filled in by the generator on a worker thread
+struct TerrainGeneratorPatch
+{
+	TerrainTile& GetTileLocal(int x, int y, int layer = 0)
+	{
+		ASSERT(TerrainPatch::IsTileIndexValid(x, y, layer));
+		return tiles[Terrain::patchSize*Terrain::patchSize*layer + Terrain::patchSize*x + y];
+	}
+	Vector2 GetTilePos(int x, int y) const { return pos + TerrainTile::GetSize() * Vector2((float)x, (float)y); }
+
+	IntVector2 offset;					// patch coordinates in the terrain
+	Vector2 pos;						// world space position of the bottom left corner
+	unsigned int seed;					// unique seed for this patch
+	vector<TerrainTile> tiles;			// same layout as terrain patch tiles
+	list<GameObjectStub> objectStubs;	// stubs get handles when they are added to the terrain
+};
+
+class TerrainGenerator
+{
+public:
+
+	TerrainGenerator(unsigned int seed = 1);
+	virtual ~TerrainGenerator();
+
+	// fill in the tiles and stubs for a patch
+	// this is called from worker threads so it must only touch the patch passed in
+	// FrankRand is seeded with the patch seed before this is called
+	virtual void Generate(TerrainGeneratorPatch& patch) const;
+
+	// solid where density is positive, must be continuous so patch edges line up
+	virtual float GetDensity(const Vector2& pos) const;
+
+	// fill in a width by height grid of densities, row major starting at the bottom left
+	// defaults to batched noise, override along with GetDensity for custom terrain
+	virtual void GetDensityGrid(const Vector2& start, const Vector2& step, int width, int height, float* result) const;
+
+	// clear out all generation state, called when terrain is cleared
+	void Reset();
+
+	// generate everything in the stream window and queue up patches around it
+	void UpdateWindow(const IntVector2& windowPatch);
+
+	// generate an area of patches and wait for them to finish
+	void GenerateArea(const IntVector2& patchMin, const IntVector2& patchMax);
+
+	// returns how many patches per second were generated using all threads
+	float Benchmark(int patchCount, bool singleThread = false);
+
+	int GetThreadCount() const { return threads.size(); }
+
+public: // settings
+
+	unsigned int seed;				// seed used to make every patch
+	float noiseScale;				// scale of the noise in world space
+	int noiseOctaves;				// how many octaves of noise to add together
+	float density;					// how solid the terrain is, from -1 to 1
+	BYTE surfaceData;				// surface used for solid tiles
+	BYTE backgroundSurfaceData;		// surface used to fill the background layer, 0 for none
+	GameObjectType stubType;		// type of stubs to place on open floor, invalid for none
+	float stubChance;				// chance for each open floor tile to get a stub
+
+	static int threadCount;			// how many worker threads to use, 0 for one less then the number of cores
+	static int generateAhead;		// how many patches past the stream window to generate
+
+private:
+
+	enum PatchState
+	{
+		PatchState_Unchecked,		// has not been looked at yet
+		PatchState_Skipped,			// already had data so it is left alone
+		PatchState_Queued,			// waiting for a worker thread
+		PatchState_Working,			// being generated by a worker thread
+		PatchState_Finished,		// waiting to be added to the terrain
+		PatchState_Done				// added to the terrain
+	};
+
+	struct Job
+	{
+		int patchIndex;				// -1 for benchmark jobs that are thrown away
+		TerrainGeneratorPatch patch;
+	};
+
+	void InitNoise();
+	void StartThreads();
+	void StopThreads();
+	void QueuePatch(int x, int y);
+	void ApplyFinished();
+	void WaitForPatch(int x, int y);
+	void FinishPatch(int patchIndex);
+	bool IsPatchPending(int patchIndex);
+	void InitJob(Job& job, const IntVector2& offset) const;
+	void RunJob(Job& job) const;
+	unsigned int GetPatchSeed(const IntVector2& offset) const;
+	void BuildTile(TerrainTile& tile, const float cornerDensity[4]) const;
+	void WorkerThread();
+
+	static unsigned __stdcall WorkerThreadEntry(void* data);
+
+	vector<BYTE> patchStates;
+	list<Job*> queuedJobs;
+	list<Job*> finishedJobs;
+	list<int> pendingPatches;		// patch indexes in the order they were queued, only used on the main thread
+	vector<HANDLE> threads;
+	CRITICAL_SECTION criticalSection;
+	HANDLE jobSemaphore;			// counts queued jobs for the workers
+	HANDLE jobFinishedEvent;		// signaled each time a worker finishes a job
+	volatile bool stopThreads;
+	unsigned int noiseSeed;			// what seed the noise tables were built with
+	bool noiseInitialized;
+};
+
+#endif // TERRAIN_GENERATOR_H
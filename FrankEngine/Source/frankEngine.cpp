@@ -108,13 +108,14 @@ void FrankEngineInit(int width, int height, GameControlBase* gameControl, GuiBas
 	ASSERT(!g_sound);
 	ASSERT(!g_input);
 	ASSERT(!g_physics);
+	ASSERT(!g_jobSystem);
 
 	// init high level game objects
+	g_jobSystem = new JobSystem();
 	g_sound = new SoundControl();
 	g_input	= new InputControl();
 	g_physics = new Physics();
 	g_physics->Init();
-	ParticleEmitter::InitParticleSystem();
 	TerrainTile::BuildCache();
 	g_cameraBase = camera;
 	g_gameControlBase = gameControl;
@@ -149,15 +150,15 @@ void FrankEngineLoop()
 
 void FrankEngineShutdown()
 {
-	// remove files in temp folder
-	Editor::ClearTempFolder();
-
 	GetDebugConsole().Save();
 
 	if (g_gameControlBase)
 	{
 		if (GameControlBase::autoSaveTerrain && g_gameControlBase->IsEditMode() && g_terrain)
 			g_terrain->Save(Terrain::terrainFilename);
+		if (g_terrain)
+			g_terrain->WaitForSave();
+		SAFE_DELETE(g_terrainGenerator);
 		g_gameControlBase->DestroyDeviceObjects();
 		delete g_gameControlBase;
 		g_gameControlBase = NULL;
@@ -167,6 +168,7 @@ void FrankEngineShutdown()
 	SAFE_DELETE(g_sound);
 	SAFE_DELETE(g_input);
 	SAFE_DELETE(g_physics);
+	SAFE_DELETE(g_jobSystem);
 }
 
 //--------------------------------------------------------------------------------------
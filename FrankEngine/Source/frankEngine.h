@@ -90,6 +90,7 @@ const GameDamageType GameDamageType_Default = GameDamageType(0);
 #include "core/inputControl.h"
 #include "core/perlinNoise.h"
 #include "core/debugConsole.h"
+#include "core/jobSystem.h"
 #include "objects/gameObject.h"
 #include "objects/camera.h"
 #include "gameControlBase.h"
@@ -97,10 +98,12 @@ const GameDamageType GameDamageType_Default = GameDamageType(0);
 #include "rendering/frankDebugRender.h"
 #include "rendering/frankFont.h"
 #include "rendering/deferredRender.h"
+#include "rendering/particleBatch.h"
 #include "gui/guiBase.h"
 #include "gui/editorGui.h"
 #include "editor/objectEditor.h"
 #include "editor/tileEditor.h"
+#include "editor/undoJournal.h"
 #include "editor/editor.h"
 #include "objects/actor.h"
 #include "objects/gameObjectBuilder.h"
@@ -109,12 +112,16 @@ const GameDamageType GameDamageType_Default = GameDamageType(0);
 #include "objects/light.h"
 #include "objects/projectile.h"
 #include "objects/weapon.h"
+#include "objects/bulletManager.h"
+#include "objects/worldSnapshot.h"
 #include "physics/physics.h"
 #include "physics/physicsRender.h"
 #include "sound/soundControl.h"
 #include "sound/musicControl.h"
+#include "sound/musicDecoder.h"
 #include "terrain/terrain.h"
 #include "terrain/terrainRender.h"
+#include "terrain/terrainGenerator.h"
 #include "terrain/terrainSurface.h"
 #include "terrain/terrainTile.h"
 #include "core/frankUtil.h"
@@ -96,11 +96,13 @@ void GameControlBase::Reset()
 
 	g_editor.ResetEditor();
 
+	bool terrainSaved = false;
 	if (autoSaveTerrain && WasEditMode())
 	{
 		// auto save when exiting edit mode, and auto load when entering edit
 		// save terrain automatically when exiting edit mode
 		g_terrain->Save(Terrain::terrainFilename);
+		terrainSaved = true;
 	}
 
 	SetPaused(false);
@@ -114,6 +116,7 @@ void GameControlBase::Reset()
 
 	// reset the world, removing all objects set to destroy on reset
 	g_objectManager.Reset();
+	g_bulletManager.Clear();
 	
 	// trigger reset of transforms
 	resetWorldXForms = true;
@@ -127,6 +130,11 @@ void GameControlBase::Reset()
 		// terrain must be loaded before other objects start getting created
 		g_terrain->Load(Terrain::terrainFilename);
 	}
+	else if (terrainSaved)
+	{
+		// terrain already matches what is being saved, don't wait on the save to reload it
+		g_terrain->Deactivate();
+	}
 	else if (GameControlBase::autoSaveTerrain)
 	{
 		// reload terrain on reset
@@ -347,7 +355,12 @@ void GameControlBase::UpdateFrameInternal(float delta)
 		g_cameraBase->PrepForUpdate();
 		
 		if (IsGameplayMode())
+		{
 			g_objectManager.Update();
+			ParticleEmitter::UpdateAll();
+			ParticleEmitter::UpdateParticleBudget();
+			g_bulletManager.Update();
+		}
 	}
 	
 	UpdateFrame(delta);
@@ -374,6 +387,9 @@ void GameControlBase::UpdateFrameInternal(float delta)
 
 	if (!paused && IsGameplayMode())
 		g_terrain->UpdatePost();
+
+	if (g_terrain)
+		g_terrain->UpdateSave();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -463,6 +479,7 @@ void GameControlBase::RenderInterpolatedObjects()
 {
 	// render out the main object group
 	g_objectManager.Render();
+	g_bulletManager.Render();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -604,6 +621,7 @@ void GameControlBase::RenderDebugText()
 			g_textHelper->DrawFormattedTextLine( L"fps: %.0f", DXUTGetFPS() );
 
 			g_textHelper->DrawFormattedTextLine( L"objects: %d", g_objectManager.GetObjectCount());
+			g_textHelper->DrawFormattedTextLine( L"bullets: %d", g_bulletManager.GetCount());
 			g_textHelper->DrawFormattedTextLine( L"particles: %d / %d", ParticleEmitter::GetTotalEmitterCount(), ParticleEmitter::GetTotalParticleCount() );
 			g_textHelper->DrawFormattedTextLine( L"simple / dynamic lights: %d / %d", DeferredRender::GetSimpleLightCount(), DeferredRender::GetDynamicLightCount());
 			g_textHelper->DrawFormattedTextLine( L"simple verts: %d", g_render->GetTotalSimpleVertsRendered());
@@ -650,6 +668,7 @@ void GameControlBase::RenderDebugText()
 			g_textHelper->DrawFormattedTextLine( L"contacts: %d", g_physics->GetPhysicsWorld()->GetContactCount() );
 			g_textHelper->DrawFormattedTextLine( L"joints: %d", g_physics->GetPhysicsWorld()->GetJointCount() );
 			g_textHelper->DrawFormattedTextLine( L"raycasts: %d", g_physics->GetRaycastCount() );
+			g_textHelper->DrawFormattedTextLine( L"collision callbacks: %d", g_physics->GetCollisionCallbackCount() );
 			//g_textHelper->DrawFormattedTextLine( L"heap bytes: %d", b2_byteCount );
 		}	
 	}
@@ -46,6 +46,13 @@ GameControl::GameControl()
 		Physics::defaultAngularDamping		= 0.1f;		// how quickly objects stop rotating
 		Physics::worldSize					= 5000;		// maximum extents of physics world
 	}
+	{
+		// collision rules, these are checked before any virtual should collide calls
+		CollisionMatrix::SetTypeFlags(GOT_Explosion, CollisionType_IgnoreSensors);
+		CollisionMatrix::SetTypesCollide(GOT_Explosion, GAME_OBJECT_TYPE_PROJECTILE, false);
+		CollisionMatrix::SetTypesCollide(GOT_Explosion, GOT_Debris, false);
+		CollisionMatrix::SetTypeFlags(GOT_Debris, CollisionType_StaticOnly);
+	}
 	{
 		// terrain settings
 		Terrain::patchLayers		= 2;	// how many layers there are
@@ -56,6 +63,15 @@ GameControl::GameControl()
 		TerrainTile::SetSize(1.0f);			// size in world space of each tile
 		Terrain::gravity = Vector2(0,-10);	// acceleartion due to gravity
 	}
+	{
+		// procedural terrain, fills in empty patches as they stream in
+		static const bool exampleUseTerrainGenerator = false;
+		if (exampleUseTerrainGenerator)
+		{
+			g_terrainGenerator = new TerrainGenerator(1234);
+			g_terrainGenerator->stubType = GOT_Crate;
+		}
+	}
 	{
 		// rendering settings
 		DeferredRender::lightEnable				= true;
@@ -56,6 +56,8 @@ enum GameObjectType
 	GOT_TriggerBox,
 	GOT_TextDecal,
 	GOT_MusicBox,
+	GOT_Explosion,
+	GOT_Debris,
 	
 	// add new game object types here
 	// this array is used to save out object stub ids
@@ -161,7 +161,7 @@ void Enemy::Kill()
 			PI, PI, PARTICLE_FLAG_CAST_SHADOWS, -0.04f			// cone angles, flags and gravity
 		);
 		smokeEffectDef.particleSpeedRandomness = 1.0f;
-		ParticleEmitter* emitter = new ParticleEmitter(smokeEffectDef, GetXFormWorld(), NULL, effectSize);
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(smokeEffectDef, GetXFormWorld(), effectSize);
 		emitter->SetRenderGroup(RenderGroup_foregroundEffect);
 	}
 	{
@@ -181,7 +181,7 @@ void Enemy::Kill()
 			PI, PI,
 			PARTICLE_FLAG_ADDITIVE
 		);
-		ParticleEmitter* emitter = new ParticleEmitter(explosionEffectDef, GetXFormWorld(), NULL, effectSize);
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(explosionEffectDef, GetXFormWorld(), effectSize);
 		emitter->SetRenderGroup(RenderGroup_foregroundAdditiveEffect);
 	}
 	{
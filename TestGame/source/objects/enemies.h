@@ -21,6 +21,7 @@ public:
 	
 	bool ShouldCollideSight() const { return false; }
 	void CollisionAdd(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Add; }
 	static WCHAR* StubDescription() { return L"simple enemy that moves towards player"; }
 	
 	static bool IsSerializable() { return true; } 
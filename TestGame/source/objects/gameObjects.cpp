@@ -583,7 +583,7 @@ void Crate::Explode()
 			PI, PI, PARTICLE_FLAG_CAST_SHADOWS, -0.04f			// cone angles, flags and gravity
 		);
 		smokeEffectDef.particleSpeedRandomness = 1.0f;
-		ParticleEmitter* emitter = new ParticleEmitter(smokeEffectDef, GetXFormWorld(), NULL, effectSize);
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(smokeEffectDef, GetXFormWorld(), effectSize);
 		emitter->SetRenderGroup(RenderGroup_foregroundEffect);
 	}
 	{
@@ -603,7 +603,7 @@ void Crate::Explode()
 			PI, PI,
 			PARTICLE_FLAG_ADDITIVE
 		);
-		ParticleEmitter* emitter = new ParticleEmitter(explosionEffectDef, GetXFormWorld(), NULL, effectSize);
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(explosionEffectDef, GetXFormWorld(), effectSize);
 		emitter->SetRenderGroup(RenderGroup_foregroundAdditiveEffect);
 	}
 	{
@@ -25,6 +25,7 @@ public:
 	void Render() {}
 	bool ShouldCollideSight() const { return false; }
 	void CollisionAdd(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Add|CollisionCallback_ShouldCollide; }
 	bool ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const
 	{
 		return otherObject.IsPlayer() && otherFixture;
@@ -125,6 +126,7 @@ public:
 	void Update();
 	void Render();
 	virtual void CollisionAdd(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Add; }
 	static WCHAR* StubDescription() { return L"attributes text will display when switch is triggered"; }
 	static WCHAR* StubAttributesDescription() { return L"text"; }
 	void ForceActivate(bool activate) { if (activate) forceActivateTimer.Set(); }
@@ -155,6 +157,7 @@ public:
 	void Render();
 	GameObject* SpawnObject();
 	virtual void CollisionAdd(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Add; }
 	static WCHAR* StubDescription() { return L"Spawns objects of a given type"; }
 	static WCHAR* StubAttributesDescription() { return L"type size offset speed max randomness rate auto"; }
 	static void StubRender(const GameObjectStub& stub, float alpha);
@@ -195,6 +198,7 @@ public:
 	void Kill();
 	void Explode();
 	void CollisionResult(GameObject& otherObject, const ContactResult& contactResult, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Result; }
 	
 	static bool IsSerializable() { return true; } 
 	static WCHAR* StubDescription() { return L"A physical crate."; }
@@ -225,6 +229,7 @@ public:
 	{ return otherObject.IsPlayer(); } // only collide with player
 
 	void CollisionPersist(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
+	static int GetCollisionCallbacks() { return CollisionCallback_Persist|CollisionCallback_ShouldCollide; }
 	
 	static WCHAR* StubDescription() { return L"Trigger box area used for the mosh pit test."; }
 
@@ -13,6 +13,9 @@
 static bool godMode = false;
 ConsoleCommand(godMode, godMode);
 
+static bool playerSpreadGun = false;
+ConsoleCommand(playerSpreadGun, playerSpreadGun);
+
 void Player::Init()
 {
 	equippedWeapon = NULL;
@@ -20,6 +23,7 @@ void Player::Init()
 
 	// basic object settings
 	SetTeam(GameTeam_player);
+	SetCollisionCallbacks(CollisionCallback_ShouldCollide);
 	lifeTimer.Set();
 	light = NULL;
 
@@ -47,7 +51,10 @@ void Player::Init()
 	}
 	{	
 		// set up the player's weapon
-		equippedWeapon = new PlayerGun(Vector2(0,radius), this);
+		if (playerSpreadGun)
+			equippedWeapon = new SpreadGun(Vector2(0,radius), this);
+		else
+			equippedWeapon = new PlayerGun(Vector2(0,radius), this);
 	}
 	if (!g_gameControl->IsEditMode())
 	{
@@ -341,7 +348,7 @@ void Player::Kill()
 			PI, PI, PARTICLE_FLAG_CAST_SHADOWS, -0.04f			// cone angles, flags and gravity
 		);
 		smokeEffectDef.particleSpeedRandomness = 1.0f;
-		ParticleEmitter* emitter = new ParticleEmitter(smokeEffectDef, GetXFormWorld());
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(smokeEffectDef, GetXFormWorld());
 		emitter->SetRenderGroup(RenderGroup_foregroundEffect);
 	}
 	{
@@ -361,7 +368,7 @@ void Player::Kill()
 			PI,		PI,			// emit angle & particle angle
 			PARTICLE_FLAG_ADDITIVE
 		);
-		ParticleEmitter* emitter = new ParticleEmitter(explosionEffectDef, GetXFormWorld());
+		ParticleEmitter* emitter = ParticleEmitter::SpawnOneShot(explosionEffectDef, GetXFormWorld());
 		emitter->SetRenderGroup(RenderGroup_foregroundAdditiveEffect);
 	}
 	{
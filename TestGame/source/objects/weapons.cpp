@@ -128,6 +128,67 @@ void PlayerGunProjectile::Render()
 	g_render->RenderQuad(xf, Vector2(radius*2.0f), Color::White(), GameTexture_Circle);
 }
 
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	SpreadGun
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+int SpreadGun::bulletsPerShot = 12;
+ConsoleCommand(SpreadGun::bulletsPerShot, spreadGunBullets);
+
+const ParticleSystemDef SpreadGun::hitEffect = ParticleSystemDef::Build
+(
+	GameTexture_Smoke,	// particle texture
+	Color::Cyan(),		// color1 start
+	Color::White(),		// color2 start
+	Color::Blue(0),		// color1 end
+	Color::Cyan(0),		// color2 end
+	0.1f,	0.0f,		// particle life time & percent fade in rate
+	.3f,	.1f,		// particle start & end size
+	0,		1,			// particle start linear & angular speed
+	0.01f,	0.02f,		// emit rate & time
+	0.1f,	0.1f,		// emit size & overall randomness
+	0, PI,				// emit angle & particle angle
+	PARTICLE_FLAG_ADDITIVE // flags & gravity
+);
+
+const WeaponDef SpreadGun::weaponStaticDef
+(
+	0.1f,					// fire rate
+	5,						// damage
+	20,						// projectile speed
+	0.05f,					// projectile size
+	0.02f,					// fire angle
+	true,					// fire automatic
+	true,					// is it a bullet
+	SoundControl_test,		// fire sound
+	NULL,					// trail effect
+	NULL,					// fire effect
+	NULL,					// smoke effect
+	&SpreadGun::hitEffect,	// weapon hit effect
+	SoundControl_Invalid,	// weapon hit sound
+	true					// lightweight bullets
+);
+
+SpreadGun::SpreadGun(const XForm2& xf, GameObject* _parent) :
+	Weapon(weaponStaticDef, xf, _parent)
+{
+}
+
+GameObject* SpreadGun::LaunchProjectile(const XForm2& xf)
+{
+	// fan out a bunch of bullets, the bullet manager handles them without any objects
+	const float spreadAngle = 0.5f*PI;
+	for (int i = 0; i < bulletsPerShot; ++i)
+	{
+		const float p = bulletsPerShot > 1? i / float(bulletsPerShot - 1) : 0.5f;
+		Weapon::LaunchProjectile(XForm2(Vector2(0), spreadAngle*(p - 0.5f)) * xf);
+	}
+
+	return NULL;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////
 /*
 	Explosion
@@ -138,7 +199,7 @@ static bool explosionDebug = false;
 ConsoleCommand(explosionDebug, explosionDebug);
 
 Explosion::Explosion(const XForm2& xf, float _force, float _radius, float _damage, GameObject* _attacker, float _time, bool _damageSelf) :
-	GameObject(xf),
+	GameObject(xf, NULL, GOT_Explosion),
 	force(_force),
 	radius(_radius),
 	damage(_damage),
@@ -154,6 +215,9 @@ Explosion::Explosion(const XForm2& xf, float _force, float _radius, float _damag
 
 	if (_attacker)
 		SetTeam(_attacker->GetTeam());
+
+	// the collision matrix keeps it from hitting projectiles and sensors, being static it never hits other static objects
+	SetCollisionCallbacks(CollisionCallback_All & ~CollisionCallback_ShouldCollide);
 	
 	CreatePhysicsBody(xf, b2_staticBody);
 	b2CircleShape shapeDef;
@@ -269,6 +333,10 @@ Debris::Debris(const XForm2& xf, float speed, GameObject* attacker, float radius
 	brightness(_brightness)
 {
 	lifeTimer.Set(RAND_BETWEEN(2.5f, 3.0f));
+
+	// only collides with terrain, the collision matrix handles that
+	SetType(GOT_Debris);
+	SetCollisionCallbacks(CollisionCallback_All & ~CollisionCallback_ShouldCollide);
 }
 
 void Debris::Update()
@@ -297,8 +365,3 @@ void Debris::HitObject(GameObject& object)
 		lifeTimer.Set(1.0f);
 }
 
-bool Debris::ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const
-{
-	// only collide with terrain
-	return (otherObject.IsStatic());
-}
@@ -39,6 +39,28 @@ public:
 	void Render();
 };
 
+////////////////////////////////////////////////////////////////////////////////////////
+/*
+	Spread Gun
+*/
+////////////////////////////////////////////////////////////////////////////////////////
+
+class SpreadGun : public Weapon
+{
+public:
+
+	SpreadGun(const XForm2& xf = XForm2::Identity(), GameObject* _parent = NULL);
+
+	static int bulletsPerShot;
+
+private:
+
+	GameObject* LaunchProjectile(const XForm2& xf);
+
+	static const WeaponDef weaponStaticDef;
+	static const ParticleSystemDef hitEffect;
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////////////
 /*
@@ -60,11 +82,6 @@ private:
 	void CollisionAdd(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
 	void CollisionPersist(GameObject& otherObject, const ContactEvent& contactEvent, b2Fixture* myFixture, b2Fixture* otherFixture);
 
-	bool ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const
-	{
-		return !(otherObject.IsStatic() || otherObject.IsProjectile() || (otherFixture && otherFixture->IsSensor()));
-	}
-
 	float force;
 	float radius;
 	float damage;
@@ -93,7 +110,6 @@ private:
 	void Render();
 	void Update();
 	void HitObject(GameObject& object);
-	bool ShouldCollide(const GameObject& otherObject, const b2Fixture* myFixture, const b2Fixture* otherFixture) const;
 
 	float brightness;
 	GameTimerPercent lifeTimer;
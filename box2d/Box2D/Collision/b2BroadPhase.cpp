@@ -40,9 +40,10 @@ b2BroadPhase::~b2BroadPhase()
 	b2Free(m_pairBuffer);
 }
 
-int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData)
+int32 b2BroadPhase::CreateProxy(const b2AABB& aabb, void* userData, bool isStatic)
 {
-	int32 proxyId = m_tree.CreateProxy(aabb, userData);
+	b2DynamicTree& tree = isStatic ? m_staticTree : m_dynamicTree;
+	int32 proxyId = b2MakeProxyId(tree.CreateProxy(aabb, userData), isStatic);
 	++m_proxyCount;
 	BufferMove(proxyId);
 	return proxyId;
@@ -52,12 +53,58 @@ void b2BroadPhase::DestroyProxy(int32 proxyId)
 {
 	UnBufferMove(proxyId);
 	--m_proxyCount;
-	m_tree.DestroyProxy(proxyId);
+	GetTree(proxyId).DestroyProxy(b2GetProxyNodeId(proxyId));
+}
+
+void b2BroadPhase::CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds)
+{
+	m_staticTree.CreateProxies(aabbs, userData, count, proxyIds);
+	m_proxyCount += count;
+	for (int32 i = 0; i < count; ++i)
+	{
+		proxyIds[i] = b2MakeProxyId(proxyIds[i], true);
+		BufferMove(proxyIds[i]);
+	}
+}
+
+void b2BroadPhase::DestroyProxies(const int32* proxyIds, int32 count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	int32* ids = (int32*)b2Alloc(count * sizeof(int32));
+	memcpy(ids, proxyIds, count * sizeof(int32));
+
+	if (m_moveCount > 0)
+	{
+		// Clear out any buffered moves in one pass instead of a search per proxy.
+		std::sort(ids, ids + count);
+		for (int32 i = 0; i < m_moveCount; ++i)
+		{
+			if (std::binary_search(ids, ids + count, m_moveBuffer[i]))
+			{
+				m_moveBuffer[i] = e_nullProxy;
+			}
+		}
+	}
+
+	// The tree only knows about node ids.
+	for (int32 i = 0; i < count; ++i)
+	{
+		b2Assert(b2IsStaticProxy(ids[i]));
+		ids[i] = b2GetProxyNodeId(ids[i]);
+	}
+
+	m_proxyCount -= count;
+	m_staticTree.DestroyProxies(ids, count);
+	b2Free(ids);
 }
 
 void b2BroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
-	bool buffer = m_tree.MoveProxy(proxyId, aabb, displacement);
+	bool buffer = GetTree(proxyId).MoveProxy(b2GetProxyNodeId(proxyId), aabb, displacement);
 	if (buffer)
 	{
 		BufferMove(proxyId);
@@ -97,8 +144,10 @@ void b2BroadPhase::UnBufferMove(int32 proxyId)
 }
 
 // This is called from b2DynamicTree::Query when we are gathering pairs.
-bool b2BroadPhase::QueryCallback(int32 proxyId)
+bool b2BroadPhase::QueryCallback(int32 nodeId)
 {
+	int32 proxyId = b2MakeProxyId(nodeId, m_queryStatic);
+
 	// A proxy cannot form a pair with itself.
 	if (proxyId == m_queryProxyId)
 	{
@@ -121,3 +170,50 @@ bool b2BroadPhase::QueryCallback(int32 proxyId)
 
 	return true;
 }
+
+int32 b2BroadPhase::GetStateSize() const
+{
+	return 2 * sizeof(int32) + m_moveCount * sizeof(int32) + m_staticTree.GetStateSize() + m_dynamicTree.GetStateSize();
+}
+
+void b2BroadPhase::SaveState(void* buffer) const
+{
+	char* p = (char*)buffer;
+	memcpy(p, &m_proxyCount, sizeof(int32));
+	p += sizeof(int32);
+	memcpy(p, &m_moveCount, sizeof(int32));
+	p += sizeof(int32);
+	memcpy(p, m_moveBuffer, m_moveCount * sizeof(int32));
+	p += m_moveCount * sizeof(int32);
+
+	m_staticTree.SaveState(p);
+	p += m_staticTree.GetStateSize();
+	m_dynamicTree.SaveState(p);
+}
+
+void b2BroadPhase::RestoreState(const void* buffer)
+{
+	const char* p = (const char*)buffer;
+	memcpy(&m_proxyCount, p, sizeof(int32));
+	p += sizeof(int32);
+
+	int32 moveCount;
+	memcpy(&moveCount, p, sizeof(int32));
+	p += sizeof(int32);
+	if (moveCount > m_moveCapacity)
+	{
+		b2Free(m_moveBuffer);
+		while (m_moveCapacity < moveCount)
+		{
+			m_moveCapacity *= 2;
+		}
+		m_moveBuffer = (int32*)b2Alloc(m_moveCapacity * sizeof(int32));
+	}
+	m_moveCount = moveCount;
+	memcpy(m_moveBuffer, p, m_moveCount * sizeof(int32));
+	p += m_moveCount * sizeof(int32);
+
+	m_staticTree.RestoreState(p);
+	p += m_staticTree.GetStateSize();
+	m_dynamicTree.RestoreState(p);
+}
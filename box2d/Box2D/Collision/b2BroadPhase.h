@@ -31,9 +31,28 @@ struct b2Pair
 	int32 next;
 };
 
+/// Proxy ids keep which tree they are in as the low bit so they are unique across both trees.
+inline int32 b2MakeProxyId(int32 nodeId, bool isStatic)
+{
+	return (nodeId << 1) | (isStatic ? 1 : 0);
+}
+
+inline int32 b2GetProxyNodeId(int32 proxyId)
+{
+	return proxyId >> 1;
+}
+
+inline bool b2IsStaticProxy(int32 proxyId)
+{
+	return (proxyId & 1) != 0;
+}
+
 /// The broad-phase is used for computing pairs and performing volume queries and ray casts.
 /// This broad-phase does not persist pairs. Instead, this reports potentially new pairs.
 /// It is up to the client to consume the new pairs and to track subsequent overlap.
+/// Static proxies are kept in their own tree which rarely changes. Moving proxies query
+/// both trees for pairs but static proxies only query the dynamic tree, so static
+/// pairs are never generated.
 class b2BroadPhase
 {
 public:
@@ -47,12 +66,20 @@ public:
 	~b2BroadPhase();
 
 	/// Create a proxy with an initial AABB. Pairs are not reported until
-	/// UpdatePairs is called.
-	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	/// UpdatePairs is called. Static proxies go in the static tree.
+	int32 CreateProxy(const b2AABB& aabb, void* userData, bool isStatic = false);
 
 	/// Destroy a proxy. It is up to the client to remove any pairs.
 	void DestroyProxy(int32 proxyId);
 
+	/// Create many static proxies at once as one balanced subtree of the static tree.
+	/// Pairs are not reported until UpdatePairs is called.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds);
+
+	/// Destroy many proxies at once. Proxies made together by CreateProxies
+	/// are removed in one step. It is up to the client to remove any pairs.
+	void DestroyProxies(const int32* proxyIds, int32 count);
+
 	/// Call MoveProxy as many times as you like, then when you are done
 	/// call UpdatePairs to finalized the proxy pairs (for your time step).
 	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
@@ -91,15 +118,24 @@ public:
 	template <typename T>
 	void RayCast(T* callback, const b2RayCastInput& input) const;
 
-	/// Get the height of the embedded tree.
+	/// Get the height of the taller embedded tree.
 	int32 GetTreeHeight() const;
 
-	/// Get the balance of the embedded tree.
+	/// Get the worst balance of the embedded trees.
 	int32 GetTreeBalance() const;
 
-	/// Get the quality metric of the embedded tree.
+	/// Get the worst quality metric of the embedded trees.
 	float32 GetTreeQuality() const;
 
+	/// Get the number of bytes needed to save the trees and buffered moves.
+	int32 GetStateSize() const;
+
+	/// Save the trees and buffered moves into a buffer of GetStateSize() bytes.
+	void SaveState(void* buffer) const;
+
+	/// Restore the trees and buffered moves saved by SaveState.
+	void RestoreState(const void* buffer);
+
 private:
 
 	friend class b2DynamicTree;
@@ -107,9 +143,13 @@ private:
 	void BufferMove(int32 proxyId);
 	void UnBufferMove(int32 proxyId);
 
-	bool QueryCallback(int32 proxyId);
+	bool QueryCallback(int32 nodeId);
+
+	const b2DynamicTree& GetTree(int32 proxyId) const;
+	b2DynamicTree& GetTree(int32 proxyId);
 
-	b2DynamicTree m_tree;
+	b2DynamicTree m_staticTree;
+	b2DynamicTree m_dynamicTree;
 
 	int32 m_proxyCount;
 
@@ -122,6 +162,47 @@ private:
 	int32 m_pairCount;
 
 	int32 m_queryProxyId;
+	bool m_queryStatic;
+};
+
+/// Passes tree queries on to the client with broad-phase proxy ids.
+template <typename T>
+struct b2BroadPhaseQueryWrapper
+{
+	bool QueryCallback(int32 nodeId)
+	{
+		m_proceed = m_callback->QueryCallback(b2MakeProxyId(nodeId, m_isStatic));
+		return m_proceed;
+	}
+
+	T* m_callback;
+	bool m_isStatic;
+	bool m_proceed;
+};
+
+/// Passes tree ray casts on to the client with broad-phase proxy ids
+/// and keeps track of the clipped fraction so it carries over to the next tree.
+template <typename T>
+struct b2BroadPhaseRayCastWrapper
+{
+	float32 RayCastCallback(const b2RayCastInput& input, int32 nodeId)
+	{
+		float32 value = m_callback->RayCastCallback(input, b2MakeProxyId(nodeId, m_isStatic));
+		if (value == 0.0f)
+		{
+			m_terminated = true;
+		}
+		else if (value > 0.0f)
+		{
+			m_maxFraction = value;
+		}
+		return value;
+	}
+
+	T* m_callback;
+	bool m_isStatic;
+	bool m_terminated;
+	float32 m_maxFraction;
 };
 
 /// This is used to sort pairs.
@@ -140,21 +221,31 @@ inline bool b2PairLessThan(const b2Pair& pair1, const b2Pair& pair2)
 	return false;
 }
 
+inline const b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId) const
+{
+	return b2IsStaticProxy(proxyId) ? m_staticTree : m_dynamicTree;
+}
+
+inline b2DynamicTree& b2BroadPhase::GetTree(int32 proxyId)
+{
+	return b2IsStaticProxy(proxyId) ? m_staticTree : m_dynamicTree;
+}
+
 inline void* b2BroadPhase::GetUserData(int32 proxyId) const
 {
-	return m_tree.GetUserData(proxyId);
+	return GetTree(proxyId).GetUserData(b2GetProxyNodeId(proxyId));
 }
 
 inline bool b2BroadPhase::TestOverlap(int32 proxyIdA, int32 proxyIdB) const
 {
-	const b2AABB& aabbA = m_tree.GetFatAABB(proxyIdA);
-	const b2AABB& aabbB = m_tree.GetFatAABB(proxyIdB);
+	const b2AABB& aabbA = GetFatAABB(proxyIdA);
+	const b2AABB& aabbB = GetFatAABB(proxyIdB);
 	return b2TestOverlap(aabbA, aabbB);
 }
 
 inline const b2AABB& b2BroadPhase::GetFatAABB(int32 proxyId) const
 {
-	return m_tree.GetFatAABB(proxyId);
+	return GetTree(proxyId).GetFatAABB(b2GetProxyNodeId(proxyId));
 }
 
 inline int32 b2BroadPhase::GetProxyCount() const
@@ -164,17 +255,17 @@ inline int32 b2BroadPhase::GetProxyCount() const
 
 inline int32 b2BroadPhase::GetTreeHeight() const
 {
-	return m_tree.GetHeight();
+	return b2Max(m_staticTree.GetHeight(), m_dynamicTree.GetHeight());
 }
 
 inline int32 b2BroadPhase::GetTreeBalance() const
 {
-	return m_tree.GetMaxBalance();
+	return b2Max(m_staticTree.GetMaxBalance(), m_dynamicTree.GetMaxBalance());
 }
 
 inline float32 b2BroadPhase::GetTreeQuality() const
 {
-	return m_tree.GetAreaRatio();
+	return b2Max(m_staticTree.GetAreaRatio(), m_dynamicTree.GetAreaRatio());
 }
 
 template <typename T>
@@ -194,10 +285,18 @@ void b2BroadPhase::UpdatePairs(T* callback)
 
 		// We have to query the tree with the fat AABB so that
 		// we don't fail to create a pair that may touch later.
-		const b2AABB& fatAABB = m_tree.GetFatAABB(m_queryProxyId);
+		const b2AABB& fatAABB = GetFatAABB(m_queryProxyId);
 
-		// Query tree, create pairs and add them pair buffer.
-		m_tree.Query(this, fatAABB);
+		// Query trees, create pairs and add them pair buffer.
+		// Static proxies only need to pair with moving ones.
+		m_queryStatic = false;
+		m_dynamicTree.Query(this, fatAABB);
+
+		if (b2IsStaticProxy(m_queryProxyId) == false)
+		{
+			m_queryStatic = true;
+			m_staticTree.Query(this, fatAABB);
+		}
 	}
 
 	// Reset move buffer
@@ -211,8 +310,8 @@ void b2BroadPhase::UpdatePairs(T* callback)
 	while (i < m_pairCount)
 	{
 		b2Pair* primaryPair = m_pairBuffer + i;
-		void* userDataA = m_tree.GetUserData(primaryPair->proxyIdA);
-		void* userDataB = m_tree.GetUserData(primaryPair->proxyIdB);
+		void* userDataA = GetUserData(primaryPair->proxyIdA);
+		void* userDataB = GetUserData(primaryPair->proxyIdB);
 
 		callback->AddPair(userDataA, userDataB);
 		++i;
@@ -236,13 +335,39 @@ void b2BroadPhase::UpdatePairs(T* callback)
 template <typename T>
 inline void b2BroadPhase::Query(T* callback, const b2AABB& aabb) const
 {
-	m_tree.Query(callback, aabb);
+	b2BroadPhaseQueryWrapper<T> wrapper;
+	wrapper.m_callback = callback;
+	wrapper.m_isStatic = false;
+	wrapper.m_proceed = true;
+	m_dynamicTree.Query(&wrapper, aabb);
+
+	if (wrapper.m_proceed)
+	{
+		wrapper.m_isStatic = true;
+		m_staticTree.Query(&wrapper, aabb);
+	}
 }
 
 template <typename T>
 inline void b2BroadPhase::RayCast(T* callback, const b2RayCastInput& input) const
 {
-	m_tree.RayCast(callback, input);
+	b2BroadPhaseRayCastWrapper<T> wrapper;
+	wrapper.m_callback = callback;
+	wrapper.m_isStatic = true;
+	wrapper.m_terminated = false;
+	wrapper.m_maxFraction = input.maxFraction;
+	m_staticTree.RayCast(&wrapper, input);
+
+	if (wrapper.m_terminated)
+	{
+		return;
+	}
+
+	// Hits in the dynamic tree must be closer than the closest static hit.
+	b2RayCastInput subInput = input;
+	subInput.maxFraction = wrapper.m_maxFraction;
+	wrapper.m_isStatic = false;
+	m_dynamicTree.RayCast(&wrapper, subInput);
 }
 
 #endif
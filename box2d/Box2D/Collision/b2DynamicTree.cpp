@@ -20,6 +20,7 @@
 #include <Box2D/Collision/b2DynamicTree.h>
 #include <cstring>
 #include <cfloat>
+#include <algorithm>
 using namespace std;
 
 
@@ -88,6 +89,7 @@ int32 b2DynamicTree::AllocateNode()
 	m_nodes[nodeId].child2 = b2_nullNode;
 	m_nodes[nodeId].height = 0;
 	m_nodes[nodeId].userData = NULL;
+	m_nodes[nodeId].pinned = false;
 	++m_nodeCount;
 	return nodeId;
 }
@@ -131,6 +133,178 @@ void b2DynamicTree::DestroyProxy(int32 proxyId)
 	FreeNode(proxyId);
 }
 
+// Orders leaves by the center of their aabb along one axis.
+struct b2TreeCenterLess
+{
+	b2TreeCenterLess(const b2TreeNode* nodes, int32 axis) : m_nodes(nodes), m_axis(axis) {}
+
+	bool operator () (int32 a, int32 b) const
+	{
+		const b2AABB& aabbA = m_nodes[a].aabb;
+		const b2AABB& aabbB = m_nodes[b].aabb;
+		if (m_axis == 0)
+		{
+			return aabbA.lowerBound.x + aabbA.upperBound.x < aabbB.lowerBound.x + aabbB.upperBound.x;
+		}
+		return aabbA.lowerBound.y + aabbA.upperBound.y < aabbB.lowerBound.y + aabbB.upperBound.y;
+	}
+
+	const b2TreeNode* m_nodes;
+	int32 m_axis;
+};
+
+// Build a balanced subtree over leaves that are not in the tree yet.
+// Returns the root of the subtree.
+int32 b2DynamicTree::BuildSubtree(int32* leaves, int32 count)
+{
+	b2Assert(count > 0);
+	if (count == 1)
+	{
+		return leaves[0];
+	}
+
+	// Split along the longest axis of the leaf centers.
+	b2Vec2 lower = m_nodes[leaves[0]].aabb.GetCenter();
+	b2Vec2 upper = lower;
+	for (int32 i = 1; i < count; ++i)
+	{
+		b2Vec2 c = m_nodes[leaves[i]].aabb.GetCenter();
+		lower = b2Min(lower, c);
+		upper = b2Max(upper, c);
+	}
+	b2Vec2 d = upper - lower;
+	int32 axis = d.x > d.y ? 0 : 1;
+
+	// Put the median in place so both halves have the same number of leaves.
+	int32 half = count / 2;
+	nth_element(leaves, leaves + half, leaves + count, b2TreeCenterLess(m_nodes, axis));
+
+	int32 child1 = BuildSubtree(leaves, half);
+	int32 child2 = BuildSubtree(leaves + half, count - half);
+
+	int32 parent = AllocateNode();
+	m_nodes[parent].child1 = child1;
+	m_nodes[parent].child2 = child2;
+	m_nodes[parent].aabb.Combine(m_nodes[child1].aabb, m_nodes[child2].aabb);
+	m_nodes[parent].height = 1 + b2Max(m_nodes[child1].height, m_nodes[child2].height);
+	m_nodes[child1].parent = parent;
+	m_nodes[child2].parent = parent;
+	return parent;
+}
+
+void b2DynamicTree::CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	for (int32 i = 0; i < count; ++i)
+	{
+		int32 proxyId = AllocateNode();
+		m_nodes[proxyId].aabb.lowerBound = aabbs[i].lowerBound - r;
+		m_nodes[proxyId].aabb.upperBound = aabbs[i].upperBound + r;
+		m_nodes[proxyId].userData = userData[i];
+		m_nodes[proxyId].height = 0;
+		proxyIds[i] = proxyId;
+	}
+
+	// The build reorders the leaves so work on a copy.
+	int32* leaves = (int32*)b2Alloc(count * sizeof(int32));
+	memcpy(leaves, proxyIds, count * sizeof(int32));
+	int32 subtree = BuildSubtree(leaves, count);
+	b2Free(leaves);
+
+	m_nodes[subtree].pinned = count > 1;
+	InsertLeaf(subtree);
+}
+
+// Returns the pinned subtree holding exactly these proxies, or b2_nullNode.
+int32 b2DynamicTree::FindPinnedSubtree(const int32* proxyIds, int32 count) const
+{
+	int32 subtree = proxyIds[0];
+	while (subtree != b2_nullNode && m_nodes[subtree].pinned == false)
+	{
+		subtree = m_nodes[subtree].parent;
+	}
+
+	if (subtree == b2_nullNode)
+	{
+		return b2_nullNode;
+	}
+
+	// Every proxy must be under the subtree.
+	for (int32 i = 1; i < count; ++i)
+	{
+		int32 index = proxyIds[i];
+		while (index != b2_nullNode && index != subtree)
+		{
+			index = m_nodes[index].parent;
+		}
+
+		if (index != subtree)
+		{
+			return b2_nullNode;
+		}
+	}
+
+	// And the subtree must not hold any other leaves.
+	int32 leafCount = 0;
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(subtree);
+	while (stack.GetCount() > 0)
+	{
+		const b2TreeNode* node = m_nodes + stack.Pop();
+		if (node->IsLeaf())
+		{
+			++leafCount;
+		}
+		else
+		{
+			stack.Push(node->child1);
+			stack.Push(node->child2);
+		}
+	}
+
+	return leafCount == count ? subtree : b2_nullNode;
+}
+
+void b2DynamicTree::DestroyProxies(const int32* proxyIds, int32 count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	int32 subtree = count > 1 ? FindPinnedSubtree(proxyIds, count) : b2_nullNode;
+	if (subtree == b2_nullNode)
+	{
+		// Something moved or was removed since the subtree was built.
+		for (int32 i = 0; i < count; ++i)
+		{
+			DestroyProxy(proxyIds[i]);
+		}
+		return;
+	}
+
+	// Detach the whole subtree and free all of its nodes.
+	RemoveLeaf(subtree);
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(subtree);
+	while (stack.GetCount() > 0)
+	{
+		int32 nodeId = stack.Pop();
+		if (m_nodes[nodeId].IsLeaf() == false)
+		{
+			stack.Push(m_nodes[nodeId].child1);
+			stack.Push(m_nodes[nodeId].child2);
+		}
+		FreeNode(nodeId);
+	}
+}
+
 bool b2DynamicTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
 {
 	b2Assert(0 <= proxyId && proxyId < m_nodeCapacity);
@@ -191,7 +365,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 	// Find the best sibling for this node
 	b2AABB leafAABB = m_nodes[leaf].aabb;
 	int32 index = m_root;
-	while (m_nodes[index].IsLeaf() == false)
+	while (m_nodes[index].IsLeaf() == false && m_nodes[index].pinned == false)
 	{
 		int32 child1 = m_nodes[index].child1;
 		int32 child2 = m_nodes[index].child2;
@@ -210,7 +384,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 		// Cost of descending into child1
 		float32 cost1;
-		if (m_nodes[child1].IsLeaf())
+		if (m_nodes[child1].IsLeaf() || m_nodes[child1].pinned)
 		{
 			b2AABB aabb;
 			aabb.Combine(leafAABB, m_nodes[child1].aabb);
@@ -227,7 +401,7 @@ void b2DynamicTree::InsertLeaf(int32 leaf)
 
 		// Cost of descending into child2
 		float32 cost2;
-		if (m_nodes[child2].IsLeaf())
+		if (m_nodes[child2].IsLeaf() || m_nodes[child2].pinned)
 		{
 			b2AABB aabb;
 			aabb.Combine(leafAABB, m_nodes[child2].aabb);
@@ -337,6 +511,12 @@ void b2DynamicTree::RemoveLeaf(int32 leaf)
 		sibling = m_nodes[parent].child1;
 	}
 
+	// The sibling takes over as the root of a pinned subtree.
+	if (m_nodes[parent].pinned)
+	{
+		m_nodes[sibling].pinned = true;
+	}
+
 	if (grandParent != b2_nullNode)
 	{
 		// Destroy parent and connect sibling to grandParent.
@@ -383,7 +563,7 @@ int32 b2DynamicTree::Balance(int32 iA)
 	b2Assert(iA != b2_nullNode);
 
 	b2TreeNode* A = m_nodes + iA;
-	if (A->IsLeaf() || A->height < 2)
+	if (A->IsLeaf() || A->height < 2 || A->pinned)
 	{
 		return iA;
 	}
@@ -398,8 +578,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 
 	int32 balance = C->height - B->height;
 
-	// Rotate C up
-	if (balance > 1)
+	// Rotate C up, unless that would split a pinned subtree
+	if (balance > 1 && C->pinned == false)
 	{
 		int32 iF = C->child1;
 		int32 iG = C->child2;
@@ -458,8 +638,8 @@ int32 b2DynamicTree::Balance(int32 iA)
 		return iC;
 	}
 	
-	// Rotate B up
-	if (balance < -1)
+	// Rotate B up, unless that would split a pinned subtree
+	if (balance < -1 && B->pinned == false)
 	{
 		int32 iD = B->child1;
 		int32 iE = B->child2;
@@ -712,6 +892,7 @@ void b2DynamicTree::RebuildBottomUp()
 		if (m_nodes[i].IsLeaf())
 		{
 			m_nodes[i].parent = b2_nullNode;
+			m_nodes[i].pinned = false;
 			nodes[count] = i;
 			++count;
 		}
@@ -770,3 +951,55 @@ void b2DynamicTree::RebuildBottomUp()
 
 	Validate();
 }
+
+// The tree is a pool of nodes so it can be copied as one block.
+struct b2TreeState
+{
+	int32 root;
+	int32 nodeCount;
+	int32 nodeCapacity;
+	int32 freeList;
+	uint32 path;
+	int32 insertionCount;
+};
+
+int32 b2DynamicTree::GetStateSize() const
+{
+	return sizeof(b2TreeState) + m_nodeCapacity * sizeof(b2TreeNode);
+}
+
+void b2DynamicTree::SaveState(void* buffer) const
+{
+	b2TreeState state;
+	state.root = m_root;
+	state.nodeCount = m_nodeCount;
+	state.nodeCapacity = m_nodeCapacity;
+	state.freeList = m_freeList;
+	state.path = m_path;
+	state.insertionCount = m_insertionCount;
+
+	char* p = (char*)buffer;
+	memcpy(p, &state, sizeof(b2TreeState));
+	memcpy(p + sizeof(b2TreeState), m_nodes, m_nodeCapacity * sizeof(b2TreeNode));
+}
+
+void b2DynamicTree::RestoreState(const void* buffer)
+{
+	const char* p = (const char*)buffer;
+	b2TreeState state;
+	memcpy(&state, p, sizeof(b2TreeState));
+
+	if (state.nodeCapacity != m_nodeCapacity)
+	{
+		b2Free(m_nodes);
+		m_nodeCapacity = state.nodeCapacity;
+		m_nodes = (b2TreeNode*)b2Alloc(m_nodeCapacity * sizeof(b2TreeNode));
+	}
+
+	memcpy(m_nodes, p + sizeof(b2TreeState), m_nodeCapacity * sizeof(b2TreeNode));
+	m_root = state.root;
+	m_nodeCount = state.nodeCount;
+	m_freeList = state.freeList;
+	m_path = state.path;
+	m_insertionCount = state.insertionCount;
+}
@@ -48,6 +48,10 @@ struct b2TreeNode
 
 	// leaf = 0, free node = -1
 	int32 height;
+
+	// Root of a subtree built by CreateProxies. Insertions and rotations
+	// leave it intact so it can be removed in one step.
+	bool pinned;
 };
 
 /// A dynamic AABB tree broad-phase, inspired by Nathanael Presson's btDbvt.
@@ -73,6 +77,17 @@ public:
 	/// Destroy a proxy. This asserts if the id is invalid.
 	void DestroyProxy(int32 proxyId);
 
+	/// Create many proxies at once. They are built into a balanced subtree with
+	/// median splits which is then inserted as a single node. This is much faster
+	/// than creating them one at a time and is meant for proxies that rarely move.
+	/// @param proxyIds receives the id of the proxy made for each aabb.
+	void CreateProxies(const b2AABB* aabbs, void* const* userData, int32 count, int32* proxyIds);
+
+	/// Destroy many proxies at once. If they are exactly the proxies of a subtree
+	/// made by CreateProxies the whole subtree is detached in one step, otherwise
+	/// they are destroyed one at a time.
+	void DestroyProxies(const int32* proxyIds, int32 count);
+
 	/// Move a proxy with a swepted AABB. If the proxy has moved outside of its fattened AABB,
 	/// then the proxy is removed from the tree and re-inserted. Otherwise
 	/// the function returns immediately.
@@ -118,6 +133,16 @@ public:
 	/// Build an optimal tree. Very expensive. For testing.
 	void RebuildBottomUp();
 
+	/// Get the number of bytes needed to save the tree.
+	int32 GetStateSize() const;
+
+	/// Copy the tree into a buffer of GetStateSize() bytes.
+	void SaveState(void* buffer) const;
+
+	/// Replace the tree with one saved by SaveState. The proxy user data
+	/// is copied as is so it must still be valid.
+	void RestoreState(const void* buffer);
+
 private:
 
 	int32 AllocateNode();
@@ -126,6 +151,9 @@ private:
 	void InsertLeaf(int32 node);
 	void RemoveLeaf(int32 node);
 
+	int32 BuildSubtree(int32* leaves, int32 count);
+	int32 FindPinnedSubtree(const int32* proxyIds, int32 count) const;
+
 	int32 Balance(int32 index);
 
 	int32 ComputeHeight() const;
@@ -146,6 +146,11 @@ b2Contact::b2Contact(b2Fixture* fA, int32 indexA, b2Fixture* fB, int32 indexB)
 
 	m_toiCount = 0;
 
+	m_islandIndexA = 0;
+	m_islandIndexB = 0;
+
+	m_userData = NULL;
+
 	m_friction = b2MixFriction(m_fixtureA->m_friction, m_fixtureB->m_friction);
 	m_restitution = b2MixRestitution(m_fixtureA->m_restitution, m_fixtureB->m_restitution);
 }
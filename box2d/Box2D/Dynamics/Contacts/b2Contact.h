@@ -135,6 +135,12 @@ public:
 	/// Reset the restitution to the default value.
 	void ResetRestitution();
 
+	/// Get the user data pointer. This is NULL until set, Box2D does not use it.
+	void* GetUserData() const;
+
+	/// Set the user data. Use this to store your application specific data.
+	void SetUserData(void* data);
+
 	/// Evaluate this contact with your own manifold and transforms.
 	virtual void Evaluate(b2Manifold* manifold, const b2Transform& xfA, const b2Transform& xfB) = 0;
 
@@ -142,6 +148,7 @@ protected:
 	friend class b2ContactManager;
 	friend class b2World;
 	friend class b2ContactSolver;
+	friend class b2Island;
 	friend class b2Body;
 	friend class b2Fixture;
 
@@ -177,7 +184,7 @@ protected:
 	static void Destroy(b2Contact* contact, b2Shape::Type typeA, b2Shape::Type typeB, b2BlockAllocator* allocator);
 	static void Destroy(b2Contact* contact, b2BlockAllocator* allocator);
 
-	b2Contact() : m_fixtureA(NULL), m_fixtureB(NULL) {}
+	b2Contact() : m_fixtureA(NULL), m_fixtureB(NULL), m_userData(NULL) {}
 	b2Contact(b2Fixture* fixtureA, int32 indexA, b2Fixture* fixtureB, int32 indexB);
 	virtual ~b2Contact() {}
 
@@ -207,8 +214,14 @@ protected:
 	int32 m_toiCount;
 	float32 m_toi;
 
+	// Island indices of the bodies, stored when the island is built.
+	int32 m_islandIndexA;
+	int32 m_islandIndexB;
+
 	float32 m_friction;
 	float32 m_restitution;
+
+	void* m_userData;
 };
 
 inline b2Manifold* b2Contact::GetManifold()
@@ -293,6 +306,16 @@ inline int32 b2Contact::GetChildIndexB() const
 	return m_indexB;
 }
 
+inline void* b2Contact::GetUserData() const
+{
+	return m_userData;
+}
+
+inline void b2Contact::SetUserData(void* data)
+{
+	m_userData = data;
+}
+
 inline void b2Contact::FlagForFiltering()
 {
 	m_flags |= e_filterFlag;
@@ -24,9 +24,22 @@
 #include <Box2D/Dynamics/b2Fixture.h>
 #include <Box2D/Dynamics/b2World.h>
 #include <Box2D/Common/b2StackAllocator.h>
+#include <string.h>
 
 #define B2_DEBUG_SOLVER 0
 
+// Width of the SIMD contact solver, 0 if it is not available.
+// MSVC compiles SSE2 intrinsics for x86 without /arch:SSE2, so _M_IX86 is enough.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define B2_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define B2_SIMD_WIDTH 4
+#else
+#define B2_SIMD_WIDTH 0
+#endif
+
 struct b2ContactPositionConstraint
 {
 	b2Vec2 localPoints[b2_maxManifoldPoints];
@@ -42,6 +55,11 @@ struct b2ContactPositionConstraint
 	int32 pointCount;
 };
 
+int32 b2ContactSolver::GetSimdWidth()
+{
+	return B2_SIMD_WIDTH;
+}
+
 b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 {
 	m_step = def->step;
@@ -52,6 +70,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 	m_positions = def->positions;
 	m_velocities = def->velocities;
 	m_contacts = def->contacts;
+	m_simdConstraints = NULL;
+	m_simdCount = 0;
+	m_simdOverflow = NULL;
+	m_simdOverflowCount = 0;
+	m_simdInitialized = false;
 
 	// Initialize position independent portions of the constraints.
 	for (int32 i = 0; i < m_count; ++i)
@@ -74,8 +97,8 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
 		vc->friction = contact->m_friction;
 		vc->restitution = contact->m_restitution;
-		vc->indexA = bodyA->m_islandIndex;
-		vc->indexB = bodyB->m_islandIndex;
+		vc->indexA = contact->m_islandIndexA;
+		vc->indexB = contact->m_islandIndexB;
 		vc->invMassA = bodyA->m_invMass;
 		vc->invMassB = bodyB->m_invMass;
 		vc->invIA = bodyA->m_invI;
@@ -86,8 +109,8 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 		vc->normalMass.SetZero();
 
 		b2ContactPositionConstraint* pc = m_positionConstraints + i;
-		pc->indexA = bodyA->m_islandIndex;
-		pc->indexB = bodyB->m_islandIndex;
+		pc->indexA = contact->m_islandIndexA;
+		pc->indexB = contact->m_islandIndexB;
 		pc->invMassA = bodyA->m_invMass;
 		pc->invMassB = bodyB->m_invMass;
 		pc->localCenterA = bodyA->m_sweep.localCenter;
@@ -130,6 +153,11 @@ b2ContactSolver::b2ContactSolver(b2ContactSolverDef* def)
 
 b2ContactSolver::~b2ContactSolver()
 {
+	if (m_simdConstraints)
+	{
+		m_allocator->Free(m_simdOverflow);
+		m_allocator->Free(m_simdConstraints);
+	}
 	m_allocator->Free(m_velocityConstraints);
 	m_allocator->Free(m_positionConstraints);
 }
@@ -286,318 +314,836 @@ void b2ContactSolver::WarmStart()
 	}
 }
 
-void b2ContactSolver::SolveVelocityConstraints()
+static void b2SolveVelocityConstraint(b2ContactVelocityConstraint* vc, b2Velocity* velocities)
 {
-	for (int32 i = 0; i < m_count; ++i)
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float32 mA = vc->invMassA;
+	float32 iA = vc->invIA;
+	float32 mB = vc->invMassB;
+	float32 iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = velocities[indexA].v;
+	float32 wA = velocities[indexA].w;
+	b2Vec2 vB = velocities[indexB].v;
+	float32 wB = velocities[indexB].w;
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float32 friction = vc->friction;
+
+	b2Assert(pointCount == 1 || pointCount == 2);
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
 	{
-		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		b2VelocityConstraintPoint* vcp = vc->points + j;
 
-		int32 indexA = vc->indexA;
-		int32 indexB = vc->indexB;
-		float32 mA = vc->invMassA;
-		float32 iA = vc->invIA;
-		float32 mB = vc->invMassB;
-		float32 iB = vc->invIB;
-		int32 pointCount = vc->pointCount;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-		b2Vec2 vA = m_velocities[indexA].v;
-		float32 wA = m_velocities[indexA].w;
-		b2Vec2 vB = m_velocities[indexB].v;
-		float32 wB = m_velocities[indexB].w;
+		// Compute tangent force
+		float32 vt = b2Dot(dv, tangent);
+		float32 lambda = vcp->tangentMass * (-vt);
 
-		b2Vec2 normal = vc->normal;
-		b2Vec2 tangent = b2Cross(normal, 1.0f);
-		float32 friction = vc->friction;
+		// b2Clamp the accumulated force
+		float32 maxFriction = friction * vcp->normalImpulse;
+		float32 newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
 
-		b2Assert(pointCount == 1 || pointCount == 2);
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
 
-		// Solve tangent constraints first because non-penetration is more important
-		// than friction.
-		for (int32 j = 0; j < pointCount; ++j)
-		{
-			b2VelocityConstraintPoint* vcp = vc->points + j;
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
 
-			// Relative velocity at contact
-			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
 
-			// Compute tangent force
-			float32 vt = b2Dot(dv, tangent);
-			float32 lambda = vcp->tangentMass * (-vt);
+	// Solve normal constraints
+	if (vc->pointCount == 1)
+	{
+		b2VelocityConstraintPoint* vcp = vc->points + 0;
 
-			// b2Clamp the accumulated force
-			float32 maxFriction = friction * vcp->normalImpulse;
-			float32 newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
-			lambda = newImpulse - vcp->tangentImpulse;
-			vcp->tangentImpulse = newImpulse;
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
 
-			// Apply contact impulse
-			b2Vec2 P = lambda * tangent;
+		// Compute normal impulse
+		float32 vn = b2Dot(dv, normal);
+		float32 lambda = -vcp->normalMass * (vn - vcp->velocityBias);
 
-			vA -= mA * P;
-			wA -= iA * b2Cross(vcp->rA, P);
+		// b2Clamp the accumulated impulse
+		float32 newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - vcp->normalImpulse;
+		vcp->normalImpulse = newImpulse;
 
-			vB += mB * P;
-			wB += iB * b2Cross(vcp->rB, P);
-		}
+		// Apply contact impulse
+		b2Vec2 P = lambda * normal;
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
 
-		// Solve normal constraints
-		if (vc->pointCount == 1)
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// Build the mini LCP for this contact patch
+		//
+		// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
+		//
+		// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
+		// b = vn0 - velocityBias
+		//
+		// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
+		// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
+		// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
+		// solution that satisfies the problem is chosen.
+		// 
+		// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
+		// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
+		//
+		// Substitute:
+		// 
+		// x = a + d
+		// 
+		// a := old total impulse
+		// x := new total impulse
+		// d := incremental impulse 
+		//
+		// For the current iteration we extend the formula for the incremental impulse
+		// to compute the new total impulse:
+		//
+		// vn = A * d + b
+		//    = A * (x - a) + b
+		//    = A * x + b - A * a
+		//    = A * x + b'
+		// b' = b - A * a;
+
+		b2VelocityConstraintPoint* cp1 = vc->points + 0;
+		b2VelocityConstraintPoint* cp2 = vc->points + 1;
+
+		b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+		b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+		b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float32 vn1 = b2Dot(dv1, normal);
+		float32 vn2 = b2Dot(dv2, normal);
+
+		b2Vec2 b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= b2Mul(vc->K, a);
+
+		const float32 k_errorTol = 1e-3f;
+		B2_NOT_USED(k_errorTol);
+
+		for (;;)
 		{
-			b2VelocityConstraintPoint* vcp = vc->points + 0;
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			b2Vec2 x = - b2Mul(vc->normalMass, b);
 
-			// Relative velocity at contact
-			b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+			if (x.x >= 0.0f && x.y >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-			// Compute normal impulse
-			float32 vn = b2Dot(dv, normal);
-			float32 lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-			// b2Clamp the accumulated impulse
-			float32 newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
-			lambda = newImpulse - vcp->normalImpulse;
-			vcp->normalImpulse = newImpulse;
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-			// Apply contact impulse
-			b2Vec2 P = lambda * normal;
-			vA -= mA * P;
-			wA -= iA * b2Cross(vcp->rA, P);
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
+				vn2 = b2Dot(dv2, normal);
+
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
 
-			vB += mB * P;
-			wB += iB * b2Cross(vcp->rB, P);
-		}
-		else
-		{
-			// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
-			// Build the mini LCP for this contact patch
-			//
-			// vn = A * x + b, vn >= 0, , vn >= 0, x >= 0 and vn_i * x_i = 0 with i = 1..2
-			//
-			// A = J * W * JT and J = ( -n, -r1 x n, n, r2 x n )
-			// b = vn0 - velocityBias
-			//
-			// The system is solved using the "Total enumeration method" (s. Murty). The complementary constraint vn_i * x_i
-			// implies that we must have in any solution either vn_i = 0 or x_i = 0. So for the 2D contact problem the cases
-			// vn1 = 0 and vn2 = 0, x1 = 0 and x2 = 0, x1 = 0 and vn2 = 0, x2 = 0 and vn1 = 0 need to be tested. The first valid
-			// solution that satisfies the problem is chosen.
-			// 
-			// In order to account of the accumulated impulse 'a' (because of the iterative nature of the solver which only requires
-			// that the accumulated impulse is clamped and not the incremental impulse) we change the impulse variable (x_i).
 			//
-			// Substitute:
-			// 
-			// x = a + d
-			// 
-			// a := old total impulse
-			// x := new total impulse
-			// d := incremental impulse 
+			// Case 2: vn1 = 0 and x2 = 0
 			//
-			// For the current iteration we extend the formula for the incremental impulse
-			// to compute the new total impulse:
+			//   0 = a11 * x1 + a12 * 0 + b1' 
+			// vn2 = a21 * x1 + a22 * 0 + b2'
 			//
-			// vn = A * d + b
-			//    = A * (x - a) + b
-			//    = A * x + b - A * a
-			//    = A * x + b'
-			// b' = b - A * a;
+			x.x = - cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.ex.y * x.x + b.y;
+
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
 
-			b2VelocityConstraintPoint* cp1 = vc->points + 0;
-			b2VelocityConstraintPoint* cp2 = vc->points + 1;
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-			b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
-			b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-			// Relative velocity at contact
-			b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-			b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-			// Compute normal velocity
-			float32 vn1 = b2Dot(dv1, normal);
-			float32 vn2 = b2Dot(dv2, normal);
+#if B2_DEBUG_SOLVER == 1
+				// Postconditions
+				dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
 
-			b2Vec2 b;
-			b.x = vn1 - cp1->velocityBias;
-			b.y = vn2 - cp2->velocityBias;
+				// Compute normal velocity
+				vn1 = b2Dot(dv1, normal);
 
-			// Compute b'
-			b -= b2Mul(vc->K, a);
+				b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+#endif
+				break;
+			}
 
-			const float32 k_errorTol = 1e-3f;
-			B2_NOT_USED(k_errorTol);
 
-			for (;;)
+			//
+			// Case 3: vn2 = 0 and x1 = 0
+			//
+			// vn1 = a11 * 0 + a12 * x2 + b1' 
+			//   0 = a21 * 0 + a22 * x2 + b2'
+			//
+			x.x = 0.0f;
+			x.y = - cp2->normalMass * b.y;
+			vn1 = vc->K.ey.x * x.y + b.x;
+			vn2 = 0.0f;
+
+			if (x.y >= 0.0f && vn1 >= 0.0f)
 			{
-				//
-				// Case 1: vn = 0
-				//
-				// 0 = A * x + b'
-				//
-				// Solve for x:
-				//
-				// x = - inv(A) * b'
-				//
-				b2Vec2 x = - b2Mul(vc->normalMass, b);
-
-				if (x.x >= 0.0f && x.y >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
 #if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+				// Postconditions
+				dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
-					vn2 = b2Dot(dv2, normal);
+				// Compute normal velocity
+				vn2 = b2Dot(dv2, normal);
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
+				b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
 #endif
-					break;
-				}
+				break;
+			}
 
-				//
-				// Case 2: vn1 = 0 and x2 = 0
-				//
-				//   0 = a11 * x1 + a12 * 0 + b1' 
-				// vn2 = a21 * x1 + a22 * 0 + b2'
-				//
-				x.x = - cp1->normalMass * b.x;
-				x.y = 0.0f;
-				vn1 = 0.0f;
-				vn2 = vc->K.ex.y * x.x + b.y;
-
-				if (x.x >= 0.0f && vn2 >= 0.0f)
-				{
-					// Get the incremental impulse
-					b2Vec2 d = x - a;
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			// 
+			// vn1 = b1
+			// vn2 = b2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f )
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+				break;
+			}
+
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
+		}
+	}
+
+	velocities[indexA].v = vA;
+	velocities[indexA].w = wA;
+	velocities[indexB].v = vB;
+	velocities[indexB].w = wB;
+}
 
-					// Compute normal velocity
-					vn1 = b2Dot(dv1, normal);
+void b2ContactSolver::SolveVelocityConstraints()
+{
+	if (m_step.simdContactSolver)
+	{
+		if (m_simdInitialized == false)
+		{
+			InitializeSimdConstraints();
+		}
 
-					b2Assert(b2Abs(vn1 - cp1->velocityBias) < k_errorTol);
+		if (m_simdConstraints)
+		{
+			SolveSimdVelocityConstraints();
+			return;
+		}
+	}
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		b2SolveVelocityConstraint(m_velocityConstraints + i, m_velocities);
+	}
+}
+
+#if B2_SIMD_WIDTH > 0
+
+#if B2_SIMD_WIDTH == 8
+typedef __m256 b2FloatW;
+inline b2FloatW b2LoadW(const float32* a) { return _mm256_loadu_ps(a); }
+inline void b2StoreW(float32* a, b2FloatW b) { _mm256_storeu_ps(a, b); }
+inline b2FloatW b2ZeroW() { return _mm256_setzero_ps(); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm256_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm256_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm256_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm256_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm256_max_ps(a, b); }
+inline b2FloatW b2NegW(b2FloatW a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm256_and_ps(a, b); }
+inline b2FloatW b2SelectW(b2FloatW mask, b2FloatW a, b2FloatW b) { return _mm256_blendv_ps(b, a, mask); }
+#else
+typedef __m128 b2FloatW;
+inline b2FloatW b2LoadW(const float32* a) { return _mm_loadu_ps(a); }
+inline void b2StoreW(float32* a, b2FloatW b) { _mm_storeu_ps(a, b); }
+inline b2FloatW b2ZeroW() { return _mm_setzero_ps(); }
+inline b2FloatW b2AddW(b2FloatW a, b2FloatW b) { return _mm_add_ps(a, b); }
+inline b2FloatW b2SubW(b2FloatW a, b2FloatW b) { return _mm_sub_ps(a, b); }
+inline b2FloatW b2MulW(b2FloatW a, b2FloatW b) { return _mm_mul_ps(a, b); }
+inline b2FloatW b2MinW(b2FloatW a, b2FloatW b) { return _mm_min_ps(a, b); }
+inline b2FloatW b2MaxW(b2FloatW a, b2FloatW b) { return _mm_max_ps(a, b); }
+inline b2FloatW b2NegW(b2FloatW a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+inline b2FloatW b2GreaterEqualW(b2FloatW a, b2FloatW b) { return _mm_cmpge_ps(a, b); }
+inline b2FloatW b2AndW(b2FloatW a, b2FloatW b) { return _mm_and_ps(a, b); }
+inline b2FloatW b2SelectW(b2FloatW mask, b2FloatW a, b2FloatW b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
 #endif
-					break;
-				}
 
+// Number of graph colors, constraints that don't fit are solved one at a time.
+const int32 b2_simdColorCount = 12;
 
-				//
-				// Case 3: vn2 = 0 and x1 = 0
-				//
-				// vn1 = a11 * 0 + a12 * x2 + b1' 
-				//   0 = a21 * 0 + a22 * x2 + b2'
-				//
-				x.x = 0.0f;
-				x.y = - cp2->normalMass * b.y;
-				vn1 = vc->K.ey.x * x.y + b.x;
-				vn2 = 0.0f;
+struct b2SimdVelocityPoint
+{
+	float32 rAx[B2_SIMD_WIDTH], rAy[B2_SIMD_WIDTH];
+	float32 rBx[B2_SIMD_WIDTH], rBy[B2_SIMD_WIDTH];
+	float32 normalImpulse[B2_SIMD_WIDTH];
+	float32 tangentImpulse[B2_SIMD_WIDTH];
+	float32 normalMass[B2_SIMD_WIDTH];
+	float32 tangentMass[B2_SIMD_WIDTH];
+	float32 velocityBias[B2_SIMD_WIDTH];
+};
 
-				if (x.y >= 0.0f && vn1 >= 0.0f)
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
+// Structure of arrays for a group of constraints with the same point count.
+// Unused lanes have no mass and a body index of -1 so they do nothing.
+struct b2SimdVelocityConstraint
+{
+	b2SimdVelocityPoint points[b2_maxManifoldPoints];
+	float32 normalX[B2_SIMD_WIDTH], normalY[B2_SIMD_WIDTH];
+	float32 normalMass11[B2_SIMD_WIDTH], normalMass12[B2_SIMD_WIDTH];
+	float32 normalMass21[B2_SIMD_WIDTH], normalMass22[B2_SIMD_WIDTH];
+	float32 K11[B2_SIMD_WIDTH], K12[B2_SIMD_WIDTH];
+	float32 K21[B2_SIMD_WIDTH], K22[B2_SIMD_WIDTH];
+	float32 invMassA[B2_SIMD_WIDTH], invIA[B2_SIMD_WIDTH];
+	float32 invMassB[B2_SIMD_WIDTH], invIB[B2_SIMD_WIDTH];
+	float32 friction[B2_SIMD_WIDTH];
+	int32 indexA[B2_SIMD_WIDTH];
+	int32 indexB[B2_SIMD_WIDTH];
+	int32 constraintIndex[B2_SIMD_WIDTH];
+	int32 pointCount;
+};
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+// A body can be shared by constraints in the same color if it can't be moved by them.
+static bool b2IsSimdBodyShared(float32 invMass, float32 invI)
+{
+	return invMass == 0.0f && invI == 0.0f;
+}
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+static void b2SetSimdLane(b2SimdVelocityConstraint* sc, int32 lane, const b2ContactVelocityConstraint* vc, int32 constraintIndex)
+{
+	sc->normalX[lane] = vc->normal.x;
+	sc->normalY[lane] = vc->normal.y;
+	sc->normalMass11[lane] = vc->normalMass.ex.x;
+	sc->normalMass12[lane] = vc->normalMass.ey.x;
+	sc->normalMass21[lane] = vc->normalMass.ex.y;
+	sc->normalMass22[lane] = vc->normalMass.ey.y;
+	sc->K11[lane] = vc->K.ex.x;
+	sc->K12[lane] = vc->K.ey.x;
+	sc->K21[lane] = vc->K.ex.y;
+	sc->K22[lane] = vc->K.ey.y;
+	sc->invMassA[lane] = vc->invMassA;
+	sc->invIA[lane] = vc->invIA;
+	sc->invMassB[lane] = vc->invMassB;
+	sc->invIB[lane] = vc->invIB;
+	sc->friction[lane] = vc->friction;
+	sc->indexA[lane] = vc->indexA;
+	sc->indexB[lane] = vc->indexB;
+	sc->constraintIndex[lane] = constraintIndex;
+
+	for (int32 j = 0; j < vc->pointCount; ++j)
+	{
+		const b2VelocityConstraintPoint* vcp = vc->points + j;
+		b2SimdVelocityPoint* scp = sc->points + j;
+		scp->rAx[lane] = vcp->rA.x;
+		scp->rAy[lane] = vcp->rA.y;
+		scp->rBx[lane] = vcp->rB.x;
+		scp->rBy[lane] = vcp->rB.y;
+		scp->normalImpulse[lane] = vcp->normalImpulse;
+		scp->tangentImpulse[lane] = vcp->tangentImpulse;
+		scp->normalMass[lane] = vcp->normalMass;
+		scp->tangentMass[lane] = vcp->tangentMass;
+		scp->velocityBias[lane] = vcp->velocityBias;
+	}
+}
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+void b2ContactSolver::InitializeSimdConstraints()
+{
+	m_simdInitialized = true;
 
-#if B2_DEBUG_SOLVER == 1
-					// Postconditions
-					dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+	// Small islands are faster with the scalar solver.
+	if (m_count < 2 * B2_SIMD_WIDTH)
+	{
+		return;
+	}
 
-					// Compute normal velocity
-					vn2 = b2Dot(dv2, normal);
+	// Each color and point count has at most one partly filled group.
+	int32 capacity = m_count / B2_SIMD_WIDTH + b2_maxManifoldPoints * b2_simdColorCount + 1;
+	m_simdConstraints = (b2SimdVelocityConstraint*)m_allocator->Allocate(capacity * sizeof(b2SimdVelocityConstraint));
+	m_simdOverflow = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	m_simdCount = 0;
+	m_simdOverflowCount = 0;
 
-					b2Assert(b2Abs(vn2 - cp2->velocityBias) < k_errorTol);
-#endif
-					break;
-				}
+	int32 bodyCount = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bodyCount = b2Max(bodyCount, b2Max(vc->indexA, vc->indexB) + 1);
+	}
 
-				//
-				// Case 4: x1 = 0 and x2 = 0
-				// 
-				// vn1 = b1
-				// vn2 = b2;
-				x.x = 0.0f;
-				x.y = 0.0f;
-				vn1 = b.x;
-				vn2 = b.y;
-
-				if (vn1 >= 0.0f && vn2 >= 0.0f )
-				{
-					// Resubstitute for the incremental impulse
-					b2Vec2 d = x - a;
+	// Greedy graph coloring with a bit per body for each color.
+	int32 wordCount = (bodyCount + 31) / 32;
+	uint32* bodyBits = (uint32*)m_allocator->Allocate(b2_simdColorCount * wordCount * sizeof(uint32));
+	int32* colors = (int32*)m_allocator->Allocate(m_count * sizeof(int32));
+	memset(bodyBits, 0, b2_simdColorCount * wordCount * sizeof(uint32));
 
-					// Apply incremental impulse
-					b2Vec2 P1 = d.x * normal;
-					b2Vec2 P2 = d.y * normal;
-					vA -= mA * (P1 + P2);
-					wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+		bool sharedA = b2IsSimdBodyShared(vc->invMassA, vc->invIA);
+		bool sharedB = b2IsSimdBodyShared(vc->invMassB, vc->invIB);
+		uint32 bitA = 1u << (vc->indexA & 31);
+		uint32 bitB = 1u << (vc->indexB & 31);
+
+		colors[i] = -1;
+		for (int32 c = 0; c < b2_simdColorCount; ++c)
+		{
+			uint32* bits = bodyBits + c * wordCount;
+			if ((sharedA == false && (bits[vc->indexA >> 5] & bitA)) ||
+				(sharedB == false && (bits[vc->indexB >> 5] & bitB)))
+			{
+				continue;
+			}
+
+			if (sharedA == false)
+			{
+				bits[vc->indexA >> 5] |= bitA;
+			}
+			if (sharedB == false)
+			{
+				bits[vc->indexB >> 5] |= bitB;
+			}
+			colors[i] = c;
+			break;
+		}
 
-					vB += mB * (P1 + P2);
-					wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+		if (colors[i] < 0)
+		{
+			m_simdOverflow[m_simdOverflowCount++] = i;
+		}
+	}
 
-					// Accumulate
-					cp1->normalImpulse = x.x;
-					cp2->normalImpulse = x.y;
+	// Pack each color into groups, keeping the original order within a color.
+	for (int32 c = 0; c < b2_simdColorCount; ++c)
+	{
+		for (int32 pointCount = 1; pointCount <= b2_maxManifoldPoints; ++pointCount)
+		{
+			b2SimdVelocityConstraint* sc = NULL;
+			int32 lane = B2_SIMD_WIDTH;
+			for (int32 i = 0; i < m_count; ++i)
+			{
+				const b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
+				if (colors[i] != c || vc->pointCount != pointCount)
+				{
+					continue;
+				}
 
-					break;
+				if (lane == B2_SIMD_WIDTH)
+				{
+					b2Assert(m_simdCount < capacity);
+					sc = m_simdConstraints + m_simdCount++;
+					memset(sc, 0, sizeof(b2SimdVelocityConstraint));
+					for (int32 j = 0; j < B2_SIMD_WIDTH; ++j)
+					{
+						sc->indexA[j] = -1;
+						sc->indexB[j] = -1;
+						sc->constraintIndex[j] = -1;
+					}
+					sc->pointCount = pointCount;
+					lane = 0;
 				}
 
-				// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
-				break;
+				b2SetSimdLane(sc, lane++, vc, i);
 			}
 		}
+	}
 
-		m_velocities[indexA].v = vA;
-		m_velocities[indexA].w = wA;
-		m_velocities[indexB].v = vB;
-		m_velocities[indexB].w = wB;
+	m_allocator->Free(colors);
+	m_allocator->Free(bodyBits);
+}
+
+static void b2GatherVelocities(const int32* indices, const b2Velocity* velocities, b2FloatW& vx, b2FloatW& vy, b2FloatW& w)
+{
+	float32 x[B2_SIMD_WIDTH], y[B2_SIMD_WIDTH], z[B2_SIMD_WIDTH];
+	for (int32 i = 0; i < B2_SIMD_WIDTH; ++i)
+	{
+		int32 index = indices[i];
+		if (index < 0)
+		{
+			x[i] = y[i] = z[i] = 0.0f;
+			continue;
+		}
+
+		x[i] = velocities[index].v.x;
+		y[i] = velocities[index].v.y;
+		z[i] = velocities[index].w;
+	}
+
+	vx = b2LoadW(x);
+	vy = b2LoadW(y);
+	w = b2LoadW(z);
+}
+
+static void b2ScatterVelocities(const int32* indices, b2Velocity* velocities, b2FloatW vx, b2FloatW vy, b2FloatW w)
+{
+	float32 x[B2_SIMD_WIDTH], y[B2_SIMD_WIDTH], z[B2_SIMD_WIDTH];
+	b2StoreW(x, vx);
+	b2StoreW(y, vy);
+	b2StoreW(z, w);
+
+	// Shared bodies are written more than once but their velocity didn't change.
+	for (int32 i = 0; i < B2_SIMD_WIDTH; ++i)
+	{
+		int32 index = indices[i];
+		if (index < 0)
+		{
+			continue;
+		}
+
+		velocities[index].v.x = x[i];
+		velocities[index].v.y = y[i];
+		velocities[index].w = z[i];
+	}
+}
+
+// Same math as b2SolveVelocityConstraint with every branch turned into a select.
+static void b2SolveSimdVelocityConstraint(b2SimdVelocityConstraint* sc, b2Velocity* velocities)
+{
+	b2FloatW vAx, vAy, wA, vBx, vBy, wB;
+	b2GatherVelocities(sc->indexA, velocities, vAx, vAy, wA);
+	b2GatherVelocities(sc->indexB, velocities, vBx, vBy, wB);
+
+	b2FloatW mA = b2LoadW(sc->invMassA);
+	b2FloatW iA = b2LoadW(sc->invIA);
+	b2FloatW mB = b2LoadW(sc->invMassB);
+	b2FloatW iB = b2LoadW(sc->invIB);
+	b2FloatW normalX = b2LoadW(sc->normalX);
+	b2FloatW normalY = b2LoadW(sc->normalY);
+	b2FloatW tangentX = normalY;
+	b2FloatW tangentY = b2NegW(normalX);
+	b2FloatW friction = b2LoadW(sc->friction);
+	b2FloatW zero = b2ZeroW();
+	int32 pointCount = sc->pointCount;
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2SimdVelocityPoint* scp = sc->points + j;
+		b2FloatW rAx = b2LoadW(scp->rAx);
+		b2FloatW rAy = b2LoadW(scp->rAy);
+		b2FloatW rBx = b2LoadW(scp->rBx);
+		b2FloatW rBy = b2LoadW(scp->rBy);
+
+		// Relative velocity at contact
+		b2FloatW dvx = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy)), vAx), b2MulW(wA, rAy));
+		b2FloatW dvy = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx)), vAy), b2MulW(wA, rAx));
+
+		// Compute tangent force
+		b2FloatW vt = b2AddW(b2MulW(dvx, tangentX), b2MulW(dvy, tangentY));
+		b2FloatW lambda = b2MulW(b2LoadW(scp->tangentMass), b2NegW(vt));
+
+		// Clamp the accumulated force
+		b2FloatW oldImpulse = b2LoadW(scp->tangentImpulse);
+		b2FloatW maxFriction = b2MulW(friction, b2LoadW(scp->normalImpulse));
+		b2FloatW newImpulse = b2MaxW(b2NegW(maxFriction), b2MinW(b2AddW(oldImpulse, lambda), maxFriction));
+		lambda = b2SubW(newImpulse, oldImpulse);
+		b2StoreW(scp->tangentImpulse, newImpulse);
+
+		// Apply contact impulse
+		b2FloatW Px = b2MulW(lambda, tangentX);
+		b2FloatW Py = b2MulW(lambda, tangentY);
+
+		vAx = b2SubW(vAx, b2MulW(mA, Px));
+		vAy = b2SubW(vAy, b2MulW(mA, Py));
+		wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx, Py), b2MulW(rAy, Px))));
+
+		vBx = b2AddW(vBx, b2MulW(mB, Px));
+		vBy = b2AddW(vBy, b2MulW(mB, Py));
+		wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx, Py), b2MulW(rBy, Px))));
+	}
+
+	// Solve normal constraints
+	if (pointCount == 1)
+	{
+		b2SimdVelocityPoint* scp = sc->points + 0;
+		b2FloatW rAx = b2LoadW(scp->rAx);
+		b2FloatW rAy = b2LoadW(scp->rAy);
+		b2FloatW rBx = b2LoadW(scp->rBx);
+		b2FloatW rBy = b2LoadW(scp->rBy);
+
+		// Relative velocity at contact
+		b2FloatW dvx = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rBy)), vAx), b2MulW(wA, rAy));
+		b2FloatW dvy = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rBx)), vAy), b2MulW(wA, rAx));
+
+		// Compute normal impulse
+		b2FloatW vn = b2AddW(b2MulW(dvx, normalX), b2MulW(dvy, normalY));
+		b2FloatW lambda = b2NegW(b2MulW(b2LoadW(scp->normalMass), b2SubW(vn, b2LoadW(scp->velocityBias))));
+
+		// Clamp the accumulated impulse
+		b2FloatW oldImpulse = b2LoadW(scp->normalImpulse);
+		b2FloatW newImpulse = b2MaxW(b2AddW(oldImpulse, lambda), zero);
+		lambda = b2SubW(newImpulse, oldImpulse);
+		b2StoreW(scp->normalImpulse, newImpulse);
+
+		// Apply contact impulse
+		b2FloatW Px = b2MulW(lambda, normalX);
+		b2FloatW Py = b2MulW(lambda, normalY);
+
+		vAx = b2SubW(vAx, b2MulW(mA, Px));
+		vAy = b2SubW(vAy, b2MulW(mA, Py));
+		wA = b2SubW(wA, b2MulW(iA, b2SubW(b2MulW(rAx, Py), b2MulW(rAy, Px))));
+
+		vBx = b2AddW(vBx, b2MulW(mB, Px));
+		vBy = b2AddW(vBy, b2MulW(mB, Py));
+		wB = b2AddW(wB, b2MulW(iB, b2SubW(b2MulW(rBx, Py), b2MulW(rBy, Px))));
+	}
+	else
+	{
+		// Block solver, see b2SolveVelocityConstraint.
+		b2SimdVelocityPoint* cp1 = sc->points + 0;
+		b2SimdVelocityPoint* cp2 = sc->points + 1;
+		b2FloatW rA1x = b2LoadW(cp1->rAx), rA1y = b2LoadW(cp1->rAy);
+		b2FloatW rB1x = b2LoadW(cp1->rBx), rB1y = b2LoadW(cp1->rBy);
+		b2FloatW rA2x = b2LoadW(cp2->rAx), rA2y = b2LoadW(cp2->rAy);
+		b2FloatW rB2x = b2LoadW(cp2->rBx), rB2y = b2LoadW(cp2->rBy);
+
+		b2FloatW ax = b2LoadW(cp1->normalImpulse);
+		b2FloatW ay = b2LoadW(cp2->normalImpulse);
+
+		// Relative velocity at contact
+		b2FloatW dv1x = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rB1y)), vAx), b2MulW(wA, rA1y));
+		b2FloatW dv1y = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rB1x)), vAy), b2MulW(wA, rA1x));
+		b2FloatW dv2x = b2AddW(b2SubW(b2SubW(vBx, b2MulW(wB, rB2y)), vAx), b2MulW(wA, rA2y));
+		b2FloatW dv2y = b2SubW(b2SubW(b2AddW(vBy, b2MulW(wB, rB2x)), vAy), b2MulW(wA, rA2x));
+
+		// Compute normal velocity
+		b2FloatW vn1 = b2AddW(b2MulW(dv1x, normalX), b2MulW(dv1y, normalY));
+		b2FloatW vn2 = b2AddW(b2MulW(dv2x, normalX), b2MulW(dv2y, normalY));
+
+		// Compute b'
+		b2FloatW K11 = b2LoadW(sc->K11), K12 = b2LoadW(sc->K12);
+		b2FloatW K21 = b2LoadW(sc->K21), K22 = b2LoadW(sc->K22);
+		b2FloatW bx = b2SubW(b2SubW(vn1, b2LoadW(cp1->velocityBias)), b2AddW(b2MulW(K11, ax), b2MulW(K12, ay)));
+		b2FloatW by = b2SubW(b2SubW(vn2, b2LoadW(cp2->velocityBias)), b2AddW(b2MulW(K21, ax), b2MulW(K22, ay)));
+
+		// Case 1: vn = 0
+		b2FloatW x1x = b2NegW(b2AddW(b2MulW(b2LoadW(sc->normalMass11), bx), b2MulW(b2LoadW(sc->normalMass12), by)));
+		b2FloatW x1y = b2NegW(b2AddW(b2MulW(b2LoadW(sc->normalMass21), bx), b2MulW(b2LoadW(sc->normalMass22), by)));
+		b2FloatW valid1 = b2AndW(b2GreaterEqualW(x1x, zero), b2GreaterEqualW(x1y, zero));
+
+		// Case 2: vn1 = 0 and x2 = 0
+		b2FloatW x2x = b2NegW(b2MulW(b2LoadW(cp1->normalMass), bx));
+		b2FloatW case2vn2 = b2AddW(b2MulW(K21, x2x), by);
+		b2FloatW valid2 = b2AndW(b2GreaterEqualW(x2x, zero), b2GreaterEqualW(case2vn2, zero));
+
+		// Case 3: vn2 = 0 and x1 = 0
+		b2FloatW x3y = b2NegW(b2MulW(b2LoadW(cp2->normalMass), by));
+		b2FloatW case3vn1 = b2AddW(b2MulW(K12, x3y), bx);
+		b2FloatW valid3 = b2AndW(b2GreaterEqualW(x3y, zero), b2GreaterEqualW(case3vn1, zero));
+
+		// Case 4: x1 = 0 and x2 = 0
+		b2FloatW valid4 = b2AndW(b2GreaterEqualW(bx, zero), b2GreaterEqualW(by, zero));
+
+		// Take the first valid case, keep the old impulse if there is none.
+		b2FloatW xx = ax;
+		b2FloatW xy = ay;
+		xx = b2SelectW(valid4, zero, xx);
+		xy = b2SelectW(valid4, zero, xy);
+		xx = b2SelectW(valid3, zero, xx);
+		xy = b2SelectW(valid3, x3y, xy);
+		xx = b2SelectW(valid2, x2x, xx);
+		xy = b2SelectW(valid2, zero, xy);
+		xx = b2SelectW(valid1, x1x, xx);
+		xy = b2SelectW(valid1, x1y, xy);
+
+		// Get the incremental impulse
+		b2FloatW dx = b2SubW(xx, ax);
+		b2FloatW dy = b2SubW(xy, ay);
+
+		// Apply incremental impulse
+		b2FloatW P1x = b2MulW(dx, normalX), P1y = b2MulW(dx, normalY);
+		b2FloatW P2x = b2MulW(dy, normalX), P2y = b2MulW(dy, normalY);
+		b2FloatW Px = b2AddW(P1x, P2x);
+		b2FloatW Py = b2AddW(P1y, P2y);
+
+		vAx = b2SubW(vAx, b2MulW(mA, Px));
+		vAy = b2SubW(vAy, b2MulW(mA, Py));
+		wA = b2SubW(wA, b2MulW(iA, b2AddW(
+			b2SubW(b2MulW(rA1x, P1y), b2MulW(rA1y, P1x)),
+			b2SubW(b2MulW(rA2x, P2y), b2MulW(rA2y, P2x)))));
+
+		vBx = b2AddW(vBx, b2MulW(mB, Px));
+		vBy = b2AddW(vBy, b2MulW(mB, Py));
+		wB = b2AddW(wB, b2MulW(iB, b2AddW(
+			b2SubW(b2MulW(rB1x, P1y), b2MulW(rB1y, P1x)),
+			b2SubW(b2MulW(rB2x, P2y), b2MulW(rB2y, P2x)))));
+
+		// Accumulate
+		b2StoreW(cp1->normalImpulse, xx);
+		b2StoreW(cp2->normalImpulse, xy);
+	}
+
+	b2ScatterVelocities(sc->indexA, velocities, vAx, vAy, wA);
+	b2ScatterVelocities(sc->indexB, velocities, vBx, vBy, wB);
+}
+
+void b2ContactSolver::SolveSimdVelocityConstraints()
+{
+	// Constraints in a group never share a body that can move, and groups
+	// are solved in order so they see each other's results.
+	for (int32 i = 0; i < m_simdCount; ++i)
+	{
+		b2SolveSimdVelocityConstraint(m_simdConstraints + i, m_velocities);
+	}
+
+	for (int32 i = 0; i < m_simdOverflowCount; ++i)
+	{
+		b2SolveVelocityConstraint(m_velocityConstraints + m_simdOverflow[i], m_velocities);
 	}
 }
 
+void b2ContactSolver::StoreSimdImpulses()
+{
+	// Copy the accumulated impulses back so they can be stored and reported.
+	for (int32 i = 0; i < m_simdCount; ++i)
+	{
+		const b2SimdVelocityConstraint* sc = m_simdConstraints + i;
+		for (int32 lane = 0; lane < B2_SIMD_WIDTH; ++lane)
+		{
+			int32 index = sc->constraintIndex[lane];
+			if (index < 0)
+			{
+				continue;
+			}
+
+			b2ContactVelocityConstraint* vc = m_velocityConstraints + index;
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = sc->points[j].normalImpulse[lane];
+				vc->points[j].tangentImpulse = sc->points[j].tangentImpulse[lane];
+			}
+		}
+	}
+}
+
+#else
+
+void b2ContactSolver::InitializeSimdConstraints()
+{
+	// Not available, the scalar solver is used.
+	m_simdInitialized = true;
+}
+
+void b2ContactSolver::SolveSimdVelocityConstraints()
+{
+}
+
+void b2ContactSolver::StoreSimdImpulses()
+{
+}
+
+#endif
+
 void b2ContactSolver::StoreImpulses()
 {
+	if (m_simdConstraints)
+	{
+		StoreSimdImpulses();
+	}
+
 	for (int32 i = 0; i < m_count; ++i)
 	{
 		b2ContactVelocityConstraint* vc = m_velocityConstraints + i;
@@ -27,6 +27,7 @@ class b2Contact;
 class b2Body;
 class b2StackAllocator;
 struct b2ContactPositionConstraint;
+struct b2SimdVelocityConstraint;
 
 struct b2VelocityConstraintPoint
 {
@@ -80,6 +81,15 @@ public:
 	bool SolvePositionConstraints();
 	bool SolveTOIPositionConstraints(int32 toiIndexA, int32 toiIndexB);
 
+	/// Number of contacts the SIMD solver handles at once, 0 if it was compiled out.
+	static int32 GetSimdWidth();
+
+	/// Pack constraints into SIMD lanes, called on the first velocity iteration.
+	/// Leaves m_simdConstraints NULL if there are too few constraints to be worth it.
+	void InitializeSimdConstraints();
+	void SolveSimdVelocityConstraints();
+	void StoreSimdImpulses();
+
 	b2TimeStep m_step;
 	b2Position* m_positions;
 	b2Velocity* m_velocities;
@@ -88,6 +98,15 @@ public:
 	b2ContactVelocityConstraint* m_velocityConstraints;
 	b2Contact** m_contacts;
 	int m_count;
+
+	// Constraints are graph colored so no two in the same color share a
+	// body that can move, then each color is packed into SIMD lanes.
+	// Constraints that don't fit in any color are solved one at a time.
+	b2SimdVelocityConstraint* m_simdConstraints;
+	int32 m_simdCount;
+	int32* m_simdOverflow;
+	int32 m_simdOverflowCount;
+	bool m_simdInitialized;
 };
 
 #endif
@@ -56,8 +56,8 @@ b2FrictionJoint::b2FrictionJoint(const b2FrictionJointDef* def)
 
 void b2FrictionJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
+	m_indexA = m_islandIndexA;
+	m_indexB = m_islandIndexB;
 	m_localCenterA = m_bodyA->m_sweep.localCenter;
 	m_localCenterB = m_bodyB->m_sweep.localCenter;
 	m_invMassA = m_bodyA->m_invMass;
@@ -127,14 +127,23 @@ b2GearJoint::b2GearJoint(const b2GearJointDef* def)
 	m_constant = coordinateA + m_ratio * coordinateB;
 
 	m_impulse = 0.0f;
+	m_islandIndexC = 0;
+	m_islandIndexD = 0;
+}
+
+void b2GearJoint::StoreIslandIndices()
+{
+	b2Joint::StoreIslandIndices();
+	m_islandIndexC = m_bodyC->m_islandIndex;
+	m_islandIndexD = m_bodyD->m_islandIndex;
 }
 
 void b2GearJoint::InitVelocityConstraints(const b2SolverData& data)
 {
-	m_indexA = m_bodyA->m_islandIndex;
-	m_indexB = m_bodyB->m_islandIndex;
-	m_indexC = m_bodyC->m_islandIndex;
-	m_indexD = m_bodyD->m_islandIndex;
+	m_indexA = m_islandIndexA;
+	m_indexB = m_islandIndexB;
+	m_indexC = m_islandIndexC;
+	m_indexD = m_islandIndexD;
 	m_lcA = m_bodyA->m_sweep.localCenter;
 	m_lcB = m_bodyB->m_sweep.localCenter;
 	m_lcC = m_bodyC->m_sweep.localCenter;
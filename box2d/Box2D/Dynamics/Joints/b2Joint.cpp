@@ -121,51 +121,46 @@ b2Joint* b2Joint::Create(const b2JointDef* def, b2BlockAllocator* allocator)
 void b2Joint::Destroy(b2Joint* joint, b2BlockAllocator* allocator)
 {
 	joint->~b2Joint();
-	switch (joint->m_type)
+	allocator->Free(joint, GetSize(joint->m_type));
+}
+
+int32 b2Joint::GetSize(b2JointType type)
+{
+	switch (type)
 	{
 	case e_distanceJoint:
-		allocator->Free(joint, sizeof(b2DistanceJoint));
-		break;
+		return sizeof(b2DistanceJoint);
 
 	case e_mouseJoint:
-		allocator->Free(joint, sizeof(b2MouseJoint));
-		break;
+		return sizeof(b2MouseJoint);
 
 	case e_prismaticJoint:
-		allocator->Free(joint, sizeof(b2PrismaticJoint));
-		break;
+		return sizeof(b2PrismaticJoint);
 
 	case e_revoluteJoint:
-		allocator->Free(joint, sizeof(b2RevoluteJoint));
-		break;
+		return sizeof(b2RevoluteJoint);
 
 	case e_pulleyJoint:
-		allocator->Free(joint, sizeof(b2PulleyJoint));
-		break;
+		return sizeof(b2PulleyJoint);
 
 	case e_gearJoint:
-		allocator->Free(joint, sizeof(b2GearJoint));
-		break;
+		return sizeof(b2GearJoint);
 
 	case e_wheelJoint:
-		allocator->Free(joint, sizeof(b2WheelJoint));
-		break;
-    
+		return sizeof(b2WheelJoint);
+
 	case e_weldJoint:
-		allocator->Free(joint, sizeof(b2WeldJoint));
-		break;
+		return sizeof(b2WeldJoint);
 
 	case e_frictionJoint:
-		allocator->Free(joint, sizeof(b2FrictionJoint));
-		break;
+		return sizeof(b2FrictionJoint);
 
 	case e_ropeJoint:
-		allocator->Free(joint, sizeof(b2RopeJoint));
-		break;
+		return sizeof(b2RopeJoint);
 
 	default:
 		b2Assert(false);
-		break;
+		return 0;
 	}
 }
 
@@ -179,6 +174,8 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_bodyA = def->bodyA;
 	m_bodyB = def->bodyB;
 	m_index = 0;
+	m_islandIndexA = 0;
+	m_islandIndexB = 0;
 	m_collideConnected = def->collideConnected;
 	m_islandFlag = false;
 	m_userData = def->userData;
@@ -194,6 +191,12 @@ b2Joint::b2Joint(const b2JointDef* def)
 	m_edgeB.next = NULL;
 }
 
+void b2Joint::StoreIslandIndices()
+{
+	m_islandIndexA = m_bodyA->m_islandIndex;
+	m_islandIndexB = m_bodyB->m_islandIndex;
+}
+
 bool b2Joint::IsActive() const
 {
 	return m_bodyA->IsActive() && m_bodyB->IsActive();
@@ -153,6 +153,7 @@ protected:
 
 	static b2Joint* Create(const b2JointDef* def, b2BlockAllocator* allocator);
 	static void Destroy(b2Joint* joint, b2BlockAllocator* allocator);
+	static int32 GetSize(b2JointType type);
 
 	b2Joint(const b2JointDef* def);
 	virtual ~b2Joint() {}
@@ -163,6 +164,9 @@ protected:
 	// This returns true if the position errors are within tolerance.
 	virtual bool SolvePositionConstraints(const b2SolverData& data) = 0;
 
+	// Copy the island indices of the bodies, called when the island is built.
+	virtual void StoreIslandIndices();
+
 	b2JointType m_type;
 	b2Joint* m_prev;
 	b2Joint* m_next;
@@ -172,6 +176,8 @@ protected:
 	b2Body* m_bodyB;
 
 	int32 m_index;
+	int32 m_islandIndexA;
+	int32 m_islandIndexB;
 
 	bool m_islandFlag;
 	bool m_collideConnected;
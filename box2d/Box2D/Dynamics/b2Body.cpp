@@ -124,6 +124,17 @@ void b2Body::SetType(b2BodyType type)
 		return;
 	}
 
+	// Static proxies live in their own broad-phase tree so they have to move over.
+	bool changeTree = (m_flags & e_activeFlag) && (m_type == b2_staticBody || type == b2_staticBody);
+	if (changeTree)
+	{
+		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->DestroyProxies(broadPhase);
+		}
+	}
+
 	m_type = type;
 
 	ResetMassData();
@@ -137,6 +148,15 @@ void b2Body::SetType(b2BodyType type)
 		SynchronizeFixtures();
 	}
 
+	if (changeTree)
+	{
+		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		{
+			f->CreateProxies(broadPhase, m_xf);
+		}
+	}
+
 	SetAwake(true);
 
 	m_force.SetZero();
@@ -453,10 +473,17 @@ void b2Body::SetActive(bool flag)
 		m_flags |= e_activeFlag;
 
 		// Create all proxies.
-		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
-		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		if (m_type == b2_staticBody)
 		{
-			f->CreateProxies(broadPhase, m_xf);
+			CreateStaticProxies();
+		}
+		else
+		{
+			b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+			for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+			{
+				f->CreateProxies(broadPhase, m_xf);
+			}
 		}
 
 		// Contacts are created the next time step.
@@ -466,10 +493,17 @@ void b2Body::SetActive(bool flag)
 		m_flags &= ~e_activeFlag;
 
 		// Destroy all proxies.
-		b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
-		for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+		if (m_type == b2_staticBody)
 		{
-			f->DestroyProxies(broadPhase);
+			DestroyStaticProxies();
+		}
+		else
+		{
+			b2BroadPhase* broadPhase = &m_world->m_contactManager.m_broadPhase;
+			for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+			{
+				f->DestroyProxies(broadPhase);
+			}
 		}
 
 		// Destroy the attached contacts.
@@ -484,6 +518,88 @@ void b2Body::SetActive(bool flag)
 	}
 }
 
+void b2Body::CreateStaticProxies()
+{
+	int32 count = 0;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		count += f->m_shape->GetChildCount();
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2StackAllocator* allocator = &m_world->m_stackAllocator;
+	b2AABB* aabbs = (b2AABB*)allocator->Allocate(count * sizeof(b2AABB));
+	void** userData = (void**)allocator->Allocate(count * sizeof(void*));
+	int32* proxyIds = (int32*)allocator->Allocate(count * sizeof(int32));
+
+	int32 index = 0;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		b2Assert(f->m_proxyCount == 0);
+		f->m_proxyCount = f->m_shape->GetChildCount();
+		for (int32 i = 0; i < f->m_proxyCount; ++i)
+		{
+			b2FixtureProxy* proxy = f->m_proxies + i;
+			f->m_shape->ComputeAABB(&proxy->aabb, m_xf, i);
+			proxy->fixture = f;
+			proxy->childIndex = i;
+			aabbs[index] = proxy->aabb;
+			userData[index] = proxy;
+			++index;
+		}
+	}
+
+	m_world->m_contactManager.m_broadPhase.CreateProxies(aabbs, userData, count, proxyIds);
+
+	index = 0;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		for (int32 i = 0; i < f->m_proxyCount; ++i)
+		{
+			f->m_proxies[i].proxyId = proxyIds[index++];
+		}
+	}
+
+	allocator->Free(proxyIds);
+	allocator->Free(userData);
+	allocator->Free(aabbs);
+}
+
+void b2Body::DestroyStaticProxies()
+{
+	int32 count = 0;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		count += f->m_proxyCount;
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	b2StackAllocator* allocator = &m_world->m_stackAllocator;
+	int32* proxyIds = (int32*)allocator->Allocate(count * sizeof(int32));
+
+	int32 index = 0;
+	for (b2Fixture* f = m_fixtureList; f; f = f->m_next)
+	{
+		for (int32 i = 0; i < f->m_proxyCount; ++i)
+		{
+			proxyIds[index++] = f->m_proxies[i].proxyId;
+			f->m_proxies[i].proxyId = b2BroadPhase::e_nullProxy;
+		}
+		f->m_proxyCount = 0;
+	}
+
+	m_world->m_contactManager.m_broadPhase.DestroyProxies(proxyIds, count);
+	allocator->Free(proxyIds);
+}
+
 void b2Body::Dump()
 {
 	int32 bodyIndex = m_islandIndex;
@@ -335,6 +335,9 @@ public:
 	/// Joints connected to an inactive body are implicitly inactive.
 	/// An inactive body is still owned by a b2World object and remains
 	/// in the body list.
+	/// Static bodies add all their fixtures to the broad-phase as one
+	/// subtree, so building a static body while inactive and then
+	/// activating it is much faster than creating fixtures one at a time.
 	void SetActive(bool flag);
 
 	/// Get the active state of the body.
@@ -386,6 +389,7 @@ private:
 	friend class b2ContactSolver;
 	friend class b2Contact;
 	
+	friend class b2Joint;
 	friend class b2DistanceJoint;
 	friend class b2GearJoint;
 	friend class b2WheelJoint;
@@ -415,6 +419,10 @@ private:
 	void SynchronizeFixtures();
 	void SynchronizeTransform();
 
+	// Static bodies add and remove all their broad-phase proxies together.
+	void CreateStaticProxies();
+	void DestroyStaticProxies();
+
 	// This is used to prevent connected bodies from colliding.
 	// It may lie, depending on the collideConnected flag.
 	bool ShouldCollide(const b2Body* other) const;
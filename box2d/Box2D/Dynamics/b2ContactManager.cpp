@@ -243,13 +243,18 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 		return;
 	}
 
+	Insert(c);
+
+	// Wake up the bodies
+	c->GetFixtureA()->GetBody()->SetAwake(true);
+	c->GetFixtureB()->GetBody()->SetAwake(true);
+}
+
+void b2ContactManager::Insert(b2Contact* c)
+{
 	// Contact creation may swap fixtures.
-	fixtureA = c->GetFixtureA();
-	fixtureB = c->GetFixtureB();
-	indexA = c->GetChildIndexA();
-	indexB = c->GetChildIndexB();
-	bodyA = fixtureA->GetBody();
-	bodyB = fixtureB->GetBody();
+	b2Body* bodyA = c->GetFixtureA()->GetBody();
+	b2Body* bodyB = c->GetFixtureB()->GetBody();
 
 	// Insert into the world.
 	c->m_prev = NULL;
@@ -286,9 +291,5 @@ void b2ContactManager::AddPair(void* proxyUserDataA, void* proxyUserDataB)
 	}
 	bodyB->m_contactList = &c->m_nodeB;
 
-	// Wake up the bodies
-	bodyA->SetAwake(true);
-	bodyB->SetAwake(true);
-
 	++m_contactCount;
 }
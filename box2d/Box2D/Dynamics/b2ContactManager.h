@@ -39,6 +39,9 @@ public:
 
 	void Destroy(b2Contact* c);
 
+	// Link a new contact into the world and body contact lists.
+	void Insert(b2Contact* c);
+
 	void Collide();
             
 	b2BroadPhase m_broadPhase;
@@ -151,7 +151,8 @@ b2Island::b2Island(
 	int32 contactCapacity,
 	int32 jointCapacity,
 	b2StackAllocator* allocator,
-	b2ContactListener* listener)
+	b2ContactListener* listener,
+	b2TaskExecutor* executor)
 {
 	m_bodyCapacity = bodyCapacity;
 	m_contactCapacity = contactCapacity;
@@ -162,6 +163,7 @@ b2Island::b2Island(
 
 	m_allocator = allocator;
 	m_listener = listener;
+	m_executor = executor;
 
 	m_bodies = (b2Body**)m_allocator->Allocate(bodyCapacity * sizeof(b2Body*));
 	m_contacts = (b2Contact**)m_allocator->Allocate(contactCapacity	 * sizeof(b2Contact*));
@@ -198,8 +200,11 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 		float32 w = b->m_angularVelocity;
 
 		// Store positions for continuous collision.
-		b->m_sweep.c0 = b->m_sweep.c;
-		b->m_sweep.a0 = b->m_sweep.a;
+		if (m_executor == NULL || b->m_type != b2_staticBody)
+		{
+			b->m_sweep.c0 = b->m_sweep.c;
+			b->m_sweep.a0 = b->m_sweep.a;
+		}
 
 		if (b->m_type == b2_dynamicBody)
 		{
@@ -232,6 +237,12 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	solverData.positions = m_positions;
 	solverData.velocities = m_velocities;
 
+	if (m_executor == NULL)
+	{
+		// Parallel islands had their indices stored when they were built.
+		StoreIslandIndices(m_contacts, m_contactCount, m_joints, m_jointCount);
+	}
+
 	// Initialize velocity constraints.
 	b2ContactSolverDef contactSolverDef;
 	contactSolverDef.step = step;
@@ -331,6 +342,12 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 	for (int32 i = 0; i < m_bodyCount; ++i)
 	{
 		b2Body* body = m_bodies[i];
+		if (m_executor && body->m_type == b2_staticBody)
+		{
+			// Static bodies don't move and are shared with other islands.
+			continue;
+		}
+
 		body->m_sweep.c = m_positions[i].c;
 		body->m_sweep.a = m_positions[i].a;
 		body->m_linearVelocity = m_velocities[i].v;
@@ -376,14 +393,36 @@ void b2Island::Solve(b2Profile* profile, const b2TimeStep& step, const b2Vec2& g
 			for (int32 i = 0; i < m_bodyCount; ++i)
 			{
 				b2Body* b = m_bodies[i];
+				if (m_executor && b->GetType() == b2_staticBody)
+				{
+					continue;
+				}
+
 				b->SetAwake(false);
 			}
 		}
 	}
 }
 
+void b2Island::StoreIslandIndices(b2Contact** contacts, int32 contactCount, b2Joint** joints, int32 jointCount)
+{
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		b2Contact* contact = contacts[i];
+		contact->m_islandIndexA = contact->m_fixtureA->GetBody()->m_islandIndex;
+		contact->m_islandIndexB = contact->m_fixtureB->GetBody()->m_islandIndex;
+	}
+
+	for (int32 i = 0; i < jointCount; ++i)
+	{
+		joints[i]->StoreIslandIndices();
+	}
+}
+
 void b2Island::SolveTOI(const b2TimeStep& subStep, int32 toiIndexA, int32 toiIndexB)
 {
+	StoreIslandIndices(m_contacts, m_contactCount, m_joints, m_jointCount);
+
 	b2Assert(toiIndexA < m_bodyCount);
 	b2Assert(toiIndexB < m_bodyCount);
 
@@ -27,6 +27,7 @@ class b2Contact;
 class b2Joint;
 class b2StackAllocator;
 class b2ContactListener;
+class b2TaskExecutor;
 struct b2ContactVelocityConstraint;
 struct b2Profile;
 
@@ -35,7 +36,8 @@ class b2Island
 {
 public:
 	b2Island(int32 bodyCapacity, int32 contactCapacity, int32 jointCapacity,
-			b2StackAllocator* allocator, b2ContactListener* listener);
+			b2StackAllocator* allocator, b2ContactListener* listener,
+			b2TaskExecutor* executor = NULL);
 	~b2Island();
 
 	void Clear()
@@ -71,9 +73,19 @@ public:
 
 	void Report(const b2ContactVelocityConstraint* constraints);
 
+	/// Copy the island index of each body into the contacts and joints that use it.
+	/// Solving only reads these copies, so islands that share a static body can be
+	/// solved at the same time as long as this is called right after each is built.
+	static void StoreIslandIndices(b2Contact** contacts, int32 contactCount, b2Joint** joints, int32 jointCount);
+
 	b2StackAllocator* m_allocator;
 	b2ContactListener* m_listener;
 
+	// Set when other islands are being solved at the same time. Static bodies
+	// are shared between islands so they are not written to, and their island
+	// indices were already copied into the constraints when the island was built.
+	b2TaskExecutor* m_executor;
+
 	b2Body** m_bodies;
 	b2Contact** m_contacts;
 	b2Joint** m_joints;
@@ -43,6 +43,7 @@ struct b2TimeStep
 	int32 velocityIterations;
 	int32 positionIterations;
 	bool warmStarting;
+	bool simdContactSolver;
 };
 
 /// This is an internal structure.
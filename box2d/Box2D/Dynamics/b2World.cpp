@@ -34,12 +34,17 @@
 #include <Box2D/Common/b2Draw.h>
 #include <Box2D/Common/b2Timer.h>
 #include <new>
+#include <cstring>
 
 b2World::b2World(const b2Vec2& gravity)
 {
 	m_destructionListener = NULL;
 	m_debugDraw = NULL;
 
+	m_taskExecutor = NULL;
+	m_threadAllocators = NULL;
+	m_threadAllocatorCount = 0;
+
 	m_bodyList = NULL;
 	m_jointList = NULL;
 
@@ -47,6 +52,7 @@ b2World::b2World(const b2Vec2& gravity)
 	m_jointCount = 0;
 
 	m_warmStarting = true;
+	m_simdContactSolver = false;
 	m_continuousPhysics = true;
 	m_subStepping = false;
 
@@ -83,6 +89,8 @@ b2World::~b2World()
 
 		b = bNext;
 	}
+
+	FreeThreadAllocators();
 }
 
 void b2World::SetDestructionListener(b2DestructionListener* listener)
@@ -105,6 +113,31 @@ void b2World::SetDebugDraw(b2Draw* debugDraw)
 	m_debugDraw = debugDraw;
 }
 
+void b2World::SetTaskExecutor(b2TaskExecutor* executor)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked())
+	{
+		return;
+	}
+
+	// The thread count may be different so make new allocators on the next solve.
+	FreeThreadAllocators();
+	m_taskExecutor = executor;
+}
+
+void b2World::FreeThreadAllocators()
+{
+	for (int32 i = 0; i < m_threadAllocatorCount; ++i)
+	{
+		m_threadAllocators[i].~b2StackAllocator();
+	}
+
+	b2Free(m_threadAllocators);
+	m_threadAllocators = NULL;
+	m_threadAllocatorCount = 0;
+}
+
 b2Body* b2World::CreateBody(const b2BodyDef* def)
 {
 	b2Assert(IsLocked() == false);
@@ -166,6 +199,12 @@ void b2World::DestroyBody(b2Body* b)
 	}
 	b->m_contactList = NULL;
 
+	// Static bodies remove all their proxies together.
+	if (b->m_type == b2_staticBody)
+	{
+		b->DestroyStaticProxies();
+	}
+
 	// Delete the attached fixtures. This destroys broad-phase proxies.
 	b2Fixture* f = b->m_fixtureList;
 	while (f)
@@ -390,13 +429,6 @@ void b2World::Solve(const b2TimeStep& step)
 	m_profile.solveVelocity = 0.0f;
 	m_profile.solvePosition = 0.0f;
 
-	// Size the island for the worst case.
-	b2Island island(m_bodyCount,
-					m_contactManager.m_contactCount,
-					m_jointCount,
-					&m_stackAllocator,
-					m_contactManager.m_contactListener);
-
 	// Clear all the island flags.
 	for (b2Body* b = m_bodyList; b; b = b->m_next)
 	{
@@ -411,6 +443,20 @@ void b2World::Solve(const b2TimeStep& step)
 		j->m_islandFlag = false;
 	}
 
+	if (m_taskExecutor && m_taskExecutor->GetThreadCount() > 1)
+	{
+		SolveParallel(step);
+		SynchronizeIslands();
+		return;
+	}
+
+	// Size the island for the worst case.
+	b2Island island(m_bodyCount,
+					m_contactManager.m_contactCount,
+					m_jointCount,
+					&m_stackAllocator,
+					m_contactManager.m_contactListener);
+
 	// Build and simulate all awake islands.
 	int32 stackSize = m_bodyCount;
 	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
@@ -548,30 +594,333 @@ void b2World::Solve(const b2TimeStep& step)
 
 	m_stackAllocator.Free(stack);
 
+	SynchronizeIslands();
+}
+
+// An island found by SolveParallel, stored as slices of shared arrays.
+struct b2ParallelIsland
+{
+	int32 bodyStart;
+	int32 bodyCount;
+	int32 contactStart;
+	int32 contactCount;
+	int32 jointStart;
+	int32 jointCount;
+	b2Profile profile;
+};
+
+struct b2PostSolveRecord
+{
+	b2Contact* contact;
+	b2ContactImpulse impulse;
+};
+
+// Buffers post solve callbacks from an island so they
+// can be reported on the calling thread in island order.
+class b2PostSolveBuffer : public b2ContactListener
+{
+public:
+	void PostSolve(b2Contact* contact, const b2ContactImpulse* impulse)
 	{
-		b2Timer timer;
-		// Synchronize fixtures, check for out of range bodies.
-		for (b2Body* b = m_bodyList; b; b = b->GetNext())
+		b2PostSolveRecord* record = m_records + m_count++;
+		record->contact = contact;
+		record->impulse = *impulse;
+	}
+
+	b2PostSolveRecord* m_records;
+	int32 m_count;
+};
+
+class b2SolveIslandTask : public b2Task
+{
+public:
+	void Run(int32 index, int32 threadIndex)
+	{
+		b2ParallelIsland* record = m_islands + index;
+
+		b2PostSolveBuffer buffer;
+		buffer.m_records = m_postSolveRecords + record->contactStart;
+		buffer.m_count = 0;
+
+		b2Island island(record->bodyCount,
+						record->contactCount,
+						record->jointCount,
+						m_allocators + threadIndex,
+						m_postSolveRecords ? &buffer : NULL,
+						m_executor);
+
+		// Fill in the island directly, island indices were stored when it was built.
+		memcpy(island.m_bodies, m_bodies + record->bodyStart, record->bodyCount * sizeof(b2Body*));
+		memcpy(island.m_contacts, m_contacts + record->contactStart, record->contactCount * sizeof(b2Contact*));
+		memcpy(island.m_joints, m_joints + record->jointStart, record->jointCount * sizeof(b2Joint*));
+		island.m_bodyCount = record->bodyCount;
+		island.m_contactCount = record->contactCount;
+		island.m_jointCount = record->jointCount;
+
+		island.Solve(&record->profile, *m_step, m_gravity, m_allowSleep);
+	}
+
+	b2ParallelIsland* m_islands;
+	b2Body** m_bodies;
+	b2Contact** m_contacts;
+	b2Joint** m_joints;
+	b2PostSolveRecord* m_postSolveRecords;
+	b2StackAllocator* m_allocators;
+	b2TaskExecutor* m_executor;
+	const b2TimeStep* m_step;
+	b2Vec2 m_gravity;
+	bool m_allowSleep;
+};
+
+// Find all awake islands first, then solve them at the same time using the task executor.
+// Results match Solve because islands only share static bodies, which are not changed.
+void b2World::SolveParallel(const b2TimeStep& step)
+{
+	int32 threadCount = m_taskExecutor->GetThreadCount();
+	if (m_threadAllocatorCount != threadCount)
+	{
+		FreeThreadAllocators();
+		m_threadAllocators = (b2StackAllocator*)b2Alloc(threadCount * sizeof(b2StackAllocator));
+		for (int32 i = 0; i < threadCount; ++i)
 		{
-			// If a body was not in an island then it did not move.
-			if ((b->m_flags & b2Body::e_islandFlag) == 0)
+			new (m_threadAllocators + i) b2StackAllocator;
+		}
+		m_threadAllocatorCount = threadCount;
+	}
+
+	// Static bodies are added once for each island they touch,
+	// and they can only be reached through a contact or joint.
+	int32 contactCapacity = m_contactManager.m_contactCount;
+	int32 bodyCapacity = m_bodyCount + contactCapacity + m_jointCount;
+	b2Body** bodies = (b2Body**)m_stackAllocator.Allocate(bodyCapacity * sizeof(b2Body*));
+	b2Contact** contacts = (b2Contact**)m_stackAllocator.Allocate(contactCapacity * sizeof(b2Contact*));
+	b2Joint** joints = (b2Joint**)m_stackAllocator.Allocate(m_jointCount * sizeof(b2Joint*));
+	b2ParallelIsland* islands = (b2ParallelIsland*)m_stackAllocator.Allocate(m_bodyCount * sizeof(b2ParallelIsland));
+	int32 bodyCount = 0;
+	int32 contactCount = 0;
+	int32 jointCount = 0;
+	int32 islandCount = 0;
+
+	// Build all awake islands, same as Solve.
+	int32 stackSize = m_bodyCount;
+	b2Body** stack = (b2Body**)m_stackAllocator.Allocate(stackSize * sizeof(b2Body*));
+	for (b2Body* seed = m_bodyList; seed; seed = seed->m_next)
+	{
+		if (seed->m_flags & b2Body::e_islandFlag)
+		{
+			continue;
+		}
+
+		if (seed->IsAwake() == false || seed->IsActive() == false)
+		{
+			continue;
+		}
+
+		// The seed can be dynamic or kinematic.
+		if (seed->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+
+		b2ParallelIsland* island = islands + islandCount++;
+		island->bodyStart = bodyCount;
+		island->contactStart = contactCount;
+		island->jointStart = jointCount;
+
+		int32 stackCount = 0;
+		stack[stackCount++] = seed;
+		seed->m_flags |= b2Body::e_islandFlag;
+
+		// Perform a depth first search (DFS) on the constraint graph.
+		while (stackCount > 0)
+		{
+			// Grab the next body off the stack and add it to the island.
+			b2Body* b = stack[--stackCount];
+			b2Assert(b->IsActive() == true);
+			b2Assert(bodyCount < bodyCapacity);
+			bodies[bodyCount++] = b;
+
+			// Make sure the body is awake.
+			b->SetAwake(true);
+
+			// To keep islands as small as possible, we don't
+			// propagate islands across static bodies.
+			if (b->GetType() == b2_staticBody)
 			{
 				continue;
 			}
 
+			// Search all contacts connected to this body.
+			for (b2ContactEdge* ce = b->m_contactList; ce; ce = ce->next)
+			{
+				b2Contact* contact = ce->contact;
+
+				// Has this contact already been added to an island?
+				if (contact->m_flags & b2Contact::e_islandFlag)
+				{
+					continue;
+				}
+
+				// Is this contact solid and touching?
+				if (contact->IsEnabled() == false ||
+					contact->IsTouching() == false)
+				{
+					continue;
+				}
+
+				// Skip sensors.
+				bool sensorA = contact->m_fixtureA->m_isSensor;
+				bool sensorB = contact->m_fixtureB->m_isSensor;
+				if (sensorA || sensorB)
+				{
+					continue;
+				}
+
+				b2Assert(contactCount < contactCapacity);
+				contacts[contactCount++] = contact;
+				contact->m_flags |= b2Contact::e_islandFlag;
+
+				b2Body* other = ce->other;
+
+				// Was the other body already added to this island?
+				if (other->m_flags & b2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				b2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= b2Body::e_islandFlag;
+			}
+
+			// Search all joints connect to this body.
+			for (b2JointEdge* je = b->m_jointList; je; je = je->next)
+			{
+				if (je->joint->m_islandFlag == true)
+				{
+					continue;
+				}
+
+				b2Body* other = je->other;
+
+				// Don't simulate joints connected to inactive bodies.
+				if (other->IsActive() == false)
+				{
+					continue;
+				}
+
+				b2Assert(jointCount < m_jointCount);
+				joints[jointCount++] = je->joint;
+				je->joint->m_islandFlag = true;
+
+				if (other->m_flags & b2Body::e_islandFlag)
+				{
+					continue;
+				}
+
+				b2Assert(stackCount < stackSize);
+				stack[stackCount++] = other;
+				other->m_flags |= b2Body::e_islandFlag;
+			}
+		}
+
+		island->bodyCount = bodyCount - island->bodyStart;
+		island->contactCount = contactCount - island->contactStart;
+		island->jointCount = jointCount - island->jointStart;
+
+		// Static bodies get a different index in each island they are in, so the
+		// indices are stored in the constraints now instead of while solving.
+		for (int32 i = island->bodyStart; i < bodyCount; ++i)
+		{
+			bodies[i]->m_islandIndex = i - island->bodyStart;
+		}
+		b2Island::StoreIslandIndices(contacts + island->contactStart, island->contactCount, joints + island->jointStart, island->jointCount);
+
+		// Allow static bodies to participate in other islands.
+		for (int32 i = island->bodyStart; i < bodyCount; ++i)
+		{
+			b2Body* b = bodies[i];
 			if (b->GetType() == b2_staticBody)
 			{
-				continue;
+				b->m_flags &= ~b2Body::e_islandFlag;
 			}
+		}
+	}
+
+	m_stackAllocator.Free(stack);
+
+	// Post solve is reported after all islands are finished.
+	b2ContactListener* listener = m_contactManager.m_contactListener;
+	b2PostSolveRecord* postSolveRecords = NULL;
+	if (listener)
+	{
+		postSolveRecords = (b2PostSolveRecord*)m_stackAllocator.Allocate(contactCount * sizeof(b2PostSolveRecord));
+	}
 
-			// Update fixtures (for broad-phase).
-			b->SynchronizeFixtures();
+	b2SolveIslandTask task;
+	task.m_islands = islands;
+	task.m_bodies = bodies;
+	task.m_contacts = contacts;
+	task.m_joints = joints;
+	task.m_postSolveRecords = postSolveRecords;
+	task.m_allocators = m_threadAllocators;
+	task.m_executor = m_taskExecutor;
+	task.m_step = &step;
+	task.m_gravity = m_gravity;
+	task.m_allowSleep = m_allowSleep;
+	m_taskExecutor->Execute(&task, islandCount);
+
+	for (int32 i = 0; i < islandCount; ++i)
+	{
+		const b2ParallelIsland* island = islands + i;
+		m_profile.solveInit += island->profile.solveInit;
+		m_profile.solveVelocity += island->profile.solveVelocity;
+		m_profile.solvePosition += island->profile.solvePosition;
+
+		if (listener)
+		{
+			for (int32 j = 0; j < island->contactCount; ++j)
+			{
+				b2PostSolveRecord* record = postSolveRecords + island->contactStart + j;
+				listener->PostSolve(record->contact, &record->impulse);
+			}
 		}
+	}
 
-		// Look for new contacts.
-		m_contactManager.FindNewContacts();
-		m_profile.broadphase = timer.GetMilliseconds();
+	if (postSolveRecords)
+	{
+		m_stackAllocator.Free(postSolveRecords);
+	}
+	m_stackAllocator.Free(islands);
+	m_stackAllocator.Free(joints);
+	m_stackAllocator.Free(contacts);
+	m_stackAllocator.Free(bodies);
+}
+
+void b2World::SynchronizeIslands()
+{
+	b2Timer timer;
+	// Synchronize fixtures, check for out of range bodies.
+	for (b2Body* b = m_bodyList; b; b = b->GetNext())
+	{
+		// If a body was not in an island then it did not move.
+		if ((b->m_flags & b2Body::e_islandFlag) == 0)
+		{
+			continue;
+		}
+
+		if (b->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+
+		// Update fixtures (for broad-phase).
+		b->SynchronizeFixtures();
 	}
+
+	// Look for new contacts.
+	m_contactManager.FindNewContacts();
+	m_profile.broadphase = timer.GetMilliseconds();
 }
 
 // Find TOI contacts and solve them.
@@ -861,6 +1210,7 @@ void b2World::SolveTOI(const b2TimeStep& step)
 		subStep.positionIterations = 20;
 		subStep.velocityIterations = step.velocityIterations;
 		subStep.warmStarting = false;
+		subStep.simdContactSolver = false;
 		island.SolveTOI(subStep, bA->m_islandIndex, bB->m_islandIndex);
 
 		// Reset island flags and synchronize broad-phase proxies.
@@ -924,6 +1274,7 @@ void b2World::Step(float32 dt, int32 velocityIterations, int32 positionIteration
 	step.dtRatio = m_inv_dt0 * dt;
 
 	step.warmStarting = m_warmStarting;
+	step.simdContactSolver = m_simdContactSolver;
 	
 	// Update contacts. This is where some contacts are destroyed.
 	{
@@ -1315,3 +1666,354 @@ void b2World::Dump()
 	b2Log("joints = NULL;\n");
 	b2Log("bodies = NULL;\n");
 }
+
+struct b2WorldState
+{
+	int32 size;
+	int32 broadPhaseSize;
+	int32 bodyCount;
+	int32 jointCount;
+	int32 contactCount;
+	int32 flags;
+	float32 inv_dt0;
+	bool stepComplete;
+};
+
+struct b2BodyState
+{
+	b2Body* body;
+	int32 fixtureCount;
+	uint16 flags;
+	b2Transform xf;
+	b2Sweep sweep;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	b2Vec2 force;
+	float32 torque;
+	float32 mass, invMass;
+	float32 I, invI;
+	float32 linearDamping;
+	float32 angularDamping;
+	float32 gravityScale;
+	float32 sleepTime;
+};
+
+struct b2FixtureState
+{
+	b2Fixture* fixture;
+	int32 proxyCount;
+};
+
+struct b2ProxyState
+{
+	int32 proxyId;
+	b2AABB aabb;
+};
+
+struct b2JointState
+{
+	b2Joint* joint;
+	b2JointType type;
+};
+
+struct b2ContactState
+{
+	b2Fixture* fixtureA;
+	b2Fixture* fixtureB;
+	int32 indexA;
+	int32 indexB;
+	uint32 flags;
+	b2Manifold manifold;
+	int32 toiCount;
+	float32 toi;
+	float32 friction;
+	float32 restitution;
+	void* userData;
+};
+
+static void b2WriteState(char*& p, const void* data, int32 size)
+{
+	memcpy(p, data, size);
+	p += size;
+}
+
+static void b2ReadState(const char*& p, void* data, int32 size)
+{
+	memcpy(data, p, size);
+	p += size;
+}
+
+int32 b2World::GetStateSize() const
+{
+	int32 size = sizeof(b2WorldState) + m_contactManager.m_broadPhase.GetStateSize();
+
+	for (const b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		size += sizeof(b2BodyState);
+		for (const b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			size += sizeof(b2FixtureState) + f->m_proxyCount * sizeof(b2ProxyState);
+		}
+	}
+
+	for (const b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		size += sizeof(b2JointState) + b2Joint::GetSize(j->m_type);
+	}
+
+	size += m_contactManager.m_contactCount * sizeof(b2ContactState);
+	return size;
+}
+
+void b2World::SaveState(void* buffer) const
+{
+	b2Assert(IsLocked() == false);
+
+	const b2BroadPhase& broadPhase = m_contactManager.m_broadPhase;
+
+	b2WorldState state;
+	state.size = GetStateSize();
+	state.broadPhaseSize = broadPhase.GetStateSize();
+	state.bodyCount = m_bodyCount;
+	state.jointCount = m_jointCount;
+	state.contactCount = m_contactManager.m_contactCount;
+	state.flags = m_flags;
+	state.inv_dt0 = m_inv_dt0;
+	state.stepComplete = m_stepComplete;
+
+	char* p = (char*)buffer;
+	b2WriteState(p, &state, sizeof(b2WorldState));
+
+	broadPhase.SaveState(p);
+	p += state.broadPhaseSize;
+
+	for (const b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b2BodyState bodyState;
+		bodyState.body = const_cast<b2Body*>(b);
+		bodyState.fixtureCount = b->m_fixtureCount;
+		bodyState.flags = b->m_flags;
+		bodyState.xf = b->m_xf;
+		bodyState.sweep = b->m_sweep;
+		bodyState.linearVelocity = b->m_linearVelocity;
+		bodyState.angularVelocity = b->m_angularVelocity;
+		bodyState.force = b->m_force;
+		bodyState.torque = b->m_torque;
+		bodyState.mass = b->m_mass;
+		bodyState.invMass = b->m_invMass;
+		bodyState.I = b->m_I;
+		bodyState.invI = b->m_invI;
+		bodyState.linearDamping = b->m_linearDamping;
+		bodyState.angularDamping = b->m_angularDamping;
+		bodyState.gravityScale = b->m_gravityScale;
+		bodyState.sleepTime = b->m_sleepTime;
+		b2WriteState(p, &bodyState, sizeof(b2BodyState));
+
+		for (const b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			b2FixtureState fixtureState;
+			fixtureState.fixture = const_cast<b2Fixture*>(f);
+			fixtureState.proxyCount = f->m_proxyCount;
+			b2WriteState(p, &fixtureState, sizeof(b2FixtureState));
+
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2ProxyState proxyState;
+				proxyState.proxyId = f->m_proxies[i].proxyId;
+				proxyState.aabb = f->m_proxies[i].aabb;
+				b2WriteState(p, &proxyState, sizeof(b2ProxyState));
+			}
+		}
+	}
+
+	// Joints only point at bodies and other joints, which must be the same
+	// when restoring, so the whole joint is copied.
+	for (const b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		b2JointState jointState;
+		jointState.joint = const_cast<b2Joint*>(j);
+		jointState.type = j->m_type;
+		b2WriteState(p, &jointState, sizeof(b2JointState));
+		b2WriteState(p, j, b2Joint::GetSize(j->m_type));
+	}
+
+	for (const b2Contact* c = m_contactManager.m_contactList; c; c = c->m_next)
+	{
+		b2ContactState contactState;
+		contactState.fixtureA = c->m_fixtureA;
+		contactState.fixtureB = c->m_fixtureB;
+		contactState.indexA = c->m_indexA;
+		contactState.indexB = c->m_indexB;
+		contactState.flags = c->m_flags;
+		contactState.manifold = c->m_manifold;
+		contactState.toiCount = c->m_toiCount;
+		contactState.toi = c->m_toi;
+		contactState.friction = c->m_friction;
+		contactState.restitution = c->m_restitution;
+		contactState.userData = c->m_userData;
+		b2WriteState(p, &contactState, sizeof(b2ContactState));
+	}
+
+	b2Assert(p - (char*)buffer == state.size);
+}
+
+int32 b2World::GetSimdContactSolverWidth()
+{
+	return b2ContactSolver::GetSimdWidth();
+}
+
+bool b2World::IsStateValid(const void* buffer, int32 size)
+{
+	if (buffer == NULL || size < (int32)sizeof(b2WorldState))
+	{
+		return false;
+	}
+
+	b2WorldState state;
+	memcpy(&state, buffer, sizeof(b2WorldState));
+	return state.size == size && state.broadPhaseSize >= 0 && state.broadPhaseSize <= size - (int32)sizeof(b2WorldState) &&
+		state.bodyCount >= 0 && state.jointCount >= 0 && state.contactCount >= 0;
+}
+
+bool b2World::RestoreState(const void* buffer, int32 size)
+{
+	b2Assert(IsLocked() == false);
+	if (IsLocked() || size < (int32)sizeof(b2WorldState))
+	{
+		return false;
+	}
+
+	const char* p = (const char*)buffer;
+	b2WorldState state;
+	b2ReadState(p, &state, sizeof(b2WorldState));
+
+	if (state.size != size || state.bodyCount != m_bodyCount || state.jointCount != m_jointCount)
+	{
+		return false;
+	}
+
+	const char* broadPhaseState = p;
+	p += state.broadPhaseSize;
+
+	// Make sure nothing was created or destroyed before changing anything.
+	const char* bodyStates = p;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b2BodyState bodyState;
+		b2ReadState(p, &bodyState, sizeof(b2BodyState));
+		if (bodyState.body != b || bodyState.fixtureCount != b->m_fixtureCount ||
+			(bodyState.flags & b2Body::e_activeFlag) != (b->m_flags & b2Body::e_activeFlag))
+		{
+			return false;
+		}
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			b2FixtureState fixtureState;
+			b2ReadState(p, &fixtureState, sizeof(b2FixtureState));
+			if (fixtureState.fixture != f || fixtureState.proxyCount != f->m_proxyCount)
+			{
+				return false;
+			}
+
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2ProxyState proxyState;
+				b2ReadState(p, &proxyState, sizeof(b2ProxyState));
+				if (proxyState.proxyId != f->m_proxies[i].proxyId)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		b2JointState jointState;
+		b2ReadState(p, &jointState, sizeof(b2JointState));
+		if (jointState.joint != j || jointState.type != j->m_type)
+		{
+			return false;
+		}
+		p += b2Joint::GetSize(j->m_type);
+	}
+
+	// Throw out the current contacts without reporting them.
+	b2Contact* c = m_contactManager.m_contactList;
+	while (c)
+	{
+		b2Contact* next = c->m_next;
+		b2Contact::Destroy(c, &m_blockAllocator);
+		c = next;
+	}
+	m_contactManager.m_contactList = NULL;
+	m_contactManager.m_contactCount = 0;
+
+	m_contactManager.m_broadPhase.RestoreState(broadPhaseState);
+
+	p = bodyStates;
+	for (b2Body* b = m_bodyList; b; b = b->m_next)
+	{
+		b2BodyState bodyState;
+		b2ReadState(p, &bodyState, sizeof(b2BodyState));
+		b->m_flags = bodyState.flags;
+		b->m_xf = bodyState.xf;
+		b->m_sweep = bodyState.sweep;
+		b->m_linearVelocity = bodyState.linearVelocity;
+		b->m_angularVelocity = bodyState.angularVelocity;
+		b->m_force = bodyState.force;
+		b->m_torque = bodyState.torque;
+		b->m_mass = bodyState.mass;
+		b->m_invMass = bodyState.invMass;
+		b->m_I = bodyState.I;
+		b->m_invI = bodyState.invI;
+		b->m_linearDamping = bodyState.linearDamping;
+		b->m_angularDamping = bodyState.angularDamping;
+		b->m_gravityScale = bodyState.gravityScale;
+		b->m_sleepTime = bodyState.sleepTime;
+		b->m_contactList = NULL;
+
+		for (b2Fixture* f = b->m_fixtureList; f; f = f->m_next)
+		{
+			p += sizeof(b2FixtureState);
+			for (int32 i = 0; i < f->m_proxyCount; ++i)
+			{
+				b2ProxyState proxyState;
+				b2ReadState(p, &proxyState, sizeof(b2ProxyState));
+				f->m_proxies[i].aabb = proxyState.aabb;
+			}
+		}
+	}
+
+	for (b2Joint* j = m_jointList; j; j = j->m_next)
+	{
+		p += sizeof(b2JointState);
+		b2ReadState(p, j, b2Joint::GetSize(j->m_type));
+	}
+
+	// Contacts are pushed onto the front of the lists, so recreate them
+	// backwards to get the same order in the world and every body.
+	const b2ContactState* contactStates = (const b2ContactState*)p;
+	for (int32 i = state.contactCount - 1; i >= 0; --i)
+	{
+		b2ContactState contactState;
+		memcpy(&contactState, contactStates + i, sizeof(b2ContactState));
+
+		c = b2Contact::Create(contactState.fixtureA, contactState.indexA, contactState.fixtureB, contactState.indexB, &m_blockAllocator);
+		b2Assert(c && c->m_fixtureA == contactState.fixtureA);
+		c->m_flags = contactState.flags;
+		c->m_manifold = contactState.manifold;
+		c->m_toiCount = contactState.toiCount;
+		c->m_toi = contactState.toi;
+		c->m_friction = contactState.friction;
+		c->m_restitution = contactState.restitution;
+		c->m_userData = contactState.userData;
+		m_contactManager.Insert(c);
+	}
+
+	m_flags = (m_flags & ~e_newFixture) | (state.flags & e_newFixture);
+	m_inv_dt0 = state.inv_dt0;
+	m_stepComplete = state.stepComplete;
+	return true;
+}
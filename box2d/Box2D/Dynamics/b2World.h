@@ -66,6 +66,16 @@ public:
 	/// by you and must remain in scope.
 	void SetDebugDraw(b2Draw* debugDraw);
 
+	/// Register a task executor to solve islands on multiple threads.
+	/// Islands are solved on the calling thread if this is NULL or the
+	/// executor only has one thread. The executor is owned by you and must
+	/// remain in scope.
+	/// @warning This function is locked during callbacks.
+	void SetTaskExecutor(b2TaskExecutor* executor);
+
+	/// Get the task executor, may be NULL.
+	b2TaskExecutor* GetTaskExecutor() const;
+
 	/// Create a rigid body given a definition. No reference to the definition
 	/// is retained.
 	/// @warning This function is locked during callbacks.
@@ -149,6 +159,15 @@ public:
 	void SetWarmStarting(bool flag) { m_warmStarting = flag; }
 	bool GetWarmStarting() const { return m_warmStarting; }
 
+	/// Enable/disable the SIMD contact solver. Contacts that don't share
+	/// bodies are solved together, so results differ slightly from the
+	/// scalar solver. Ignored when built without SSE2.
+	void SetSimdContactSolver(bool flag) { m_simdContactSolver = flag; }
+	bool GetSimdContactSolver() const { return m_simdContactSolver; }
+
+	/// Number of contacts the SIMD contact solver handles at once, 0 if it was compiled out.
+	static int32 GetSimdContactSolverWidth();
+
 	/// Enable/disable continuous physics. For testing.
 	void SetContinuousPhysics(bool flag) { m_continuousPhysics = flag; }
 	bool GetContinuousPhysics() const { return m_continuousPhysics; }
@@ -204,6 +223,26 @@ public:
 	/// @warning this should be called outside of a time step.
 	void Dump();
 
+	/// Get the number of bytes needed to save the simulation state.
+	int32 GetStateSize() const;
+
+	/// Save the simulation state into a buffer of GetStateSize() bytes. This includes
+	/// body motion, joint impulses, contacts with their warm starting impulses and the
+	/// broad-phase. Bodies, fixtures and joints are saved by address, not by definition.
+	/// @warning this should be called outside of a time step.
+	void SaveState(void* buffer) const;
+
+	/// Restore a state saved by SaveState. The world must have the same bodies, fixtures
+	/// and joints it had when the state was saved, otherwise nothing is changed and this
+	/// returns false. Contacts are rebuilt without calling the contact listener.
+	/// Stepping after a restore gives the same results as stepping after the save.
+	/// @warning this should be called outside of a time step.
+	bool RestoreState(const void* buffer, int32 size);
+
+	/// Check that a buffer looks like a whole state saved by SaveState, without
+	/// comparing it to any world.
+	static bool IsStateValid(const void* buffer, int32 size);
+
 private:
 
 	// m_flags
@@ -220,7 +259,10 @@ private:
 	friend class b2Controller;
 
 	void Solve(const b2TimeStep& step);
+	void SolveParallel(const b2TimeStep& step);
 	void SolveTOI(const b2TimeStep& step);
+	void SynchronizeIslands();
+	void FreeThreadAllocators();
 
 	void DrawJoint(b2Joint* joint);
 	void DrawShape(b2Fixture* shape, const b2Transform& xf, const b2Color& color);
@@ -244,12 +286,18 @@ private:
 	b2DestructionListener* m_destructionListener;
 	b2Draw* m_debugDraw;
 
+	// Used to solve islands in parallel, each thread gets its own allocator.
+	b2TaskExecutor* m_taskExecutor;
+	b2StackAllocator* m_threadAllocators;
+	int32 m_threadAllocatorCount;
+
 	// This is used to compute the time step ratio to
 	// support a variable time step.
 	float32 m_inv_dt0;
 
 	// These are for debugging the solver.
 	bool m_warmStarting;
+	bool m_simdContactSolver;
 	bool m_continuousPhysics;
 	bool m_subStepping;
 
@@ -341,6 +389,11 @@ inline const b2ContactManager& b2World::GetContactManager() const
 	return m_contactManager;
 }
 
+inline b2TaskExecutor* b2World::GetTaskExecutor() const
+{
+	return m_taskExecutor;
+}
+
 inline const b2Profile& b2World::GetProfile() const
 {
 	return m_profile;
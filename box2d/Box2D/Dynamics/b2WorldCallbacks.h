@@ -152,4 +152,34 @@ public:
 									const b2Vec2& normal, float32 fraction) = 0;
 };
 
+/// A unit of work that can be split up across threads.
+/// See b2TaskExecutor
+class b2Task
+{
+public:
+	virtual ~b2Task() {}
+
+	/// Run one item of the task.
+	/// @param index the item to run, from 0 to the count passed to Execute
+	/// @param threadIndex the thread running the item, from 0 to the executor thread count
+	virtual void Run(int32 index, int32 threadIndex) = 0;
+};
+
+/// Implement this to let the world solve islands on multiple threads.
+/// Box2D does not create threads itself. Islands are collected first and
+/// then solved in parallel, post solve callbacks are buffered and reported
+/// afterwards in the same order as the single threaded solver.
+/// See b2World::SetTaskExecutor
+class b2TaskExecutor
+{
+public:
+	virtual ~b2TaskExecutor() {}
+
+	/// How many threads run tasks, including the calling thread.
+	virtual int32 GetThreadCount() const = 0;
+
+	/// Run every item of the task and return when they are all finished.
+	virtual void Execute(b2Task* task, int32 count) = 0;
+};
+
 #endif